@@ -2,9 +2,13 @@
 
 #include "Controller.h"
 #include "ServerConn.h"
+#include "ThreadPool.h"
 #include "model/Model.h"
 #include "IServerEvent.h"
 #include "log/Log.h"
+#include "log/Metrics.h"
+#include "log/Trace.h"
+#include "log/Watchdog.h"
 #include "FlobbyDirs.h"
 
 #include <boost/bind.hpp>
@@ -22,17 +26,32 @@ static Controller* controller_ = nullptr;
 Controller::Controller():
     client_(0),
     model_(0),
-    ui_(0),
+    eventLoop_(0),
     connected_(false),
     nextThreadId_(1)
 {
     // ugly singleton
     assert(controller_ == 0);
     controller_ = this;
+
+    // downloads and other short jobs share the default lane, an engine process can run beside a demo in the engine lane
+    // a running game must not block exit so the engine lane is not waited for
+    // archive prefetch reads up to a GB from disk, one thread of its own keeps it from delaying other jobs
+    std::vector<std::size_t> laneSizes(3);
+    laneSizes[JL_DEFAULT] = 4;
+    laneSizes[JL_ENGINE] = 2;
+    laneSizes[JL_PREFETCH] = 1;
+    threadPool_.reset(new ThreadPool(laneSizes, boost::bind(&Controller::threadDone, this, _1, _2), { JL_ENGINE }));
 }
 
 Controller::~Controller()
 {
+    for (std::size_t lane : { JL_DEFAULT, JL_ENGINE, JL_PREFETCH })
+    {
+        ThreadPool::Stats const stats = threadPool_->stats(lane);
+        LOG(DEBUG) << "thread pool lane " << lane << ": jobs " << stats.jobs_ << " canceled " << stats.canceled_
+                   << " wait " << stats.waitSeconds_ << "s run " << stats.runSeconds_ << "s max run " << stats.maxRunSeconds_ << "s";
+    }
 }
 
 void Controller::setIControllerEvent(IControllerEvent & iControllerEvent)
@@ -69,15 +88,13 @@ uint64_t Controller::timeNow() const
     return duration_cast<milliseconds>(diff).count();
 }
 
-unsigned int Controller::startThread(boost::function<int()> function)
+unsigned int Controller::startThread(boost::function<int()> function, JobLane lane, int priority)
 {
     unsigned int threadId = nextThreadId_;
-    LOG(DEBUG) << "startThread " << threadId;
-
-    boost::lock_guard<boost::mutex> lock(mutexThreads_); // protect threads_
+    LOG(DEBUG) << "startThread " << threadId << " lane " << lane << " priority " << priority;
 
-    boost::thread* t = new boost::thread(boost::bind(&Controller::runThread, this, function, threadId));
-    threads_[threadId] = ThreadInfo(t);
+    // plain functions ignore the cancel token, queued jobs can still be canceled
+    threadPool_->submit(threadId, boost::bind(function), lane, priority);
 
     ++nextThreadId_;
     nextThreadId_ = std::max(nextThreadId_, 1U); // make sure it doesn't wrap to zero
@@ -85,41 +102,74 @@ unsigned int Controller::startThread(boost::function<int()> function)
     return threadId;
 }
 
-void Controller::runThread(boost::function<int()> function, unsigned int id)
+bool Controller::cancelThread(unsigned int id)
 {
-    LOG(DEBUG) << "runThread " << id;
+    LOG(DEBUG) << "cancelThread " << id;
+    return threadPool_->cancel(id);
+}
 
-    int const res = function();
+void Controller::stopThreads()
+{
+    threadPool_->stop();
+}
 
+void Controller::startTimer(double seconds, boost::function<void()> function)
+{
+    uint64_t const due = timeNow() + static_cast<uint64_t>(seconds*1000);
+    timers_.insert(std::make_pair(due, function));
+    scheduleTimer();
+}
+
+void Controller::scheduleTimer()
+{
+    // one event loop timeout for the first due timer
+    eventLoop_->removeTimeout(&timerCallback, this);
+    if (!timers_.empty())
     {
-        boost::lock_guard<boost::mutex> lock(mutexThreads_);
-        Threads::iterator it = threads_.find(id);
-        LOG_IF(FATAL, it == threads_.end())<< "thread " << id << "not found";
-        it->second.result_ = res;
+        uint64_t const now = timeNow();
+        uint64_t const due = timers_.begin()->first;
+        eventLoop_->addTimeout(due > now ? (due - now)/1000.0 : 0.0, &timerCallback, this);
     }
-
-    ui_->addCallbackEvent(&threadDoneCallback, reinterpret_cast<void*>(static_cast<uintptr_t>(id)) );
 }
 
-void Controller::threadDoneCallback(void* data)
+void Controller::timerCallback(void * data)
 {
-    unsigned int id = reinterpret_cast<uintptr_t>(data);
+    Controller* c = static_cast<Controller*>(data);
 
-    int result;
+    uint64_t const now = c->timeNow();
+    while (!c->timers_.empty() && c->timers_.begin()->first <= now)
     {
-        boost::lock_guard<boost::mutex> lock(controller_->mutexThreads_); // protect threads_
+        boost::function<void()> const function = c->timers_.begin()->second;
+        c->timers_.erase(c->timers_.begin());
+        function(); // can add timers
+    }
+    c->scheduleTimer();
+}
 
-        Threads::iterator it = controller_->threads_.find(id);
-        LOG_IF(FATAL, it == controller_->threads_.end())<< "thread " << id << "not found";
+void Controller::threadDone(unsigned int id, int result)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutexDone_);
+        doneQueue_.push_back(std::make_pair(id, result));
+    }
+    eventLoop_->addCallbackEvent(&threadDoneCallback, this);
+}
+
+void Controller::threadDoneCallback(void* data)
+{
+    Controller* c = static_cast<Controller*>(data);
 
-        ThreadInfo& ti = it->second;
-        result = ti.result_;
+    DoneQueue doneQueue;
+    {
+        boost::lock_guard<boost::mutex> lock(c->mutexDone_);
+        doneQueue.swap(c->doneQueue_);
+    }
 
-        ti.thread_->join();
-        delete ti.thread_;
-        controller_->threads_.erase(it);
+    // processDone is called without lock held as it may start new threads
+    for (auto const & idResult : doneQueue)
+    {
+        c->client_->processDone(idResult);
     }
-    controller_->client_->processDone(std::make_pair(id, result));
 }
 
 void Controller::connected(bool connected)
@@ -129,7 +179,7 @@ void Controller::connected(bool connected)
         connectedQueue_.push_back(connected);
         LOG_IF(DEBUG, connectedQueue_.size() > 1) << "connectedQueue_.size():" << connectedQueue_.size();
     }
-    ui_->addCallbackEvent(&connectedCallback, this);
+    eventLoop_->addCallbackEvent(&connectedCallback, this);
 }
 
 void Controller::disconnect()
@@ -139,13 +189,15 @@ void Controller::disconnect()
 
 void Controller::message(std::string const & msg)
 {
+    static MetricsGauge & queueDepth = Metrics::gauge("controller.recv_queue");
     {
         boost::lock_guard<boost::recursive_mutex> lock(mutexRecv_);
         recvQueue_.push_back(msg);
+        queueDepth.set(recvQueue_.size());
         LOG_IF(DEBUG, recvQueue_.size() > 10) << "recvQueue_.size():" << recvQueue_.size();
     }
 
-    ui_->addCallbackEvent(&messageCallback, this);
+    eventLoop_->addCallbackEvent(&messageCallback, this);
 }
 
 void Controller::connectedCallback(void * data)
@@ -165,14 +217,27 @@ void Controller::connectedCallback(void * data)
 
 void Controller::messageCallback(void *data)
 {
+    static MetricsGauge & queueDepth = Metrics::gauge("controller.recv_queue");
+    static MetricsHistogram & batchSize = Metrics::histogram("controller.recv_batch");
+    TraceSpan span("messageCallback", "controller");
+    Watchdog::beat();
+    WatchdogActivity activity("messageCallback");
     Controller* c = static_cast<Controller*>(data);
 
     boost::lock_guard<boost::recursive_mutex> lock(c->mutexRecv_);
 
+    bool const batch = !c->recvQueue_.empty();
+    std::size_t const size = c->recvQueue_.size();
     while (!c->recvQueue_.empty())
     {
         auto msg = c->recvQueue_.front();
         c->recvQueue_.pop_front();
         c->client_->message(msg);
     }
+    queueDepth.set(0);
+    if (batch)
+    {
+        batchSize.record(size);
+        c->client_->messageBatchDone();
+    }
 }
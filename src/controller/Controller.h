@@ -4,7 +4,7 @@
 
 #include "model/IController.h"
 #include "IServerEvent.h"
-#include "gui/UserInterface.h"
+#include "IEventLoop.h"
 
 #include <boost/thread.hpp>
 #include <deque>
@@ -16,6 +16,7 @@
 //
 class Model;
 class ServerConn;
+class ThreadPool;
 
 class Controller : public IController, public IServerEvent
 {
@@ -24,7 +25,7 @@ public:
     virtual ~Controller();
 
     void model(Model & model) { model_ = &model; }
-    void userInterface(UserInterface & ui) { ui_ = &ui; }
+    void eventLoop(IEventLoop & eventLoop) { eventLoop_ = &eventLoop; } // UserInterface or HeadlessEventLoop
 
     // IController (called by model)
     void setIControllerEvent(IControllerEvent & iControllerEvent);
@@ -33,13 +34,15 @@ public:
     void send(std::string const& msg);
     uint64_t lastSendTime() const;
     uint64_t timeNow() const;
-    unsigned int startThread(boost::function<int()> function);
-    void runThread(boost::function<int()> function, unsigned int id);
+    unsigned int startThread(boost::function<int()> function, JobLane lane = JL_DEFAULT, int priority = 0);
+    bool cancelThread(unsigned int id);
+    void stopThreads(); // before the objects used by jobs are destroyed, see ThreadPool::stop
+    void startTimer(double seconds, boost::function<void()> function);
 
 private:
     IControllerEvent * client_;
     Model * model_;
-    UserInterface * ui_;
+    IEventLoop * eventLoop_;
     bool connected_;
     std::unique_ptr<ServerConn> server_;
 
@@ -51,28 +54,29 @@ private:
 
     boost::mutex mutexConnected_;
     boost::recursive_mutex mutexRecv_;
-    boost::mutex mutexThreads_;
+    boost::mutex mutexDone_;
 
     // IServerEvent (called by server_ from its own thread)
     //
     void connected(bool connected);
     void message(std::string const & msg);
 
-    // FLTK callbacks
+    // event loop callbacks
     //
     static void connectedCallback(void * data);
     static void messageCallback(void * data);
 
     unsigned int nextThreadId_;
+    std::unique_ptr<ThreadPool> threadPool_;
+
+    typedef std::deque<std::pair<unsigned int, int>> DoneQueue; // id, result
+    DoneQueue doneQueue_;
+
+    void threadDone(unsigned int id, int result); // called by threadPool_ from worker thread
     static void threadDoneCallback(void * data);
 
-    struct ThreadInfo
-    {
-        boost::thread* thread_;
-        int result_;
-        ThreadInfo(): thread_(nullptr), result_(-1) {}
-        ThreadInfo(boost::thread* thread): thread_(thread), result_(-1) {}
-    };
-    typedef std::map<unsigned int, ThreadInfo> Threads;
-    Threads threads_;
+    typedef std::multimap<uint64_t, boost::function<void()>> Timers; // due time (timeNow) -> function
+    Timers timers_;
+    void scheduleTimer();
+    static void timerCallback(void * data);
 };
@@ -0,0 +1,128 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "HeadlessEventLoop.h"
+
+#include <algorithm>
+#include <cassert>
+
+HeadlessEventLoop::HeadlessEventLoop():
+    quit_(false)
+{
+}
+
+HeadlessEventLoop::~HeadlessEventLoop()
+{
+}
+
+void HeadlessEventLoop::addCallbackEvent(Callback cb, void * data)
+{
+    assert(cb != 0);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(Event(cb, data));
+    }
+    cv_.notify_one();
+}
+
+void HeadlessEventLoop::addTimeout(double seconds, Callback cb, void * data)
+{
+    assert(cb != 0);
+    Clock::time_point const due = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timeouts_.insert(std::make_pair(due, Event(cb, data))); // after those with the same due time
+    }
+    cv_.notify_one();
+}
+
+void HeadlessEventLoop::removeTimeout(Callback cb, void * data)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = timeouts_.begin(); it != timeouts_.end(); )
+    {
+        if (it->second == Event(cb, data))
+        {
+            it = timeouts_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void HeadlessEventLoop::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (runOne(lock, Clock::time_point::max()))
+    {
+    }
+    quit_ = false;
+}
+
+void HeadlessEventLoop::quit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_one();
+}
+
+unsigned int HeadlessEventLoop::runFor(double seconds)
+{
+    Clock::time_point const until = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    unsigned int count = 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (runOne(lock, until))
+    {
+        ++count;
+    }
+    quit_ = false;
+    return count;
+}
+
+bool HeadlessEventLoop::runOne(std::unique_lock<std::mutex> & lock, Clock::time_point until)
+{
+    while (!quit_)
+    {
+        Clock::time_point const now = Clock::now();
+        bool const timeoutDue = !timeouts_.empty() && timeouts_.begin()->first <= now;
+        if (!events_.empty() || timeoutDue)
+        {
+            Event event;
+            if (!events_.empty())
+            {
+                event = events_.front();
+                events_.pop_front();
+            }
+            else
+            {
+                event = timeouts_.begin()->second;
+                timeouts_.erase(timeouts_.begin());
+            }
+
+            // callbacks can add events and timeouts
+            lock.unlock();
+            event.first(event.second);
+            lock.lock();
+            return true;
+        }
+
+        if (now >= until)
+        {
+            return false;
+        }
+
+        if (timeouts_.empty() && until == Clock::time_point::max())
+        {
+            cv_.wait(lock);
+        }
+        else
+        {
+            cv_.wait_until(lock, timeouts_.empty() ? until : std::min(until, timeouts_.begin()->first));
+        }
+    }
+    return false;
+}
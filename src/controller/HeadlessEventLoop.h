@@ -0,0 +1,44 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "IEventLoop.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// event loop without FLTK and X, for running the model from the command line or in tests
+// same ordering as the FLTK loop: callback events in the order they were added,
+// timeouts in the order they are due (in the order they were added if due at the same time)
+class HeadlessEventLoop: public IEventLoop
+{
+public:
+    HeadlessEventLoop();
+    virtual ~HeadlessEventLoop();
+
+    // IEventLoop
+    void addCallbackEvent(Callback cb, void * data);
+    void addTimeout(double seconds, Callback cb, void * data);
+    void removeTimeout(Callback cb, void * data);
+
+    void run(); // runs callbacks in calling thread until quit()
+    void quit(); // from any thread, run() returns after the current callback
+
+    unsigned int runFor(double seconds); // like run() but returns after seconds, returns number of callbacks run
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::pair<Callback, void *> Event;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Event> events_;
+    std::multimap<Clock::time_point, Event> timeouts_;
+    bool quit_;
+
+    bool runOne(std::unique_lock<std::mutex> & lock, Clock::time_point until); // false if nothing ran until
+};
@@ -0,0 +1,19 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+// the thread the model runs in, UserInterface (FLTK) or HeadlessEventLoop
+// callbacks run in the loop thread in the order they were added, timeouts after their time
+class IEventLoop
+{
+public:
+    typedef void (*Callback)(void * data);
+
+    virtual void addCallbackEvent(Callback cb, void * data) = 0; // from any thread
+    virtual void addTimeout(double seconds, Callback cb, void * data) = 0; // only from loop thread
+    virtual void removeTimeout(Callback cb, void * data) = 0; // only from loop thread, removes all matching
+
+protected:
+    ~IEventLoop() {}
+
+};
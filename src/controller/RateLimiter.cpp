@@ -0,0 +1,53 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "RateLimiter.h"
+
+#include <algorithm>
+
+RateLimiter::RateLimiter(double bytesPerSecond, double burstBytes, Clock::time_point now):
+    bytesPerSecond_(bytesPerSecond),
+    burstBytes_(burstBytes),
+    tokens_(burstBytes),
+    timeLast_(now)
+{
+}
+
+void RateLimiter::refill(Clock::time_point now)
+{
+    if (now > timeLast_)
+    {
+        double const seconds = std::chrono::duration<double>(now - timeLast_).count();
+        tokens_ = std::min(burstBytes_, tokens_ + seconds*bytesPerSecond_);
+        timeLast_ = now;
+    }
+}
+
+std::size_t RateLimiter::allowance(Clock::time_point now)
+{
+    refill(now);
+    return tokens_ > 0 ? static_cast<std::size_t>(tokens_) : 0;
+}
+
+void RateLimiter::consume(std::size_t bytes)
+{
+    tokens_ -= bytes;
+}
+
+bool RateLimiter::allowed(std::size_t bytes, Clock::time_point now)
+{
+    refill(now);
+    return tokens_ >= std::min<double>(bytes, burstBytes_);
+}
+
+RateLimiter::Clock::duration RateLimiter::delay(std::size_t bytes, Clock::time_point now)
+{
+    refill(now);
+    double const missing = std::min<double>(bytes, burstBytes_) - tokens_;
+    if (missing <= 0)
+    {
+        return Clock::duration::zero();
+    }
+    // round up so the bucket has enough tokens when the delay has passed
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(missing/bytesPerSecond_))
+        + Clock::duration(1);
+}
@@ -0,0 +1,37 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// token bucket limiting outgoing bytes, keeps us below the lobby server flood limit
+// not thread safe, only used from the ServerConn io thread
+class RateLimiter
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // bucket starts full
+    RateLimiter(double bytesPerSecond, double burstBytes, Clock::time_point now = Clock::now());
+
+    // bytes that can be sent at time now without exceeding the limit
+    std::size_t allowance(Clock::time_point now);
+
+    // bytes were sent, can be more than allowance (message larger than burst sent on a full bucket)
+    void consume(std::size_t bytes);
+
+    // true if a message of bytes can be sent, messages larger than burst are allowed when the bucket is full
+    bool allowed(std::size_t bytes, Clock::time_point now);
+
+    // time until a message of bytes will be allowed
+    Clock::duration delay(std::size_t bytes, Clock::time_point now);
+
+private:
+    double const bytesPerSecond_;
+    double const burstBytes_;
+    double tokens_;
+    Clock::time_point timeLast_;
+
+    void refill(Clock::time_point now);
+};
@@ -10,11 +10,22 @@
 
 using boost::asio::ip::tcp;
 
+// uberserver kicks clients sending more than about 2 kB/s averaged over 10 s, stay well below
+static double const sendBytesPerSecond = 1500;
+static double const sendBurstBytes = 8192;
+
+// limit of buffers in one gathered write, asio writes at most 64 buffers per system call
+static std::size_t const maxWriteBuffers = 64;
+
 
 ServerConn::ServerConn(std::string const & host, std::string const & service, IServerEvent & iServerEvent):
     client_(iServerEvent),
     socket_(ioService_),
-    resolver_(ioService_)
+    resolver_(ioService_),
+    sendPosted_(false),
+    rateLimiter_(sendBytesPerSecond, sendBurstBytes),
+    rateTimer_(ioService_),
+    rateWait_(false)
 {
     tcp::resolver::query query(host, service);
 
@@ -31,7 +42,9 @@ ServerConn::ServerConn(std::string const & host, std::string const & service, IS
 
 ServerConn::~ServerConn()
 {
-    doClose();
+    // close on the io thread, it also cancels a pending rate limit wait
+    // if the io thread already ended the socket is already closed
+    ioService_.post(boost::bind(&ServerConn::doClose, this));
     thread_->join();
     LOG(DEBUG) << "ServerConn destroyed";
 }
@@ -60,6 +73,10 @@ void ServerConn::connectHandler(const boost::system::error_code& error)
     if (!error)
     {
         client_.connected(true);
+        if (writing_.empty() && !rateWait_)
+        {
+            startWrite(); // messages queued before connect
+        }
         boost::asio::async_read_until(
                 socket_,
                 recvBuf_,
@@ -107,38 +124,89 @@ void ServerConn::send(std::string msg)
         msg.append(1, '\n');
     }
     LOG(DEBUG) << "ServerConn::send " << msg;
-    ioService_.post(boost::bind(&ServerConn::doSend, this, msg));
+
+    // messages sent while doSend is posted are taken by the same doSend
+    bool post;
+    {
+        std::lock_guard<std::mutex> lock(mutexPending_);
+        pending_.push_back(std::move(msg));
+        post = !sendPosted_;
+        sendPosted_ = true;
+    }
+    if (post)
+    {
+        ioService_.post(boost::bind(&ServerConn::doSend, this));
+    }
 }
 
-void ServerConn::doSend(const std::string & msg)
+void ServerConn::doSend()
 {
-    bool write_in_progress = !sendQueue_.empty();
-    sendQueue_.push_back(msg);
-    if (!write_in_progress)
     {
-        boost::asio::async_write(
-                socket_,
-                boost::asio::buffer(sendQueue_.front().data(),
-                        sendQueue_.front().length()),
-                boost::bind(&ServerConn::writeHandler, this,
-                        boost::asio::placeholders::error));
+        std::lock_guard<std::mutex> lock(mutexPending_);
+        for (std::string & msg : pending_)
+        {
+            sendQueue_.push_back(std::move(msg));
+        }
+        pending_.clear();
+        sendPosted_ = false;
+    }
+
+    if (writing_.empty() && !rateWait_)
+    {
+        startWrite();
+    }
+}
+
+void ServerConn::startWrite()
+{
+    assert(writing_.empty());
+    if (sendQueue_.empty() || !socket_.is_open())
+    {
+        return;
     }
+
+    auto const now = RateLimiter::Clock::now();
+    if (!rateLimiter_.allowed(sendQueue_.front().size(), now))
+    {
+        auto const delay = rateLimiter_.delay(sendQueue_.front().size(), now);
+        LOG(DEBUG) << "send rate limited, waiting " << std::chrono::duration_cast<std::chrono::milliseconds>(delay).count() << " ms";
+        rateWait_ = true;
+        rateTimer_.expires_from_now(delay);
+        rateTimer_.async_wait(boost::bind(&ServerConn::rateTimerHandler, this, boost::asio::placeholders::error));
+        return;
+    }
+
+    // gather all queued messages the rate limit allows into one write, the first is always sent
+    std::size_t const allowance = rateLimiter_.allowance(now);
+    std::size_t bytes = 0;
+    do
+    {
+        bytes += sendQueue_.front().size();
+        writing_.push_back(std::move(sendQueue_.front()));
+        sendQueue_.pop_front();
+    }
+    while (!sendQueue_.empty() && writing_.size() < maxWriteBuffers && bytes + sendQueue_.front().size() <= allowance);
+    rateLimiter_.consume(bytes);
+
+    writeBuffers_.clear();
+    for (std::string const & msg : writing_)
+    {
+        writeBuffers_.push_back(boost::asio::buffer(msg));
+    }
+
+    boost::asio::async_write(
+            socket_,
+            writeBuffers_,
+            boost::bind(&ServerConn::writeHandler, this,
+                    boost::asio::placeholders::error));
 }
 
 void ServerConn::writeHandler(const boost::system::error_code& error)
 {
     if (!error)
     {
-        sendQueue_.pop_front();
-        if (!sendQueue_.empty())
-        {
-            boost::asio::async_write(
-                    socket_,
-                    boost::asio::buffer(sendQueue_.front().data(),
-                            sendQueue_.front().length()),
-                    boost::bind(&ServerConn::writeHandler, this,
-                            boost::asio::placeholders::error));
-        }
+        writing_.clear();
+        startWrite();
     }
     else
     {
@@ -146,10 +214,21 @@ void ServerConn::writeHandler(const boost::system::error_code& error)
     }
 }
 
+void ServerConn::rateTimerHandler(const boost::system::error_code& error)
+{
+    rateWait_ = false;
+    if (!error)
+    {
+        startWrite();
+    }
+}
+
 void ServerConn::doClose()
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
+    rateTimer_.cancel();
+
     if (socket_.is_open())
     {
         socket_.close();
@@ -2,12 +2,16 @@
 
 #pragma once
 
+#include "RateLimiter.h"
+
 #include <boost/asio.hpp>
 #include <boost/signals2/signal.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/array.hpp>
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <vector>
 
 // forwards
 class IServerEvent;
@@ -19,7 +23,7 @@ public:
     ServerConn(std::string const & host, std::string const & service, IServerEvent & iServerEvent);
     virtual ~ServerConn();
 
-    void send(std::string msg);
+    void send(std::string msg); // thread safe, msg is moved to the send queue
 
 private:
     IServerEvent & client_;
@@ -30,8 +34,19 @@ private:
     boost::asio::streambuf recvBuf_;
     std::unique_ptr<std::thread> thread_;
 
+    // messages from send, moved to sendQueue_ by doSend on the io thread
+    std::mutex mutexPending_;
+    std::vector<std::string> pending_;
+    bool sendPosted_; // doSend is posted and will take pending_
+
+    // below is only accessed from the io thread
     typedef std::deque<std::string> SendQueue;
     SendQueue sendQueue_;
+    std::vector<std::string> writing_; // messages in the current gathered write
+    std::vector<boost::asio::const_buffer> writeBuffers_;
+    RateLimiter rateLimiter_;
+    boost::asio::steady_timer rateTimer_;
+    bool rateWait_;
 
     void resolveHandler(
         const boost::system::error_code& error,
@@ -39,8 +54,10 @@ private:
     void connectHandler(const boost::system::error_code& error);
     void readHandler(const boost::system::error_code& error, std::size_t bytes);
 
-    void doSend(const std::string & msg);
+    void doSend();
+    void startWrite();
     void writeHandler(const boost::system::error_code& error);
+    void rateTimerHandler(const boost::system::error_code& error);
 
     void doClose();
 
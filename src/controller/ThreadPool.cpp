@@ -0,0 +1,282 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "ThreadPool.h"
+#include "log/Log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+int const ThreadPool::stopSeconds;
+
+struct ThreadPool::State
+{
+    struct QueuedJob
+    {
+        unsigned int id_;
+        Job job_;
+        CancelToken token_;
+        Clock::time_point queued_;
+    };
+
+    // ordered by descending priority, then submit order
+    typedef std::map<std::pair<int, uint64_t>, QueuedJob> Queue;
+
+    struct Lane
+    {
+        Queue queue_;
+        std::condition_variable cond_;
+        Stats stats_;
+        std::size_t workers_; // not exited yet
+        bool detached_; // not waited for by stop, constant
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    std::map<unsigned int, CancelToken> running_;
+    uint64_t seq_;
+    bool stop_;
+    DoneFunction done_; // cleared by stop
+    unsigned int callingDone_; // done calls in progress
+    std::condition_variable stopCond_; // notified when a worker exits or a done call returns
+
+    State(): seq_(0), stop_(false), callingDone_(0) {}
+
+    void callDone(DoneFunction const & done, unsigned int id, int result);
+};
+
+void ThreadPool::State::callDone(DoneFunction const & done, unsigned int id, int result)
+{
+    // done was copied with callingDone_ incremented so stop can wait for the call
+    done(id, result);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --callingDone_;
+    }
+    stopCond_.notify_all();
+}
+
+ThreadPool::ThreadPool(std::vector<std::size_t> const & laneSizes, DoneFunction done, std::vector<std::size_t> const & detachedLanes):
+    state_(std::make_shared<State>())
+{
+    state_->done_ = done;
+
+    for (std::size_t lane = 0; lane < laneSizes.size(); ++lane)
+    {
+        state_->lanes_.emplace_back(new State::Lane());
+        State::Lane & l = *state_->lanes_.back();
+        l.stats_ = Stats{0, 0, 0, 0, 0};
+        l.workers_ = std::max<std::size_t>(1, laneSizes[lane]);
+        l.detached_ = std::find(detachedLanes.begin(), detachedLanes.end(), lane) != detachedLanes.end();
+    }
+
+    for (std::size_t lane = 0; lane < laneSizes.size(); ++lane)
+    {
+        for (std::size_t i = 0; i < state_->lanes_[lane]->workers_; ++i)
+        {
+            workers_.push_back(Worker{lane, std::unique_ptr<std::thread>(new std::thread(&ThreadPool::worker, state_, lane))});
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::stop()
+{
+    if (workers_.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        state_->stop_ = true;
+        state_->done_.clear();
+        for (auto & lane : state_->lanes_)
+        {
+            lane->queue_.clear();
+        }
+        for (auto & pair : state_->running_)
+        {
+            pair.second.cancel();
+        }
+    }
+
+    for (auto & lane : state_->lanes_)
+    {
+        lane->cond_.notify_all();
+    }
+
+    bool stopped;
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex_);
+        state_->stopCond_.wait(lock, [this]() { return state_->callingDone_ == 0; });
+        stopped = state_->stopCond_.wait_for(lock, std::chrono::seconds(stopSeconds), [this]()
+            {
+                return std::all_of(state_->lanes_.begin(), state_->lanes_.end(),
+                    [](std::unique_ptr<State::Lane> const & lane) { return lane->detached_ || lane->workers_ == 0; });
+            });
+    }
+    LOG_IF(WARNING, !stopped) << "jobs still running after " << stopSeconds << "s, not waiting for them";
+
+    // a worker may be running an engine process for a long time, don't block exit on it
+    // workers keep state alive through their own shared_ptr
+    for (Worker & worker : workers_)
+    {
+        if (stopped && !state_->lanes_[worker.lane_]->detached_)
+        {
+            worker.thread_->join();
+        }
+        else
+        {
+            worker.thread_->detach();
+        }
+    }
+    workers_.clear();
+}
+
+void ThreadPool::submit(unsigned int id, Job job, std::size_t lane, int priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+
+        if (lane >= state_->lanes_.size())
+        {
+            throw std::invalid_argument("invalid thread pool lane");
+        }
+
+        State::QueuedJob queuedJob;
+        queuedJob.id_ = id;
+        queuedJob.job_ = job;
+        queuedJob.queued_ = Clock::now();
+        state_->lanes_[lane]->queue_.insert(std::make_pair(std::make_pair(-priority, state_->seq_++), queuedJob));
+    }
+    state_->lanes_[lane]->cond_.notify_one();
+}
+
+bool ThreadPool::cancel(unsigned int id)
+{
+    DoneFunction done;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+
+        auto running = state_->running_.find(id);
+        if (running != state_->running_.end())
+        {
+            running->second.cancel();
+            return true;
+        }
+
+        bool found = false;
+        for (auto & lane : state_->lanes_)
+        {
+            for (auto it = lane->queue_.begin(); it != lane->queue_.end(); ++it)
+            {
+                if (it->second.id_ == id)
+                {
+                    lane->queue_.erase(it);
+                    lane->stats_.canceled_ += 1;
+                    found = true;
+                    break;
+                }
+            }
+            if (found) break;
+        }
+        if (!found)
+        {
+            return false;
+        }
+        done = state_->done_;
+        if (done)
+        {
+            ++state_->callingDone_;
+        }
+    }
+
+    if (done)
+    {
+        state_->callDone(done, id, -1);
+    }
+    return true;
+}
+
+ThreadPool::Stats ThreadPool::stats(std::size_t lane) const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex_);
+    return state_->lanes_.at(lane)->stats_;
+}
+
+std::size_t ThreadPool::queued(std::size_t lane) const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex_);
+    return state_->lanes_.at(lane)->queue_.size();
+}
+
+void ThreadPool::worker(std::shared_ptr<State> state, std::size_t laneIndex)
+{
+    State::Lane & lane = *state->lanes_[laneIndex];
+
+    for (;;)
+    {
+        State::QueuedJob job;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex_);
+            lane.cond_.wait(lock, [&]() { return state->stop_ || !lane.queue_.empty(); });
+            if (state->stop_)
+            {
+                --lane.workers_;
+                state->stopCond_.notify_all();
+                return;
+            }
+            job = lane.queue_.begin()->second;
+            lane.queue_.erase(lane.queue_.begin());
+            state->running_[job.id_] = job.token_;
+        }
+
+        Clock::time_point const start = Clock::now();
+        int result = -1;
+        try
+        {
+            result = job.job_(job.token_);
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << "job " << job.id_ << " failed: " << e.what();
+        }
+        Clock::time_point const end = Clock::now();
+
+        double const waitSeconds = std::chrono::duration<double>(start - job.queued_).count();
+        double const runSeconds = std::chrono::duration<double>(end - start).count();
+        LOG(DEBUG) << "job " << job.id_ << " lane " << laneIndex << " waited " << waitSeconds << "s ran " << runSeconds << "s";
+
+        DoneFunction done;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex_);
+            state->running_.erase(job.id_);
+            Stats & stats = lane.stats_;
+            stats.jobs_ += 1;
+            stats.waitSeconds_ += waitSeconds;
+            stats.runSeconds_ += runSeconds;
+            stats.maxRunSeconds_ = std::max(stats.maxRunSeconds_, runSeconds);
+            done = state->done_;
+            if (done)
+            {
+                ++state->callingDone_;
+            }
+        }
+
+        if (done)
+        {
+            state->callDone(done, job.id_, result);
+        }
+    }
+}
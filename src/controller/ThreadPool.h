@@ -0,0 +1,79 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <boost/function.hpp>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// forwards
+namespace std { class thread; }
+
+// shared flag a job can poll to stop early, see ThreadPool::cancel
+class CancelToken
+{
+public:
+    CancelToken(): canceled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    bool canceled() const { return *canceled_; }
+    void cancel() const { *canceled_ = true; }
+
+private:
+    std::shared_ptr<std::atomic<bool>> canceled_;
+};
+
+// fixed size thread pool with one priority queue per lane
+// each lane has its own worker threads so long running jobs in one lane never delay jobs in another
+class ThreadPool
+{
+public:
+    typedef boost::function<int (CancelToken const & token)> Job;
+    typedef boost::function<void (unsigned int id, int result)> DoneFunction; // called from worker thread
+
+    struct Stats
+    {
+        unsigned int jobs_; // finished jobs
+        unsigned int canceled_; // jobs removed from queue by cancel
+        double waitSeconds_; // total time finished jobs spent in queue
+        double runSeconds_; // total run time of finished jobs
+        double maxRunSeconds_;
+    };
+
+    static int const stopSeconds = 5; // stop waits at most this long for running jobs
+
+    // laneSizes is number of worker threads per lane, stop does not wait for jobs of detachedLanes
+    ThreadPool(std::vector<std::size_t> const & laneSizes, DoneFunction done,
+               std::vector<std::size_t> const & detachedLanes = std::vector<std::size_t>());
+    ~ThreadPool(); // stops
+
+    // drops queued jobs and cancels running ones, done is not called anymore after return
+    // waits up to stopSeconds for running jobs except those in detached lanes (e.g. engine processes),
+    // these are left to finish on their own
+    void stop();
+
+    // jobs with higher priority are started first, jobs with same priority in submit order
+    // done is called with -1 if job throws
+    void submit(unsigned int id, Job job, std::size_t lane, int priority = 0);
+
+    // queued job is removed and done is called with -1, running job gets its token canceled
+    // returns false if job is unknown
+    bool cancel(unsigned int id);
+
+    Stats stats(std::size_t lane) const;
+    std::size_t queued(std::size_t lane) const;
+
+private:
+    struct State;
+    std::shared_ptr<State> state_; // shared with worker threads
+    struct Worker
+    {
+        std::size_t lane_;
+        std::unique_ptr<std::thread> thread_;
+    };
+    std::vector<Worker> workers_; // empty after stop
+
+    static void worker(std::shared_ptr<State> state, std::size_t lane);
+};
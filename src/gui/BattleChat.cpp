@@ -101,7 +101,7 @@ void BattleChat::battleChatMsg(std::string const & userName, std::string const &
     if (interest >= -1 && msg.find(myName) != std::string::npos)
     {
         interest = 1;
-        Sound::beep();
+        Sound::beep(SE_HIGHLIGHT);
     }
 
     textDisplay_->append(oss.str(), interest);
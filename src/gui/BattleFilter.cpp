@@ -0,0 +1,84 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "BattleFilter.h"
+
+#include "model/Battle.h"
+
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+
+BattleFilter::Settings::Settings():
+    minPlayers_(0),
+    maxRank_(-1),
+    hidePassworded_(false),
+    hideRunning_(false)
+{
+}
+
+BattleFilter::BattleFilter():
+    fields_(0)
+{
+}
+
+BattleFilter::BattleFilter(Settings const & settings):
+    settings_(settings),
+    fields_(0),
+    game_(compileTokens(settings.game_)),
+    engine_(compileTokens(settings.engine_)),
+    map_(compileTokens(settings.map_))
+{
+    if (!game_.empty()) fields_ |= BF_GAME;
+    if (!engine_.empty()) fields_ |= BF_ENGINE;
+    if (!map_.empty()) fields_ |= BF_MAP;
+    if (settings_.minPlayers_ > 0) fields_ |= BF_PLAYERS;
+    if (settings_.maxRank_ >= 0) fields_ |= BF_RANK;
+    if (settings_.hidePassworded_ || settings_.hideRunning_) fields_ |= BF_STATUS;
+}
+
+BattleFilter::Tokens BattleFilter::compileTokens(std::string const & text)
+{
+    Tokens tokens;
+    boost::algorithm::split(tokens, text, boost::is_any_of(","));
+
+    for (auto & token : tokens)
+    {
+        boost::trim(token);
+    }
+
+    // an empty token matches all so the whole filter can be dropped
+    if (std::find(tokens.begin(), tokens.end(), std::string()) != tokens.end())
+    {
+        tokens.clear();
+    }
+    return tokens;
+}
+
+bool BattleFilter::matches(Tokens const & tokens, std::string const & text)
+{
+    if (tokens.empty())
+    {
+        return true;
+    }
+
+    for (auto const & token : tokens)
+    {
+        if ( !boost::algorithm::ifind_first(text, token).empty() )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BattleFilter::passes(Battle const & battle) const
+{
+    // cheap checks first
+    if (battle.playerCount() < settings_.minPlayers_) return false;
+    if (settings_.maxRank_ >= 0 && battle.rank() > settings_.maxRank_) return false;
+    if (settings_.hidePassworded_ && battle.passworded()) return false;
+    if (settings_.hideRunning_ && battle.running()) return false;
+
+    return matches(game_, battle.modName())
+        && matches(engine_, battle.engineVersionLong())
+        && matches(map_, battle.mapName());
+}
@@ -0,0 +1,58 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Battle;
+
+// battle fields, used as bitmask to tell what changed in a battle and what a filter depends on
+enum BattleField
+{
+    BF_STATUS = 1 << 0, // passworded, locked, running
+    BF_TITLE = 1 << 1, // title and founder
+    BF_ENGINE = 1 << 2,
+    BF_GAME = 1 << 3,
+    BF_MAP = 1 << 4,
+    BF_PLAYERS = 1 << 5, // players, spectators and max players
+    BF_SYNC = 1 << 6, // have map and game, see Model::getSyncStatus
+    BF_RANK = 1 << 7
+};
+
+// battle filter predicate compiled from settings, i.e. text filters are split and trimmed once
+class BattleFilter
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        std::string game_; // comma separated case-insensitive substrings, empty matches all
+        std::string engine_;
+        std::string map_;
+        int minPlayers_;
+        int maxRank_; // battles requiring a higher rank are hidden, -1 means no limit
+        bool hidePassworded_;
+        bool hideRunning_;
+    };
+
+    BattleFilter(); // passes all battles
+    explicit BattleFilter(Settings const & settings);
+
+    Settings const & settings() const { return settings_; }
+    unsigned int fields() const { return fields_; } // BattleField mask of fields the filter depends on
+    bool passes(Battle const & battle) const;
+
+private:
+    typedef std::vector<std::string> Tokens;
+
+    Settings settings_;
+    unsigned int fields_;
+    Tokens game_;
+    Tokens engine_;
+    Tokens map_;
+
+    static Tokens compileTokens(std::string const & text);
+    static bool matches(Tokens const & tokens, std::string const & text);
+};
@@ -6,6 +6,7 @@
 
 #include <FL/Fl_Input.H>
 #include <FL/Fl_Int_Input.H>
+#include <FL/Fl_Check_Button.H>
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Return_Button.H>
 #include <FL/Fl.H>
@@ -22,10 +23,22 @@ BattleFilterDialog::BattleFilterDialog():
     game_ = new Fl_Input(10, 30, 380, 30, "Game (e.g 'zero,nota')");
     game_->align(FL_ALIGN_TOP_LEFT);
 
-    players_ = new Fl_Int_Input(10, 100, 380, 30, "Minimum players");
+    engine_ = new Fl_Input(10, 85, 380, 30, "Engine (e.g '104,105')");
+    engine_->align(FL_ALIGN_TOP_LEFT);
+
+    map_ = new Fl_Input(10, 140, 380, 30, "Map (e.g 'comet,delta')");
+    map_->align(FL_ALIGN_TOP_LEFT);
+
+    players_ = new Fl_Int_Input(10, 195, 185, 30, "Minimum players");
     players_->align(FL_ALIGN_TOP_LEFT);
 
-    box_ = new Fl_Box(10, 170, 380, 30);
+    maxRank_ = new Fl_Int_Input(205, 195, 185, 30, "Maximum rank (empty for any)");
+    maxRank_->align(FL_ALIGN_TOP_LEFT);
+
+    hidePassworded_ = new Fl_Check_Button(10, 235, 185, 30, "Hide passworded");
+    hideRunning_ = new Fl_Check_Button(205, 235, 185, 30, "Hide running");
+
+    box_ = new Fl_Box(10, 280, 380, 30);
     box_->labelcolor(FL_RED);
 
     Fl_Return_Button * btn = new Fl_Return_Button(280, 350, 110, 30, "Set filter");
@@ -63,17 +76,54 @@ void BattleFilterDialog::onFilterSet()
         return;
     }
 
-    std::string gameFilter = game_->value();
-    boost::trim(gameFilter);
-    filterSetSignal_(gameFilter, players);
+    int maxRank = -1;
+    std::string maxRankStr = maxRank_->value();
+    boost::trim(maxRankStr);
+    if (!maxRankStr.empty())
+    {
+        try
+        {
+            maxRank = boost::lexical_cast<int>(maxRankStr);
+        }
+        catch (boost::bad_lexical_cast & e)
+        {
+            // check below will display error
+        }
+
+        if (maxRank < 0)
+        {
+            box_->label("Maximum rank must be empty or a non-negative number");
+            Sound::beep();
+            return;
+        }
+    }
+
+    BattleFilter::Settings settings;
+    settings.game_ = game_->value();
+    boost::trim(settings.game_);
+    settings.engine_ = engine_->value();
+    boost::trim(settings.engine_);
+    settings.map_ = map_->value();
+    boost::trim(settings.map_);
+    settings.minPlayers_ = players;
+    settings.maxRank_ = maxRank;
+    settings.hidePassworded_ = hidePassworded_->value() != 0;
+    settings.hideRunning_ = hideRunning_->value() != 0;
+
+    filterSetSignal_(settings);
     box_->label(0);
     hide();
 }
 
-void BattleFilterDialog::show(std::string const & game, int players)
+void BattleFilterDialog::show(BattleFilter::Settings const & settings)
 {
-    game_->value(game.c_str());
-    players_->value(boost::lexical_cast<std::string>(players).c_str());
+    game_->value(settings.game_.c_str());
+    engine_->value(settings.engine_.c_str());
+    map_->value(settings.map_.c_str());
+    players_->value(boost::lexical_cast<std::string>(settings.minPlayers_).c_str());
+    maxRank_->value(settings.maxRank_ < 0 ? "" : boost::lexical_cast<std::string>(settings.maxRank_).c_str());
+    hidePassworded_->value(settings.hidePassworded_ ? 1 : 0);
+    hideRunning_->value(settings.hideRunning_ ? 1 : 0);
     Fl_Window::show();
 }
 
@@ -3,6 +3,7 @@
 #include "BattleInfo.h"
 #include "StringTable.h"
 #include "MapImage.h"
+#include "MapWindow.h"
 #include "Cache.h"
 
 #include "model/Model.h"
@@ -41,6 +42,11 @@ BattleInfo::BattleInfo(int x, int y, int w, int h, Model & model, Cache & cache)
     resizable(headerText_);
     end();
 
+    // window creation resets current group, restore it since we are created inside a parent group
+    Fl_Group * save = Fl_Group::current();
+    mapWindow_ = new MapWindow(cache_, "BattleInfoMapWindow");
+    Fl_Group::current(save);
+
     // model signal handlers
     model_.connectBattleChanged( boost::bind(&BattleInfo::battleChanged, this, _1) );
     model_.connectBattleClosed( boost::bind(&BattleInfo::battleClosed, this, _1) );
@@ -53,6 +59,7 @@ BattleInfo::BattleInfo(int x, int y, int w, int h, Model & model, Cache & cache)
 
 BattleInfo::~BattleInfo()
 {
+    delete mapWindow_;
 }
 
 void BattleInfo::setMapImage(Battle const & battle)
@@ -64,6 +71,10 @@ void BattleInfo::setMapImage(Battle const & battle)
         mapImageBox_->image(image);
         mapImageBox_->activate();
         currentMapImage_ = battle.mapName();
+
+        MapAnalysis const * mapAnalysis = cache_.getMapAnalysis(battle.mapName());
+        mapImageBox_->setMetalSpots(mapAnalysis ? mapAnalysis->spots() : std::vector<MapAnalysis::MetalSpot>());
+        mapSummary_ = mapAnalysis ? mapAnalysis->summary() : "";
     }
     else if (!model_.getUnitSyncPath().empty())
     {
@@ -72,6 +83,8 @@ void BattleInfo::setMapImage(Battle const & battle)
         mapImageBox_->copy_label(msg.c_str());
         mapImageBox_->activate();
         currentMapImage_.clear();
+        mapImageBox_->setMetalSpots(std::vector<MapAnalysis::MetalSpot>());
+        mapSummary_.clear();
     }
     else
     {
@@ -80,6 +93,8 @@ void BattleInfo::setMapImage(Battle const & battle)
         mapImageBox_->label("");
         mapImageBox_->deactivate();
         currentMapImage_.clear();
+        mapImageBox_->setMetalSpots(std::vector<MapAnalysis::MetalSpot>());
+        mapSummary_.clear();
     }
 }
 
@@ -127,6 +142,13 @@ void BattleInfo::handleOnMapImage()
                     }
                 }
                 break;
+
+                case FL_MIDDLE_MOUSE: // show big zoomable map
+                    if (mapImageBox_->image() != 0)
+                    {
+                        mapWindow_->showMap(mapName);
+                    }
+                break;
             }
             break;
 
@@ -183,7 +205,9 @@ void BattleInfo::reset()
     mapImageBox_->image(0);
     mapImageBox_->label(0);
     mapImageBox_->deactivate();
+    mapImageBox_->setMetalSpots(std::vector<MapAnalysis::MetalSpot>());
     currentMapImage_.clear();
+    mapSummary_.clear();
     headerText_->value("");
 }
 
@@ -199,8 +223,12 @@ void BattleInfo::setHeaderText(Battle const & battle)
     std::ostringstream oss;
     oss << battle.title() << " / " << battle.founder() << " / " << battle.engineVersionLong() << "\n"
         << battle.mapName() << "\n"
-        << battle.modName() << "\n"
-        << "Users:";
+        << battle.modName() << "\n";
+    if (!mapSummary_.empty())
+    {
+        oss << mapSummary_ << "\n";
+    }
+    oss << "Users:";
 
     for (Battle::BattleUsers::value_type pair : battle.users())
     {
@@ -12,6 +12,7 @@ class User;
 class Battle;
 class Model;
 class Cache;
+class MapWindow;
 class Fl_Box;
 class Fl_Group;
 class Fl_Button;
@@ -35,8 +36,10 @@ private:
     int battleId_;
     Fl_Group *header_;
     MapImage* mapImageBox_;
+    MapWindow* mapWindow_;
     std::unique_ptr<Fl_RGB_Image> mapImage_;
     std::string currentMapImage_; // optimization, indicates what map image is currently shown to avoid setting the same image
+    std::string mapSummary_; // metal and slope summary of current map
     Fl_Multiline_Output *headerText_;
     StringTable *userList_;
 
@@ -16,13 +16,18 @@
 
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/format.hpp>
 #include <boost/algorithm/string.hpp>
 #include <sstream>
+#include <cstdio>
 #include <cassert>
 
 static char const * PrefBattleFilterGame = "BattleFilterGame";
 static char const * PrefBattleFilterPlayers = "BattleFilterPlayers";
+static char const * PrefBattleFilterEngine = "BattleFilterEngine";
+static char const * PrefBattleFilterMap = "BattleFilterMap";
+static char const * PrefBattleFilterMaxRank = "BattleFilterMaxRank";
+static char const * PrefBattleFilterHidePassworded = "BattleFilterHidePassworded";
+static char const * PrefBattleFilterHideRunning = "BattleFilterHideRunning";
 
 
 BattleList::BattleList(int x, int y, int w, int h, Model & model, Cache & cache): // TODO cache is only needed by BattleInfo
@@ -31,7 +36,7 @@ BattleList::BattleList(int x, int y, int w, int h, Model & model, Cache & cache)
 {
     int const h1 = h-128;
     battleList_ = new StringTable(x, y, w, h1, "BattleList",
-            { {"status",4}, {"title / host",15}, {"engine",4}, {"game",10}, {"map",15}, {"players",4} }, -5 /* sort on players by default */);
+            { {"status",4}, {"title / host",15}, {"engine",4}, {"game",10}, {"map",15}, {"players",4}, {"sync",4} }, -5 /* sort on players by default */);
 
     battleInfo_ = new BattleInfo(x, y+h1, w, h-h1, model_, cache);
 
@@ -44,30 +49,44 @@ BattleList::BattleList(int x, int y, int w, int h, Model & model, Cache & cache)
     model_.connectConnected( boost::bind(&BattleList::connected, this, _1) );
     model_.connectLoginResult( boost::bind(&BattleList::loginResult, this, _1, _2) );
     model_.connectBattleOpened( boost::bind(&BattleList::battleOpened, this, _1) );
-    model_.connectBattleChanged( boost::bind(&BattleList::battleChanged, this, _1) );
+    model_.connectBattlesChanged( boost::bind(&BattleList::battlesChanged, this, _1) );
     model_.connectBattleClosed( boost::bind(&BattleList::battleClosed, this, _1) );
-    model_.connectUserJoinedBattle( boost::bind(&BattleList::userJoinedLeftBattle, this, _1, _2) );
-    model_.connectUserLeftBattle( boost::bind(&BattleList::userJoinedLeftBattle, this, _1, _2) );
-
 
     battleList_->connectSelectedRowChanged( boost::bind(&BattleList::battleListRowChanged, this, _1) );
     battleList_->connectRowClicked( boost::bind(&BattleList::battleListRowClicked, this, _1, _2) );
     battleList_->connectRowDoubleClicked( boost::bind(&BattleList::battleListRowDoubleClicked, this, _1, _2) );
 
-    battleFilterDialog_->connectFilterSet( boost::bind(&BattleList::setFilter, this, _1, _2) );
+    battleFilterDialog_->connectFilterSet( boost::bind(&BattleList::setFilter, this, _1) );
 
     // read prefs
+    BattleFilter::Settings settings;
     char str[65];
     prefs().get(PrefBattleFilterGame, str, "", 64);
-    filterGame_ = str;
-    prefs().get(PrefBattleFilterPlayers, filterPlayers_, 0);
-
+    settings.game_ = str;
+    prefs().get(PrefBattleFilterEngine, str, "", 64);
+    settings.engine_ = str;
+    prefs().get(PrefBattleFilterMap, str, "", 64);
+    settings.map_ = str;
+    prefs().get(PrefBattleFilterPlayers, settings.minPlayers_, 0);
+    prefs().get(PrefBattleFilterMaxRank, settings.maxRank_, -1);
+    int val;
+    prefs().get(PrefBattleFilterHidePassworded, val, 0);
+    settings.hidePassworded_ = (val != 0);
+    prefs().get(PrefBattleFilterHideRunning, val, 0);
+    settings.hideRunning_ = (val != 0);
+    filter_ = BattleFilter(settings);
 }
 
 BattleList::~BattleList()
 {
-    prefs().set(PrefBattleFilterGame, filterGame_.c_str());
-    prefs().set(PrefBattleFilterPlayers, filterPlayers_);
+    BattleFilter::Settings const & settings = filter_.settings();
+    prefs().set(PrefBattleFilterGame, settings.game_.c_str());
+    prefs().set(PrefBattleFilterEngine, settings.engine_.c_str());
+    prefs().set(PrefBattleFilterMap, settings.map_.c_str());
+    prefs().set(PrefBattleFilterPlayers, settings.minPlayers_);
+    prefs().set(PrefBattleFilterMaxRank, settings.maxRank_);
+    prefs().set(PrefBattleFilterHidePassworded, settings.hidePassworded_ ? 1 : 0);
+    prefs().set(PrefBattleFilterHideRunning, settings.hideRunning_ ? 1 : 0);
 }
 
 void BattleList::loginResult(bool success, std::string const & info)
@@ -79,7 +98,7 @@ void BattleList::loginResult(bool success, std::string const & info)
         for (auto b : battles)
         {
             assert(b);
-            battleOpened(*b);
+            updateEntry(*b);
         }
         battleList_->sort();
     }
@@ -87,64 +106,113 @@ void BattleList::loginResult(bool success, std::string const & info)
 
 void BattleList::battleOpened(const Battle & battle)
 {
-    if (passesFilter(battle))
+    if (updateEntry(battle))
     {
-        battleList_->addRow(makeRow(battle));
+        battleList_->sort();
     }
 }
 
+void BattleList::battlesChanged(std::vector<Battle const *> const & battles)
+{
+    bool sortNeeded = false;
+    for (Battle const * battle : battles)
+    {
+        sortNeeded |= updateEntry(*battle);
+    }
+    if (sortNeeded)
+    {
+        battleList_->sort();
+    }
+}
 
-
-void BattleList::battleChanged(const Battle & battle)
+bool BattleList::updateEntry(const Battle & battle)
 {
-    if (passesFilter(battle))
+    Entry entry = makeEntry(battle);
+
+    auto it = entries_.find(battle.id());
+    if (it == entries_.end())
     {
-        StringTableRow row = makeRow(battle);
-        try
+        bool const passes = filter_.passes(battle);
+        entry.passes_ = passes;
+        if (passes)
         {
-            battleList_->updateRow(row);
-        }
-        catch (std::runtime_error & e)
-        {
-            // battle was not in list, add it
-            battleList_->addRow(row);
+            battleList_->addRow(StringTableRow(entry.id_, entry.data_), false);
         }
+        entries_.insert(std::make_pair(battle.id(), std::move(entry)));
+        return passes;
     }
-    else
+
+    Entry & current = it->second;
+    unsigned int const changed = changedFields(current, entry);
+    if (changed == 0)
     {
-        try
+        return false;
+    }
+
+    bool sortNeeded = false;
+
+    // only re-evaluate filter if a field it depends on changed
+    entry.passes_ = (changed & filter_.fields()) ? filter_.passes(battle) : current.passes_;
+
+    if (entry.passes_ && current.passes_)
+    {
+        int const rowIndex = battleList_->rowIndex(entry.id_);
+        if (rowIndex >= 0)
         {
-            battleList_->removeRow(boost::lexical_cast<std::string>(battle.id()));
+            sortNeeded = battleList_->updateCells(rowIndex, entry.data_, changed, false);
         }
-        catch (std::runtime_error & e)
+        else
         {
-            // battle was not in list, ignore
+            LOG(WARNING) << "battle row missing: " << entry.id_;
+            battleList_->addRow(StringTableRow(entry.id_, entry.data_), false);
+            sortNeeded = true;
         }
     }
-}
-
-
-
-void BattleList::battleClosed(const Battle & battle)
-{
-    try
+    else if (entry.passes_)
     {
-        battleList_->removeRow(boost::lexical_cast<std::string>(battle.id()));
+        battleList_->addRow(StringTableRow(entry.id_, entry.data_), false);
+        sortNeeded = true;
     }
-    catch (std::runtime_error & e)
+    else if (current.passes_)
     {
-        // battle was not in list, ignore
+        battleList_->removeRow(entry.id_);
     }
+
+    current = std::move(entry);
+    return sortNeeded;
 }
 
-void BattleList::userJoinedLeftBattle(User const & user, const Battle & battle)
+void BattleList::battleClosed(const Battle & battle)
 {
-    static_cast<void>(user); // unused
-    battleChanged(battle);
+    auto it = entries_.find(battle.id());
+    if (it != entries_.end())
+    {
+        if (it->second.passes_)
+        {
+            battleList_->removeRow(it->second.id_);
+        }
+        entries_.erase(it);
+    }
 }
 
 void BattleList::refresh()
 {
+    // maps and games may have been added, update sync column
+    std::vector<int> ids;
+    for (auto const & pair : entries_)
+    {
+        ids.push_back(pair.first);
+    }
+    bool sortNeeded = false;
+    for (int id : ids)
+    {
+        sortNeeded |= updateEntry(model_.getBattle(id));
+    }
+    if (sortNeeded)
+    {
+        battleList_->sort();
+    }
+
     battleInfo_->refresh();
 }
 
@@ -231,80 +299,89 @@ std::string BattleList::statusString(Battle const & battle)
     return oss.str();
 }
 
-StringTableRow BattleList::makeRow(Battle const & battle)
+std::string BattleList::syncString(Battle const & battle)
 {
-    boost::format players("%2d %2d/%2d"); // players (non-specs/maxplayers)
-    players % battle.playerCount() % (battle.playerCount()-battle.spectators()) % battle.maxPlayers();
-
-    return StringTableRow( boost::lexical_cast<std::string>(battle.id()),
-            { statusString(battle),
-              battle.title() + " / " + battle.founder(),
-              battle.engineVersionLong(),
-              battle.modName(),
-              battle.mapName(),
-              players.str() } );
-}
-
-void BattleList::connected(bool connected)
-{
-    if (!connected)
+    switch (model_.getSyncStatus(battle))
     {
-        battleList_->clear();
-        battleInfo_->reset();
+    case Model::SS_SYNCED: return "ok";
+    case Model::SS_MISSING_MAP: return "map";
+    case Model::SS_MISSING_GAME: return "game";
+    case Model::SS_MISSING_BOTH: return "map game";
+    case Model::SS_MISMATCH: return "hash";
+    case Model::SS_UNKNOWN: break;
     }
+    return "?";
 }
 
-void BattleList::setFilter(std::string const & game, int players)
+BattleList::Entry BattleList::makeEntry(Battle const & battle)
 {
-    filterGame_ = game;
-    filterPlayers_ = players;
+    // players (non-specs/maxplayers)
+    char players[32];
+    std::snprintf(players, sizeof(players), "%2d %2d/%2d", battle.playerCount(), battle.playerCount()-battle.spectators(), battle.maxPlayers());
+
+    Entry entry;
+    entry.id_ = boost::lexical_cast<std::string>(battle.id());
+    entry.data_ = { statusString(battle),
+                    battle.title() + " / " + battle.founder(),
+                    battle.engineVersionLong(),
+                    battle.modName(),
+                    battle.mapName(),
+                    players,
+                    syncString(battle) };
+    entry.rank_ = battle.rank();
+    entry.passes_ = false;
+    return entry;
+}
 
-    battleList_->clear();
+unsigned int BattleList::changedFields(Entry const & a, Entry const & b)
+{
+    assert(a.data_.size() == b.data_.size());
 
-    for (Battle const * b : model_.getBattles())
+    unsigned int changed = 0;
+    for (std::size_t c = 0; c < a.data_.size(); ++c)
     {
-        if (passesFilter(*b))
+        if (a.data_[c] != b.data_[c])
         {
-            battleList_->addRow(makeRow(*b));
+            changed |= (1u << c);
         }
+    }
+    if (a.rank_ != b.rank_)
+    {
+        changed |= BF_RANK;
+    }
+    return changed;
+}
 
+void BattleList::connected(bool connected)
+{
+    // battles are kept while reconnecting, the model signals what changed
+    if (!connected && !model_.resyncPending())
+    {
+        battleList_->clear();
+        entries_.clear();
+        battleInfo_->reset();
     }
 }
 
-bool BattleList::passesFilter(Battle const & battle)
+void BattleList::setFilter(BattleFilter::Settings const & settings)
 {
-    if (battle.playerCount() < filterPlayers_) return false;
+    filter_ = BattleFilter(settings);
 
-    if (!filterGame_.empty())
-    {
-        std::vector<std::string> games;
-        boost::algorithm::split(games, filterGame_, boost::is_any_of(","));
+    battleList_->clear();
 
-        int matches = 0;
-        for (auto& game : games)
-        {
-            boost::trim(game);
-
-            if (game.empty())
-            {
-                // ignore empty game filters
-                matches += 1;
-            }
-            else if ( !boost::algorithm::ifind_first(battle.modName(), game).empty() )
-            {
-                matches += 1;
-            }
-        }
-        if (matches == 0)
+    for (auto & pair : entries_)
+    {
+        Entry & entry = pair.second;
+        entry.passes_ = filter_.passes(model_.getBattle(pair.first));
+        if (entry.passes_)
         {
-            return false;
+            battleList_->addRow(StringTableRow(entry.id_, entry.data_), false);
         }
     }
-
-    return true;
+    battleList_->sort();
 }
 
 void BattleList::showFilterDialog()
 {
-    battleFilterDialog_->show(filterGame_, filterPlayers_);
+    battleFilterDialog_->show(filter_.settings());
 }
@@ -3,13 +3,15 @@
 #pragma once
 
 #include "StringTable.h"
+#include "BattleFilter.h"
 
 #include <FL/Fl_Group.H>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 class Model;
-class User;
 class Battle;
 class BattleInfo;
 class Cache;
@@ -30,30 +32,41 @@ private:
     Model & model_;
     StringTable * battleList_;
     BattleInfo * battleInfo_;
-    std::string filterGame_;
-    int filterPlayers_;
+    BattleFilter filter_;
     BattleFilterDialog * battleFilterDialog_;
 
+    // last seen state of each battle, used to only filter and redraw what changed
+    struct Entry
+    {
+        std::string id_;
+        std::vector<std::string> data_; // one string per column, column index matches BattleField bit
+        int rank_;
+        bool passes_; // passes filter, i.e. is in list
+    };
+    typedef std::unordered_map<int, Entry> Entries;
+    Entries entries_;
+
     // model signal handlers
     //
     void connected(bool connected);
     void loginResult(bool success, std::string const & info);
     void battleOpened(Battle const & battle);
-    void battleChanged(Battle const & battle);
+    void battlesChanged(std::vector<Battle const *> const & battles);
     void battleClosed(Battle const & battle);
-    void userJoinedLeftBattle(User const & user, const Battle & battle);
 
     void battleListRowChanged(int rowIndex);
     void battleListRowClicked(int rowIndex, int button);
     void battleListRowDoubleClicked(int rowIndex, int button);
 
-    StringTableRow makeRow(Battle const & battle);
+    bool updateEntry(Battle const & battle); // adds, updates or removes row, returns true if list must be sorted
+    Entry makeEntry(Battle const & battle);
+    static unsigned int changedFields(Entry const & a, Entry const & b); // returns BattleField mask
     std::string statusString(Battle const & battle);
+    std::string syncString(Battle const & battle); // what is missing, "ok" if synced
 
     void joinBattle(Battle const & battle);
 
-    bool passesFilter(Battle const & battle);
-    void setFilter(std::string const & game, int players);
+    void setFilter(BattleFilter::Settings const & settings);
 
 };
 
@@ -7,6 +7,7 @@
 #include "ITabs.h"
 #include "Prefs.h"
 #include "MapImage.h"
+#include "MapWindow.h"
 #include "AddBotDialog.h"
 #include "PopupMenu.h"
 #include "GameSettings.h"
@@ -28,6 +29,8 @@
 #include <boost/format.hpp>
 #include <boost/algorithm/string.hpp>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <cassert>
 
 static char const * PrefBattleRoomSplitV = "BattleRoomSplitV";
@@ -42,7 +45,8 @@ BattleRoom::BattleRoom(int x, int y, int w, int h, Model & model, Cache & cache,
     iTabs_(iTabs),
     springDialog_(springDialog),
     battleId_(-1),
-    lastRunning_(false)
+    lastRunning_(false),
+    mapAnalysis_(0)
 {
     // limit split drag
     resizable( new Fl_Box(this->x(), this->y()+100, this->w(), this->h()-(100+100)) );
@@ -112,6 +116,7 @@ BattleRoom::BattleRoom(int x, int y, int w, int h, Model & model, Cache & cache,
     mapInfo_  = new Fl_Multiline_Output(rightX+rightW/2, y+2*buttonH, rightW/2, rightW/2);
     mapInfo_->box(FL_FLAT_BOX);
     mapInfo_->color(FL_BACKGROUND2_COLOR);
+    mapInfo_->wrap(1);
 
     // settings
     settings_  = new GameSettings(rightX, y+2*buttonH+rightW/2, rightW, topH-2*buttonH-rightW/2, model );
@@ -140,6 +145,7 @@ BattleRoom::BattleRoom(int x, int y, int w, int h, Model & model, Cache & cache,
     top_->deactivate();
 
     addBotDialog_ = new AddBotDialog(model);
+    mapWindow_ = new MapWindow(cache_, "BattleRoomMapWindow");
 
     // model signals
     model_.connectBattleJoined( boost::bind(&BattleRoom::joined, this, _1) );
@@ -155,6 +161,7 @@ BattleRoom::BattleRoom(int x, int y, int w, int h, Model & model, Cache & cache,
     model_.connectRemoveStartRect( boost::bind(&BattleRoom::removeStartRect, this, _1) );
     model_.connectSpringExit( boost::bind(&BattleRoom::springExit, this) );
     model_.connectConnected( boost::bind(&BattleRoom::connected, this, _1) );
+    model_.connectDownloadProgress( boost::bind(&BattleRoom::downloadProgress, this, _1, _2, _3, _4) );
 
     playerList_->connectRowClicked( boost::bind(&BattleRoom::playerClicked, this, _1, _2) );
     playerList_->connectRowDoubleClicked( boost::bind(&BattleRoom::playerDoubleClicked, this, _1, _2) );
@@ -166,6 +173,7 @@ BattleRoom::BattleRoom(int x, int y, int w, int h, Model & model, Cache & cache,
 BattleRoom::~BattleRoom()
 {
     prefs().set(PrefBattleRoomSplitV, battleChat_->y());
+    delete mapWindow_;
 }
 
 void BattleRoom::initTiles()
@@ -192,7 +200,19 @@ void BattleRoom::setMapImage(Battle const & battle)
             << "Tidal: " << mapInfo.tidalStrength_ << "\n"
             << "Gravity: " << mapInfo.gravity_ << "\n";
 
-        mapInfo_->value(oss.str().c_str());
+        mapAnalysis_ = cache_.getMapAnalysis(battle.mapName());
+        if (mapAnalysis_)
+        {
+            oss << mapAnalysis_->summary() << "\n";
+            mapImageBox_->setMetalSpots(mapAnalysis_->spots());
+        }
+        else
+        {
+            mapImageBox_->setMetalSpots(std::vector<MapAnalysis::MetalSpot>());
+        }
+
+        mapInfoText_ = oss.str();
+        updateMapInfoText();
     }
     else if (!model_.getUnitSyncPath().empty())
     {
@@ -201,7 +221,7 @@ void BattleRoom::setMapImage(Battle const & battle)
         mapImageBox_->copy_label(msg.c_str());
         mapImageBox_->activate();
 
-        mapInfo_->value(0);
+        clearMapInfo();
     }
     else
     {
@@ -210,10 +230,17 @@ void BattleRoom::setMapImage(Battle const & battle)
         mapImageBox_->label("");
         mapImageBox_->deactivate();
 
-        mapInfo_->value(0);
+        clearMapInfo();
     }
 
     currentMapImage_ = battle.mapName();
+
+    // big map follows the battle, e.g. when the host changes map
+    if (mapWindow_->shown() && mapWindow_->mapName() != currentMapImage_)
+    {
+        mapWindow_->showMap(currentMapImage_);
+        updateMapWindowStartRects();
+    }
 }
 
 void BattleRoom::updateDownloadButtons(Battle const & battle)
@@ -383,6 +410,7 @@ void BattleRoom::userChanged(User const & user)
             readyBtn_->value(user.battleStatus().ready());
             teamBtn_->value(user.battleStatus().allyTeam());
             mapImageBox_->setAlly( user.battleStatus().spectator() ? -1 : user.battleStatus().allyTeam());
+            updateMapWindowStartRects();
             Battle const& battle = model_.getBattle(battleId);
             if (battle.running() && !me.status().inGame())
             {
@@ -408,7 +436,7 @@ void BattleRoom::close()
     mapImageBox_->image(0);
     mapImageBox_->label(0);
     currentMapImage_.clear();
-    mapInfo_->value(0);
+    clearMapInfo();
 
     headerText_->value("");
     hideDownloadGameButton();
@@ -417,6 +445,7 @@ void BattleRoom::close()
     startBtn_->deactivate();
 
     mapImageBox_->removeAllStartRects();
+    updateMapWindowStartRects();
 
     settings_->clear();
 
@@ -807,11 +836,64 @@ void BattleRoom::menuBot(std::string const& botName, std::string const& ownerNam
 void BattleRoom::addStartRect(StartRect const & startRect)
 {
     mapImageBox_->addStartRect(startRect);
+    updateMapWindowStartRects();
+    updateMapInfoText();
 }
 
 void BattleRoom::removeStartRect(int ally)
 {
     mapImageBox_->removeStartRect(ally);
+    updateMapWindowStartRects();
+    updateMapInfoText();
+}
+
+void BattleRoom::clearMapInfo()
+{
+    mapAnalysis_ = 0;
+    mapInfoText_.clear();
+    mapImageBox_->setMetalSpots(std::vector<MapAnalysis::MetalSpot>());
+    mapInfo_->value(0);
+}
+
+void BattleRoom::updateMapInfoText()
+{
+    if (mapInfoText_.empty())
+    {
+        return;
+    }
+
+    std::ostringstream oss;
+    oss << mapInfoText_;
+
+    // per box metal and slope, helps judging box fairness
+    if (mapAnalysis_)
+    {
+        std::vector<StartRect> startRects = mapImageBox_->startRects();
+        std::sort(startRects.begin(), startRects.end(),
+                  [](StartRect const & a, StartRect const & b) { return a.ally() < b.ally(); });
+
+        oss << std::fixed << std::setprecision(1);
+        for (StartRect const & sr : startRects)
+        {
+            MapAnalysis::BoxSummary const summary = mapAnalysis_->boxSummary(sr);
+            oss << "Box " << sr.ally()+1 << ": " << summary.spots_ << " spots ("
+                << MapAnalysis::metalUnits(summary.value_) << "), slope " << summary.meanSlope_ << "\n";
+        }
+    }
+
+    mapInfo_->value(oss.str().c_str());
+}
+
+void BattleRoom::updateMapWindowStartRects()
+{
+    if (mapWindow_->shown() && mapWindow_->mapName() == currentMapImage_)
+    {
+        mapWindow_->setStartRects(mapImageBox_->startRects(), mapImageBox_->ally());
+    }
+    else
+    {
+        mapWindow_->setStartRects(std::vector<StartRect>(), -1);
+    }
 }
 
 void BattleRoom::connected(bool connected)
@@ -860,6 +942,14 @@ void BattleRoom::handleOnMapImage()
                     }
                 }
                 break;
+
+                case FL_MIDDLE_MOUSE: // show big zoomable map
+                    if (mapImageBox_->image() != 0)
+                    {
+                        mapWindow_->showMap(mapName);
+                        mapWindow_->setStartRects(mapImageBox_->startRects(), mapImageBox_->ally());
+                    }
+                break;
             }
             break;
 
@@ -962,6 +1052,21 @@ void BattleRoom::handleOnDownloadGame()
     }
 }
 
+void BattleRoom::downloadProgress(Model::DownloadType downloadType, std::string const & name, uint64_t bytesDone, uint64_t bytesTotal)
+{
+    if (battleId_ == -1 || downloadType != Model::DT_GAME || downloadGameBtn_->active() || bytesTotal == 0)
+    {
+        return;
+    }
+
+    if (model_.getBattle(battleId_).modName() == name)
+    {
+        std::ostringstream oss;
+        oss << "Downloading\n" << (100*bytesDone/bytesTotal) << "%";
+        downloadGameBtn_->copy_label(oss.str().c_str());
+    }
+}
+
 void BattleRoom::hideDownloadGameButton()
 {
     headerText_->size(header_->w(), header_->h());
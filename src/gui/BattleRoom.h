@@ -20,6 +20,8 @@ class Cache;
 class ITabs;
 class MapImage;
 class AddBotDialog;
+class MapWindow;
+class MapAnalysis;
 class GameSettings;
 class SpringDialog;
 
@@ -55,6 +57,7 @@ public:
     void removeStartRect(int ally);
     void springExit();
     void connected(bool connected);
+    void downloadProgress(Model::DownloadType downloadType, std::string const & name, uint64_t bytesDone, uint64_t bytesTotal);
 
     int battleId() const;
 
@@ -85,6 +88,8 @@ private:
     Fl_Multiline_Output * mapInfo_;
     GameSettings * settings_;
     std::string currentMapImage_; // optimization, indicates what map image is currently shown to avoid setting the same image
+    std::string mapInfoText_; // map info part of mapInfo_, box summaries are appended to it
+    MapAnalysis const * mapAnalysis_; // analysis of current map, 0 if not available
     std::vector<std::string> sideNames_;
 
     typedef std::map<int,int> Balance;
@@ -95,6 +100,7 @@ private:
 
     BattleChat * battleChat_;
     AddBotDialog * addBotDialog_;
+    MapWindow * mapWindow_;
 
     static void onSpec(Fl_Widget* w, void* data);
     static void onReady(Fl_Widget* w, void* data);
@@ -114,6 +120,9 @@ private:
     StringTableRow makeRow(User const & user);
     StringTableRow makeRow(Bot const & bot);
     void handleOnMapImage();
+    void updateMapWindowStartRects();
+    void updateMapInfoText(); // call when map or start rects changed
+    void clearMapInfo();
     void handleOnDownloadGame();
     void hideDownloadGameButton();
     void showDownloadGameButton(Model::DownloadType downloadType);
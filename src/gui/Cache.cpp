@@ -3,17 +3,38 @@
 #include "Cache.h"
 
 #include "log/Log.h"
+#include "log/Metrics.h"
+#include "log/Trace.h"
 #include "model/Model.h"
+#include "ImageResize.h"
+#include "MyImage.h"
 #include "FlobbyDirs.h"
 
-#include <Magick++.h>
 #include <FL/Fl_Shared_Image.H>
 
 #include <sstream> // ostringstream
+#include <memory>
 #include <fstream>
 #include <boost/filesystem.hpp>
 #include <cassert>
 
+namespace
+{
+    // "cache.<kind>.hits" served from memory or cache file, "cache.<kind>.misses" created with unitsync
+    struct CacheMetrics
+    {
+        explicit CacheMetrics(std::string const & kind):
+            hits_(Metrics::counter("cache." + kind + ".hits")),
+            misses_(Metrics::counter("cache." + kind + ".misses"))
+        {
+        }
+        void count(bool hit) { (hit ? hits_ : misses_).add(); }
+
+        MetricsCounter & hits_;
+        MetricsCounter & misses_;
+    };
+}
+
 Cache::Cache(Model & model):
     model_(model)
 {
@@ -53,19 +74,24 @@ std::string Cache::pathMapInfo(std::string const& mapName)
     return mapPath(mapName, "info.bin");
 }
 
+std::string Cache::pathMapAnalysis(std::string const& mapName)
+{
+    return mapPath(mapName, "analysis.bin");
+}
+
 std::string Cache::pathMapImage(std::string const& mapName)
 {
-    return mapPath(mapName, "minimap_128.png");
+    return mapPath(mapName, "minimap_128.img");
 }
 
 std::string Cache::pathMetalImage(std::string const& mapName)
 {
-    return mapPath(mapName, "metal_128.png");
+    return mapPath(mapName, "metal_128.img");
 }
 
 std::string Cache::pathHeightImage(std::string const& mapName)
 {
-    return mapPath(mapName, "height_128.png");
+    return mapPath(mapName, "height_128.img");
 }
 
 std::string Cache::mapInfoKey(std::string const& mapName)
@@ -122,10 +148,14 @@ bool Cache::hasHeightImage(std::string const & mapName)
 
 Fl_Shared_Image * Cache::getMapImage(std::string const & mapName)
 {
+    TraceSpan span("Cache::getMapImage", "cache");
+    static CacheMetrics metrics("map_image");
+
     std::string const path = pathMapImage(mapName);
     if (path.empty()) return 0;
 
     Fl_Shared_Image * image = Fl_Shared_Image::get(path.c_str());
+    metrics.count(image != 0);
 
     if (image == 0)
     {
@@ -154,10 +184,14 @@ Fl_Shared_Image * Cache::getMapImage(std::string const & mapName)
 
 Fl_Shared_Image * Cache::getMetalImage(std::string const & mapName)
 {
+    TraceSpan span("Cache::getMetalImage", "cache");
+    static CacheMetrics metrics("metal_image");
+
     std::string const path = pathMetalImage(mapName);
     if (path.empty()) return 0;
 
     Fl_Shared_Image * image = Fl_Shared_Image::get(path.c_str());
+    metrics.count(image != 0);
 
     if (image == 0)
     {
@@ -165,16 +199,8 @@ Fl_Shared_Image * Cache::getMetalImage(std::string const & mapName)
         auto imageData = model_.getMetalMap(mapName, w, h);
         if (imageData)
         {
-            // create RGB data to get a green metal map
-            std::unique_ptr<uint8_t[]> rgb(new uint8_t[3*w*h]);
-            for (int i=0; i<w*h; ++i)
-            {
-                rgb[i*3+0] = 0;
-                rgb[i*3+1] = imageData[i];
-                rgb[i*3+2] = 0;
-            }
-
-            createImageFile(rgb.get(), w, h, 3, path);
+            // stored as single channel, tinted green when loaded
+            createImageFile(imageData.get(), w, h, 1, path, 1, 0x00ff00);
 
             image = Fl_Shared_Image::get(path.c_str());
             if (image == 0)
@@ -188,10 +214,14 @@ Fl_Shared_Image * Cache::getMetalImage(std::string const & mapName)
 
 Fl_Shared_Image * Cache::getHeightImage(std::string const & mapName)
 {
+    TraceSpan span("Cache::getHeightImage", "cache");
+    static CacheMetrics metrics("height_image");
+
     std::string const path = pathHeightImage(mapName);
     if (path.empty()) return 0;
 
     Fl_Shared_Image * image = Fl_Shared_Image::get(path.c_str());
+    metrics.count(image != 0);
 
     if (image == 0)
     {
@@ -211,46 +241,205 @@ Fl_Shared_Image * Cache::getHeightImage(std::string const & mapName)
     return image;
 }
 
-void Cache::createImageFile(uint8_t const * data, int w, int h, int d, std::string const & path, double r /* w/h */)
+void Cache::createImageFile(uint8_t const * data, int w, int h, int d, std::string const & path, double r /* w/h */, unsigned int tint /* = 0 */)
 {
     assert(w > 0 && h > 0 && (d == 1 || d == 3) && r > 0);
 
-    // create image, we will resize it below
-    Magick::Image image;
-    image.read(w, h, d == 1 ? "I" : "RGB", Magick::CharPixel, data);
-    image.depth(8);
+    int const maxSize = 128;
+    int w2, h2;
+    thumbnailSize(w, h, r, maxSize, w2, h2);
 
-    double const r2 = static_cast<double>(w)/h * r;
+    std::unique_ptr<uint8_t[]> thumbnail(new uint8_t[w2*h2*d]);
+    resizeAreaAverage(data, w, h, d, thumbnail.get(), w2, h2);
 
-    int const maxSize = 128;
-    int w2 = maxSize;
-    int h2 = maxSize;
+    MyImage::write(path, thumbnail.get(), w2, h2, d, tint);
+}
+
+std::string Cache::MapTiles::tilePath(int level, int tx, int ty) const
+{
+    std::ostringstream oss;
+    oss << prefix_ << level << "_" << tx << "_" << ty << ".img";
+    return oss.str();
+}
+
+void Cache::getMapTiles(std::string const& mapName, MapLayer layer, MapTilesDone done)
+{
+    TraceSpan span("Cache::getMapTiles", "cache");
+    static char const * layerNames[] = { "map", "metal", "height" };
+    static CacheMetrics metrics("map_tiles");
+
+    MapTiles tiles;
 
-    if (r2 < 1)
+    unsigned int const chksum = model_.getMapChecksum(mapName);
+    if (chksum == 0)
     {
-        w2 *= r2;
+        done(tiles);
+        return;
     }
-    else if (r2 > 1)
+
+    std::ostringstream ossDir;
+    ossDir << mapDir() << "tiles/" << mapName << "_" << chksum << "/";
+    std::string const dir = ossDir.str();
+    if (!boost::filesystem::is_directory(dir))
     {
-        h2 /= r2;
+        boost::filesystem::create_directories(dir);
     }
-    assert(w2 > 0 && h2 > 0);
+    tiles.prefix_ = dir + layerNames[layer] + "_";
 
-    // resize and write
-    Magick::Geometry geom(w2, h2);
-    geom.aspect(true);
-    image.resize(geom);
-    image.write(path);
+    // index file is written last, i.e. all tiles exist if it can be read
+    {
+        std::ifstream ifs(tiles.prefix_ + "index.txt");
+        if (ifs >> tiles.levels_ >> tiles.w_ >> tiles.h_ && tiles.levels_ > 0)
+        {
+            metrics.count(true);
+            done(tiles);
+            return;
+        }
+    }
+
+    std::vector<MapTilesDone> & waiting = tileJobs_[tiles.prefix_];
+    waiting.push_back(done);
+    if (waiting.size() > 1)
+    {
+        return; // already being created
+    }
+    metrics.count(false);
+
+    // unitsync is not thread safe, the layer is read here and only the tiles are made in the job
+    std::shared_ptr<MapLayerData> const data = std::make_shared<MapLayerData>(readMapLayer(mapName, layer));
+    std::shared_ptr<MapTiles> const result = std::make_shared<MapTiles>(tiles);
+    result->levels_ = 0;
+    model_.runJob(
+        [data, result, mapName]()
+        {
+            try
+            {
+                createMapTiles(*data, *result);
+                LOG(DEBUG) << "created " << result->levels_ << " tile levels for " << mapName << " (" << result->w_ << "x" << result->h_ << ")";
+                return 0;
+            }
+            catch (std::exception const & e)
+            {
+                LOG(WARNING) << "failed to create map tiles for " << mapName << ": " << e.what();
+                result->levels_ = 0;
+                return 1;
+            }
+        },
+        [this, result](int)
+        {
+            std::vector<MapTilesDone> callers;
+            callers.swap(tileJobs_[result->prefix_]);
+            tileJobs_.erase(result->prefix_);
+            for (MapTilesDone const & callerDone : callers)
+            {
+                callerDone(*result);
+            }
+        });
+}
+
+Cache::MapLayerData Cache::readMapLayer(std::string const& mapName, MapLayer layer)
+{
+    MapLayerData layerData;
+    int w = 0;
+    int h = 0;
+
+    switch (layer)
+    {
+    case ML_MAP:
+    {
+        auto imageData = model_.getMapImage(mapName, 0);
+        if (!imageData) break;
+
+        // minimap is always 1024x1024, shrink it to the real map aspect
+        int mapW, mapH;
+        model_.getMapSize(mapName, mapW, mapH);
+        layerData.d_ = 3;
+        thumbnailSize(1024, 1024, static_cast<double>(mapW)/mapH, 1024, w, h);
+        layerData.data_.reset(new uint8_t[w*h*layerData.d_]);
+        resizeAreaAverage(imageData.get(), 1024, 1024, layerData.d_, layerData.data_.get(), w, h);
+        break;
+    }
+    case ML_METAL:
+        layerData.data_ = model_.getMetalMap(mapName, w, h);
+        layerData.tint_ = 0x00ff00;
+        break;
+    case ML_HEIGHT:
+        layerData.data_ = model_.getHeightMap(mapName, w, h);
+        break;
+    }
+
+    layerData.w_ = w;
+    layerData.h_ = h;
+    return layerData;
+}
+
+void Cache::createMapTiles(MapLayerData & layer, MapTiles& tiles)
+{
+    if (!layer.data_) return;
+
+    std::unique_ptr<uint8_t[]> data = std::move(layer.data_);
+    int const d = layer.d_;
+
+    tiles.w_ = layer.w_;
+    tiles.h_ = layer.h_;
+    tiles.levels_ = 1;
+    while (tiles.levelW(tiles.levels_-1) > MapTiles::tileSize || tiles.levelH(tiles.levels_-1) > MapTiles::tileSize)
+    {
+        ++tiles.levels_;
+    }
+
+    int const ts = MapTiles::tileSize;
+    std::unique_ptr<uint8_t[]> tile(new uint8_t[ts*ts*d]);
+
+    for (int level = 0; level < tiles.levels_; ++level)
+    {
+        int const lw = tiles.levelW(level);
+        int const lh = tiles.levelH(level);
+
+        if (level > 0)
+        {
+            // each level is made from the previous one
+            std::unique_ptr<uint8_t[]> next(new uint8_t[lw*lh*d]);
+            resizeAreaAverage(data.get(), tiles.levelW(level-1), tiles.levelH(level-1), d, next.get(), lw, lh);
+            data = std::move(next);
+        }
+
+        for (int ty = 0; ty < tiles.tilesY(level); ++ty)
+        {
+            for (int tx = 0; tx < tiles.tilesX(level); ++tx)
+            {
+                int const tw = std::min(ts, lw - tx*ts);
+                int const th = std::min(ts, lh - ty*ts);
+                for (int row = 0; row < th; ++row)
+                {
+                    uint8_t const* src = data.get() + ((ty*ts + row)*lw + tx*ts)*d;
+                    std::copy(src, src + tw*d, tile.get() + row*tw*d);
+                }
+                MyImage::write(tiles.tilePath(level, tx, ty), tile.get(), tw, th, d, layer.tint_);
+            }
+        }
+    }
+
+    std::string const indexPath = tiles.prefix_ + "index.txt";
+    std::ofstream ofs(indexPath);
+    ofs << tiles.levels_ << " " << tiles.w_ << " " << tiles.h_ << "\n";
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to write tiles index file: " + indexPath);
+    }
 }
 
 MapInfo const & Cache::getMapInfo(std::string const & mapName)
 {
+    TraceSpan span("Cache::getMapInfo", "cache");
+    static CacheMetrics metrics("map_info");
     std::string const key = mapInfoKey(mapName);
 
     auto it = mapInfos_.find(key);
     if (it != mapInfos_.end())
     {
         // loaded into memory
+        metrics.count(true);
         return it->second;
     }
     else
@@ -263,11 +452,13 @@ MapInfo const & Cache::getMapInfo(std::string const & mapName)
             // map info file found
             MapInfo mapInfo;
             ifs >> mapInfo;
+            metrics.count(true);
             return mapInfos_[key] = mapInfo;
         }
         else
         {
             // create map info file
+            metrics.count(false);
             MapInfo const mapInfo = model_.getMapInfo(mapName);
             std::ofstream ofs(path);
             if (!ofs.good())
@@ -280,3 +471,61 @@ MapInfo const & Cache::getMapInfo(std::string const & mapName)
         }
     }
 }
+
+MapAnalysis const * Cache::getMapAnalysis(std::string const & mapName)
+{
+    TraceSpan span("Cache::getMapAnalysis", "cache");
+    static CacheMetrics metrics("map_analysis");
+    std::string const path = pathMapAnalysis(mapName);
+    if (path.empty()) return 0;
+
+    std::string const key = mapInfoKey(mapName);
+    auto it = mapAnalyses_.find(key);
+    if (it != mapAnalyses_.end())
+    {
+        // loaded into memory
+        metrics.count(true);
+        return &it->second;
+    }
+
+    std::ifstream ifs(path);
+    if (ifs.good())
+    {
+        MapAnalysis mapAnalysis;
+        try
+        {
+            ifs >> mapAnalysis;
+            metrics.count(true);
+            return &(mapAnalyses_[key] = mapAnalysis);
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << "failed to read map analysis file, recreating it:" << path << ", " << e.what();
+        }
+    }
+
+    // create map analysis file
+    metrics.count(false);
+    int metalW = 0, metalH = 0;
+    int heightW = 0, heightH = 0;
+    auto metal = model_.getMetalMap(mapName, metalW, metalH);
+    auto height = model_.getHeightMap(mapName, heightW, heightH);
+    if (!metal && !height)
+    {
+        return 0;
+    }
+
+    MapAnalysis mapAnalysis;
+    mapAnalysis.analyze(metal.get(), metalW, metalH, height.get(), heightW, heightH);
+
+    std::ofstream ofs(path);
+    if (!ofs.good())
+    {
+        LOG(WARNING) << "failed to open map analysis file for writing:" << path;
+    }
+    else
+    {
+        ofs << mapAnalysis;
+    }
+    return &(mapAnalyses_[key] = mapAnalysis);
+}
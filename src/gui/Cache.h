@@ -3,9 +3,15 @@
 #pragma once
 
 #include "model/MapInfo.h"
+#include "model/MapAnalysis.h"
 
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 class Model;
 class Fl_Shared_Image;
@@ -23,22 +29,63 @@ public:
     bool hasHeightImage(std::string const& mapName);
 
     MapInfo const&   getMapInfo(std::string const& mapName);
+    MapAnalysis const* getMapAnalysis(std::string const& mapName); // returns 0 if map not found
     Fl_Shared_Image* getMapImage(std::string const& mapName); // returns 0 if map not found
     Fl_Shared_Image* getMetalImage(std::string const& mapName);
     Fl_Shared_Image* getHeightImage(std::string const& mapName);
 
+    enum MapLayer { ML_MAP, ML_METAL, ML_HEIGHT };
+
+    // tiled mip pyramid of a map layer stored as MyImage files
+    // level 0 is full resolution (real map aspect), each level halves the size until it fits in one tile
+    struct MapTiles
+    {
+        static int const tileSize = 256;
+
+        int levels_ = 0; // 0 if map not found
+        int w_ = 0; // level 0 size
+        int h_ = 0;
+        std::string prefix_; // tile path prefix
+
+        int levelW(int level) const { return std::max(1, w_ >> level); }
+        int levelH(int level) const { return std::max(1, h_ >> level); }
+        int tilesX(int level) const { return (levelW(level) + tileSize - 1)/tileSize; }
+        int tilesY(int level) const { return (levelH(level) + tileSize - 1)/tileSize; }
+        std::string tilePath(int level, int tx, int ty) const;
+    };
+    typedef std::function<void (MapTiles const & tiles)> MapTilesDone;
+    // done is called with the tiles (levels_ 0 if map not found), right away if they exist,
+    // otherwise the tiles are created in a pooled job and done is called from the FLTK thread when it is finished
+    void getMapTiles(std::string const& mapName, MapLayer layer, MapTilesDone done);
+
 private:
     Model & model_;
     std::map<std::string, MapInfo> mapInfos_;
+    std::map<std::string, MapAnalysis> mapAnalyses_;
+    std::map<std::string, std::vector<MapTilesDone> > tileJobs_; // running by MapTiles::prefix_, waiting callers
+
+    struct MapLayerData
+    {
+        std::unique_ptr<uint8_t[]> data_; // 0 if map not found
+        int w_ = 0;
+        int h_ = 0;
+        int d_ = 1;
+        unsigned int tint_ = 0;
+    };
 
     std::string mapDir();
     std::string mapInfoKey(std::string const& mapName); // returns "<mapname>_<chksum>", throws if map not found
 
     std::string pathMapInfo(std::string const& mapName);
+    std::string pathMapAnalysis(std::string const& mapName);
     std::string pathMapImage(std::string const& mapName);
     std::string pathMetalImage(std::string const& mapName);
     std::string pathHeightImage(std::string const& mapName);
     std::string mapPath(std::string const& mapName, std::string const& suffix); // returns empty string if map do not exist
 
-    void createImageFile(uint8_t const* data, int w, int h, int d, std::string const& path, double r = 1 /* w/h */);
+    MapLayerData readMapLayer(std::string const& mapName, MapLayer layer); // with unitsync, FLTK thread only
+    static void createMapTiles(MapLayerData & layer, MapTiles& tiles); // thread safe, writes tiles and index
+
+    // writes a thumbnail in MyImage format, tint is only used for d 1 (see MyImage::write)
+    void createImageFile(uint8_t const* data, int w, int h, int d, std::string const& path, double r = 1 /* w/h */, unsigned int tint = 0);
 };
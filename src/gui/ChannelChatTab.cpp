@@ -36,6 +36,10 @@ ChannelChatTab::ChannelChatTab(int x, int y, int w, int h, std::string const & c
     Fl_Group * left = new Fl_Group(x, y, leftW, h);
     int const ih = FL_NORMAL_SIZE*2; // input height
     text_ = new TextDisplay2(x, y, leftW, h-ih, &logFile_);
+    if (LogFile::enabled())
+    {
+        text_->appendHistory(LogFile::tail(logFile_.path(), LogFile::historyLines));
+    }
     input_ = new ChatInput(x, y+h-ih, leftW, ih);
     input_->connectText( boost::bind(&ChannelChatTab::onInput, this, _1) );
     input_->connectComplete( boost::bind(&ChannelChatTab::onComplete, this, _1, _2, _3, _4) );
@@ -60,6 +64,7 @@ ChannelChatTab::ChannelChatTab(int x, int y, int w, int h, std::string const & c
     model_.connectChannelClients( boost::bind(&ChannelChatTab::clients, this, _1, _2) );
     model_.connectUserJoinedChannel( boost::bind(&ChannelChatTab::userJoined, this, _1, _2) );
     model_.connectUserLeftChannel( boost::bind(&ChannelChatTab::userLeft, this, _1, _2, _3) );
+    model_.connectChannelUsersChanged( boost::bind(&ChannelChatTab::usersChanged, this, _1, _2) );
     model_.connectSaidChannel( boost::bind(&ChannelChatTab::said, this, _1, _2, _3) );
 }
 
@@ -132,18 +137,16 @@ void ChannelChatTab::clients(std::string const & channelName, std::vector<std::s
 {
     if (channelName == channelName_)
     {
-        for (std::string const & userName : clients)
-        {
-            // catch non-existing user exception here (uberserver bug) to not skip the rest of users in channel
-            try
-            {
-                userList_->add(userName);
-            }
-            catch (std::invalid_argument const& ex)
-            {
-                LOG(WARNING)<< ex.what();
-            }
-        }
+        // model has all users of the channel, rebuild the list at once instead of sorting on each add
+        userList_->set(model_.getChannelUsers(channelName_));
+    }
+}
+
+void ChannelChatTab::usersChanged(std::string const & channelName, std::vector<User const *> const & users)
+{
+    if (channelName == channelName_)
+    {
+        userList_->update(users);
     }
 }
 
@@ -208,6 +211,11 @@ void ChannelChatTab::leave()
     userList_->clear();
 }
 
+void ChannelChatTab::disconnected()
+{
+    userList_->clear();
+}
+
 void ChannelChatTab::append(std::string const & msg, int interest)
 {
     if (msg.empty())
@@ -229,7 +237,7 @@ void ChannelChatTab::append(std::string const & msg, int interest)
 
     if ((interest == 0 && beep_) || interest > 0)
     {
-        Sound::beep();
+        Sound::beep(SE_HIGHLIGHT);
     }
 
 }
@@ -22,6 +22,7 @@ public:
                 ITabs& iTabs, Model & model, ChatSettingsDialog & chatSettingsDialog);
     virtual ~ChannelChatTab();
     void leave();
+    void disconnected(); // channel is rejoined by model after reconnect
     void append(std::string const & msg, int interest = -1);
     void setSplitPos(int x);
     std::string logPath();
@@ -52,6 +53,7 @@ private:
     void clients(std::string const & channelName, std::vector<std::string> const & clients);
     void userJoined(std::string const & channelName, std::string const & userName);
     void userLeft(std::string const & channelName, std::string const & userName, std::string const & reason);
+    void usersChanged(std::string const & channelName, std::vector<User const *> const & users);
     void said(std::string const & channelName, std::string const & userName, std::string const & message);
 
 };
@@ -7,7 +7,6 @@
 
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Preferences.H>
-#include <boost/signals2/signal.hpp>
 #include <string>
 
 
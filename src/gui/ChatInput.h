@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include "model/Signal.h"
+
 #include <FL/Fl_Input.H>
-#include <boost/signals2/signal.hpp>
 #include <deque>
 #include <string>
 #include <cassert>
@@ -20,14 +21,14 @@ public:
     ChatInput(int x, int y, int w, int h, size_t historySize = 10);
 
     // signals
-    typedef boost::signals2::signal<void (std::string const & text)> TextSignal;
-    boost::signals2::connection connectText(TextSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & text)> TextSignal;
+    SignalConnection connectText(TextSignal::slot_type subscriber)
     { return textSignal_.connect(subscriber); }
 
     // result contain completed word and new insert position, completed word is unchanged if not found
-    typedef boost::signals2::signal<void (std::string const& text, std::size_t pos, std::string const& ignore, CompleteResult& result)> CompleteSignal;
-    boost::signals2::connection connectComplete(CompleteSignal::slot_type subscriber)
-    { assert(completeSignal_.num_slots() == 0); return completeSignal_.connect(subscriber); }
+    typedef Signal<void (std::string const& text, std::size_t pos, std::string const& ignore, CompleteResult& result)> CompleteSignal;
+    SignalConnection connectComplete(CompleteSignal::slot_type subscriber)
+    { assert(completeSignal_.empty()); return completeSignal_.connect(subscriber); }
 
 private:
     size_t historySize_;
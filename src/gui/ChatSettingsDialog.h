@@ -3,9 +3,9 @@
 #pragma once
 
 #include "TextDisplay2.h"
+#include "model/Signal.h"
 
 #include <FL/Fl_Window.H>
-#include <boost/signals2/signal.hpp>
 #include <vector>
 #include <string>
 
@@ -39,8 +39,8 @@ public:
     PrivateChatSettings const & getPrivateChatSettings() { return privateChatSettings_; }
 
     // signals
-    typedef boost::signals2::signal<void (void)> ChatSettingsChangedSignal;
-    boost::signals2::connection connectChatSettingsChanged(ChatSettingsChangedSignal::slot_type subscriber)
+    typedef Signal<void (void)> ChatSettingsChangedSignal;
+    SignalConnection connectChatSettingsChanged(ChatSettingsChangedSignal::slot_type subscriber)
     { return ChatSettingsChangedSignal_.connect(subscriber); }
 
 private:
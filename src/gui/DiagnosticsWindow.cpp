@@ -0,0 +1,208 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "DiagnosticsWindow.h"
+#include "StringTable.h"
+#include "Prefs.h"
+#include "log/Log.h"
+
+#include <FL/Fl.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Native_File_Chooser.H>
+#include <FL/fl_ask.H>
+#include <boost/lexical_cast.hpp>
+#include <unordered_map>
+#include <cstdio>
+
+static char const * PrefWindowX = "WindowX";
+static char const * PrefWindowY = "WindowY";
+static char const * PrefWindowW  = "WindowW";
+static char const * PrefWindowH = "WindowH";
+
+static double const refreshInterval = 1.0;
+
+namespace
+{
+    std::string formatRate(double rate)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), rate < 10 ? "%.1f" : "%.0f", rate);
+        return buf;
+    }
+
+    std::string formatDuration(uint64_t ns)
+    {
+        char buf[32];
+        if (ns < 1000)
+        {
+            std::snprintf(buf, sizeof(buf), "%uns", static_cast<unsigned int>(ns));
+        }
+        else if (ns < 1000000)
+        {
+            std::snprintf(buf, sizeof(buf), "%.1fus", ns/1e3);
+        }
+        else if (ns < 1000000000)
+        {
+            std::snprintf(buf, sizeof(buf), "%.1fms", ns/1e6);
+        }
+        else
+        {
+            std::snprintf(buf, sizeof(buf), "%.2fs", ns/1e9);
+        }
+        return buf;
+    }
+}
+
+DiagnosticsWindow::DiagnosticsWindow():
+    Fl_Double_Window(700, 500, "Diagnostics"),
+    prefs_(prefs(), "DiagnosticsWindow")
+{
+    int const bh = FL_NORMAL_SIZE*2; // button height
+    int const m = 5; // margin
+
+    table_ = new StringTable(0, 0, 700, 500 - bh - 2*m, "Diagnostics",
+            { {"metric",24}, {"value",8}, {"per sec",6}, {"p50",6}, {"p90",6}, {"p99",6}, {"max",6} });
+    Fl_Button * btn = new Fl_Button(700 - 150 - m, 500 - bh - m, 150, bh, "Save as JSON...");
+    btn->callback(DiagnosticsWindow::callbackSave, this);
+
+    resizable(table_);
+    end();
+
+    int x, y, w, h;
+    prefs_.get(PrefWindowX, x, 0);
+    prefs_.get(PrefWindowY, y, 0);
+    prefs_.get(PrefWindowW, w, 700);
+    prefs_.get(PrefWindowH, h, 500);
+    resize(x,y,w,h);
+}
+
+DiagnosticsWindow::~DiagnosticsWindow()
+{
+    Fl::remove_timeout(onTimer, this);
+    prefs_.set(PrefWindowX, x_root());
+    prefs_.set(PrefWindowY, y_root());
+    prefs_.set(PrefWindowW, w());
+    prefs_.set(PrefWindowH, h());
+}
+
+void DiagnosticsWindow::show()
+{
+    if (!shown())
+    {
+        Metrics::timing(true);
+        last_ = Metrics::snapshot();
+        refresh();
+        Fl::add_timeout(refreshInterval, onTimer, this);
+    }
+    Fl_Double_Window::show();
+}
+
+void DiagnosticsWindow::hide()
+{
+    Fl::remove_timeout(onTimer, this);
+    Metrics::timing(false);
+    Fl_Double_Window::hide();
+}
+
+void DiagnosticsWindow::onTimer(void * data)
+{
+    DiagnosticsWindow * o = static_cast<DiagnosticsWindow*>(data);
+    o->refresh();
+    Fl::repeat_timeout(refreshInterval, onTimer, data);
+}
+
+void DiagnosticsWindow::refresh()
+{
+    Metrics::Snapshot const now = Metrics::snapshot();
+    double const seconds = std::chrono::duration<double>(now.time_ - last_.time_).count();
+
+    std::unordered_map<std::string, uint64_t> lastCounts;
+    for (auto const & c : last_.counters_)
+    {
+        lastCounts[c.name_] = c.value_;
+    }
+    for (auto const & h : last_.histograms_)
+    {
+        lastCounts[h.name_] = h.count_;
+    }
+    auto const rate = [&](std::string const & name, uint64_t count)
+    {
+        auto const it = lastCounts.find(name);
+        uint64_t const delta = count - (it != lastCounts.end() ? it->second : 0);
+        return seconds > 0 ? formatRate(delta/seconds) : std::string();
+    };
+
+    std::vector<StringTableRow> rows;
+    for (auto const & c : now.counters_)
+    {
+        rows.push_back(StringTableRow(c.name_,
+            { c.name_, boost::lexical_cast<std::string>(c.value_), rate(c.name_, c.value_), "", "", "", "" }));
+    }
+    for (auto const & g : now.gauges_)
+    {
+        rows.push_back(StringTableRow(g.name_,
+            { g.name_, boost::lexical_cast<std::string>(g.value_), "", "", "", "", boost::lexical_cast<std::string>(g.max_) }));
+    }
+    for (auto const & h : now.histograms_)
+    {
+        // controller.recv_batch counts messages, all others are durations
+        bool const duration = (h.name_ != "controller.recv_batch");
+        auto const value = [duration](uint64_t v) { return duration ? formatDuration(v) : boost::lexical_cast<std::string>(v); };
+        rows.push_back(StringTableRow(h.name_,
+            { h.name_, boost::lexical_cast<std::string>(h.count_), rate(h.name_, h.count_),
+              value(h.p50_), value(h.p90_), value(h.p99_), value(h.max_) }));
+    }
+
+    std::vector<StringTableRow> added;
+    for (StringTableRow & row : rows)
+    {
+        int const index = table_->rowIndex(row.id_);
+        if (index >= 0)
+        {
+            table_->updateCells(index, row.data_, ~0u, false);
+        }
+        else
+        {
+            added.push_back(std::move(row));
+        }
+    }
+    if (added.empty())
+    {
+        table_->sort();
+    }
+    else
+    {
+        table_->addRows(std::move(added)); // sorts
+    }
+
+    last_ = now;
+}
+
+void DiagnosticsWindow::callbackSave(Fl_Widget*, void *data)
+{
+    DiagnosticsWindow * o = static_cast<DiagnosticsWindow*>(data);
+    o->save();
+}
+
+void DiagnosticsWindow::save()
+{
+    Fl_Native_File_Chooser fc;
+    fc.title("Save metrics");
+    fc.type(Fl_Native_File_Chooser::BROWSE_SAVEFILE);
+    fc.options(Fl_Native_File_Chooser::SAVEAS_CONFIRM | Fl_Native_File_Chooser::NEW_FOLDER);
+    fc.preset_file("flobby_metrics.json");
+
+    if (fc.show() != 0)
+    {
+        return;
+    }
+
+    try
+    {
+        Metrics::writeJson(fc.filename());
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << e.what();
+        fl_alert("%s", e.what());
+    }
+}
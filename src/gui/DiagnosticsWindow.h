@@ -0,0 +1,32 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "log/Metrics.h"
+
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Preferences.H>
+
+class StringTable;
+
+// live view of the Metrics registry, refreshed every second while shown
+// metrics timing is enabled only while the window is shown
+class DiagnosticsWindow: public Fl_Double_Window
+{
+public:
+    DiagnosticsWindow();
+    virtual ~DiagnosticsWindow();
+
+    void show();
+    void hide();
+
+private:
+    Fl_Preferences prefs_;
+    StringTable * table_;
+    Metrics::Snapshot last_;
+
+    static void onTimer(void * data);
+    static void callbackSave(Fl_Widget*, void*);
+    void refresh();
+    void save();
+};
@@ -13,15 +13,30 @@
 char const * const PrefPrDownloaderExternal = "PrDownloaderExternal";
 char const * const PrefPrDownloaderCmd = "PrDownloaderCmd";
 
+// an upgrade does not switch users to the in-process rapid downloader, it is opt-in until it has seen more use
+static int const useExternalPrdDefault = 1;
+
+void DownloadSettingsDialog::setupDownloader(Model & model)
+{
+    int useExternalPrd;
+    prefs().get(PrefPrDownloaderExternal, useExternalPrd, useExternalPrdDefault);
+    model.useExternalPrDownloader(0 != useExternalPrd);
+
+    char* str;
+    prefs().get(PrefPrDownloaderCmd, str, "pr-downloader");
+    model.setPrDownloaderCmd(str);
+    ::free(str);
+}
+
 DownloadSettingsDialog::DownloadSettingsDialog(Model & model) :
         model_(model), Fl_Window(400, 300, "Downloader")
 {
     set_modal();
 
-    useExternalPrDownloader_ = new Fl_Check_Button(10, 30, 380, 30, "Use external pr-downloader (forced atm)");
-    useExternalPrDownloader_->callback(DownloadSettingsDialog::callbackExternal, this);
+    useExternalPrDownloader_ = new Fl_Check_Button(10, 30, 380, 30, "Use external pr-downloader for games too");
+    useExternalPrDownloader_->tooltip("games are downloaded from rapid by flobby itself otherwise");
 
-    prDownloaderCmd_ = new Fl_File_Input(10, 90, 360, 40, "External pr-downloader command");
+    prDownloaderCmd_ = new Fl_File_Input(10, 90, 360, 40, "External pr-downloader command (maps and engines)");
     prDownloaderCmd_->align(FL_ALIGN_TOP_LEFT);
 
     prDownloaderCmdBrowse_ = new Fl_Button(370, 90, 20, 40, "...");
@@ -33,27 +48,18 @@ DownloadSettingsDialog::DownloadSettingsDialog(Model & model) :
     end();
 
     init();
-
-    model_.useExternalPrDownloader(0 != useExternalPrDownloader_->value());
-    model_.setPrDownloaderCmd(prDownloaderCmd_->value());
 }
 
 void DownloadSettingsDialog::init()
 {
     int useExternalPrd;
-    prefs().get(PrefPrDownloaderExternal, useExternalPrd, 0);
+    prefs().get(PrefPrDownloaderExternal, useExternalPrd, useExternalPrdDefault);
     useExternalPrDownloader_->value(useExternalPrd);
 
-    // TODO use external pr-d until 91.0 unitsync is gone ?
-    useExternalPrDownloader_->value(1);
-    useExternalPrDownloader_->deactivate();
-
     char* str;
     prefs().get(PrefPrDownloaderCmd, str, "pr-downloader");
     prDownloaderCmd_->value(str);
     ::free(str);
-
-    onExternal();
 }
 
 DownloadSettingsDialog::~DownloadSettingsDialog()
@@ -66,34 +72,12 @@ void DownloadSettingsDialog::callbackSave(Fl_Widget*, void *data)
     o->onSave();
 }
 
-void DownloadSettingsDialog::callbackExternal(Fl_Widget*, void *data)
-{
-    DownloadSettingsDialog * o = static_cast<DownloadSettingsDialog*>(data);
-    o->onExternal();
-}
-
 void DownloadSettingsDialog::callbackBrowsePrDownloader(Fl_Widget*, void *data)
 {
     DownloadSettingsDialog * o = static_cast<DownloadSettingsDialog*>(data);
     o->onBrowsePrDownloader();
 }
 
-void DownloadSettingsDialog::onExternal()
-{
-    int const useExternal = useExternalPrDownloader_->value();
-
-    if (0 != useExternal)
-    {
-        prDownloaderCmd_->activate();
-        prDownloaderCmdBrowse_->activate();
-    }
-    else
-    {
-        prDownloaderCmd_->deactivate();
-        prDownloaderCmdBrowse_->deactivate();
-    }
-}
-
 void DownloadSettingsDialog::onSave()
 {
     prefs().set(PrefPrDownloaderExternal, useExternalPrDownloader_->value());
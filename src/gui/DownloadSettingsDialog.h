@@ -18,6 +18,8 @@ public:
     DownloadSettingsDialog(Model & model);
     virtual ~DownloadSettingsDialog();
 
+    static void setupDownloader(Model & model); // sets model from prefs
+
     void show();
     void init();
 
@@ -30,11 +32,9 @@ private:
     Fl_Button * prDownloaderCmdBrowse_;
     Fl_Return_Button * save_;
 
-    static void callbackExternal(Fl_Widget*, void*);
     static void callbackBrowsePrDownloader(Fl_Widget*, void*);
     static void callbackSave(Fl_Widget*, void*);
 
-    void onExternal();
     void onSave();
     void onBrowsePrDownloader();
     bool openFileDialog(char const * title, char const * fileName, std::string & result); // returns false on cancel
@@ -3,7 +3,6 @@
 #pragma once
 
 #include <FL/Fl_Window.H>
-#include <boost/signals2/signal.hpp>
 #include <string>
 
 class Fl_Int_Input;
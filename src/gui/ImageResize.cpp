@@ -0,0 +1,141 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "ImageResize.h"
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+// source taps for each destination index along one axis
+struct Taps
+{
+    std::vector<int> first_; // first source index
+    std::vector<int> count_; // number of source indices
+    std::vector<int> offset_; // offset into weights_
+    std::vector<float> weights_; // sums to 1 for each destination index
+};
+
+void calcTaps(int srcSize, int dstSize, Taps& taps)
+{
+    taps.first_.resize(dstSize);
+    taps.count_.resize(dstSize);
+    taps.offset_.resize(dstSize);
+    taps.weights_.clear();
+
+    double const scale = static_cast<double>(srcSize)/dstSize;
+
+    for (int i=0; i<dstSize; ++i)
+    {
+        double const start = i*scale;
+        double const end = std::min((i+1)*scale, static_cast<double>(srcSize));
+        int const first = static_cast<int>(start);
+        int const last = std::min(static_cast<int>(end - 1e-9), srcSize-1);
+
+        taps.first_[i] = first;
+        taps.count_[i] = last - first + 1;
+        taps.offset_[i] = taps.weights_.size();
+
+        for (int j=first; j<=last; ++j)
+        {
+            double const overlap = std::min(end, j+1.0) - std::max(start, static_cast<double>(j));
+            taps.weights_.push_back(static_cast<float>(overlap/(end-start)));
+        }
+    }
+}
+
+// horizontal pass of one source row into a float row of w2*d values
+void resampleRow(uint8_t const* __restrict src, int d, Taps const& taps, float* __restrict out)
+{
+    int const w2 = taps.first_.size();
+    float const* weights = taps.weights_.data();
+
+    for (int x=0; x<w2; ++x)
+    {
+        uint8_t const* s = src + taps.first_[x]*d;
+        float const* wt = weights + taps.offset_[x];
+        int const count = taps.count_[x];
+
+        for (int c=0; c<d; ++c)
+        {
+            float sum = 0;
+            for (int j=0; j<count; ++j)
+            {
+                sum += wt[j] * s[j*d + c];
+            }
+            out[x*d + c] = sum;
+        }
+    }
+}
+
+}
+
+void resizeAreaAverage(uint8_t const* src, int w, int h, int d, uint8_t* dst, int w2, int h2)
+{
+    assert(src && dst);
+    assert(w > 0 && h > 0 && w2 > 0 && h2 > 0 && d > 0);
+
+    Taps tapsX;
+    Taps tapsY;
+    calcTaps(w, w2, tapsX);
+    calcTaps(h, h2, tapsY);
+
+    int const rowSize = w2*d;
+    std::vector<float> row(rowSize);
+    std::vector<float> acc(rowSize);
+
+    // the loops over rowSize below are kept trivial so the compiler can vectorize them
+    for (int y=0; y<h2; ++y)
+    {
+        std::fill(acc.begin(), acc.end(), 0.0f);
+
+        float const* wt = tapsY.weights_.data() + tapsY.offset_[y];
+        int const first = tapsY.first_[y];
+        int const count = tapsY.count_[y];
+
+        for (int j=0; j<count; ++j)
+        {
+            resampleRow(src + static_cast<std::size_t>(first+j)*w*d, d, tapsX, row.data());
+
+            float const wy = wt[j];
+            float* __restrict a = acc.data();
+            float const* __restrict r = row.data();
+            for (int i=0; i<rowSize; ++i)
+            {
+                a[i] += wy * r[i];
+            }
+        }
+
+        uint8_t* __restrict out = dst + static_cast<std::size_t>(y)*rowSize;
+        float const* __restrict a = acc.data();
+        for (int i=0; i<rowSize; ++i)
+        {
+            float const v = a[i] + 0.5f;
+            out[i] = static_cast<uint8_t>(v < 255.0f ? v : 255.0f);
+        }
+    }
+}
+
+void thumbnailSize(int w, int h, double r, int maxSize, int& w2, int& h2)
+{
+    assert(w > 0 && h > 0 && r > 0 && maxSize > 0);
+
+    double const r2 = static_cast<double>(w)/h * r;
+
+    w2 = maxSize;
+    h2 = maxSize;
+
+    if (r2 < 1)
+    {
+        w2 *= r2;
+    }
+    else if (r2 > 1)
+    {
+        h2 /= r2;
+    }
+
+    w2 = std::max(w2, 1);
+    h2 = std::max(h2, 1);
+}
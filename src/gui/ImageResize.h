@@ -0,0 +1,13 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cstdint>
+
+// area-average (box filter) resampling of 8-bit images with d interleaved channels
+// each destination pixel is the mean of the source area it covers, partial pixels are weighted by coverage
+// dst must hold w2*h2*d bytes
+void resizeAreaAverage(uint8_t const* src, int w, int h, int d, uint8_t* dst, int w2, int h2);
+
+// calculates thumbnail size fitting in maxSize x maxSize, r is the real aspect ratio (w/h) of the image content
+void thumbnailSize(int w, int h, double r, int maxSize, int& w2, int& h2);
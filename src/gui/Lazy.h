@@ -0,0 +1,44 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <memory>
+
+// owns an object created by the factory on first use,
+// for windows and dialogs not needed at startup, they must not depend on signals emitted before they exist
+template <typename T>
+class Lazy
+{
+public:
+    typedef std::function<T * ()> Factory;
+
+    explicit Lazy(Factory factory):
+        factory_(factory)
+    {
+    }
+
+    Lazy(Lazy const &) = delete;
+    Lazy & operator=(Lazy const &) = delete;
+
+    T & get()
+    {
+        if (!object_)
+        {
+            object_.reset(factory_());
+            assert(object_);
+        }
+        return *object_;
+    }
+
+    T * operator->() { return &get(); }
+
+    T * created() const { return object_.get(); } // 0 if not used yet, does not create
+
+    void reset() { object_.reset(); } // deletes, next use creates a new one
+
+private:
+    Factory factory_;
+    std::unique_ptr<T> object_;
+};
@@ -1,6 +1,7 @@
 // This file is part of flobby (GPL v2 or later), see the LICENSE file
 
 #include "LogFile.h"
+#include "LogIndex.h"
 #include "FlobbyDirs.h"
 #include "TextFunctions.h"
 #include "log/Log.h"
@@ -9,12 +10,22 @@
 #include <stdexcept>
 #include <ctime>
 #include <cassert>
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static std::string dir_;
 static bool enabled_ = false;
+static std::unique_ptr<LogIndex> index_;
 
 LogFile::LogFile(std::string const & name):
-    name_(name)
+    name_(name),
+    offset_(0)
 {
 }
 
@@ -30,6 +41,20 @@ void LogFile::init()
     {
         boost::filesystem::create_directories(dir_.c_str());
     }
+
+    try
+    {
+        index_.reset(new LogIndex(dir_));
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << "chat log index not available: " << e.what();
+    }
+}
+
+LogIndex * LogFile::index()
+{
+    return index_.get();
 }
 
 std::string const & LogFile::dir()
@@ -55,20 +80,42 @@ void LogFile::log(std::string const & text)
     if (!ofs_.is_open())
     {
         std::string const fileName = path();
+        boost::system::error_code ec;
+        uintmax_t const size = boost::filesystem::file_size(fileName, ec);
+        offset_ = ec ? 0 : size;
         ofs_.open(fileName, std::fstream::app);
         if (!ofs_.good())
         {
             throw std::runtime_error("failed to open log file: " + fileName);
         }
-        ofs_ << "\nNEW LOG SESSION " << buf << std::endl;
+        writeLine("");
+        writeLine(std::string("NEW LOG SESSION ") + buf);
     }
-    ofs_ << buf << ": " << text << std::endl;
+    writeLine(std::string(buf) + ": " + text);
     if (!ofs_.good())
     {
         throw std::runtime_error("problem writing to log : " + name_);
     }
 }
 
+void LogFile::writeLine(std::string const & line)
+{
+    ofs_ << line << std::endl;
+
+    if (index_)
+    {
+        try
+        {
+            index_->add(name_, offset_, line);
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << "failed to index chat log: " << e.what();
+        }
+    }
+    offset_ += line.size() + 1;
+}
+
 bool LogFile::enabled()
 {
     return enabled_;
@@ -84,3 +131,60 @@ void LogFile::openLogFile(std::string const& path)
     std::string const uri = "file://" + path;
     flOpenUri(uri);
 }
+
+std::vector<std::string> LogFile::tail(std::string const& path, std::size_t maxLines, std::size_t maxBytes)
+{
+    std::vector<std::string> lines;
+
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return lines;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0 || maxLines == 0)
+    {
+        ::close(fd);
+        return lines;
+    }
+
+    // map only the part we may read and the byte before it, offset must be page aligned
+    std::size_t const size = static_cast<std::size_t>(st.st_size);
+    std::size_t const pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t const begin = size > maxBytes ? size - maxBytes : 0;
+    std::size_t const before = begin > 0 ? begin - 1 : 0;
+    std::size_t const offset = before - before % pageSize;
+    void * const map = ::mmap(0, size - offset, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        LOG(WARNING) << "mmap failed: " << path << ", " << std::strerror(errno);
+        return lines;
+    }
+
+    char const * const data = static_cast<char const *>(map);
+    char const * const first = data + (begin - offset);
+    char const * end = data + (size - offset);
+    bool const partialFirst = begin > 0 && first[-1] != '\n'; // first line starts before maxBytes
+
+    // memrchr searches a word at a time, cost depends on maxLines and not on file size
+    while (end > first && lines.size() < maxLines)
+    {
+        char const * nl = static_cast<char const *>(::memrchr(first, '\n', end - first));
+        char const * const lineBegin = nl ? nl + 1 : first;
+        if (nl == 0 && partialFirst)
+        {
+            break; // skip partial line
+        }
+        if (lineBegin != end)
+        {
+            lines.emplace_back(lineBegin, end);
+        }
+        end = nl ? nl : first;
+    }
+
+    ::munmap(map, size - offset);
+    std::reverse(lines.begin(), lines.end());
+    return lines;
+}
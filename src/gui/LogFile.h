@@ -2,8 +2,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <fstream>
+#include <vector>
+
+class LogIndex;
 
 class LogFile
 {
@@ -13,6 +17,7 @@ public:
 
     static void init();
     static std::string const & dir();
+    static LogIndex * index(); // null if index could not be opened
     static bool enabled();
     static void enable(bool enable);
 
@@ -21,7 +26,16 @@ public:
 
     static void openLogFile(std::string const& path);
 
+    static std::size_t const historyLines = 100; // shown when a chat tab is opened
+
+    // last maxLines non-empty lines of file, oldest first, empty if file does not exist
+    // file is memory mapped and only its end is read, at most maxBytes
+    static std::vector<std::string> tail(std::string const& path, std::size_t maxLines, std::size_t maxBytes = 1 << 20);
+
 private:
     std::string name_;
     std::ofstream ofs_;
+    uint64_t offset_; // of next line, for index
+
+    void writeLine(std::string const & line);
 };
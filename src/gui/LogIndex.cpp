@@ -0,0 +1,898 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "LogIndex.h"
+#include "log/Log.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+std::size_t const flushCount = 100000; // pending postings
+std::size_t const maxCandidates = 50000; // lines read for one search, newest first
+std::size_t const timeSize = 21; // "YYYY-MM-DD HH:MM:SS: "
+char const segmentMagic[] = "FLIX1";
+
+void putVarint(std::string & out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+uint64_t getVarint(char const * & p, char const * end)
+{
+    uint64_t v = 0;
+    for (int shift = 0; p != end && shift < 64; shift += 7)
+    {
+        unsigned char const c = static_cast<unsigned char>(*p++);
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    throw std::runtime_error("bad varint in log index");
+}
+
+uint64_t getVarint(std::istream & is)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int const c = is.get();
+        if (c == EOF)
+        {
+            break;
+        }
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    throw std::runtime_error("bad varint in log index");
+}
+
+bool hasTime(std::string const & line)
+{
+    return line.size() >= timeSize && line[4] == '-' && line[10] == ' ' && line[19] == ':' && line[20] == ' ';
+}
+
+}
+
+bool LogIndex::Posting::operator<(Posting const & other) const
+{
+    return file_ < other.file_ || (file_ == other.file_ && offset_ < other.offset_);
+}
+
+bool LogIndex::Posting::operator==(Posting const & other) const
+{
+    return file_ == other.file_ && offset_ == other.offset_;
+}
+
+LogIndex::LogIndex(std::string const & logDir):
+    logDir_(logDir),
+    indexDir_(logDir + "index/"),
+    loaded_(false),
+    nextSegment_(0),
+    pendingCount_(0),
+    stop_(false),
+    ready_(false)
+{
+}
+
+LogIndex::Segment::~Segment()
+{
+    if (merged_)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path_, ec);
+    }
+}
+
+std::string LogIndex::path(std::string const & logName) const
+{
+    return logDir_ + logName + ".log";
+}
+
+uint32_t LogIndex::fileId(std::string const & logName)
+{
+    auto it = fileIds_.find(logName);
+    if (it != fileIds_.end())
+    {
+        return it->second;
+    }
+    uint32_t const id = static_cast<uint32_t>(files_.size());
+    files_.push_back(File{logName, 0, 0, 0, false, 0});
+    fileIds_[logName] = id;
+    return id;
+}
+
+void LogIndex::add(std::string const & logName, uint64_t offset, std::string const & line)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loaded_)
+    {
+        unloaded_.push_back(Line{logName, offset, line}); // file ids are not known yet
+        return;
+    }
+    addLocked(logName, offset, line);
+}
+
+void LogIndex::addLocked(std::string const & logName, uint64_t offset, std::string const & line)
+{
+    uint32_t const id = fileId(logName);
+    File & file = files_[id];
+    uint64_t const end = offset + line.size() + 1;
+    if (offset < file.indexedSize_ || (file.liveEnd_ != 0 && offset < file.liveEnd_))
+    {
+        return; // already indexed
+    }
+
+    pendingCount_ += addLine(pending_, id, offset, line);
+    if (offset == file.indexedSize_ && file.liveEnd_ == 0)
+    {
+        file.indexedSize_ = end;
+    }
+    else
+    {
+        // lines written while flobby was not running or the index was not saved are indexed by update
+        if (file.liveEnd_ == 0)
+        {
+            file.liveBegin_ = offset;
+        }
+        file.liveEnd_ = end;
+    }
+}
+
+std::size_t LogIndex::addLine(PostingsMap & postings, uint32_t file, uint64_t offset, std::string const & line)
+{
+    if (!hasTime(line))
+    {
+        return 0; // session start or empty line
+    }
+
+    std::vector<std::string> lineWords = words(line.substr(timeSize));
+    std::sort(lineWords.begin(), lineWords.end());
+    lineWords.erase(std::unique(lineWords.begin(), lineWords.end()), lineWords.end());
+    for (std::string const & word : lineWords)
+    {
+        postings[word].push_back(Posting{file, offset});
+    }
+    return lineWords.size();
+}
+
+void LogIndex::indexFile(std::string const & logName, uint64_t size)
+{
+    uint32_t id;
+    uint64_t pos;
+    uint64_t end;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = fileId(logName);
+        File const & file = files_[id];
+        pos = file.indexedSize_;
+        end = file.liveEnd_ != 0 ? file.liveBegin_ : size;
+    }
+    if (pos >= end)
+    {
+        return;
+    }
+
+    std::ifstream ifs(path(logName), std::ios::binary);
+    ifs.seekg(pos);
+    if (!ifs.good())
+    {
+        return;
+    }
+
+    // file is read without lock, postings are added in chunks so add is not blocked for long
+    PostingsMap postings;
+    std::size_t count = 0;
+    std::string line;
+    bool done = false;
+    while (!done)
+    {
+        if (pos < end && !stop_ && std::getline(ifs, line) && !ifs.eof()) // incomplete last line is indexed when complete
+        {
+            count += addLine(postings, id, pos, line);
+            pos += line.size() + 1;
+        }
+        else
+        {
+            done = true;
+        }
+
+        if (done || count >= flushCount/10)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto & wordPostings : postings)
+            {
+                Postings & p = pending_[wordPostings.first];
+                p.insert(p.end(), wordPostings.second.begin(), wordPostings.second.end());
+            }
+            pendingCount_ += count;
+            postings.clear();
+            count = 0;
+
+            File & file = files_[id];
+            file.indexedSize_ = std::max(file.indexedSize_, pos);
+            if (file.liveEnd_ != 0 && file.indexedSize_ >= file.liveBegin_)
+            {
+                file.indexedSize_ = file.liveEnd_;
+                file.liveBegin_ = file.liveEnd_ = 0;
+            }
+        }
+    }
+}
+
+void LogIndex::update()
+{
+    namespace fs = boost::filesystem;
+
+    std::lock_guard<std::mutex> lockUpdate(updateMutex_);
+    load();
+
+    for (fs::directory_iterator it(logDir_), end; it != end && !stop_; ++it)
+    {
+        fs::path const & p = it->path();
+        if (p.extension() == ".log" && fs::is_regular_file(p))
+        {
+            indexFile(p.stem().string(), fs::file_size(p));
+
+            bool flush;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flush = pendingCount_ >= flushCount;
+            }
+            if (flush)
+            {
+                flushPending(true);
+            }
+        }
+    }
+    if (!stop_)
+    {
+        flushPending(true);
+        ready_ = true;
+    }
+}
+
+void LogIndex::flush()
+{
+    stop_ = true;
+    std::lock_guard<std::mutex> lockUpdate(updateMutex_);
+    stop_ = false;
+    flushPending(false);
+}
+
+void LogIndex::flushPending(bool merge)
+{
+    std::vector<File> files;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!loaded_ || pending_.empty())
+        {
+            return;
+        }
+        flushing_.swap(pending_);
+        pendingCount_ = 0;
+        for (auto & wordPostings : flushing_)
+        {
+            Postings & p = wordPostings.second;
+            std::sort(p.begin(), p.end());
+            p.erase(std::unique(p.begin(), p.end()), p.end());
+        }
+        files = files_; // what is indexed with flushing_
+    }
+
+    // file ids are assigned by files table order, new files must be in it before a segment refers to them,
+    // with the previous sizes so a crash before the sizes are saved only gives duplicate postings
+    if (std::any_of(files.begin(), files.end(), [](File const & file) { return !file.inTable_; }))
+    {
+        saveFiles(files, false);
+    }
+
+    // flushing_ is only read meanwhile
+    auto it = flushing_.cbegin();
+    SegmentPtr const segment = writeSegment([this, &it](std::string & word, Postings & postings)
+    {
+        if (it == flushing_.cend())
+        {
+            return false;
+        }
+        word = it->first;
+        postings = it->second;
+        ++it;
+        return true;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.push_back(segment);
+        flushing_.clear();
+    }
+
+    saveFiles(files, true);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            files_[i].inTable_ = true;
+            files_[i].savedSize_ = files[i].indexedSize_;
+        }
+    }
+
+    if (merge)
+    {
+        mergeSegments();
+    }
+}
+
+LogIndex::Postings LogIndex::pendingPostings(std::string const & word) const
+{
+    Postings result;
+    for (PostingsMap const * map : { &flushing_, &pending_ })
+    {
+        auto it = map->find(word);
+        if (it != map->end())
+        {
+            result.insert(result.end(), it->second.begin(), it->second.end());
+        }
+    }
+    return result;
+}
+
+LogIndex::Postings LogIndex::postings(std::string const & word, std::vector<SegmentPtr> const & segments, Postings const & pending)
+{
+    Postings result;
+    for (SegmentPtr const & segment : segments)
+    {
+        auto it = segment->words_.find(word);
+        if (it != segment->words_.end())
+        {
+            std::ifstream ifs(segment->path_, std::ios::binary);
+            Postings const p = readPostings(ifs, it->second);
+            result.insert(result.end(), p.begin(), p.end());
+        }
+    }
+    result.insert(result.end(), pending.begin(), pending.end());
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+std::vector<LogIndex::Hit> LogIndex::search(Query const & query, std::size_t maxHits)
+{
+    std::vector<Hit> hits;
+
+    std::vector<std::string> queryWords = words(query.text_);
+    std::sort(queryWords.begin(), queryWords.end());
+    queryWords.erase(std::unique(queryWords.begin(), queryWords.end()), queryWords.end());
+    if (queryWords.empty())
+    {
+        return hits;
+    }
+
+    load();
+
+    // segment files are read after unlocking, the segments stay until the snapshot is released
+    std::vector<SegmentPtr> segments;
+    std::vector<Postings> pending(queryWords.size());
+    std::vector<std::string> fileNames;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments = segments_;
+        for (std::size_t i = 0; i < queryWords.size(); ++i)
+        {
+            pending[i] = pendingPostings(queryWords[i]);
+        }
+        for (File const & file : files_)
+        {
+            fileNames.push_back(file.name_);
+        }
+    }
+
+    Postings result;
+    for (std::size_t i = 0; i < queryWords.size(); ++i)
+    {
+        Postings p = postings(queryWords[i], segments, pending[i]);
+        if (i == 0)
+        {
+            result.swap(p);
+        }
+        else
+        {
+            Postings both;
+            std::set_intersection(result.begin(), result.end(), p.begin(), p.end(), std::back_inserter(both));
+            result.swap(both);
+        }
+        if (result.empty())
+        {
+            return hits;
+        }
+    }
+
+    if (!query.logName_.empty())
+    {
+        result.erase(std::remove_if(result.begin(), result.end(), [&fileNames, &query](Posting const & p)
+            { return fileNames[p.file_].find(query.logName_) == std::string::npos; }), result.end());
+    }
+
+    // lines of a log file are in time order, the files are read backwards from their newest candidate line
+    // and merged by time stamp so the filters are applied before at most maxCandidates lines have been read
+    struct Cursor
+    {
+        uint32_t file_;
+        std::vector<uint64_t> offsets_; // ascending
+        std::size_t next_; // offsets_[next_-1] is read next
+        std::unique_ptr<std::ifstream> ifs_;
+        std::string line_; // last read
+    };
+    std::vector<Cursor> cursors;
+    for (Posting const & p : result)
+    {
+        if (cursors.empty() || cursors.back().file_ != p.file_)
+        {
+            cursors.push_back(Cursor{p.file_, {}, 0, nullptr, ""});
+        }
+        cursors.back().offsets_.push_back(p.offset_);
+    }
+
+    std::size_t linesRead = 0;
+    auto const readPrevious = [&](Cursor & c)
+    {
+        if (!c.ifs_)
+        {
+            c.ifs_.reset(new std::ifstream(path(fileNames[c.file_]), std::ios::binary));
+            c.next_ = c.offsets_.size();
+        }
+        while (c.next_ > 0)
+        {
+            --c.next_;
+            ++linesRead;
+            c.ifs_->clear();
+            c.ifs_->seekg(c.offsets_[c.next_]);
+            if (std::getline(*c.ifs_, c.line_) && hasTime(c.line_))
+            {
+                return true;
+            }
+            // log file changed since indexed
+        }
+        c.ifs_.reset();
+        return false;
+    };
+
+    auto const older = [&cursors](std::size_t a, std::size_t b)
+        { return cursors[a].line_.compare(0, timeSize, cursors[b].line_, 0, timeSize) < 0; };
+    std::vector<std::size_t> heap; // of cursors, newest line on top
+    for (std::size_t i = 0; i < cursors.size(); ++i)
+    {
+        if (readPrevious(cursors[i]))
+        {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), older);
+
+    std::string const userPrefix = query.userName_.empty() ? "" : query.userName_ + ": ";
+    while (!heap.empty() && hits.size() < maxHits && linesRead <= maxCandidates)
+    {
+        std::pop_heap(heap.begin(), heap.end(), older);
+        Cursor & c = cursors[heap.back()];
+        if (!query.since_.empty() && c.line_.compare(0, query.since_.size(), query.since_) < 0)
+        {
+            break; // all others are older
+        }
+        if (userPrefix.empty() || c.line_.compare(timeSize, userPrefix.size(), userPrefix) == 0)
+        {
+            hits.push_back(Hit{fileNames[c.file_], c.offsets_[c.next_], c.line_});
+        }
+
+        if (readPrevious(c))
+        {
+            std::push_heap(heap.begin(), heap.end(), older);
+        }
+        else
+        {
+            heap.pop_back();
+        }
+    }
+    return hits;
+}
+
+std::vector<std::string> LogIndex::words(std::string const & text)
+{
+    std::vector<std::string> result;
+    std::string word;
+    for (std::size_t i = 0; i <= text.size(); ++i)
+    {
+        unsigned char const c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+        {
+            word += static_cast<char>(c);
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            word += static_cast<char>(c - 'A' + 'a');
+        }
+        else
+        {
+            if (word.size() >= 2 && word.size() <= 64)
+            {
+                result.push_back(word);
+            }
+            word.clear();
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> LogIndex::context(std::string const & path, uint64_t offset, int linesAround, int & hitLine)
+{
+    std::vector<std::string> lines;
+    hitLine = -1;
+
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.good())
+    {
+        return lines;
+    }
+
+    // lines are short, read a window around offset
+    uint64_t const window = 256*(linesAround + 1);
+    uint64_t const begin = offset > window ? offset - window : 0;
+    ifs.seekg(begin);
+    std::string buf(window*2, '\0');
+    ifs.read(&buf[0], buf.size());
+    buf.resize(static_cast<std::size_t>(ifs.gcount()));
+
+    std::istringstream iss(buf);
+    std::string line;
+    uint64_t pos = begin;
+    if (begin > 0)
+    {
+        std::getline(iss, line); // partial line
+        pos += line.size() + 1;
+    }
+    while (std::getline(iss, line) && !iss.eof())
+    {
+        if (pos == offset)
+        {
+            hitLine = static_cast<int>(lines.size());
+        }
+        lines.push_back(line);
+        pos += line.size() + 1;
+    }
+
+    if (hitLine == -1)
+    {
+        lines.clear();
+        return lines;
+    }
+
+    int const first = std::max(0, hitLine - linesAround);
+    int const last = std::min(static_cast<int>(lines.size()), hitLine + linesAround + 1);
+    hitLine -= first;
+    return std::vector<std::string>(lines.begin() + first, lines.begin() + last);
+}
+
+void LogIndex::load()
+{
+    std::lock_guard<std::mutex> lockLoad(loadMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loaded_)
+        {
+            return;
+        }
+    }
+
+    // read without mutex_ so add is not blocked meanwhile
+    std::vector<File> files;
+    std::vector<SegmentPtr> segments;
+    unsigned int nextSegment = 0;
+    try
+    {
+        boost::filesystem::create_directories(indexDir_);
+        files = loadFiles();
+        segments = loadSegments(nextSegment);
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << "failed to load chat log index: " << e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_ = true;
+    files_.swap(files);
+    for (uint32_t id = 0; id < files_.size(); ++id)
+    {
+        fileIds_[files_[id].name_] = id;
+    }
+    segments_.swap(segments);
+    nextSegment_ = nextSegment;
+
+    std::vector<Line> lines;
+    lines.swap(unloaded_);
+    for (Line const & line : lines)
+    {
+        addLocked(line.logName_, line.offset_, line.line_);
+    }
+}
+
+std::vector<LogIndex::File> LogIndex::loadFiles() const
+{
+    std::vector<File> files;
+    std::ifstream ifs(indexDir_ + "files");
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        std::size_t const tab = line.find('\t');
+        if (tab == std::string::npos)
+        {
+            continue;
+        }
+        uint64_t const size = std::stoull(line.substr(0, tab));
+        files.push_back(File{line.substr(tab + 1), size, 0, 0, true, size});
+    }
+    return files;
+}
+
+void LogIndex::saveFiles(std::vector<File> const & files, bool indexed)
+{
+    std::string const fileName = indexDir_ + "files";
+    {
+        std::ofstream ofs(fileName + ".tmp");
+        for (File const & file : files)
+        {
+            ofs << (indexed ? file.indexedSize_ : file.savedSize_) << '\t' << file.name_ << '\n';
+        }
+        if (!ofs.good())
+        {
+            throw std::runtime_error("failed to write " + fileName);
+        }
+    }
+    boost::filesystem::rename(fileName + ".tmp", fileName);
+}
+
+std::vector<LogIndex::SegmentPtr> LogIndex::loadSegments(unsigned int & nextSegment) const
+{
+    namespace fs = boost::filesystem;
+
+    std::vector<SegmentPtr> segments;
+    std::vector<fs::path> tmpFiles;
+    for (fs::directory_iterator it(indexDir_), end; it != end; ++it)
+    {
+        std::string const name = it->path().filename().string();
+        if (it->path().extension() == ".tmp")
+        {
+            tmpFiles.push_back(it->path()); // left by a crash while writing
+            continue;
+        }
+        if (name.compare(0, 3, "seg") != 0 || name.find_first_not_of("0123456789", 3) != std::string::npos)
+        {
+            continue;
+        }
+        nextSegment = std::max(nextSegment, static_cast<unsigned int>(std::stoul(name.substr(3))) + 1);
+        try
+        {
+            segments.push_back(readSegment(it->path().string()));
+        }
+        catch (std::exception const & e)
+        {
+            // not completely written, its lines are not in files either and are indexed again
+            LOG(WARNING) << "removing broken log index segment " << name << ": " << e.what();
+            fs::remove(it->path());
+        }
+    }
+    for (fs::path const & p : tmpFiles)
+    {
+        LOG(INFO) << "removing " << p.string();
+        fs::remove(p);
+    }
+
+    // largest first like mergeSegments leaves them, merged by the next update
+    std::sort(segments.begin(), segments.end(), [](SegmentPtr const & a, SegmentPtr const & b) { return a->size_ > b->size_; });
+    return segments;
+}
+
+LogIndex::SegmentPtr LogIndex::readSegment(std::string const & path)
+{
+    SegmentPtr const result = std::make_shared<Segment>();
+    Segment & segment = *result;
+    segment.path_ = path;
+    segment.size_ = boost::filesystem::file_size(path);
+
+    // header, postings, dictionary, dictionary position (8 bytes little endian)
+    std::size_t const headerSize = sizeof(segmentMagic) - 1;
+    if (segment.size_ < headerSize + 8)
+    {
+        throw std::runtime_error("truncated");
+    }
+    std::ifstream ifs(path, std::ios::binary);
+    std::string magic(headerSize, '\0');
+    ifs.read(&magic[0], headerSize);
+    if (magic != segmentMagic)
+    {
+        throw std::runtime_error("bad header");
+    }
+
+    unsigned char trailer[8];
+    ifs.seekg(segment.size_ - 8);
+    ifs.read(reinterpret_cast<char*>(trailer), 8);
+    uint64_t dictPos = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        dictPos = (dictPos << 8) | trailer[i];
+    }
+    if (!ifs.good() || dictPos < headerSize || dictPos > segment.size_ - 8)
+    {
+        throw std::runtime_error("bad dictionary position");
+    }
+
+    ifs.seekg(dictPos);
+    uint64_t pos = headerSize;
+    for (uint64_t count = getVarint(ifs); count > 0; --count)
+    {
+        std::string word(getVarint(ifs), '\0');
+        ifs.read(&word[0], word.size());
+        uint32_t const bytes = static_cast<uint32_t>(getVarint(ifs));
+        segment.words_.emplace_hint(segment.words_.end(), word, Segment::Entry{pos, bytes});
+        pos += bytes;
+    }
+    if (!ifs.good() || pos != dictPos)
+    {
+        throw std::runtime_error("truncated dictionary");
+    }
+    return result;
+}
+
+LogIndex::SegmentPtr LogIndex::writeSegment(NextWord next)
+{
+    std::ostringstream oss;
+    oss << indexDir_ << "seg" << nextSegment_++;
+
+    SegmentPtr const result = std::make_shared<Segment>();
+    Segment & segment = *result;
+    segment.path_ = oss.str();
+
+    std::ofstream ofs(segment.path_ + ".tmp", std::ios::binary);
+    ofs << segmentMagic;
+    uint64_t pos = sizeof(segmentMagic) - 1;
+
+    // postings are delta encoded, offset is absolute when file changes
+    std::string dict;
+    std::string data;
+    std::string word;
+    Postings postings;
+    while (next(word, postings))
+    {
+        data.clear();
+        uint32_t file = 0;
+        uint64_t offset = 0;
+        for (Posting const & p : postings)
+        {
+            putVarint(data, p.file_ - file);
+            putVarint(data, p.file_ != file ? p.offset_ : p.offset_ - offset);
+            file = p.file_;
+            offset = p.offset_;
+        }
+        ofs << data;
+
+        segment.words_.emplace_hint(segment.words_.end(), word, Segment::Entry{pos, static_cast<uint32_t>(data.size())});
+        pos += data.size();
+        putVarint(dict, word.size());
+        dict += word;
+        putVarint(dict, data.size());
+        postings.clear();
+    }
+
+    std::string count;
+    putVarint(count, segment.words_.size());
+    ofs << count << dict;
+    for (int i = 0; i < 8; ++i)
+    {
+        ofs.put(static_cast<char>(pos >> (8*i)));
+    }
+    ofs.close();
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to write " + segment.path_);
+    }
+    boost::filesystem::rename(segment.path_ + ".tmp", segment.path_);
+
+    segment.size_ = pos + count.size() + dict.size() + 8;
+    return result;
+}
+
+LogIndex::Postings LogIndex::readPostings(std::istream & is, Segment::Entry const & entry)
+{
+    Postings result;
+
+    std::string buf(entry.bytes_, '\0');
+    is.seekg(entry.pos_);
+    is.read(&buf[0], buf.size());
+    if (!is.good())
+    {
+        LOG(WARNING) << "failed to read log index";
+        return result;
+    }
+
+    char const * p = buf.data();
+    char const * const end = p + buf.size();
+    uint32_t file = 0;
+    uint64_t offset = 0;
+    while (p != end)
+    {
+        uint64_t const fileDelta = getVarint(p, end);
+        uint64_t const offsetValue = getVarint(p, end);
+        file += static_cast<uint32_t>(fileDelta);
+        offset = fileDelta != 0 ? offsetValue : offset + offsetValue;
+        result.push_back(Posting{file, offset});
+    }
+    return result;
+}
+
+void LogIndex::mergeSegments()
+{
+    // merge last two while the newer one is at least half the size of the older one
+    // segments_ is only changed by load and update so it is read without mutex_ here
+    while (!stop_ && segments_.size() >= 2 && segments_[segments_.size() - 2]->size_ <= 2*segments_.back()->size_)
+    {
+        SegmentPtr const older = segments_[segments_.size() - 2];
+        SegmentPtr const newer = segments_.back();
+
+        // both dictionaries are sorted, postings are read in file order
+        std::ifstream ifsOlder(older->path_, std::ios::binary);
+        std::ifstream ifsNewer(newer->path_, std::ios::binary);
+        auto itOlder = older->words_.begin();
+        auto itNewer = newer->words_.begin();
+        SegmentPtr const merged = writeSegment([&](std::string & word, Postings & postings)
+        {
+            bool const useOlder = itOlder != older->words_.end() && (itNewer == newer->words_.end() || itOlder->first <= itNewer->first);
+            bool const useNewer = itNewer != newer->words_.end() && (itOlder == older->words_.end() || itNewer->first <= itOlder->first);
+            if (!useOlder && !useNewer)
+            {
+                return false;
+            }
+
+            Postings a, b;
+            if (useOlder)
+            {
+                word = itOlder->first;
+                a = readPostings(ifsOlder, itOlder->second);
+                ++itOlder;
+            }
+            if (useNewer)
+            {
+                word = itNewer->first;
+                b = readPostings(ifsNewer, itNewer->second);
+                ++itNewer;
+            }
+            std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(postings));
+            postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+            return true;
+        });
+
+        // the old files are removed when no search uses them anymore, at the latest with older and newer
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            older->merged_ = true;
+            newer->merged_ = true;
+            segments_.resize(segments_.size() - 2);
+            segments_.push_back(merged);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// inverted index of the chat log files, word -> (log file, line offset) postings
+// postings are kept in memory until flush and then written to a new segment file
+// (delta encoded postings in word order followed by the word dictionary),
+// segments of similar size are merged so their count stays logarithmic in the index size
+// add is cheap and called from the FLTK thread, update and search read files and are run in pooled jobs,
+// the index is loaded from disk by the first update or search
+class LogIndex
+{
+public:
+    struct Query
+    {
+        std::string text_; // all words must be in line
+        std::string logName_; // part of log name, e.g. "channel_main", empty for all
+        std::string userName_; // author, empty for all
+        std::string since_; // YYYY-MM-DD, empty for all
+    };
+
+    struct Hit
+    {
+        std::string logName_;
+        uint64_t offset_;
+        std::string line_; // as in log file
+    };
+
+    explicit LogIndex(std::string const & logDir); // index is stored in logDir/index/, nothing is read yet
+
+    // line as written to log file at offset, without newline
+    // lines after content not indexed yet are kept in memory until update indexed the content before them
+    void add(std::string const & logName, uint64_t offset, std::string const & line);
+
+    // indexes all *.log content not indexed yet (e.g. logs written before the index existed), writes pending postings
+    // and merges segments, may take long for big logs, returns early when flush is called meanwhile
+    void update();
+    bool ready() const { return ready_; } // an update has completed, search finds all logged lines
+
+    void flush(); // writes pending postings, stops a running update first
+
+    // newest first, only what is indexed, may read many files so not to be called from the FLTK thread
+    std::vector<Hit> search(Query const & query, std::size_t maxHits = 500);
+
+    std::string path(std::string const & logName) const;
+
+    // lower case words (letters, digits and any non-ASCII), shorter than 2 chars are skipped
+    static std::vector<std::string> words(std::string const & text);
+
+    // lines around offset, hitLine is set to index of the line at offset
+    static std::vector<std::string> context(std::string const & path, uint64_t offset, int linesAround, int & hitLine);
+
+private:
+    struct Posting
+    {
+        uint32_t file_;
+        uint64_t offset_;
+        bool operator<(Posting const & other) const;
+        bool operator==(Posting const & other) const;
+    };
+    typedef std::vector<Posting> Postings;
+    typedef std::map<std::string, Postings> PostingsMap;
+
+    // shared with running searches, the file of a merged segment is removed when the last search using it is done
+    struct Segment
+    {
+        Segment(): size_(0), merged_(false) {}
+        ~Segment();
+
+        std::string path_;
+        uint64_t size_;
+        struct Entry { uint64_t pos_; uint32_t bytes_; };
+        std::map<std::string, Entry> words_;
+        bool merged_;
+    };
+    typedef std::shared_ptr<Segment> SegmentPtr;
+
+    struct File
+    {
+        std::string name_;
+        uint64_t indexedSize_; // all lines before are indexed
+        uint64_t liveBegin_; // lines added after a part not indexed yet, liveEnd_ is 0 if none
+        uint64_t liveEnd_;
+        bool inTable_; // name is in files table, with savedSize_
+        uint64_t savedSize_;
+    };
+
+    struct Line
+    {
+        std::string logName_;
+        uint64_t offset_;
+        std::string line_;
+    };
+
+    std::string const logDir_;
+    std::string const indexDir_;
+
+    std::mutex loadMutex_; // one load at a time, index files are read before mutex_ is locked
+
+    std::mutex mutex_; // for all below, index and log files are read and written without it
+    bool loaded_;
+    std::vector<Line> unloaded_; // added before load
+    std::vector<File> files_;
+    std::unordered_map<std::string, uint32_t> fileIds_;
+    std::vector<SegmentPtr> segments_; // only changed by load and update
+    unsigned int nextSegment_; // used by update only
+    PostingsMap pending_;
+    std::size_t pendingCount_;
+    PostingsMap flushing_; // being written to a segment, searched like pending_
+
+    std::mutex updateMutex_; // one update or flush at a time
+    std::atomic<bool> stop_;
+    std::atomic<bool> ready_;
+
+    void load();
+
+    // with mutex_ locked
+    uint32_t fileId(std::string const & logName);
+    void addLocked(std::string const & logName, uint64_t offset, std::string const & line);
+    Postings pendingPostings(std::string const & word) const;
+
+    // with updateMutex_ locked
+    void indexFile(std::string const & logName, uint64_t size);
+    void flushPending(bool merge);
+
+    static std::size_t addLine(PostingsMap & postings, uint32_t file, uint64_t offset, std::string const & line); // returns postings added
+    static Postings postings(std::string const & word, std::vector<SegmentPtr> const & segments, Postings const & pending);
+    std::vector<File> loadFiles() const;
+    void saveFiles(std::vector<File> const & files, bool indexed); // with indexedSize_ or savedSize_
+    std::vector<SegmentPtr> loadSegments(unsigned int & nextSegment) const;
+    static SegmentPtr readSegment(std::string const & path); // throws on error
+    // next returns false after last word, words must be returned in order
+    typedef std::function<bool (std::string & word, Postings & postings)> NextWord;
+    SegmentPtr writeSegment(NextWord next);
+    static Postings readPostings(std::istream & is, Segment::Entry const & entry);
+    void mergeSegments();
+};
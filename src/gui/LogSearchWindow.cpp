@@ -0,0 +1,236 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "LogSearchWindow.h"
+#include "LogFile.h"
+#include "StringTable.h"
+#include "ITabs.h"
+#include "Prefs.h"
+#include "log/Log.h"
+#include "model/Model.h"
+
+#include <FL/Fl.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Choice.H>
+#include <FL/Fl_Return_Button.H>
+#include <FL/Fl_Tile.H>
+#include <FL/Fl_Text_Display.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <ctime>
+
+static char const * PrefWindowX = "WindowX";
+static char const * PrefWindowY = "WindowY";
+static char const * PrefWindowW  = "WindowW";
+static char const * PrefWindowH = "WindowH";
+
+LogSearchWindow::LogSearchWindow(Model & model, ITabs & iTabs):
+    Fl_Double_Window(800, 600, "Search chat logs"),
+    model_(model),
+    iTabs_(iTabs),
+    prefs_(prefs(), "LogSearchWindow"),
+    generation_(std::make_shared<unsigned int>(0))
+{
+    int const ih = FL_NORMAL_SIZE*2; // input height
+    int const lh = FL_NORMAL_SIZE*1.5; // label height
+    int const m = 5; // margin
+
+    words_ = new Fl_Input(m, lh, 300, ih, "Words");
+    words_->align(FL_ALIGN_TOP_LEFT);
+    logName_ = new Fl_Input(310, lh, 150, ih, "Channel or user chat");
+    logName_->align(FL_ALIGN_TOP_LEFT);
+    userName_ = new Fl_Input(465, lh, 120, ih, "Said by");
+    userName_->align(FL_ALIGN_TOP_LEFT);
+    period_ = new Fl_Choice(590, lh, 110, ih, "When");
+    period_->align(FL_ALIGN_TOP_LEFT);
+    period_->add("Any time|Last day|Last week|Last month|Last year");
+    period_->value(0);
+    Fl_Return_Button * btn = new Fl_Return_Button(705, lh, 90, ih, "Search");
+    btn->callback(LogSearchWindow::callbackSearch, this);
+
+    int const y = lh + ih + m;
+    Fl_Tile * tile = new Fl_Tile(0, y, 800, 600 - y);
+    hitList_ = new StringTable(0, y, 800, 350, "LogSearchHits",
+            { {"log",10}, {"time",10}, {"text",40} }, -1 /* newest first */);
+    context_ = new Fl_Text_Display(0, y + 350, 800, 600 - y - 350);
+    contextText_ = new Fl_Text_Buffer();
+    context_->buffer(contextText_);
+    tile->end();
+
+    resizable(tile);
+    end();
+
+    int x, yw, w, h;
+    prefs_.get(PrefWindowX, x, 0);
+    prefs_.get(PrefWindowY, yw, 0);
+    prefs_.get(PrefWindowW, w, 800);
+    prefs_.get(PrefWindowH, h, 600);
+    resize(x,yw,w,h);
+
+    hitList_->connectRowClicked( boost::bind(&LogSearchWindow::hitClicked, this, _1, _2) );
+    hitList_->connectRowDoubleClicked( boost::bind(&LogSearchWindow::hitDoubleClicked, this, _1, _2) );
+}
+
+LogSearchWindow::~LogSearchWindow()
+{
+    ++*generation_;
+    prefs_.set(PrefWindowX, x_root());
+    prefs_.set(PrefWindowY, y_root());
+    prefs_.set(PrefWindowW, w());
+    prefs_.set(PrefWindowH, h());
+}
+
+void LogSearchWindow::callbackSearch(Fl_Widget*, void *data)
+{
+    LogSearchWindow * o = static_cast<LogSearchWindow*>(data);
+    o->search();
+}
+
+void LogSearchWindow::search()
+{
+    LogIndex * index = LogFile::index();
+    if (index == 0)
+    {
+        contextText_->text("Chat log index not available, see flobby.log");
+        return;
+    }
+
+    LogIndex::Query query;
+    query.text_ = words_->value();
+    query.logName_ = logName_->value();
+    query.userName_ = userName_->value();
+
+    static int const days[] = { 0, 1, 7, 31, 365 };
+    int const period = days[period_->value()];
+    if (period > 0)
+    {
+        char buf[16];
+        std::time_t const t = std::time(0) - period*24*3600;
+        std::tm tm = *std::localtime(&t);
+        std::strftime(buf, sizeof(buf), "%F", &tm);
+        query.since_ = buf;
+    }
+
+    // logs are indexed in a pooled job started by UserInterface
+    contextText_->text("Searching...");
+    std::shared_ptr<std::vector<LogIndex::Hit>> const hits = std::make_shared<std::vector<LogIndex::Hit>>();
+    std::shared_ptr<unsigned int> const generation = generation_;
+    unsigned int const myGeneration = ++*generation;
+    model_.runJob(
+        [index, query, hits]()
+        {
+            try
+            {
+                *hits = index->search(query);
+                return 0;
+            }
+            catch (std::exception const & e)
+            {
+                LOG(WARNING) << "chat log search failed: " << e.what();
+                hits->clear();
+                return 1;
+            }
+        },
+        [this, index, hits, generation, myGeneration](int)
+        {
+            if (*generation == myGeneration) // window still exists and no newer search started
+            {
+                searchDone(*index, *hits);
+            }
+        });
+}
+
+void LogSearchWindow::searchDone(LogIndex const & index, std::vector<LogIndex::Hit> & hits)
+{
+    hits_.swap(hits);
+
+    std::vector<StringTableRow> rows;
+    rows.reserve(hits_.size());
+    for (std::size_t i = 0; i < hits_.size(); ++i)
+    {
+        std::string const & line = hits_[i].line_;
+        rows.push_back(StringTableRow(boost::lexical_cast<std::string>(i),
+            {
+                hits_[i].logName_,
+                line.substr(0, 19),
+                line.size() > 21 ? line.substr(21) : ""
+            } ));
+    }
+    hitList_->clear();
+    hitList_->addRows(std::move(rows));
+
+    if (!index.ready())
+    {
+        contextText_->text(hits_.empty() ? "No matches, chat logs are still being indexed" :
+                                           "Chat logs are still being indexed, older lines may be missing");
+    }
+    else
+    {
+        contextText_->text(hits_.empty() ? "No matches" : "");
+    }
+}
+
+LogIndex::Hit const * LogSearchWindow::hit(int rowIndex)
+{
+    try
+    {
+        std::size_t const i = boost::lexical_cast<std::size_t>(hitList_->getRow(static_cast<std::size_t>(rowIndex)).id_);
+        return i < hits_.size() ? &hits_[i] : 0;
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << e.what();
+        return 0;
+    }
+}
+
+void LogSearchWindow::hitClicked(int rowIndex, int button)
+{
+    LogIndex::Hit const * h = hit(rowIndex);
+    LogIndex * index = LogFile::index();
+    if (h == 0 || index == 0)
+    {
+        return;
+    }
+
+    int hitLine;
+    std::vector<std::string> const lines = LogIndex::context(index->path(h->logName_), h->offset_, 20, hitLine);
+    std::string text;
+    int start = 0;
+    int end = 0;
+    for (int i = 0; i < static_cast<int>(lines.size()); ++i)
+    {
+        if (i == hitLine)
+        {
+            start = static_cast<int>(text.size());
+            end = start + static_cast<int>(lines[i].size());
+        }
+        text += lines[i];
+        text += '\n';
+    }
+    contextText_->text(text.c_str());
+
+    // select and show the hit
+    contextText_->select(start, end);
+    context_->insert_position(start);
+    context_->show_insert_position();
+}
+
+void LogSearchWindow::hitDoubleClicked(int rowIndex, int button)
+{
+    LogIndex::Hit const * h = hit(rowIndex);
+    if (h == 0)
+    {
+        return;
+    }
+
+    std::string const & name = h->logName_;
+    if (name.compare(0, 8, "channel_") == 0)
+    {
+        iTabs_.openChannelChat(name.substr(8));
+    }
+    else if (name.compare(0, 5, "chat_") == 0)
+    {
+        iTabs_.openPrivateChat(name.substr(5));
+    }
+}
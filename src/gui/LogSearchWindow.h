@@ -0,0 +1,51 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "LogIndex.h"
+
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Preferences.H>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Model;
+class ITabs;
+class StringTable;
+class Fl_Input;
+class Fl_Choice;
+class Fl_Text_Display;
+class Fl_Text_Buffer;
+
+// search in chat logs, selected hit is shown with the lines around it, double click opens the chat tab
+// the search runs in a pooled job
+class LogSearchWindow: public Fl_Double_Window
+{
+public:
+    LogSearchWindow(Model & model, ITabs & iTabs);
+    virtual ~LogSearchWindow();
+
+private:
+    Model & model_;
+    ITabs & iTabs_;
+    Fl_Preferences prefs_;
+
+    Fl_Input * words_;
+    Fl_Input * logName_;
+    Fl_Input * userName_;
+    Fl_Choice * period_;
+    StringTable * hitList_;
+    Fl_Text_Display * context_;
+    Fl_Text_Buffer * contextText_;
+
+    std::vector<LogIndex::Hit> hits_;
+    std::shared_ptr<unsigned int> generation_; // incremented by each search and the destructor, older results are dropped
+
+    static void callbackSearch(Fl_Widget*, void*);
+    void search();
+    void searchDone(LogIndex const & index, std::vector<LogIndex::Hit> & hits);
+    void hitClicked(int rowIndex, int button);
+    void hitDoubleClicked(int rowIndex, int button);
+    LogIndex::Hit const * hit(int rowIndex);
+};
@@ -17,6 +17,7 @@
 
 // Prefs
 static char const * const PrefAutoLogin = "AutoLogin";
+static char const * const PrefAutoReconnect = "AutoReconnect";
 
 LoginDialog::LoginDialog(Model & model):
     Fl_Window(400, 400, "Login"),
@@ -38,9 +39,10 @@ LoginDialog::LoginDialog(Model & model):
     password_ = new Fl_Secret_Input(10, 170, 380, 30, "Password");
     password_->align(FL_ALIGN_TOP_LEFT);
 
-    autoLogin_ = new Fl_Check_Button(10, 220, 380, 30, "Login automatically");
+    autoLogin_ = new Fl_Check_Button(10, 210, 380, 30, "Login automatically");
+    autoReconnect_ = new Fl_Check_Button(10, 240, 380, 30, "Reconnect automatically when connection is lost");
 
-    info_ = new Fl_Box(10, 250, 380, 90);
+    info_ = new Fl_Box(10, 270, 380, 70);
     info_->labelcolor(FL_RED);
 
     Fl_Return_Button * btn = new Fl_Return_Button(300, 350, 90, 30, "Login");
@@ -85,6 +87,11 @@ void LoginDialog::loadLoginPrefs()
     int autoLogin;
     prefs_.get(PrefAutoLogin, autoLogin, 0);
     autoLogin_->value(autoLogin);
+
+    int autoReconnect;
+    prefs_.get(PrefAutoReconnect, autoReconnect, 1);
+    autoReconnect_->value(autoReconnect);
+    model_.setAutoReconnect(autoReconnect != 0);
 }
 
 void LoginDialog::show()
@@ -126,6 +133,8 @@ void LoginDialog::onLogin()
     prefs_.set(PrefLoginPort, port_->value());
     prefs_.set(PrefLoginUser, userName_->value());
     prefs_.set(PrefAutoLogin, static_cast<int>(autoLogin_->value()) );
+    prefs_.set(PrefAutoReconnect, static_cast<int>(autoReconnect_->value()) );
+    model_.setAutoReconnect(autoReconnect_->value() != 0);
 
     attemptLogin();
 }
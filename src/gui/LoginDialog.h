@@ -4,7 +4,6 @@
 
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Preferences.H>
-#include <boost/signals2/signal.hpp>
 #include <string>
 
 class Model;
@@ -32,6 +31,7 @@ private:
     Fl_Input * userName_;
     Fl_Secret_Input * password_;
     Fl_Check_Button * autoLogin_;
+    Fl_Check_Button * autoReconnect_;
     Fl_Box * info_;
 
     std::string passwordHash_;
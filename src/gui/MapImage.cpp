@@ -1,6 +1,7 @@
 // This file is part of flobby (GPL v2 or later), see the LICENSE file
 
 #include "MapImage.h"
+#include "log/Trace.h"
 
 #include "FL/Fl.H"
 #include "FL/fl_draw.H"
@@ -22,6 +23,7 @@ MapImage::~MapImage()
 
 void MapImage::draw()
 {
+    TraceSpan span("MapImage::draw");
     draw_box();
 
     Fl_Image * img = image();
@@ -31,7 +33,8 @@ void MapImage::draw()
         int Y = y() + h()/2 - img->h()/2;
 
         img->draw(X, Y);
-        drawStartRects(X, Y, img->w(), img->h());
+        drawMetalSpots(X, Y, img->w(), img->h());
+        drawStartRects(startRects_, ally_, X, Y, img->w(), img->h());
     }
     else
     {
@@ -39,19 +42,39 @@ void MapImage::draw()
     }
 }
 
-void MapImage::drawStartRects(int x, int y, int w, int h)
+void MapImage::drawMetalSpots(int x, int y, int w, int h)
 {
-    for (StartRect const & sr : startRects_)
+    // skip overlay on maps with metal everywhere, it would only hide the map
+    if (metalSpots_.size() > 256)
     {
-        fl_color( (sr.ally() == ally_) ? FL_GREEN : FL_RED );
+        return;
+    }
+
+    int const r = 2;
+    for (MapAnalysis::MetalSpot const & spot : metalSpots_)
+    {
+        int const X = x + std::round( spot.x_*w );
+        int const Y = y + std::round( spot.y_*h );
+        fl_color(FL_BLACK);
+        fl_pie(X-r-1, Y-r-1, 2*r+2, 2*r+2, 0, 360);
+        fl_color(FL_YELLOW);
+        fl_pie(X-r, Y-r, 2*r, 2*r, 0, 360);
+    }
+}
+
+void MapImage::drawStartRects(std::vector<StartRect> const& startRects, int ally, int x, int y, int w, int h)
+{
+    for (StartRect const & sr : startRects)
+    {
+        fl_color( (sr.ally() == ally) ? FL_GREEN : FL_RED );
 
         int X = x + std::round( sr.left()*w );
         int Y = y + std::round( sr.top()*h );
         int W = std::round( (sr.right() - sr.left())*w );
         int H = std::round( (sr.bottom() - sr.top())*h );
         fl_rect(X, Y, W, H);
-        std::string const ally = boost::lexical_cast<std::string>(sr.ally()+1);
-        fl_draw(ally.c_str(), X, Y, W, H, FL_ALIGN_CENTER);
+        std::string const allyStr = boost::lexical_cast<std::string>(sr.ally()+1);
+        fl_draw(allyStr.c_str(), X, Y, W, H, FL_ALIGN_CENTER);
     }
 }
 
@@ -75,6 +98,12 @@ void MapImage::removeAllStartRects()
     redraw();
 }
 
+void MapImage::setMetalSpots(std::vector<MapAnalysis::MetalSpot> const & spots)
+{
+    metalSpots_ = spots;
+    redraw();
+}
+
 void MapImage::setAlly(int ally)
 {
     if (ally != ally_)
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "model/StartRect.h"
+#include "model/MapAnalysis.h"
 #include <FL/Fl_Box.H>
 #include <vector>
 
@@ -16,15 +17,21 @@ public:
     void removeStartRect(int ally);
     void removeAllStartRects();
     void setAlly(int ally);
+    void setMetalSpots(std::vector<MapAnalysis::MetalSpot> const & spots); // overlay, empty vector removes it
+    std::vector<StartRect> const& startRects() const { return startRects_; }
+    int ally() const { return ally_; }
+
+    // draws start rects scaled to a map drawn at x,y with size w,h
+    static void drawStartRects(std::vector<StartRect> const& startRects, int ally, int x, int y, int w, int h);
 
 private:
     int ally_;
     std::vector<StartRect> startRects_;
+    std::vector<MapAnalysis::MetalSpot> metalSpots_;
 
     int handle(int event);
     void draw();
-
-    void drawStartRects(int x, int y, int w, int h);
+    void drawMetalSpots(int x, int y, int w, int h);
 
 };
 
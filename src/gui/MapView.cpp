@@ -0,0 +1,272 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "MapView.h"
+#include "MapImage.h"
+#include "MyImage.h"
+
+#include "log/Log.h"
+#include "log/Trace.h"
+
+#include <FL/Fl.H>
+#include <FL/fl_draw.H>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+MapView::MapView(int x, int y, int w, int h, Cache & cache):
+    Fl_Widget(x, y, w, h),
+    cache_(cache),
+    layer_(Cache::ML_MAP),
+    loading_(false),
+    request_(std::make_shared<unsigned int>(0)),
+    level_(0),
+    viewX_(0),
+    viewY_(0),
+    dragX_(0),
+    dragY_(0),
+    ally_(-1)
+{
+    labelcolor(FL_WHITE);
+}
+
+MapView::~MapView()
+{
+    ++*request_;
+}
+
+void MapView::map(std::string const & mapName, Cache::MapLayer layer)
+{
+    if (mapName == mapName_ && layer == layer_ && (tiles_.levels_ > 0 || loading_))
+    {
+        return;
+    }
+
+    clear();
+    mapName_ = mapName;
+    layer_ = layer;
+    loading_ = true;
+    label("creating map tiles...");
+
+    // the tiles job may finish after this view is gone
+    std::shared_ptr<unsigned int> const request = request_;
+    unsigned int const myRequest = *request;
+    try
+    {
+        cache_.getMapTiles(mapName, layer,
+            [this, request, myRequest](Cache::MapTiles const & tiles)
+            {
+                if (*request == myRequest) // view still exists, not cleared and no other map meanwhile
+                {
+                    tilesReady(tiles);
+                }
+            });
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << "failed to get map tiles for " << mapName << ": " << e.what();
+        tilesReady(Cache::MapTiles());
+    }
+}
+
+void MapView::tilesReady(Cache::MapTiles const & tiles)
+{
+    loading_ = false;
+    tiles_ = tiles;
+    label(tiles_.levels_ == 0 ? "map not available" : 0);
+    fit();
+    redraw();
+}
+
+void MapView::setStartRects(std::vector<StartRect> const & startRects, int ally)
+{
+    startRects_ = startRects;
+    ally_ = ally;
+    redraw();
+}
+
+void MapView::clear()
+{
+    images_.clear();
+    tiles_ = Cache::MapTiles();
+    mapName_.clear();
+    loading_ = false;
+    ++*request_;
+    label(0);
+    redraw();
+}
+
+void MapView::draw()
+{
+    TraceSpan span("MapView::draw");
+    fl_push_clip(x(), y(), w(), h());
+    fl_rectf(x(), y(), w(), h(), FL_BLACK);
+
+    if (tiles_.levels_ == 0)
+    {
+        draw_label();
+        fl_pop_clip();
+        return;
+    }
+
+    int const ts = Cache::MapTiles::tileSize;
+    int const lw = tiles_.levelW(level_);
+    int const lh = tiles_.levelH(level_);
+
+    // map origin in window coordinates
+    int const ox = x() - viewX_;
+    int const oy = y() - viewY_;
+
+    // visible part of current level
+    int const vx0 = std::max(0, viewX_);
+    int const vy0 = std::max(0, viewY_);
+    int const vx1 = std::min(lw, viewX_ + w());
+    int const vy1 = std::min(lh, viewY_ + h());
+
+    std::set<TileKey> visible;
+    if (vx1 > vx0 && vy1 > vy0)
+    {
+        for (int ty = vy0/ts; ty <= (vy1-1)/ts; ++ty)
+        {
+            for (int tx = vx0/ts; tx <= (vx1-1)/ts; ++tx)
+            {
+                TileKey const key(level_, tx, ty);
+                visible.insert(key);
+                Fl_RGB_Image * image = tile(key);
+                if (image)
+                {
+                    image->draw(ox + tx*ts, oy + ty*ts);
+                }
+            }
+        }
+    }
+
+    // release tiles not visible anymore
+    for (auto it = images_.begin(); it != images_.end(); )
+    {
+        if (visible.count(it->first) == 0)
+        {
+            it = images_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    MapImage::drawStartRects(startRects_, ally_, ox, oy, lw, lh);
+
+    fl_pop_clip();
+}
+
+Fl_RGB_Image * MapView::tile(TileKey const & key)
+{
+    auto it = images_.find(key);
+    if (it != images_.end())
+    {
+        return it->second.get();
+    }
+
+    std::unique_ptr<Fl_RGB_Image> & image = images_[key];
+    std::string const path = tiles_.tilePath(std::get<0>(key), std::get<1>(key), std::get<2>(key));
+    try
+    {
+        image.reset(new MyImage(path));
+    }
+    catch (std::exception const & e)
+    {
+        // keep the empty entry to avoid retrying while the tile is visible
+        LOG(WARNING) << "failed to load tile " << path << ": " << e.what();
+    }
+    return image.get();
+}
+
+int MapView::handle(int event)
+{
+    switch (event)
+    {
+    case FL_PUSH:
+        dragX_ = Fl::event_x();
+        dragY_ = Fl::event_y();
+        return 1;
+
+    case FL_DRAG:
+        viewX_ -= Fl::event_x() - dragX_;
+        viewY_ -= Fl::event_y() - dragY_;
+        dragX_ = Fl::event_x();
+        dragY_ = Fl::event_y();
+        clampView();
+        redraw();
+        return 1;
+
+    case FL_MOUSEWHEEL:
+        if (Fl::event_dy() != 0)
+        {
+            zoom(Fl::event_dy() < 0 ? -1 : 1, Fl::event_x() - x(), Fl::event_y() - y());
+        }
+        return 1;
+    }
+
+    return Fl_Widget::handle(event);
+}
+
+void MapView::resize(int x, int y, int w, int h)
+{
+    Fl_Widget::resize(x, y, w, h);
+    clampView();
+}
+
+void MapView::zoom(int levelDelta, int mx, int my)
+{
+    if (tiles_.levels_ == 0)
+    {
+        return;
+    }
+
+    int const level = std::max(0, std::min(tiles_.levels_-1, level_ + levelDelta));
+    if (level == level_)
+    {
+        return;
+    }
+
+    double const sx = static_cast<double>(tiles_.levelW(level))/tiles_.levelW(level_);
+    double const sy = static_cast<double>(tiles_.levelH(level))/tiles_.levelH(level_);
+
+    viewX_ = (viewX_ + mx)*sx - mx;
+    viewY_ = (viewY_ + my)*sy - my;
+    level_ = level;
+
+    clampView();
+    redraw();
+}
+
+void MapView::fit()
+{
+    // use the most detailed level that fits in view
+    level_ = std::max(0, tiles_.levels_-1);
+    for (int level = 0; level < tiles_.levels_; ++level)
+    {
+        if (tiles_.levelW(level) <= w() && tiles_.levelH(level) <= h())
+        {
+            level_ = level;
+            break;
+        }
+    }
+    viewX_ = 0;
+    viewY_ = 0;
+    clampView();
+}
+
+void MapView::clampView()
+{
+    if (tiles_.levels_ == 0)
+    {
+        return;
+    }
+
+    // center level if smaller than view, otherwise keep view inside level
+    int const lw = tiles_.levelW(level_);
+    int const lh = tiles_.levelH(level_);
+
+    viewX_ = (lw <= w()) ? -(w() - lw)/2 : std::max(0, std::min(viewX_, lw - w()));
+    viewY_ = (lh <= h()) ? -(h() - lh)/2 : std::max(0, std::min(viewY_, lh - h()));
+}
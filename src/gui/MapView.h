@@ -0,0 +1,56 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "Cache.h"
+#include "model/StartRect.h"
+
+#include <FL/Fl_Widget.H>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class Fl_RGB_Image;
+
+// zoomable and pannable map view drawing tiles from Cache::getMapTiles
+// only the tiles visible at the current zoom level are kept in memory, missing tiles are created in a pooled job
+class MapView: public Fl_Widget
+{
+public:
+    MapView(int x, int y, int w, int h, Cache & cache);
+    virtual ~MapView();
+
+    void map(std::string const & mapName, Cache::MapLayer layer);
+    void setStartRects(std::vector<StartRect> const & startRects, int ally);
+    void clear();
+
+private:
+    Cache & cache_;
+    std::string mapName_;
+    Cache::MapLayer layer_;
+    Cache::MapTiles tiles_;
+    bool loading_; // waiting for tiles of mapName_
+    std::shared_ptr<unsigned int> request_; // incremented by clear and the destructor, tiles of older requests are ignored
+    int level_;
+    int viewX_; // view position in current level pixels, negative when level is smaller than view
+    int viewY_;
+    int dragX_;
+    int dragY_;
+    std::vector<StartRect> startRects_;
+    int ally_;
+
+    typedef std::tuple<int, int, int> TileKey; // level, tx, ty
+    std::map<TileKey, std::unique_ptr<Fl_RGB_Image>> images_;
+
+    void draw();
+    int handle(int event);
+    void resize(int x, int y, int w, int h);
+
+    void tilesReady(Cache::MapTiles const & tiles);
+    Fl_RGB_Image * tile(TileKey const & key); // returns 0 if tile could not be loaded
+    void zoom(int levelDelta, int mx, int my); // keeps map position at mx,my (widget relative) still
+    void fit();
+    void clampView();
+};
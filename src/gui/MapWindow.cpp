@@ -0,0 +1,78 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "MapWindow.h"
+#include "MapView.h"
+#include "Cache.h"
+#include "Prefs.h"
+
+#include <FL/Fl_Round_Button.H>
+
+static char const * PrefWindowX = "WindowX";
+static char const * PrefWindowY = "WindowY";
+static char const * PrefWindowW  = "WindowW";
+static char const * PrefWindowH = "WindowH";
+
+MapWindow::MapWindow(Cache & cache, char const * prefsGroup):
+    Fl_Double_Window(512, 512, "Map"),
+    cache_(cache),
+    prefs_(prefs(), prefsGroup)
+{
+    int const btnH = FL_NORMAL_SIZE*2;
+
+    char const * layerNames[] = { "Map", "Metal", "Height" };
+    for (int i=0; i<3; ++i)
+    {
+        layerBtns_[i] = new Fl_Round_Button(i*80, 0, 80, btnH, layerNames[i]);
+        layerBtns_[i]->type(FL_RADIO_BUTTON);
+        layerBtns_[i]->callback(MapWindow::callbackLayer, this);
+    }
+    layerBtns_[0]->setonly();
+
+    mapView_ = new MapView(0, btnH, w(), h()-btnH, cache_);
+    resizable(mapView_);
+    end();
+
+    int x, y, w, h;
+    prefs_.get(PrefWindowX, x, 0);
+    prefs_.get(PrefWindowY, y, 0);
+    prefs_.get(PrefWindowW, w, 512);
+    prefs_.get(PrefWindowH, h, 512+btnH);
+    resize(x,y,w,h);
+    size_range(3*80, 128+btnH, 0, 0, 0, 0, 0);
+}
+
+MapWindow::~MapWindow()
+{
+    prefs_.set(PrefWindowX, x_root());
+    prefs_.set(PrefWindowY, y_root());
+    prefs_.set(PrefWindowW, w());
+    prefs_.set(PrefWindowH, h());
+}
+
+void MapWindow::showMap(std::string const & mapName)
+{
+    mapName_ = mapName;
+    copy_label(mapName_.c_str());
+    updateLayer();
+    show();
+}
+
+void MapWindow::setStartRects(std::vector<StartRect> const & startRects, int ally)
+{
+    mapView_->setStartRects(startRects, ally);
+}
+
+void MapWindow::callbackLayer(Fl_Widget*, void* data)
+{
+    MapWindow * mw = static_cast<MapWindow*>(data);
+    mw->updateLayer();
+}
+
+void MapWindow::updateLayer()
+{
+    Cache::MapLayer layer = Cache::ML_MAP;
+    if (layerBtns_[1]->value()) layer = Cache::ML_METAL;
+    if (layerBtns_[2]->value()) layer = Cache::ML_HEIGHT;
+
+    mapView_->map(mapName_, layer);
+}
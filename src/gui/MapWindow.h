@@ -0,0 +1,35 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "model/StartRect.h"
+
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Preferences.H>
+#include <string>
+#include <vector>
+
+class Cache;
+class MapView;
+class Fl_Round_Button;
+
+class MapWindow: public Fl_Double_Window
+{
+public:
+    MapWindow(Cache & cache, char const * prefsGroup); // position and size are saved in prefsGroup
+    virtual ~MapWindow();
+
+    void showMap(std::string const & mapName);
+    void setStartRects(std::vector<StartRect> const & startRects, int ally);
+    std::string const & mapName() const { return mapName_; }
+
+private:
+    Cache & cache_;
+    Fl_Preferences prefs_;
+    std::string mapName_;
+    MapView * mapView_;
+    Fl_Round_Button * layerBtns_[3]; // map, metal, height
+
+    static void callbackLayer(Fl_Widget*, void* data);
+    void updateLayer();
+};
@@ -1,6 +1,7 @@
 // This file is part of flobby (GPL v2 or later), see the LICENSE file
 
 #include "MapsWindow.h"
+#include "log/Trace.h"
 #include "PopupMenu.h"
 #include "Prefs.h"
 #include "Cache.h"
@@ -101,6 +102,7 @@ int MapsWindow::handle(int event)
 
 void MapsWindow::draw()
 {
+    TraceSpan span("MapsWindow::draw");
     Fl_Double_Window::draw();
     return;
 }
@@ -136,6 +138,7 @@ void MapsWindow::MapArea::MapInfoWin::info(std::string const& info)
 
 void MapsWindow::MapArea::MapInfoWin::draw()
 {
+    TraceSpan span("MapsWindow::MapArea::MapInfoWin::draw");
     draw_box(FL_BORDER_BOX, 0, 0, w(), h(), Fl_Tooltip::color());
     fl_color(Fl_Tooltip::textcolor());
     fl_font(Fl_Tooltip::font(), Fl_Tooltip::size());
@@ -163,6 +166,7 @@ MapsWindow::MapArea::MapArea(int x, int y, int w, int h, Model& model)
 
 void MapsWindow::MapArea::draw()
 {
+    TraceSpan span("MapsWindow::MapArea::draw");
     fl_color(FL_BACKGROUND_COLOR);
     fl_rectf(0, 0, w(), h());
 
@@ -6,20 +6,22 @@
 
 #include <FL/Fl_Shared_Image.H>
 #include <cstring>
+#include <cstdio>
 #include <fstream>
 #include <stdexcept>
 
 MyImage::MyImage(std::string const & fileName):
     Fl_RGB_Image(0,0,0)
 {
-    std::ifstream ifs(fileName);
+    std::ifstream ifs(fileName, std::ios::binary);
 
     if (!ifs.good())
     {
         throw std::invalid_argument("file not found:" + fileName);
     }
 
-    // header: FLOBBY_IMAGE <W> <H> <D>\n, e.g. "FLOBBY_IMAGE 512 512 3\n"
+    // header: FLOBBY_IMAGE <W> <H> <D> [<TINT>]\n, e.g. "FLOBBY_IMAGE 512 512 3\n" or "FLOBBY_IMAGE 128 128 1 00ff00\n"
+    // optional TINT (hex RRGGBB) is only valid for D 1, the image is expanded to RGB using the tint when loaded
 
     std::string id;
     ifs >> id;
@@ -52,9 +54,21 @@ MyImage::MyImage(std::string const & fileName):
     }
     d(depth);
 
-    // terminating newline
+    unsigned int tint = 0;
     char ch;
     ifs.get(ch);
+    if (ifs.good() && ch == ' ')
+    {
+        ifs >> std::hex >> tint >> std::dec;
+        if (!ifs.good() || depth != 1)
+        {
+            throw std::runtime_error("error extracting tint");
+        }
+        ifs.get(ch);
+    }
+
+    // terminating newline
+
     if (!ifs.good() || ch != '\n')
     {
         throw std::runtime_error("expected newline");
@@ -76,6 +90,30 @@ MyImage::MyImage(std::string const & fileName):
     {
         throw std::runtime_error("data left");
     }
+
+    if (tint != 0)
+    {
+        expandTint(tint);
+    }
+}
+
+void MyImage::expandTint(unsigned int tint)
+{
+    int const n = w()*h();
+    unsigned int const rgb[3] = { (tint >> 16) & 0xff, (tint >> 8) & 0xff, tint & 0xff };
+
+    uchar * expanded = new uchar[3*n];
+    for (int i=0; i<n; ++i)
+    {
+        unsigned int const v = array[i];
+        expanded[i*3+0] = v*rgb[0]/255;
+        expanded[i*3+1] = v*rgb[1]/255;
+        expanded[i*3+2] = v*rgb[2]/255;
+    }
+
+    delete[] (uchar*)array;
+    array = expanded;
+    d(3);
 }
 
 void MyImage::registerHandler()
@@ -94,10 +132,10 @@ Fl_Image * MyImage::check(char const * fileName, uchar * header, int headerSize)
     return 0;
 }
 
-void MyImage::write(std::string const & path, uchar const * mapImageData, int w, int h, int d)
+void MyImage::write(std::string const & path, uchar const * mapImageData, int w, int h, int d, unsigned int tint /* = 0 */)
 {
     LOG(DEBUG) << "write " << path;
-    std::ofstream ofs(path);
+    std::ofstream ofs(path, std::ios::binary);
 
     if (!ofs.good())
     {
@@ -110,12 +148,22 @@ void MyImage::write(std::string const & path, uchar const * mapImageData, int w,
     {
         throw std::runtime_error("bad dimensions");
     }
+    if (tint != 0 && d != 1)
+    {
+        throw std::runtime_error("tint only allowed for depth 1");
+    }
 
     ofs << "FLOBBY_IMAGE"
         << " " << w
         << " " << h
-        << " " << d
-        << '\n';
+        << " " << d;
+    if (tint != 0)
+    {
+        char tintStr[8];
+        std::snprintf(tintStr, sizeof(tintStr), "%06x", tint & 0xffffff);
+        ofs << " " << tintStr;
+    }
+    ofs << '\n';
 
     ofs.write(reinterpret_cast<char const *>(mapImageData), w*h*d);
 }
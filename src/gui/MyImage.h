@@ -13,9 +13,12 @@ public:
     MyImage(std::string const & fileName);
 
     static void registerHandler();
-    static void write(std::string const & path, uchar const * mapImageData, int w, int h, int d);
+    // tint (0xRRGGBB) can be set for d 1 images to get them colorized when loaded
+    static void write(std::string const & path, uchar const * mapImageData, int w, int h, int d, unsigned int tint = 0);
 
 private:
+    void expandTint(unsigned int tint);
+
     static Fl_Image * check(char const * fileName, uchar * header, int headerSize);
 
 };
@@ -25,7 +25,7 @@ BattleChatSettings& battleChatSettings()
     return battleChatSettings_;
 }
 
-boost::signals2::connection connectBattleChatSettingsChanged(BattleChatSettingsChangedSignal::slot_type subscriber)
+SignalConnection connectBattleChatSettingsChanged(BattleChatSettingsChangedSignal::slot_type subscriber)
 {
     return battleChatSettingsChangedSignal_.connect(subscriber);
 }
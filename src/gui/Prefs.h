@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include "model/Signal.h"
+
 #include <FL/Fl_Preferences.H>
-#include <boost/signals2/signal.hpp>
 
 
 void initPrefs();
@@ -28,6 +29,6 @@ struct BattleChatSettings
     void save();
 };
 BattleChatSettings& battleChatSettings();
-typedef boost::signals2::signal<void (void)> BattleChatSettingsChangedSignal;
-boost::signals2::connection connectBattleChatSettingsChanged(BattleChatSettingsChangedSignal::slot_type subscriber);
+typedef Signal<void (void)> BattleChatSettingsChangedSignal;
+SignalConnection connectBattleChatSettingsChanged(BattleChatSettingsChangedSignal::slot_type subscriber);
 
@@ -30,6 +30,10 @@ PrivateChatTab::PrivateChatTab(int x, int y, int w, int h, std::string const & u
     int const m = 0; // margin
     int const ih = FL_NORMAL_SIZE*2; // input height
     text_ = new TextDisplay2(x+m, y+m, w-2*m, h-ih-2*m, &logFile_);
+    if (LogFile::enabled())
+    {
+        text_->appendHistory(LogFile::tail(logFile_.path(), LogFile::historyLines));
+    }
 
     input_ = new ChatInput(x, y+h-ih, w, ih);
     input_->connectText( boost::bind(&PrivateChatTab::onInput, this, _1) );
@@ -163,7 +167,7 @@ void PrivateChatTab::append(std::string const & msg, int interest)
 
     if (interest == 0 && beep_)
     {
-        Sound::beep();
+        Sound::beep(SE_PRIVATE);
     }
 }
 
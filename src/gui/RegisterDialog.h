@@ -4,7 +4,6 @@
 
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Preferences.H>
-#include <boost/signals2/signal.hpp>
 #include <string>
 
 class Model;
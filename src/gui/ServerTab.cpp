@@ -58,6 +58,7 @@ ServerTab::ServerTab(int x, int y, int w, int h,
     model_.connectServerMsg( boost::bind(&ServerTab::message, this, _1, _2) );
     model_.connectUserJoined( boost::bind(&ServerTab::userJoined, this, _1) );
     model_.connectUserLeft( boost::bind(&ServerTab::userLeft, this, _1) );
+    model_.connectUsersChanged( boost::bind(&UserList::update, userList_, _1) );
     model_.connectRing( boost::bind(&ServerTab::ring, this, _1) );
     model_.connectDownloadDone( boost::bind(&ServerTab::downloadDone, this, _1, _2, _3) );
 }
@@ -132,7 +133,11 @@ void ServerTab::connected(bool connected)
 {
     if (!connected)
     {
-        userList_->clear();
+        // users are kept while reconnecting, the model signals what changed
+        if (!model_.resyncPending())
+        {
+            userList_->clear();
+        }
         append("Disconnected from server\n", 1); // extra newline for clarity
     }
 }
@@ -155,7 +160,7 @@ void ServerTab::userLeft(User const & user)
 void ServerTab::ring(std::string const & userName)
 {
     append("ring from " + userName, 1);
-    Sound::beep();
+    Sound::beep(SE_RING);
 }
 
 int ServerTab::handle(int event)
@@ -1,32 +1,108 @@
 // This file is part of flobby (GPL v2 or later), see the LICENSE file
 
 #include "Sound.h"
+#include "SoundPlayer.h"
+#include "model/Process.h"
+#include "log/Log.h"
 
 #include <boost/chrono.hpp>
-#include <cstdlib>
+#include <stdexcept>
 
 bool Sound::enable_ = true;
+bool Sound::useCommand_ = false;
 std::string Sound::command_;
 
-static boost::chrono::time_point<boost::chrono::steady_clock> timeLast_ = boost::chrono::steady_clock::now();
+using namespace boost::chrono;
 
-void Sound::beep(char const * command)
+static time_point<steady_clock> timeLast_[SE_COUNT];
+
+static std::shared_ptr<SoundSample const> defaultSample(SoundEvent event)
 {
-    using namespace boost::chrono;
+    // distinct tones per event
+    static double const frequencies[SE_COUNT] = { 880, 660, 990, 1320 };
+    static int const durations[SE_COUNT] = { 120, 150, 150, 400 };
+    return SoundSample::tone(frequencies[event], durations[event], SoundPlayer::rate);
+}
 
-    if (enable_ || command)
+static bool startPlayer(SoundPlayer & player)
+{
+    if (!player.start())
+    {
+        return false;
+    }
+    for (int event = 0; event < SE_COUNT; ++event)
     {
-        // limit to one beep per second
+        player.sample(event, defaultSample(static_cast<SoundEvent>(event)));
+    }
+    return true;
+}
+
+// built-in playback, started on first use, null if built without ALSA
+static SoundPlayer * player()
+{
+    static SoundPlayer player;
+    static bool const started = startPlayer(player);
+    return started ? &player : nullptr;
+}
+
+void Sound::beep(SoundEvent event)
+{
+    if (enable_)
+    {
+        // limit to one beep per second and event
         auto const now = steady_clock::now();
-        auto const diff = now - timeLast_;
+        if (duration_cast<seconds>(now - timeLast_[event]).count() > 0)
+        {
+            play(event);
+            timeLast_[event] = now;
+        }
+    }
+}
+
+void Sound::test(SoundEvent event)
+{
+    play(event);
+}
+
+void Sound::sampleFile(SoundEvent event, std::string const & path)
+{
+    SoundPlayer * p = player();
+    if (!p)
+    {
+        return;
+    }
 
-        std::string const cmd = command ? command : command_.c_str();
-        if (command || duration_cast<seconds>(diff).count() > 0)
+    std::shared_ptr<SoundSample const> sample;
+    if (!path.empty())
+    {
+        try
+        {
+            sample = SoundSample::loadWav(path, SoundPlayer::rate);
+        }
+        catch (std::exception const & e)
         {
-            std::string const cmd2(cmd + " > /dev/null 2>&1 &");
-            int const ret = std::system(cmd2.c_str());
-            static_cast<void>(ret);
-            timeLast_ = now;
+            LOG(WARNING) << "failed to load sound, using default: " << e.what();
         }
     }
+
+    p->sample(event, sample ? sample : defaultSample(event));
+}
+
+void Sound::play(SoundEvent event)
+{
+    SoundPlayer * p = player();
+    if (p && p->available() && !useCommand_)
+    {
+        p->trigger(event);
+        return;
+    }
+
+    try
+    {
+        Process::spawnDetached(Process::splitArgs(command_));
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << "beep failed: " << e.what();
+    }
 }
@@ -4,14 +4,29 @@
 
 #include <string>
 
+enum SoundEvent
+{
+    SE_BEEP, // errors and other attention
+    SE_PRIVATE, // private message
+    SE_HIGHLIGHT, // own name mentioned or beep enabled for channel
+    SE_RING,
+    SE_COUNT
+};
+
 class Sound
 {
 public:
-    static void beep(char const* command = nullptr);
+    static void beep(SoundEvent event = SE_BEEP); // at most one per second and event
+    static void test(SoundEvent event); // plays even if sound is disabled
+
+    // WAV file played for event, empty for built-in tone, decoded at once so playing never touches the disk
+    // starts built-in playback on first call
+    static void sampleFile(SoundEvent event, std::string const & path);
 
     static bool enable_;
+    static bool useCommand_; // run command_ instead of built-in playback, also used if audio output is not available
     static std::string command_;
 
 private:
-
+    static void play(SoundEvent event);
 };
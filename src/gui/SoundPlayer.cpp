@@ -0,0 +1,168 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "SoundPlayer.h"
+
+#include "log/Log.h"
+
+#ifdef FLOBBY_ALSA
+#include <alsa/asoundlib.h>
+#endif
+#include <thread>
+#include <vector>
+#include <cerrno>
+
+SoundPlayer::SoundPlayer():
+    stop_(false),
+    failed_(false),
+    head_(0),
+    tail_(0)
+{
+    ::sem_init(&sem_, 0, 0);
+}
+
+SoundPlayer::~SoundPlayer()
+{
+    if (thread_)
+    {
+        stop_ = true;
+        ::sem_post(&sem_);
+        thread_->join();
+    }
+    ::sem_destroy(&sem_);
+}
+
+bool SoundPlayer::start()
+{
+#ifdef FLOBBY_ALSA
+    thread_.reset(new std::thread(&SoundPlayer::run, this));
+    return true;
+#else
+    LOG(INFO) << "built without ALSA, using sound command";
+    return false;
+#endif
+}
+
+#ifdef FLOBBY_ALSA
+static snd_pcm_t * openPcm(int rate)
+{
+    snd_pcm_t * pcm = nullptr;
+    int err = ::snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        LOG(WARNING) << "snd_pcm_open failed: " << ::snd_strerror(err);
+        return nullptr;
+    }
+
+    // 50 ms latency, notification sounds don't need less
+    err = ::snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 1, 50000);
+    if (err < 0)
+    {
+        LOG(WARNING) << "snd_pcm_set_params failed: " << ::snd_strerror(err);
+        ::snd_pcm_close(pcm);
+        return nullptr;
+    }
+    return pcm;
+}
+#endif
+
+void SoundPlayer::sample(int index, std::shared_ptr<SoundSample const> const & sample)
+{
+    if (index >= 0 && index < maxSamples)
+    {
+        std::atomic_store(&samples_[index], sample);
+    }
+}
+
+void SoundPlayer::trigger(int index)
+{
+    unsigned int const head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= queueSize)
+    {
+        return; // audio thread is behind, a dropped notification sound doesn't matter
+    }
+    queue_[head % queueSize] = index;
+    head_.store(head + 1, std::memory_order_release);
+    ::sem_post(&sem_);
+}
+
+bool SoundPlayer::popTrigger(int & index)
+{
+    unsigned int const tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    index = queue_[tail % queueSize];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+void SoundPlayer::run()
+{
+#ifdef FLOBBY_ALSA
+    snd_pcm_t * pcm = nullptr; // open while sounds are playing
+    SoundMixer mixer;
+    int const periodFrames = rate/100; // 10 ms
+    std::vector<int16_t> buffer(periodFrames);
+
+    while (!stop_)
+    {
+        if (!mixer.active())
+        {
+            // idle, wait for next trigger
+            while (::sem_wait(&sem_) != 0 && errno == EINTR) {}
+        }
+        else
+        {
+            // consume posts without blocking, triggers are read from the queue
+            while (::sem_trywait(&sem_) == 0) {}
+        }
+
+        int index;
+        while (popTrigger(index))
+        {
+            if (index >= 0 && index < maxSamples && !failed_)
+            {
+                mixer.play(std::atomic_load(&samples_[index]));
+            }
+        }
+
+        if (!mixer.active())
+        {
+            continue;
+        }
+
+        if (pcm == nullptr)
+        {
+            pcm = openPcm(rate);
+            if (pcm == nullptr)
+            {
+                failed_ = true; // Sound uses the command from now on
+                mixer = SoundMixer();
+                continue;
+            }
+        }
+
+        mixer.mix(buffer.data(), periodFrames);
+        snd_pcm_sframes_t written = ::snd_pcm_writei(pcm, buffer.data(), periodFrames);
+        if (written < 0)
+        {
+            written = ::snd_pcm_recover(pcm, written, 1);
+            LOG_IF(WARNING, written < 0) << "snd_pcm_writei failed: " << ::snd_strerror(written);
+        }
+
+        if (!mixer.active())
+        {
+            // let the last period play out, the device is not held while idle
+            ::snd_pcm_drain(pcm);
+            ::snd_pcm_close(pcm);
+            pcm = nullptr;
+        }
+    }
+
+    if (pcm != nullptr)
+    {
+        ::snd_pcm_close(pcm);
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "SoundSample.h"
+
+#include <atomic>
+#include <memory>
+#include <semaphore.h>
+
+// forwards
+namespace std { class thread; }
+
+// plays preloaded samples from its own audio thread (ALSA), trigger never blocks the caller
+// the device is opened by the audio thread when a sound starts and closed when all sounds ended
+// trigger must only be called from one thread (the FLTK thread)
+class SoundPlayer
+{
+public:
+    static int const rate = 44100;
+    static int const maxSamples = 8;
+
+    SoundPlayer();
+    ~SoundPlayer();
+
+    // starts the audio thread, returns false if flobby is built without ALSA
+    bool start();
+    bool available() const { return !failed_; } // false after the device could not be opened, triggers are dropped
+
+    void sample(int index, std::shared_ptr<SoundSample const> const & sample);
+    void trigger(int index); // dropped if queue is full
+
+private:
+    std::unique_ptr<std::thread> thread_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> failed_;
+    sem_t sem_; // posted for each trigger and on stop
+
+    std::shared_ptr<SoundSample const> samples_[maxSamples]; // accessed with std::atomic_load/store
+
+    // single producer single consumer ring of sample indices
+    static unsigned int const queueSize = 16;
+    int queue_[queueSize];
+    std::atomic<unsigned int> head_; // written by trigger
+    std::atomic<unsigned int> tail_; // written by audio thread
+
+    void run();
+    bool popTrigger(int & index);
+};
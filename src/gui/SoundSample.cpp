@@ -0,0 +1,198 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "SoundSample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+
+uint32_t le32(char const * p)
+{
+    unsigned char const * u = reinterpret_cast<unsigned char const *>(p);
+    return u[0] | (u[1] << 8) | (u[2] << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+uint16_t le16(char const * p)
+{
+    unsigned char const * u = reinterpret_cast<unsigned char const *>(p);
+    return u[0] | (u[1] << 8);
+}
+
+// one sample scaled to -1..1
+double pcmValue(char const * p, int bits)
+{
+    switch (bits)
+    {
+    case 8:
+        return (static_cast<unsigned char>(p[0]) - 128)/128.0;
+    case 16:
+        return static_cast<int16_t>(le16(p))/32768.0;
+    case 24:
+    {
+        unsigned char const * u = reinterpret_cast<unsigned char const *>(p);
+        uint32_t const v = (u[0] << 8) | (u[1] << 16) | (static_cast<uint32_t>(u[2]) << 24); // sign in top bit
+        return static_cast<int32_t>(v)/2147483648.0;
+    }
+    case 32:
+        return static_cast<int32_t>(le32(p))/2147483648.0;
+    }
+    return 0;
+}
+
+}
+
+std::shared_ptr<SoundSample const> SoundSample::loadWav(std::string const & path, int rate)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.good())
+    {
+        throw std::invalid_argument("file not found:" + path);
+    }
+    std::vector<char> const file((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    if (file.size() < 12 || std::memcmp(file.data(), "RIFF", 4) != 0 || std::memcmp(file.data() + 8, "WAVE", 4) != 0)
+    {
+        throw std::runtime_error("not a WAV file:" + path);
+    }
+
+    int channels = 0;
+    int fileRate = 0;
+    int bits = 0;
+    char const * data = nullptr;
+    std::size_t dataSize = 0;
+
+    std::size_t pos = 12;
+    while (pos + 8 <= file.size())
+    {
+        char const * chunk = file.data() + pos;
+        std::size_t const size = std::min<std::size_t>(le32(chunk + 4), file.size() - pos - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+        {
+            int const format = le16(chunk + 8);
+            if (format != 1 && format != 0xfffe) // PCM or WAVE_FORMAT_EXTENSIBLE
+            {
+                throw std::runtime_error("only PCM WAV supported:" + path);
+            }
+            channels = le16(chunk + 10);
+            fileRate = le32(chunk + 12);
+            bits = le16(chunk + 22);
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0)
+        {
+            data = chunk + 8;
+            dataSize = size;
+        }
+        pos += 8 + size + (size & 1); // chunks are word aligned
+    }
+
+    if (channels <= 0 || fileRate <= 0 || (bits != 8 && bits != 16 && bits != 24 && bits != 32) || data == nullptr)
+    {
+        throw std::runtime_error("unsupported WAV file:" + path);
+    }
+
+    // mix down to mono
+    int const frameSize = channels*bits/8;
+    std::size_t const frames = dataSize/frameSize;
+    std::vector<double> mono(frames);
+    for (std::size_t i = 0; i < frames; ++i)
+    {
+        double sum = 0;
+        for (int c = 0; c < channels; ++c)
+        {
+            char const * p = data + i*frameSize + c*bits/8;
+            sum += pcmValue(p, bits);
+        }
+        mono[i] = sum/channels;
+    }
+
+    // linear resampling is good enough for notification sounds
+    std::shared_ptr<SoundSample> sample = std::make_shared<SoundSample>();
+    sample->rate_ = rate;
+    std::size_t const outFrames = frames*static_cast<uint64_t>(rate)/fileRate;
+    sample->data_.resize(outFrames);
+    double const step = static_cast<double>(fileRate)/rate;
+    for (std::size_t i = 0; i < outFrames; ++i)
+    {
+        double const x = i*step;
+        std::size_t const i0 = static_cast<std::size_t>(x);
+        std::size_t const i1 = std::min(i0 + 1, frames - 1);
+        double const f = x - i0;
+        double const v = mono[i0]*(1 - f) + mono[i1]*f;
+        sample->data_[i] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, v*32768.0)));
+    }
+    return sample;
+}
+
+std::shared_ptr<SoundSample const> SoundSample::tone(double frequency, int milliSeconds, int rate, double volume)
+{
+    std::shared_ptr<SoundSample> sample = std::make_shared<SoundSample>();
+    sample->rate_ = rate;
+    std::size_t const frames = static_cast<std::size_t>(rate)*milliSeconds/1000;
+    std::size_t const fade = std::min<std::size_t>(rate/200, frames/2); // 5 ms, avoids clicks
+    sample->data_.resize(frames);
+
+    for (std::size_t i = 0; i < frames; ++i)
+    {
+        double gain = volume;
+        if (i < fade) gain *= static_cast<double>(i)/fade;
+        if (frames - i < fade) gain *= static_cast<double>(frames - i)/fade;
+        sample->data_[i] = static_cast<int16_t>(32767*gain*std::sin(2*M_PI*frequency*i/rate));
+    }
+    return sample;
+}
+
+SoundMixer::SoundMixer()
+{
+    voices_.reserve(maxVoices);
+}
+
+void SoundMixer::play(std::shared_ptr<SoundSample const> const & sample)
+{
+    if (!sample || sample->data_.empty())
+    {
+        return;
+    }
+
+    if (voices_.size() == maxVoices)
+    {
+        voices_.erase(voices_.begin());
+    }
+    voices_.push_back(Voice{sample, 0});
+}
+
+bool SoundMixer::active() const
+{
+    return !voices_.empty();
+}
+
+void SoundMixer::mix(int16_t * out, int frames)
+{
+    acc_.assign(frames, 0);
+
+    for (Voice & voice : voices_)
+    {
+        std::vector<int16_t> const & data = voice.sample_->data_;
+        std::size_t const n = std::min<std::size_t>(frames, data.size() - voice.pos_);
+        int16_t const * src = data.data() + voice.pos_;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            acc_[i] += src[i];
+        }
+        voice.pos_ += n;
+    }
+
+    voices_.erase(std::remove_if(voices_.begin(), voices_.end(),
+        [](Voice const & voice) { return voice.pos_ >= voice.sample_->data_.size(); }), voices_.end());
+
+    for (int i = 0; i < frames; ++i)
+    {
+        out[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, acc_[i])));
+    }
+}
@@ -0,0 +1,45 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// mono 16 bit sound decoded once, played by SoundPlayer
+struct SoundSample
+{
+    int rate_;
+    std::vector<int16_t> data_;
+
+    // PCM WAV file (8, 16, 24 or 32 bit, any number of channels), channels are mixed down and resampled to rate
+    static std::shared_ptr<SoundSample const> loadWav(std::string const & path, int rate); // throws on error
+
+    // sine tone with short fade in and out
+    static std::shared_ptr<SoundSample const> tone(double frequency, int milliSeconds, int rate, double volume = 0.3);
+};
+
+// mixes playing samples into an output buffer, only used by the audio thread
+class SoundMixer
+{
+public:
+    static int const maxVoices = 8;
+
+    SoundMixer();
+
+    void play(std::shared_ptr<SoundSample const> const & sample); // oldest voice is replaced if all are busy
+    bool active() const;
+
+    // writes frames samples, silence after all voices ended
+    void mix(int16_t * out, int frames);
+
+private:
+    struct Voice
+    {
+        std::shared_ptr<SoundSample const> sample_;
+        std::size_t pos_;
+    };
+    std::vector<Voice> voices_;
+    std::vector<int32_t> acc_;
+};
@@ -9,31 +9,65 @@
 #include <FL/Fl_Check_Button.H>
 #include <FL/Fl_Input.H>
 #include <FL/Fl_Return_Button.H>
+#include <cstring>
+#include <string>
 
 // Prefs
 static char const * const PrefSound = "Sound";
 static char const * const PrefSoundCommand = "SoundCommand";
+static char const * const PrefSoundUseCommand = "SoundUseCommand";
+static char const * const PrefSoundFiles[] = { "SoundFilePrivate", "SoundFileHighlight", "SoundFileRing" };
+static SoundEvent const fileEvents[] = { SE_PRIVATE, SE_HIGHLIGHT, SE_RING };
+
+static char const * const defaultCommand = "xkbbell -v 100";
+
+static int storedUseCommandDefault()
+{
+    char * text = 0;
+    if (prefs().entryExists(PrefSoundCommand))
+    {
+        prefs().get(PrefSoundCommand, text, "");
+    }
+    int const val = SoundSettingsDialog::useCommandDefault(text);
+    ::free(text);
+    return val;
+}
+
+int SoundSettingsDialog::useCommandDefault(char const * storedCommand)
+{
+    // sounds used to be played only with the command and older versions stored the default command at every start,
+    // keep using the command only if the user changed it
+    return storedCommand != 0 && std::strcmp(storedCommand, defaultCommand) != 0 ? 1 : 0;
+}
 
 SoundSettingsDialog::SoundSettingsDialog():
     Fl_Window(400, 400, "Sound settings")
 {
     set_modal();
 
-    enable_ = new Fl_Check_Button(10, 30, 380, 30, "Enable sound");
+    enable_ = new Fl_Check_Button(10, 10, 380, 30, "Enable sound");
+
+    char const * labels[] = { "Private message sound (WAV file, empty for default)",
+                              "Highlight sound (WAV file, empty for default)",
+                              "Ring sound (WAV file, empty for default)" };
+    for (int i = 0; i < 3; ++i)
+    {
+        files_[i] = new Fl_Input(10, 70 + i*60, 380, 30, labels[i]);
+        files_[i]->align(FL_ALIGN_TOP_LEFT);
+    }
+
+    useCommand_ = new Fl_Check_Button(10, 240, 380, 30, "Use sound command instead");
 
-    command_ = new Fl_Input(10, 80, 380, 30, "Sound command");
+    command_ = new Fl_Input(10, 295, 380, 30, "Sound command");
     command_->align(FL_ALIGN_TOP_LEFT);
 
-    Fl_Button * test = new Fl_Button(350, 110, 40, 30, "Test");
+    Fl_Button * test = new Fl_Button(10, 360, 90, 30, "Test");
     test->callback(SoundSettingsDialog::callbackTest, this);
 
     Fl_Return_Button * btn = new Fl_Return_Button(300, 360, 90, 30, "Apply");
     btn->callback(SoundSettingsDialog::callbackApply, this);
 
     end();
-
-    loadPrefs();
-    savePrefs();
 }
 
 SoundSettingsDialog::~SoundSettingsDialog()
@@ -53,26 +87,69 @@ void SoundSettingsDialog::loadPrefs()
     prefs().get(PrefSound, val, 1);
     enable_->value(val);
 
+    prefs().get(PrefSoundUseCommand, val, storedUseCommandDefault());
+    useCommand_->value(val);
+
     char * text;
-    prefs().get(PrefSoundCommand, text, "xkbbell -v 100");
+    prefs().get(PrefSoundCommand, text, defaultCommand);
     command_->value(text);
     ::free(text);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        prefs().get(PrefSoundFiles[i], text, "");
+        files_[i]->value(text);
+        ::free(text);
+    }
 }
 
 void SoundSettingsDialog::savePrefs()
 {
     prefs().set(PrefSound, enable_->value());
-
+    prefs().set(PrefSoundUseCommand, useCommand_->value());
     prefs().set(PrefSoundCommand, command_->value());
+    for (int i = 0; i < 3; ++i)
+    {
+        prefs().set(PrefSoundFiles[i], files_[i]->value());
+    }
+
+    setupSound();
+}
+
+void SoundSettingsDialog::setupSound()
+{
+    int val;
+
+    prefs().get(PrefSound, val, 1);
+    Sound::enable_ = val == 1 ? true : false;
+
+    prefs().get(PrefSoundUseCommand, val, storedUseCommandDefault());
+    Sound::useCommand_ = val == 1 ? true : false;
+
+    char * text;
+    prefs().get(PrefSoundCommand, text, defaultCommand);
+    Sound::command_ = text;
+    ::free(text);
 
-    Sound::enable_ = enable_->value() == 1 ? true : false;
-    Sound::command_ = command_->value();
+    // samples are only decoded when file changed, the player is started with default sounds when first needed
+    static std::string loaded[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        prefs().get(PrefSoundFiles[i], text, "");
+        if (loaded[i] != text)
+        {
+            loaded[i] = text;
+            Sound::sampleFile(fileEvents[i], loaded[i]);
+        }
+        ::free(text);
+    }
 }
 
 void SoundSettingsDialog::callbackTest(Fl_Widget*, void *data)
 {
     SoundSettingsDialog * o = static_cast<SoundSettingsDialog*>(data);
-    Sound::beep(o->command_->value());
+    o->apply();
+    Sound::test(SE_HIGHLIGHT);
 }
 
 void SoundSettingsDialog::callbackApply(Fl_Widget*, void *data)
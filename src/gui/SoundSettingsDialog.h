@@ -13,11 +13,16 @@ public:
     SoundSettingsDialog();
     virtual ~SoundSettingsDialog();
 
+    static void setupSound(); // sets Sound from prefs
+    static int useCommandDefault(char const * storedCommand); // SoundUseCommand default, storedCommand is 0 if not set
+
     void show();
 
 private:
     Fl_Check_Button * enable_;
+    Fl_Check_Button * useCommand_;
     Fl_Input * command_;
+    Fl_Input * files_[3]; // private, highlight, ring
 
     static void callbackTest(Fl_Widget*, void*);
     static void callbackApply(Fl_Widget*, void*);
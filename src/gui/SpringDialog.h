@@ -2,9 +2,10 @@
 
 #pragma once
 
+#include "model/Signal.h"
+
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Preferences.H>
-#include <boost/signals2/signal.hpp>
 #include <boost/filesystem.hpp>
 #include <string>
 
@@ -32,8 +33,8 @@ public:
     std::string getSpringCmd(std::string const& engineVersion);
 
     // signals
-    typedef boost::signals2::signal<void (std::string const & text)> ProfileSetSignal;
-    boost::signals2::connection connectProfileSet(ProfileSetSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & text)> ProfileSetSignal;
+    SignalConnection connectProfileSet(ProfileSetSignal::slot_type subscriber)
     { return profileSetSignal_.connect(subscriber); }
 
 private:
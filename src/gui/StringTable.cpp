@@ -2,6 +2,8 @@
 
 #include "StringTable.h"
 #include "log/Log.h"
+#include "log/Metrics.h"
+#include "log/Trace.h"
 #include "Prefs.h"
 
 #include <FL/fl_draw.H>
@@ -11,6 +13,7 @@
 #include <algorithm>            // STL sort
 #include <cassert>
 #include <stdexcept>
+#include <unordered_set>
 
 // Prefs
 static char const * PrefColWidth = "ColWidth";
@@ -25,7 +28,12 @@ StringTable::StringTable(int x, int y, int w, int h, std::string const & name,
     selectedRow_(-1),
     headers_(headers),
     prefs_(prefs(), label()),
-    savePrefs_(savePrefs)
+    savePrefs_(savePrefs),
+    sorts_(Metrics::counter("table." + name + ".sorts")),
+    sortTime_(Metrics::histogram("table." + name + ".sort_time")),
+    draws_(Metrics::counter("table." + name + ".draws")),
+    traceSort_(Trace::intern(name + " sort")),
+    traceDraw_(Trace::intern(name + " draw"))
 {
     labeltype(FL_NO_LABEL);
     box(FL_THIN_DOWN_FRAME);
@@ -93,7 +101,12 @@ void StringTable::sort_column(int col, int reverse)
         assert(selectedRow_ >= 0 && selectedRow_ < rows());
         id = rows_[selectedRow_].id_;
     }
-    std::stable_sort(rows_.begin(), rows_.end(), SortColumn(col, reverse));
+    sorts_.add();
+    {
+        MetricsTimer timer(sortTime_);
+        TraceSpan span(traceSort_);
+        std::stable_sort(rows_.begin(), rows_.end(), SortColumn(col, reverse));
+    }
 
     if (!id.empty())
     {
@@ -102,6 +115,13 @@ void StringTable::sort_column(int col, int reverse)
     redraw();
 }
 
+void StringTable::draw()
+{
+    draws_.add();
+    TraceSpan span(traceDraw_);
+    Fl_Table_Row::draw();
+}
+
 // Draw sort arrow
 void StringTable::draw_sort_arrow(int X,int Y,int W,int H,int sort) {
     int xlft = X+(W-6)-8;
@@ -206,7 +226,7 @@ StringTableRow const & StringTable::getRow(std::size_t rowIndex)
     throw std::runtime_error("rowIndex out of bounds");
 }
 
-void StringTable::addRow(const StringTableRow & row)
+void StringTable::addRow(const StringTableRow & row, bool sortNow)
 {
     assert(row.data_.size() == headers_.size());
 
@@ -223,7 +243,39 @@ void StringTable::addRow(const StringTableRow & row)
     rows( static_cast<int>(rows_.size()) );
     row_height(rows()-1, col_header_height()+2);
 
-    // instant sort
+    if (sortNow)
+    {
+        sort();
+    }
+}
+
+void StringTable::addRows(std::vector<StringTableRow> rows)
+{
+    std::unordered_set<std::string> ids;
+    ids.reserve(rows_.size() + rows.size());
+    for (StringTableRow const & r : rows_)
+    {
+        ids.insert(r.id_);
+    }
+
+    rows_.reserve(rows_.size() + rows.size());
+    for (StringTableRow & row : rows)
+    {
+        assert(row.data_.size() == headers_.size());
+        if (ids.insert(row.id_).second)
+        {
+            rows_.push_back(std::move(row));
+        }
+        else
+        {
+            LOG(DEBUG) << "skipping existing row: " << row.id_;
+        }
+    }
+
+    // setting the height row by row recalculates the table size each time
+    rows( static_cast<int>(rows_.size()) );
+    row_height_all(col_header_height()+2);
+
     sort();
 }
 
@@ -251,6 +303,46 @@ void StringTable::updateRow(const StringTableRow & row)
     throw std::runtime_error("row not found:" + row.id_);
 }
 
+bool StringTable::updateCells(std::size_t rowIndex, std::vector<std::string> const & data, unsigned int columnMask, bool sortNow)
+{
+    assert(data.size() == headers_.size());
+
+    if (rowIndex >= rows_.size())
+    {
+        throw std::runtime_error("rowIndex out of bounds");
+    }
+
+    StringTableRow & row = rows_[rowIndex];
+    bool sortNeeded = false;
+    for (std::size_t c = 0; c < headers_.size(); ++c)
+    {
+        if ((columnMask & (1u << c)) && row.data_[c] != data[c])
+        {
+            row.data_[c] = data[c];
+            redraw_range(rowIndex, rowIndex, c, c);
+            sortNeeded |= (static_cast<int>(c) == sort_lastcol_);
+        }
+    }
+
+    if (sortNeeded && sortNow)
+    {
+        sort();
+    }
+    return sortNeeded;
+}
+
+int StringTable::rowIndex(std::string const & id) const
+{
+    for (std::size_t i = 0; i < rows_.size(); ++i)
+    {
+        if (rows_[i].id_ == id)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
 void StringTable::removeRow(std::string const & id)
 {
     int row = 0;
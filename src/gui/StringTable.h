@@ -2,14 +2,18 @@
 
 #pragma once
 
+#include "model/Signal.h"
+
 #include <FL/Fl_Table_Row.H>
 #include <FL/Fl_Preferences.H>
 
-#include <boost/signals2/signal.hpp>
 #include <string>
 #include <vector>
 #include <array>
 
+class MetricsCounter;
+class MetricsHistogram;
+
 struct StringTableColumnDef
 {
     std::string name_;
@@ -50,18 +54,24 @@ public:
 
     // signals
     //
-    typedef boost::signals2::signal<void (int rowIndex)> SelectedRowChangedSignal;
-    boost::signals2::connection connectSelectedRowChanged(SelectedRowChangedSignal::slot_type subscriber) { return selectedRowSignal_.connect(subscriber); }
+    typedef Signal<void (int rowIndex)> SelectedRowChangedSignal;
+    SignalConnection connectSelectedRowChanged(SelectedRowChangedSignal::slot_type subscriber) { return selectedRowSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (int rowIndex, int button)> RowClickedSignal; // button is FL_LEFT/MIDDLE/RIGHT_MOUSE (1,2,3)
-    boost::signals2::connection connectRowClicked(RowClickedSignal::slot_type subscriber) { return rowClickedSignal_.connect(subscriber); }
+    typedef Signal<void (int rowIndex, int button)> RowClickedSignal; // button is FL_LEFT/MIDDLE/RIGHT_MOUSE (1,2,3)
+    SignalConnection connectRowClicked(RowClickedSignal::slot_type subscriber) { return rowClickedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (int rowIndex, int button)> RowDoubleClickedSignal;
-    boost::signals2::connection connectRowDoubleClicked(RowDoubleClickedSignal::slot_type subscriber) { return rowDoubleClickedSignal_.connect(subscriber); }
+    typedef Signal<void (int rowIndex, int button)> RowDoubleClickedSignal;
+    SignalConnection connectRowDoubleClicked(RowDoubleClickedSignal::slot_type subscriber) { return rowDoubleClickedSignal_.connect(subscriber); }
 
     StringTableRow const & getRow(std::size_t rowIndex);
-    void addRow(StringTableRow const & row);
+    void addRow(StringTableRow const & row, bool sortNow = true); // caller must call sort() if sortNow is false
+    // adds many rows with one duplicate check and one sort, rows with existing or repeated ids are skipped
+    void addRows(std::vector<StringTableRow> rows);
     void updateRow(StringTableRow const & row);
+    // only copies and redraws columns in mask (bit 0 is column 0), returns true if sort column changed
+    // sorts if sort column changed and sortNow is true, so several rows can be updated with one sort
+    bool updateCells(std::size_t rowIndex, std::vector<std::string> const & data, unsigned int columnMask, bool sortNow = true);
+    int rowIndex(std::string const & id) const; // returns -1 if row not found
     void removeRow(std::string const & id);
     bool rowExist(std::string const & id);
     void sort();
@@ -83,6 +93,7 @@ private:
     void sort_column(int col, int reverse=0);                   // sort table by a column
     void draw_sort_arrow(int X,int Y,int W,int H,int sort);
     void savePrefs();
+    void draw();
 
 
     struct SortColumn
@@ -98,6 +109,13 @@ private:
     Fl_Preferences prefs_;
     bool savePrefs_;
 
+    // "table.<name>.*", see Metrics
+    MetricsCounter & sorts_;
+    MetricsHistogram & sortTime_;
+    MetricsCounter & draws_;
+    char const * traceSort_;
+    char const * traceDraw_;
+
     static void event_callback(Fl_Widget*, void*);
     void event_callback2();
 
@@ -11,6 +11,7 @@
 
 #include "model/Model.h"
 #include "log/Log.h"
+#include "log/Trace.h"
 
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Tile.H>
@@ -358,6 +359,7 @@ int Tabs::handleServerTabClick()
 
 void Tabs::draw()
 {
+    TraceSpan span("Tabs::draw");
     // workaround for bugged drawing in Fl_Tabs, needed when closing tabs
     fl_color(FL_BACKGROUND_COLOR);
     fl_rectf(x(), y(), w(), logUsersTab_->y() - y());
@@ -442,7 +444,7 @@ void Tabs::connected(bool connected)
         {
             ChannelChatTab * cc = pair.second;
             cc->append("Disconnected from server", -1);
-            cc->leave();
+            cc->disconnected();
         }
         redraw();
     }
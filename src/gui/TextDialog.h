@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include "model/Signal.h"
+
 #include <FL/Fl_Window.H>
-#include <boost/signals2/signal.hpp>
 #include <string>
 
 class Fl_Multiline_Input;
@@ -18,8 +19,8 @@ public:
 
     // signals
     //
-    typedef boost::signals2::signal<void (std::string const & text)> TextSaveSignal;
-    boost::signals2::connection connectTextSave(TextSaveSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & text)> TextSaveSignal;
+    SignalConnection connectTextSave(TextSaveSignal::slot_type subscriber)
     { return textSaveSignal_.connect(subscriber); }
 
 private:
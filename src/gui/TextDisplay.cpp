@@ -3,6 +3,7 @@
 #include "TextDisplay.h"
 
 #include "log/Log.h"
+#include "log/Trace.h"
 
 #include <sstream>
 #include <ctime>
@@ -99,6 +100,7 @@ int TextDisplay::handle(int event)
 
 void TextDisplay::draw()
 {
+    TraceSpan span("TextDisplay::draw");
     if (scrollToBottom_)
     {
         bottomline(size());
@@ -4,6 +4,7 @@
 #include "PopupMenu.h"
 #include "LogFile.h"
 #include "log/Log.h"
+#include "log/Trace.h"
 #include "TextFunctions.h"
 
 #include <FL/Fl.H>
@@ -100,6 +101,7 @@ void TextDisplay2::append(std::string const & text, int interest)
 
     // limit text buffer size, raise limit if we are scrolled up
     int const maxLength = 20000*(scrollToBottom ? 1 : 10);
+    TraceSpan span(text_->length() > maxLength ? "TextDisplay2::trim" : 0);
     while (text_->length() > maxLength)
     {
         int const posNewline = text_->line_end(0);
@@ -113,6 +115,37 @@ void TextDisplay2::append(std::string const & text, int interest)
     }
 }
 
+void TextDisplay2::appendHistory(std::vector<std::string> const & lines)
+{
+    if (lines.empty())
+    {
+        return;
+    }
+
+    // one buffer append for all lines, shown with low interest style
+    std::string text;
+    for (std::string const & line : lines)
+    {
+        text += line;
+        text += '\n';
+    }
+    std::string style(text.size(), 'B');
+    for (std::size_t pos = text.find('\n'); pos != std::string::npos; pos = text.find('\n', pos + 1))
+    {
+        style[pos] = '\n';
+    }
+
+    text_->append(text.c_str());
+    style_->append(style.c_str());
+    scroll(text_->length(), 0);
+}
+
+void TextDisplay2::draw()
+{
+    TraceSpan span("TextDisplay2::draw");
+    Fl_Text_Display::draw();
+}
+
 int TextDisplay2::handle(int event)
 {
     // make mouse wheel scroll in bigger steps if shift is down
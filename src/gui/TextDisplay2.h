@@ -4,6 +4,7 @@
 
 #include <FL/Fl_Text_Display.H>
 #include <string>
+#include <vector>
 
 class LogFile;
 class Fl_Text_Buffer;
@@ -15,6 +16,7 @@ public:
     virtual ~TextDisplay2();
 
     void append(std::string const & text, int interest = 0);
+    void appendHistory(std::vector<std::string> const & lines); // lines from log file, no time stamp added
 
     enum {
         STYLE_TIME = 0,
@@ -34,5 +36,6 @@ private:
     LogFile* logFile_;
 
     int handle(int event);
+    void draw();
 
 };
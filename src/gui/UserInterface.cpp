@@ -10,6 +10,9 @@
 #include "ProgressDialog.h"
 #include "ChannelsWindow.h"
 #include "MapsWindow.h"
+#include "LogSearchWindow.h"
+#include "DiagnosticsWindow.h"
+#include "LogIndex.h"
 #include "BattleList.h"
 #include "BattleInfo.h"
 #include "BattleRoom.h"
@@ -23,8 +26,12 @@
 #include "FontSettingsDialog.h"
 #include "DownloadSettingsDialog.h"
 #include "OpenBattleZkDialog.h"
+#include "MyImage.h"
 
 #include "log/Log.h"
+#include "log/StartupPhase.h"
+#include "log/Trace.h"
+#include "log/Watchdog.h"
 #include "model/Model.h"
 
 // TODO #include <pr-downloader.h>
@@ -33,7 +40,6 @@
 #include <X11/extensions/scrnsaver.h>
 #include <FL/x.H>
 #include "icon.xpm.h"
-#include <Magick++.h>
 
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Menu_Bar.H>
@@ -48,6 +54,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <cassert>
 
 // Prefs
@@ -58,6 +65,11 @@ static char const * PrefAppWindowH = "AppWindowH";
 static char const * PrefAppWindowSplitH = "AppWindowSplitH";
 static char const * PrefLeftSplitV = "LeftSplitV";
 static char const * PrefAutoJoinChannels = "AutoJoinChannels";
+static char const * PrefWatchdog = "Watchdog";
+static char const * PrefWatchdogThreshold = "WatchdogThreshold"; // ms
+
+static double const watchdogTickInterval = 0.05;
+static double const logIndexInterval = 60; // indexes chat logs written by other flobby instances or not added
 
 
 static XScreenSaverInfo* xScreenSaverInfo = 0;
@@ -67,8 +79,27 @@ UserInterface::UserInterface(Model & model) :
     model_(model),
     cache_(new Cache(model_)),
     genJobsCount_(0),
-    openMapsWindow_(false)
+    openMapsWindow_(false),
+    logIndexJob_(false),
+    channelsWindow_([this] { return new ChannelsWindow(model_); }),
+    mapsWindow_([this] { return new MapsWindow(model_, *cache_); }),
+    logSearchWindow_([this] { return new LogSearchWindow(model_, *tabs_); }),
+    diagnosticsWindow_([] { return new DiagnosticsWindow(); }),
+    registerDialog_([this] { return new RegisterDialog(model_); }),
+    loggingDialog_([] { return new LoggingDialog(); }),
+    autoJoinChannelsDialog_([this]() -> TextDialog *
+        {
+            TextDialog * dlg = new TextDialog("Channels to auto-join", "One channel per line");
+            dlg->connectTextSave(boost::bind(&UserInterface::autoJoinChannels, this, _1));
+            return dlg;
+        }),
+    soundSettingsDialog_([] { return new SoundSettingsDialog(); }),
+    fontSettingsDialog_([] { return new FontSettingsDialog(); }),
+    downloadSettingsDialog_([this] { return new DownloadSettingsDialog(model_); }),
+    openBattleZkDialog_([this] { return new OpenBattleZkDialog(model_); })
 {
+    StartupPhase phase("user interface");
+
     TextDisplay2::initTextStyles();
 
     Fl_File_Icon::load_system_icons();
@@ -114,7 +145,14 @@ UserInterface::UserInterface(Model & model) :
         { "&Other",              0, 0, 0, FL_SUBMENU },
             { "&Reload available games && maps", FL_COMMAND + 'r', (Fl_Callback *)&menuRefresh, this },
             { "&Generate missing cache files", 0, (Fl_Callback *)&menuGenerateCacheFiles, this },
+            { "&Verify downloaded games", 0, (Fl_Callback *)&menuCheckPool, this },
+            { "Re&pair downloaded games...", 0, (Fl_Callback *)&menuRepairPool, this },
             { "&Maps...", FL_COMMAND +'m', (Fl_Callback *)&menuMaps, this },
+            { "&Search chat logs...", FL_COMMAND +'f', (Fl_Callback *)&menuLogSearch, this },
+            { "&Diagnostics...", 0, (Fl_Callback *)&menuDiagnostics, this },
+            { "Record &trace", 0, (Fl_Callback *)&menuTraceRecord, this, FL_MENU_TOGGLE },
+            { "Save tra&ce...", 0, (Fl_Callback *)&menuTraceSave, this },
+            { "Stall &watchdog", 0, (Fl_Callback *)&menuWatchdog, this, FL_MENU_TOGGLE },
             { 0 },
 
         { 0 }
@@ -152,31 +190,33 @@ UserInterface::UserInterface(Model & model) :
     mainWindow_->end();
 
     progressDialog_ = new ProgressDialog();
-    channelsWindow_ = new ChannelsWindow(model_);
-    mapsWindow_ = new MapsWindow(model_, *cache_);
 
     loginDialog_ = new LoginDialog(model_);
-    registerDialog_ = new RegisterDialog(model_);
     agreementDialog_ = new AgreementDialog(model_, *loginDialog_);
-    loggingDialog_ = new LoggingDialog();
-    autoJoinChannelsDialog_ = new TextDialog("Channels to auto-join", "One channel per line");
-    autoJoinChannelsDialog_->connectTextSave(boost::bind(&UserInterface::autoJoinChannels, this, _1));
-    soundSettingsDialog_ = new SoundSettingsDialog();
     chatSettingsDialog_ = new ChatSettingsDialog();
-    fontSettingsDialog_ = new FontSettingsDialog();
-    downloadSettingsDialog_ = new DownloadSettingsDialog(model_);
     tabs_->setChatSettingsDialog(chatSettingsDialog_); // ugly dependency injection
-    openBattleZkDialog_ = new OpenBattleZkDialog(model_);
+
+    // settings applied at startup, their dialogs are created on first use
+    SoundSettingsDialog::setupSound();
+    DownloadSettingsDialog::setupDownloader(model_);
 
 
     // model signal handlers
     model.connectConnected( boost::bind(&UserInterface::connected, this, _1) );
     model.connectLoginResult( boost::bind(&UserInterface::loginResult, this, _1, _2) );
+    model.connectReconnected( boost::bind(&UserInterface::reconnected, this) );
     model.connectJoinBattleFailed( boost::bind(&UserInterface::joinBattleFailed, this, _1) );
     model.connectDownloadDone( boost::bind(&UserInterface::downloadDone, this, _1, _2, _3) );
     model.connectStartDemo(boost::bind(&UserInterface::startDemo, this, _1, _2) );
 
-    Magick::InitializeMagick(0);
+    MyImage::registerHandler(); // map cache images
+
+    int watchdog;
+    prefs().get(PrefWatchdog, watchdog, 0);
+    if (watchdog != 0)
+    {
+        startWatchdog();
+    }
 
     gUserInterface = this;
 }
@@ -191,13 +231,29 @@ UserInterface::~UserInterface()
     prefs().set(PrefAppWindowSplitH, battleRoom_->x());
     prefs().set(PrefLeftSplitV, battleList_->y());
 
-    delete channelsWindow_;
-    delete mapsWindow_;
+    stopWatchdog();
+    Fl::remove_timeout(logIndexTimer, this);
+    channelsWindow_.reset();
+    mapsWindow_.reset();
+    logSearchWindow_.reset();
+    diagnosticsWindow_.reset();
     delete loginDialog_;
     delete mainWindow_;
 
     model_.disconnect();
 
+    if (LogFile::index())
+    {
+        try
+        {
+            LogFile::index()->flush();
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << "failed to save chat log index: " << e.what();
+        }
+    }
+
     prefs().flush();
 }
 
@@ -244,20 +300,33 @@ int UserInterface::run(int argc, char** argv)
         tileLeft_->position(0, battleList_->y(), 0, y);
     }
 
-    tabs_->initTiles();
-    battleRoom_->initTiles();
+    {
+        StartupPhase phase("main window");
+        tabs_->initTiles();
+        battleRoom_->initTiles();
 
-    mainWindow_->show(argc, argv);
-    startTitle_ = mainWindow_->label();
-    springDialog_->removeNonExistingProfiles();
-    springDialog_->addFoundProfiles();
-    // select current spring profile (spring and unitsync)
-    bool const pathsOk = springDialog_->setPaths();
+        mainWindow_->show(argc, argv);
+        startTitle_ = mainWindow_->label();
+    }
+
+    bool pathsOk;
+    {
+        StartupPhase phase("spring profiles");
+        springDialog_->removeNonExistingProfiles();
+        springDialog_->addFoundProfiles();
+        // select current spring profile (spring and unitsync)
+        pathsOk = springDialog_->setPaths();
+    }
 
     if (loginDialog_->autoLogin())
     {
         loginDialog_->attemptLogin();
     }
+    StartupPhase::done("ready for login");
+
+    // catches up with logs written before the index existed
+    startLogIndexJob();
+    Fl::add_timeout(logIndexInterval, logIndexTimer, this);
 
     Fl::lock();
     return Fl::run();
@@ -272,6 +341,17 @@ void UserInterface::addCallbackEvent(Fl_Awake_Handler handler, void *data)
     Fl::unlock();
 }
 
+void UserInterface::addTimeout(double seconds, Fl_Timeout_Handler handler, void *data)
+{
+    assert(handler != 0);
+    Fl::add_timeout(seconds, handler, data);
+}
+
+void UserInterface::removeTimeout(Fl_Timeout_Handler handler, void *data)
+{
+    Fl::remove_timeout(handler, data);
+}
+
 void UserInterface::menuLogin(Fl_Widget *w, void* d)
 {
     UserInterface * ui = static_cast<UserInterface*>(d);
@@ -434,18 +514,23 @@ void UserInterface::onTest(Fl_Widget *w, void* d)
 
 void UserInterface::connected(bool connected)
 {
-    enableMenuItem(UserInterface::menuDisconnect, connected);
-    enableMenuItem(UserInterface::menuRegister, !connected);
+    // disconnect also stops reconnecting
+    bool const reconnecting = model_.reconnecting();
+    enableMenuItem(UserInterface::menuDisconnect, connected || reconnecting);
+    enableMenuItem(UserInterface::menuRegister, !connected && !reconnecting);
     if (model_.isZeroK()) {
         enableMenuItem(UserInterface::menuOpenBattleZk, connected);
     }
 
     if (!connected)
     {
-        enableMenuItem(UserInterface::menuLogin, true);
+        enableMenuItem(UserInterface::menuLogin, !reconnecting);
         enableMenuItem(UserInterface::menuJoinChannel, false);
         enableMenuItem(UserInterface::menuChannels, false);
-        channelsWindow_->hide();
+        if (channelsWindow_.created())
+        {
+            channelsWindow_->hide();
+        }
         Fl::remove_timeout(checkAway);
     }
 }
@@ -467,6 +552,16 @@ void UserInterface::loginResult(bool success, std::string const & info)
     }
 }
 
+void UserInterface::reconnected()
+{
+    // channels are rejoined by model, no auto-join here
+    enableMenuItem(UserInterface::menuLogin, false);
+    enableMenuItem(UserInterface::menuJoinChannel, true);
+    enableMenuItem(UserInterface::menuChannels, true);
+
+    checkAway(this);
+}
+
 void UserInterface::joinBattleFailed(std::string const & reason)
 {
     fl_alert("Join battle failed.\n%s", reason.c_str());
@@ -509,6 +604,118 @@ void UserInterface::menuGenerateCacheFiles(Fl_Widget *w, void* d)
     Fl::add_timeout(0, doGenJob, ui);
 }
 
+void UserInterface::menuCheckPool(Fl_Widget *w, void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    ui->model_.checkPool(false);
+}
+
+void UserInterface::menuRepairPool(Fl_Widget *w, void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    if (fl_choice("Remove corrupt game files?\nBroken games must be downloaded again afterwards.", "Cancel", "Remove", 0) == 1)
+    {
+        ui->model_.checkPool(true);
+    }
+}
+
+void UserInterface::menuLogSearch(Fl_Widget *w, void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    ui->startLogIndexJob();
+    ui->logSearchWindow_->show();
+}
+
+void UserInterface::menuDiagnostics(Fl_Widget *w, void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    ui->diagnosticsWindow_->show();
+}
+
+void UserInterface::menuTraceRecord(Fl_Widget *w, void* d)
+{
+    Fl_Menu_Item const * item = static_cast<Fl_Menu_Bar*>(w)->mvalue();
+    Trace::enable(item->value() != 0);
+}
+
+void UserInterface::menuTraceSave(Fl_Widget *w, void* d)
+{
+    Fl_Native_File_Chooser fc;
+    fc.title("Save trace");
+    fc.type(Fl_Native_File_Chooser::BROWSE_SAVEFILE);
+    fc.options(Fl_Native_File_Chooser::SAVEAS_CONFIRM | Fl_Native_File_Chooser::NEW_FOLDER);
+    fc.preset_file("flobby_trace.json");
+
+    if (fc.show() == 0)
+    {
+        try
+        {
+            Trace::writeJson(fc.filename());
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << e.what();
+            fl_alert("%s", e.what());
+        }
+    }
+}
+
+void UserInterface::menuWatchdog(Fl_Widget *w, void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    Fl_Menu_Item const * item = static_cast<Fl_Menu_Bar*>(w)->mvalue();
+    prefs().set(PrefWatchdog, item->value() != 0 ? 1 : 0);
+    if (item->value() != 0)
+    {
+        ui->startWatchdog();
+    }
+    else
+    {
+        ui->stopWatchdog();
+    }
+}
+
+void UserInterface::startWatchdog()
+{
+    if (watchdog_)
+    {
+        return;
+    }
+
+    int threshold;
+    prefs().get(PrefWatchdogThreshold, threshold, 150);
+    watchdog_.reset(new Watchdog(cacheDir(), std::max(threshold, 10)));
+    Fl::add_timeout(watchdogTickInterval, watchdogTick, this);
+
+    setMenuItemChecked((Fl_Callback *)&menuWatchdog, true);
+    setMenuItemChecked((Fl_Callback *)&menuTraceRecord, Trace::enabled());
+}
+
+void UserInterface::stopWatchdog()
+{
+    if (!watchdog_)
+    {
+        return;
+    }
+
+    Fl::remove_timeout(watchdogTick, this);
+    watchdog_.reset();
+
+    setMenuItemChecked((Fl_Callback *)&menuWatchdog, false);
+    setMenuItemChecked((Fl_Callback *)&menuTraceRecord, Trace::enabled());
+}
+
+void UserInterface::watchdogTick(void* d)
+{
+    Watchdog::beat();
+    Fl::repeat_timeout(watchdogTickInterval, watchdogTick, d);
+}
+
 void UserInterface::menuMaps(Fl_Widget *w, void* d)
 {
     UserInterface * ui = static_cast<UserInterface*>(d);
@@ -608,6 +815,24 @@ void UserInterface::menuLogging(Fl_Widget *w, void* d)
 
 }
 
+void UserInterface::setMenuItemChecked(void(*cb)(Fl_Widget*, void*), bool checked)
+{
+    Fl_Menu_Item * mi = const_cast<Fl_Menu_Item *>(menuBar_->find_item(cb));
+    if (mi == 0)
+    {
+        throw std::runtime_error("menu callback not found");
+    }
+
+    if (checked)
+    {
+        mi->set();
+    }
+    else
+    {
+        mi->clear();
+    }
+}
+
 void UserInterface::enableMenuItem(void(*cb)(Fl_Widget*, void*), bool enable)
 {
     Fl_Menu_Item * mi = const_cast<Fl_Menu_Item *>(menuBar_->find_item(cb));
@@ -723,11 +948,50 @@ void UserInterface::mainWindowCallback(Fl_Widget * w, void * p)
 
 void UserInterface::quit()
 {
-    channelsWindow_->hide();
-    mapsWindow_->hide();
+    // only hide windows that were used
+    if (channelsWindow_.created()) channelsWindow_->hide();
+    if (mapsWindow_.created()) mapsWindow_->hide();
+    if (logSearchWindow_.created()) logSearchWindow_->hide();
+    if (diagnosticsWindow_.created()) diagnosticsWindow_->hide();
     mainWindow_->hide();
 }
 
+void UserInterface::startLogIndexJob()
+{
+    LogIndex * index = LogFile::index();
+    if (logIndexJob_ || index == 0 || !LogFile::enabled())
+    {
+        return;
+    }
+
+    logIndexJob_ = true;
+    model_.runJob(
+        [index]
+        {
+            try
+            {
+                index->update();
+                return 0;
+            }
+            catch (std::exception const & e)
+            {
+                LOG(WARNING) << "chat log index update failed: " << e.what();
+                return 1;
+            }
+        },
+        [this](int)
+        {
+            logIndexJob_ = false;
+        });
+}
+
+void UserInterface::logIndexTimer(void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+    ui->startLogIndexJob();
+    Fl::repeat_timeout(logIndexInterval, logIndexTimer, d);
+}
+
 void UserInterface::checkAway(void* d)
 {
     if (fl_display && xScreenSaverInfo)
@@ -833,3 +1097,36 @@ void UserInterface::postQuitEvent()
     if (!gUserInterface) return;
     gUserInterface->addCallbackEvent(quitHandler, gUserInterface);
 }
+
+void UserInterface::traceHandler(void* d)
+{
+    UserInterface * ui = static_cast<UserInterface*>(d);
+
+    // first signal starts recording, later ones save what was recorded
+    if (!Trace::enabled())
+    {
+        Trace::enable(true);
+        LOG(INFO) << "trace recording started";
+    }
+    else
+    {
+        std::string const path = cacheDir() + "flobby_trace.json";
+        try
+        {
+            Trace::writeJson(path);
+            LOG(INFO) << "trace saved to " << path;
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << e.what();
+        }
+    }
+
+    ui->setMenuItemChecked((Fl_Callback *)&menuTraceRecord, Trace::enabled());
+}
+
+void UserInterface::postTraceEvent()
+{
+    if (!gUserInterface) return;
+    gUserInterface->addCallbackEvent(traceHandler, gUserInterface);
+}
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "model/Model.h"
+#include "controller/IEventLoop.h"
+#include "Lazy.h"
 
 #include <memory>
 #include <string>
@@ -22,6 +24,9 @@ class ProgressDialog;
 class TextDialog;
 class ChannelsWindow;
 class MapsWindow;
+class LogSearchWindow;
+class DiagnosticsWindow;
+class Watchdog;
 class BattleList;
 class BattleRoom;
 class Tabs;
@@ -38,7 +43,7 @@ class Fl_Menu_Bar;
 class Fl_Tile;
 class Fl_Widget;
 
-class UserInterface
+class UserInterface: public IEventLoop
 {
 public:
     UserInterface(Model & model);
@@ -49,7 +54,12 @@ public:
     int run(int argc, char** argv);
 
     static void postQuitEvent();
-    void addCallbackEvent(void (*cb)(void*) /* Fl_Awake_Handler */, void *data);
+    static void postTraceEvent(); // starts trace recording or saves the trace, see traceHandler
+
+    // IEventLoop, the FLTK thread
+    void addCallbackEvent(Callback cb /* Fl_Awake_Handler */, void *data);
+    void addTimeout(double seconds, Callback cb /* Fl_Timeout_Handler */, void *data); // only from FLTK thread
+    void removeTimeout(Callback cb /* Fl_Timeout_Handler */, void *data);
 
 private:
     static void setupLogging();
@@ -74,26 +84,31 @@ private:
     std::deque<GenJob> genJobs_;
     std::size_t genJobsCount_;
     bool openMapsWindow_; // used for showing maps windows after map image files generation is done
+    bool logIndexJob_; // chat log index update is running
 
     Fl_Double_Window * mainWindow_;
     std::string startTitle_;
     Fl_Menu_Bar * menuBar_;
 
+    // windows and dialogs not needed at startup are created on first use
     ProgressDialog * progressDialog_;
-    ChannelsWindow * channelsWindow_;
-    MapsWindow * mapsWindow_;
+    Lazy<ChannelsWindow> channelsWindow_;
+    Lazy<MapsWindow> mapsWindow_;
+    Lazy<LogSearchWindow> logSearchWindow_;
+    Lazy<DiagnosticsWindow> diagnosticsWindow_;
+    std::unique_ptr<Watchdog> watchdog_; // 0 if off
 
     SpringDialog * springDialog_;
     LoginDialog * loginDialog_;
-    RegisterDialog * registerDialog_;
+    Lazy<RegisterDialog> registerDialog_;
     AgreementDialog * agreementDialog_;
-    LoggingDialog * loggingDialog_;
-    TextDialog * autoJoinChannelsDialog_;
-    ChatSettingsDialog * chatSettingsDialog_;
-    SoundSettingsDialog * soundSettingsDialog_;
-    FontSettingsDialog * fontSettingsDialog_;
-    DownloadSettingsDialog * downloadSettingsDialog_;
-    OpenBattleZkDialog * openBattleZkDialog_;
+    Lazy<LoggingDialog> loggingDialog_;
+    Lazy<TextDialog> autoJoinChannelsDialog_;
+    ChatSettingsDialog * chatSettingsDialog_; // used by all chat tabs
+    Lazy<SoundSettingsDialog> soundSettingsDialog_;
+    Lazy<FontSettingsDialog> fontSettingsDialog_;
+    Lazy<DownloadSettingsDialog> downloadSettingsDialog_;
+    Lazy<OpenBattleZkDialog> openBattleZkDialog_;
 
     Fl_Tile * tile_; // whole app window client area
     Fl_Tile * tileLeft_; // chat and battle list
@@ -104,10 +119,12 @@ private:
     void loadAppIcon();
     void reloadMapsMods();
     void quit();
+    void startLogIndexJob();
 
     // Model signal handlers
     void connected(bool connected);
     void loginResult(bool success, std::string const & info);
+    void reconnected();
     void joinBattleFailed(std::string const & reason);
     void downloadDone(Model::DownloadType downloadType, std::string const& name, bool success);
     void startDemo(std::string const& engineVersion, std::string const& demoFile);
@@ -126,6 +143,13 @@ private:
     static void menuRefresh(Fl_Widget *w, void* d);
     static void menuGenerateCacheFiles(Fl_Widget *w, void* d);
     static void menuMaps(Fl_Widget *w, void* d);
+    static void menuCheckPool(Fl_Widget *w, void* d);
+    static void menuRepairPool(Fl_Widget *w, void* d);
+    static void menuLogSearch(Fl_Widget *w, void* d);
+    static void menuDiagnostics(Fl_Widget *w, void* d);
+    static void menuTraceRecord(Fl_Widget *w, void* d);
+    static void menuTraceSave(Fl_Widget *w, void* d);
+    static void menuWatchdog(Fl_Widget *w, void* d);
     static void menuSpring(Fl_Widget *w, void* d);
     static void menuDownloader(Fl_Widget *w, void* d);
     static void menuLogging(Fl_Widget *w, void* d);
@@ -141,8 +165,14 @@ private:
     static void doGenJob(void* d);
     static void closeProgressDialog(void* d);
     static void quitHandler(void* d);
+    static void traceHandler(void* d);
+    static void watchdogTick(void* d);
+    static void logIndexTimer(void* d);
     static void menuOpenBattleZk(Fl_Widget *w, void* d);
 
     void enableMenuItem(void(*cb)(Fl_Widget*, void*), bool enable);
+    void setMenuItemChecked(void(*cb)(Fl_Widget*, void*), bool checked);
+    void startWatchdog();
+    void stopWatchdog();
 
 };
@@ -19,8 +19,6 @@ UserList::UserList(int x, int y, int w, int h, Model & model, ITabs & iTabs, boo
 {
     connectRowClicked( boost::bind(&UserList::userClicked, this, _1, _2) );
     connectRowDoubleClicked( boost::bind(&UserList::userDoubleClicked, this, _1, _2) );
-
-    model_.connectUserChanged( boost::bind(&UserList::userChanged, this, _1) );
 }
 
 void UserList::add(User const & user)
@@ -58,15 +56,33 @@ std::string UserList::statusString(User const & user)
     return oss.str();
 }
 
-void UserList::userChanged(User const & user)
+void UserList::set(std::vector<User const *> const & users)
+{
+    std::vector<StringTableRow> rows;
+    rows.reserve(users.size());
+    for (User const * user : users)
+    {
+        rows.push_back(makeRow(*user));
+    }
+    clear();
+    addRows(std::move(rows));
+}
+
+void UserList::update(std::vector<User const *> const & users)
 {
-    try
+    // most changed users are not in this list, sort once after all rows are updated
+    bool sortNeeded = false;
+    for (User const * user : users)
     {
-        updateRow(makeRow(user)); // throws if row not found
+        int const index = rowIndex(user->name());
+        if (index >= 0)
+        {
+            sortNeeded |= updateCells(index, makeRow(*user).data_, ~0u, false);
+        }
     }
-    catch (std::runtime_error & e)
+    if (sortNeeded)
     {
-        // ignore
+        sort();
     }
 }
 
@@ -5,6 +5,7 @@
 #include "StringTable.h"
 
 #include <string>
+#include <vector>
 
 class Model;
 class ITabs;
@@ -18,6 +19,8 @@ public:
     void add(User const & user);
     void add(std::string const & userName);
     void remove(std::string const & userName);
+    void set(std::vector<User const *> const & users); // replaces all rows
+    void update(std::vector<User const *> const & users); // users not in list are ignored
 
     std::string completeUserName(std::string const& text, std::string const& ignore);
 
@@ -31,7 +34,4 @@ private:
     // StringTable signals
     void userClicked(int rowIndex, int button);
     void userDoubleClicked(int rowIndex, int button);
-
-    // model signals
-    void userChanged(User const & user);
 };
@@ -5,6 +5,7 @@
 
 #include "log/Log.h"
 #include "model/Model.h"
+#include "model/HostMessage.h"
 
 #include <FL/Fl.H>
 #include <FL/Fl_Box.H>
@@ -12,7 +13,6 @@
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/regex.hpp> // <regex> in gcc 4.7 still "empty"
 #include <sstream>
 
 VoteLine::VoteLine(int x, int y, int w, int h, Model & model):
@@ -60,65 +60,6 @@ void VoteLine::onNo(Fl_Widget * w, void * data)
     o->model_.sayBattle("!n");
 }
 
-std::string VoteLine::checkSpringieVote(std::string const & msg)
-{
-    std::string voteText;
-
-    if (msg.find("Poll: ") == 0)
-    {
-        voteText = msg.substr(6);
-        if (msg.find("[END:") == std::string::npos)
-        {
-            activate();
-        }
-        else
-        {
-            deactivate();
-        }
-    }
-
-    return voteText;
-}
-
-std::string VoteLine::checkSpadsVote(std::string const & msg)
-{
-    std::string voteText;
-
-    std::vector<std::string> const enablers =
-    {
-        "called a vote for command",
-        "Vote in progress:",
-    };
-
-    for (std::string const & text : enablers)
-    {
-        if (std::string::npos != msg.find(text))
-        {
-            activate();
-            voteText = msg;
-            return voteText;
-        }
-    }
-
-    const std::vector<std::string> disablers =
-    {
-        "Vote for command",
-        "Vote cancelled",
-    };
-
-    for (const std::string& text : disablers)
-    {
-        if (std::string::npos != msg.find(text))
-        {
-            deactivate();
-            voteText = msg;
-            return voteText;
-        }
-    }
-
-    return voteText;
-}
-
 void VoteLine::addVoteLine(std::string const & voteText)
 {
     std::string const timeNow = getHourMinuteNow();
@@ -129,92 +70,27 @@ void VoteLine::addVoteLine(std::string const & voteText)
 
 bool VoteLine::processHostMessage(std::string const & msg)
 {
-    std::string voteText;
-
-    voteText = checkSpringieVote(msg);
-    if (!voteText.empty())
+    HostMessage const hm = recognizeHostMessage(msg);
+    if (hm.text_.empty())
     {
-        addVoteLine(voteText);
-        return true;
+        return false;
     }
 
-    voteText = checkSpadsVote(msg);
-    if (!voteText.empty())
+    switch (hm.type_)
     {
-        addVoteLine(voteText);
-        return true;
-    }
-
-    return false;
-}
-
-/*
-void VoteLine::processHostMessage(std::string const & msg)
-{
-    size_t pos;
-
-    if ((pos = msg.find("? !vote 1 = yes, !vote 2 = no")) != std::string::npos)
-    {
-        // new vote
-        question_ = msg.substr(0, pos+1).c_str();
-        votesYes_ = votesNo_ = votesTotal_ = 0;
-        makeVotesString();
-        copy_label((question_ + votes_).c_str());
+    case HostMessage::HM_VOTE_START:
         activate();
-    }
-    else if (msg.find("option ") == 0) // optimization
-    {
-        // yes or no vote
-        boost::regex re("option ([12]) has (\\d+) of (\\d+) votes");
-        boost::smatch m;
-        if (boost::regex_search(msg, m, re))
-        {
-            if (m[1] == "1")
-            {
-                votesYes_ = boost::lexical_cast<int>(m[2]);
-            }
-            else if (m[1] == "2")
-            {
-                votesNo_ = boost::lexical_cast<int>(m[2]);
-            }
-            else
-            {
-                LOG(WARNING)<< "expected [12]: '" << msg << "'";
-                throw std::runtime_error("expected [12]");
-            }
-            votesTotal_ = boost::lexical_cast<int>(m[3]);
-            makeVotesString();
-
-            copy_label((question_ + votes_).c_str());
-        }
-        else
-        {
-            LOG(WARNING)<< "expected match for: '" << msg << "'";
-        }
-    }
-    else if (msg.find("vote successful") == 0 ||
-             msg.find("not enough votes") == 0 ||
-             msg.find("poll cancelled") == 0)
-    {
-        // vote end
-        copy_label((question_ + votes_ + msg).c_str());
-        deactivate();
-    }
-    else if (msg.find("There is no poll going on") == 0)
-    {
-        // no vote in progress
-        copy_label(msg.c_str());
+        break;
+    case HostMessage::HM_VOTE_END:
         deactivate();
+        break;
+    default:
+        return false;
     }
-}
 
-void VoteLine::makeVotesString()
-{
-    std::ostringstream oss;
-    oss << " [" << votesYes_ << "y " << votesNo_ << "n of " << votesTotal_ << "] ";
-    votes_ = oss.str();
+    addVoteLine(hm.text_.to_string());
+    return true;
 }
-*/
 
 int VoteLine::handle(int event)
 {
@@ -26,8 +26,6 @@ private:
     static void onYes(Fl_Widget * w, void * data);
     static void onNo(Fl_Widget * w, void * data);
 
-    std::string checkSpringieVote(std::string const & msg);
-    std::string checkSpadsVote(std::string const & msg);
     void addVoteLine(std::string const & voteText);
 
     int handle(int event);
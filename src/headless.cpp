@@ -0,0 +1,386 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+// runs the model without FLTK and X (see HeadlessEventLoop), e.g. for bots, load tests and benchmarks
+// logs in, joins channels, prints chat to stdout and optionally sends lines read from stdin as raw server commands
+
+#include "FlobbyDirs.h"
+#include "FlobbyConfig.h"
+#include "log/Log.h"
+#include "log/Metrics.h"
+#include "controller/Controller.h"
+#include "controller/HeadlessEventLoop.h"
+#include "model/Model.h"
+
+#include <boost/bind.hpp>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+static volatile std::sig_atomic_t quitSignal_ = 0;
+
+static double const tickInterval = 0.1; // checks quit signal and ping
+
+static
+void printUsage(char const* argv0)
+{
+    std::fprintf(stderr,
+        "usage: %s [options] -u <user> -w <password>\n"
+        " -s | --server <host>    : lobby server, default lobby.springrts.com\n"
+        " -p | --port <port>      : lobby server port, default 8200\n"
+        " -u | --user <user>      : user name\n"
+        " -w | --password <pw>    : password\n"
+        " -j | --join <channel>   : join channel after login, can be repeated\n"
+        " -i | --stdin            : send lines from stdin as server commands after login, quit at end of input\n"
+        " -t | --time <seconds>   : quit after seconds, default runs until Ctrl-C\n"
+        " -m | --metrics <file>   : write metrics as JSON to file on exit\n"
+        " -z | --zerok            : use zero-k lobby protocol\n"
+        " -d | --dir <dir>        : use <dir> for flobby config and cache instead of XDG\n"
+        " -h | --help             : print help message\n"
+        "exit code is 0 if login succeeded and the connection was not lost\n", argv0);
+}
+
+static
+void quitHandler(int s)
+{
+    quitSignal_ = 1;
+}
+
+namespace
+{
+    struct Options
+    {
+        std::string host_ = "lobby.springrts.com";
+        std::string port_ = "8200";
+        std::string user_;
+        std::string password_;
+        std::vector<std::string> channels_;
+        bool stdin_ = false;
+        double time_ = 0;
+        std::string metricsFile_;
+        bool zerok_ = false;
+        std::string dir_;
+    };
+
+    // model signal handlers and callbacks, all called in the event loop thread except readStdin
+    class Session
+    {
+    public:
+        Session(HeadlessEventLoop & loop, Model & model, Options const & options):
+            loop_(loop),
+            model_(model),
+            options_(options),
+            loggedIn_(false),
+            failed_(false),
+            stdinDone_(false)
+        {
+            stopStdin_[0] = stopStdin_[1] = -1;
+            model_.setAutoReconnect(false);
+            model_.connectConnected( boost::bind(&Session::connected, this, _1) );
+            model_.connectLoginResult( boost::bind(&Session::loginResult, this, _1, _2) );
+            model_.connectSaidChannel( boost::bind(&Session::saidChannel, this, _1, _2, _3) );
+            model_.connectSaidPrivate( boost::bind(&Session::saidPrivate, this, _1, _2) );
+            model_.connectServerMsg( boost::bind(&Session::serverMsg, this, _1, _2) );
+
+            loop_.addTimeout(tickInterval, tick, this);
+            if (options_.time_ > 0)
+            {
+                loop_.addTimeout(options_.time_, timeUp, this);
+            }
+        }
+
+        ~Session()
+        {
+            // the loop is not run anymore, the reader must not post to it after this
+            if (stdinThread_.joinable())
+            {
+                char const c = 0;
+                ssize_t const res = ::write(stopStdin_[1], &c, 1);
+                (void)res;
+                stdinThread_.join();
+                ::close(stopStdin_[0]);
+                ::close(stopStdin_[1]);
+            }
+        }
+
+        bool failed() const { return failed_ || !loggedIn_; }
+
+    private:
+        HeadlessEventLoop & loop_;
+        Model & model_;
+        Options const & options_;
+        bool loggedIn_;
+        bool failed_;
+
+        std::thread stdinThread_;
+        int stopStdin_[2]; // pipe, written to stop stdinThread_
+        std::mutex mutexStdin_;
+        std::deque<std::string> stdinLines_;
+        bool stdinDone_;
+
+        void connected(bool connected)
+        {
+            if (connected)
+            {
+                model_.login(options_.user_, model_.calcPasswordHash(options_.password_));
+            }
+            else
+            {
+                LOG(WARNING) << "connection to " << options_.host_ << ":" << options_.port_ << " lost";
+                failed_ = true;
+                loop_.quit();
+            }
+        }
+
+        void loginResult(bool success, std::string const & info)
+        {
+            if (!success)
+            {
+                LOG(WARNING) << "login failed: " << info;
+                failed_ = true;
+                loop_.quit();
+                return;
+            }
+
+            LOG(INFO) << "logged in as " << options_.user_;
+            loggedIn_ = true;
+            for (std::string const & channel : options_.channels_)
+            {
+                model_.joinChannel(channel);
+            }
+            if (options_.stdin_ && !stdinThread_.joinable())
+            {
+                if (::pipe(stopStdin_) != 0)
+                {
+                    LOG(WARNING) << "pipe failed, stdin is not read";
+                    return;
+                }
+                stdinThread_ = std::thread(&Session::readStdin, this);
+            }
+        }
+
+        void saidChannel(std::string const & channelName, std::string const & userName, std::string const & message)
+        {
+            std::cout << "#" << channelName << " <" << userName << "> " << message << std::endl;
+        }
+
+        void saidPrivate(std::string const & userName, std::string const & message)
+        {
+            std::cout << "<" << userName << "> " << message << std::endl;
+        }
+
+        void serverMsg(std::string const & msg, int interest)
+        {
+            std::cout << "* " << msg << std::endl;
+        }
+
+        void readStdin() // own thread, polls stdin and stopStdin_ so the destructor can end it
+        {
+            std::string pending; // incomplete last line
+            for (;;)
+            {
+                pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { stopStdin_[0], POLLIN, 0 } };
+                if (::poll(fds, 2, -1) < 0)
+                {
+                    continue; // EINTR
+                }
+                if (fds[1].revents != 0)
+                {
+                    return; // stopped, loop is not run anymore
+                }
+
+                char buf[4096];
+                ssize_t const n = ::read(STDIN_FILENO, buf, sizeof(buf));
+                if (n <= 0)
+                {
+                    break;
+                }
+                pending.append(buf, n);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutexStdin_);
+                    for (std::string::size_type nl = pending.find('\n'); nl != std::string::npos; nl = pending.find('\n'))
+                    {
+                        stdinLines_.push_back(pending.substr(0, nl));
+                        pending.erase(0, nl + 1);
+                    }
+                }
+                loop_.addCallbackEvent(stdinCallback, this);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutexStdin_);
+                if (!pending.empty())
+                {
+                    stdinLines_.push_back(pending);
+                }
+                stdinDone_ = true;
+            }
+            loop_.addCallbackEvent(stdinCallback, this);
+        }
+
+        static void stdinCallback(void * data)
+        {
+            Session * s = static_cast<Session*>(data);
+
+            std::deque<std::string> lines;
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(s->mutexStdin_);
+                lines.swap(s->stdinLines_);
+                done = s->stdinDone_;
+            }
+            for (std::string const & line : lines)
+            {
+                s->model_.sendMessage(line);
+            }
+            if (done && s->options_.time_ <= 0)
+            {
+                s->loop_.quit();
+            }
+        }
+
+        static void tick(void * data)
+        {
+            Session * s = static_cast<Session*>(data);
+            if (quitSignal_)
+            {
+                s->loop_.quit();
+                return;
+            }
+            if (s->loggedIn_)
+            {
+                s->model_.checkPing();
+            }
+            s->loop_.addTimeout(tickInterval, tick, data);
+        }
+
+        static void timeUp(void * data)
+        {
+            Session * s = static_cast<Session*>(data);
+            s->loop_.quit();
+        }
+    };
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool const hasValue = i < argc-1;
+        auto const is = [&](char const * shortName, char const * longName)
+            { return std::strcmp(shortName, argv[i]) == 0 || std::strcmp(longName, argv[i]) == 0; };
+
+        if (is("-s", "--server") && hasValue)
+        {
+            options.host_ = argv[++i];
+        }
+        else if (is("-p", "--port") && hasValue)
+        {
+            options.port_ = argv[++i];
+        }
+        else if (is("-u", "--user") && hasValue)
+        {
+            options.user_ = argv[++i];
+        }
+        else if (is("-w", "--password") && hasValue)
+        {
+            options.password_ = argv[++i];
+        }
+        else if (is("-j", "--join") && hasValue)
+        {
+            options.channels_.push_back(argv[++i]);
+        }
+        else if (is("-i", "--stdin"))
+        {
+            options.stdin_ = true;
+        }
+        else if (is("-t", "--time") && hasValue)
+        {
+            options.time_ = std::atof(argv[++i]);
+        }
+        else if (is("-m", "--metrics") && hasValue)
+        {
+            options.metricsFile_ = argv[++i];
+        }
+        else if (is("-z", "--zerok"))
+        {
+            options.zerok_ = true;
+        }
+        else if (is("-d", "--dir") && hasValue)
+        {
+            options.dir_ = argv[++i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (options.user_.empty())
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    // Ctrl-C and kill quit cleanly, checked in Session::tick
+    {
+        struct sigaction quitAction;
+
+        quitAction.sa_handler = quitHandler;
+        sigemptyset(&quitAction.sa_mask);
+        quitAction.sa_flags = 0;
+
+        sigaction(SIGINT, &quitAction, NULL);
+        sigaction(SIGTERM, &quitAction, NULL);
+    }
+
+    initDirs(options.dir_);
+    Log::logFile(cacheDir()+"flobby-headless.log");
+    LOG(INFO)<< "starting flobby-headless "<< FLOBBY_VERSION;
+
+    Metrics::timing(!options.metricsFile_.empty());
+
+    bool failed;
+    {
+        HeadlessEventLoop loop; // outlives controller which posts to it from its threads
+        Controller controller;
+        Model model(controller, options.zerok_);
+        controller.model(model);
+        controller.eventLoop(loop);
+
+        Session session(loop, model, options);
+        model.connect(options.host_, options.port_);
+        loop.run();
+
+        failed = session.failed();
+        model.disconnect();
+        model.stopJobs();
+        controller.stopThreads();
+    }
+
+    if (!options.metricsFile_.empty())
+    {
+        try
+        {
+            Metrics::writeJson(options.metricsFile_);
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << e.what();
+            failed = true;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
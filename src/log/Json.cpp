@@ -0,0 +1,30 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Json.h"
+
+#include <cstdio>
+#include <ostream>
+
+void writeJsonString(std::ostream & os, char const * str)
+{
+    os << '"';
+    for (; *str; ++str)
+    {
+        char const c = *str;
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            os << buf;
+        }
+        else
+        {
+            os << c;
+        }
+    }
+    os << '"';
+}
@@ -0,0 +1,8 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <iosfwd>
+
+// writes str as quoted JSON string, for the metrics and trace exports
+void writeJsonString(std::ostream & os, char const * str);
@@ -10,6 +10,8 @@ std::ostringstream Log::earlyLogs_;
 std::ofstream Log::ofs_;
 std::string Log::fileName_;
 Log::Severity Log::minSev_ = Log::Info;
+std::deque<std::string> Log::recentLines_;
+std::size_t const Log::recentLinesMax;
 
 static std::mutex m;
 
@@ -69,6 +71,12 @@ Log::~Log()
         ofs_ << oss_.str() << std::endl;
     }
 
+    recentLines_.push_back(oss_.str());
+    if (recentLines_.size() > recentLinesMax)
+    {
+        recentLines_.pop_front();
+    }
+
     if (sev_ == Fatal)
     {
         std::abort();
@@ -85,6 +93,12 @@ std::string const & Log::logFile()
     return fileName_;
 }
 
+std::vector<std::string> Log::recentLines()
+{
+    std::lock_guard<std::mutex> lock(m);
+    return std::vector<std::string>(recentLines_.begin(), recentLines_.end());
+}
+
 void Log::minSeverity(Severity sev)
 {
     minSev_ = sev;
@@ -5,6 +5,9 @@
 #include <sstream>
 #include <fstream>
 #include <ctime>
+#include <deque>
+#include <string>
+#include <vector>
 
 class Log
 {
@@ -30,12 +33,16 @@ public:
     static std::string const & logFile();
     static void minSeverity(Severity sev);
     static Severity minSeverity() { return minSev_; }
+    static std::vector<std::string> recentLines(); // last recentLinesMax lines logged, oldest first
+
+    static std::size_t const recentLinesMax = 200;
 
 private:
     static std::ostringstream earlyLogs_; // things logged before logfile is opened
     static std::ofstream ofs_;
     static std::string fileName_;
     static Severity minSev_;
+    static std::deque<std::string> recentLines_;
 
     std::tm tm_;
     Severity sev_;
@@ -0,0 +1,209 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Metrics.h"
+#include "Json.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+int const MetricsHistogram::subBits;
+int const MetricsHistogram::subBuckets;
+int const MetricsHistogram::bucketCount;
+std::atomic<bool> Metrics::timing_(false);
+
+namespace
+{
+    std::mutex registryMutex;
+    std::map<std::string, std::unique_ptr<MetricsCounter> > counters;
+    std::map<std::string, std::unique_ptr<MetricsGauge> > gauges;
+    std::map<std::string, std::unique_ptr<MetricsHistogram> > histograms;
+
+    template <typename T>
+    T & get(std::map<std::string, std::unique_ptr<T> > & metrics, std::string const & name)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::unique_ptr<T> & metric = metrics[name];
+        if (!metric)
+        {
+            metric.reset(new T);
+        }
+        return *metric;
+    }
+
+    template <typename T>
+    void updateMax(std::atomic<T> & max, T value)
+    {
+        T current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+void MetricsGauge::set(int64_t value)
+{
+    value_.store(value, std::memory_order_relaxed);
+    updateMax(max_, value);
+}
+
+MetricsHistogram::MetricsHistogram():
+    count_(0),
+    sum_(0),
+    max_(0)
+{
+    for (auto & bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+int MetricsHistogram::bucket(uint64_t value)
+{
+    if (value < static_cast<uint64_t>(2*subBuckets))
+    {
+        return static_cast<int>(value);
+    }
+    int const msb = 63 - __builtin_clzll(value);
+    int const shift = msb - subBits;
+    return (shift + 1)*subBuckets + static_cast<int>((value >> shift) & (subBuckets - 1));
+}
+
+uint64_t MetricsHistogram::bucketLow(int bucket)
+{
+    if (bucket < 2*subBuckets)
+    {
+        return bucket;
+    }
+    int const shift = bucket/subBuckets - 1;
+    return static_cast<uint64_t>(subBuckets + bucket%subBuckets) << shift;
+}
+
+void MetricsHistogram::record(uint64_t value)
+{
+    buckets_[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    updateMax(max_, value);
+}
+
+uint64_t MetricsHistogram::percentile(double p) const
+{
+    // count_ may be ahead of the buckets while recording, use the buckets only
+    uint64_t total = 0;
+    for (auto const & bucket : buckets_)
+    {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(p*total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            uint64_t const high = (i + 1 < bucketCount) ? bucketLow(i + 1) - 1 : UINT64_MAX;
+            return std::min(high, max());
+        }
+    }
+    return max();
+}
+
+MetricsCounter & Metrics::counter(std::string const & name)
+{
+    return get(counters, name);
+}
+
+MetricsGauge & Metrics::gauge(std::string const & name)
+{
+    return get(gauges, name);
+}
+
+MetricsHistogram & Metrics::histogram(std::string const & name)
+{
+    return get(histograms, name);
+}
+
+void Metrics::timing(bool enable)
+{
+    timing_.store(enable, std::memory_order_relaxed);
+}
+
+Metrics::Snapshot Metrics::snapshot()
+{
+    Snapshot snapshot;
+    snapshot.time_ = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto const & pair : counters)
+    {
+        snapshot.counters_.push_back({ pair.first, pair.second->value() });
+    }
+    for (auto const & pair : gauges)
+    {
+        snapshot.gauges_.push_back({ pair.first, pair.second->value(), pair.second->max() });
+    }
+    for (auto const & pair : histograms)
+    {
+        MetricsHistogram const & h = *pair.second;
+        snapshot.histograms_.push_back({ pair.first, h.count(), h.sum(),
+            h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.max() });
+    }
+    return snapshot;
+}
+
+void Metrics::Snapshot::writeJson(std::ostream & os) const
+{
+    os << "{\n  \"counters\": {";
+    char const * sep = "\n    ";
+    for (auto const & c : counters_)
+    {
+        os << sep;
+        writeJsonString(os, c.name_.c_str());
+        os << ": " << c.value_;
+        sep = ",\n    ";
+    }
+    os << "\n  },\n  \"gauges\": {";
+    sep = "\n    ";
+    for (auto const & g : gauges_)
+    {
+        os << sep;
+        writeJsonString(os, g.name_.c_str());
+        os << ": { \"value\": " << g.value_ << ", \"max\": " << g.max_ << " }";
+        sep = ",\n    ";
+    }
+    os << "\n  },\n  \"histograms\": {";
+    sep = "\n    ";
+    for (auto const & h : histograms_)
+    {
+        os << sep;
+        writeJsonString(os, h.name_.c_str());
+        os << ": { \"count\": " << h.count_ << ", \"sum\": " << h.sum_
+           << ", \"p50\": " << h.p50_ << ", \"p90\": " << h.p90_ << ", \"p99\": " << h.p99_
+           << ", \"max\": " << h.max_ << " }";
+        sep = ",\n    ";
+    }
+    os << "\n  }\n}\n";
+}
+
+void Metrics::writeJson(std::string const & path)
+{
+    std::ofstream ofs(path);
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to open metrics file for writing: " + path);
+    }
+    snapshot().writeJson(ofs);
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to write metrics file: " + path);
+    }
+}
@@ -0,0 +1,128 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// process wide registry of named counters, gauges and latency histograms, e.g. shown in the diagnostics window
+// metrics are created on first use and never removed so references stay valid, hot paths keep the reference
+// (e.g. in a function static) and only do a relaxed atomic update
+// histograms are only recorded while timing is enabled so no clock is read otherwise
+
+class MetricsCounter
+{
+public:
+    MetricsCounter(): value_(0) {}
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_;
+};
+
+class MetricsGauge
+{
+public:
+    MetricsGauge(): value_(0), max_(0) {}
+    void set(int64_t value);
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+    int64_t max() const { return max_.load(std::memory_order_relaxed); } // highest value set
+
+private:
+    std::atomic<int64_t> value_;
+    std::atomic<int64_t> max_;
+};
+
+// log-linear buckets like HdrHistogram, each power of two is split in subBuckets so a percentile
+// is within 1/subBuckets of the recorded value, values are nanoseconds when used with MetricsTimer
+class MetricsHistogram
+{
+public:
+    static int const subBits = 4;
+    static int const subBuckets = 1 << subBits;
+    static int const bucketCount = (64 - subBits + 1)*subBuckets;
+
+    MetricsHistogram();
+    void record(uint64_t value);
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t percentile(double p) const; // p in [0,1], highest value of the bucket, 0 if empty
+
+    static int bucket(uint64_t value);
+    static uint64_t bucketLow(int bucket); // lowest value in bucket
+
+private:
+    std::atomic<uint32_t> buckets_[bucketCount];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+class Metrics
+{
+public:
+    static MetricsCounter & counter(std::string const & name);
+    static MetricsGauge & gauge(std::string const & name);
+    static MetricsHistogram & histogram(std::string const & name);
+
+    static void timing(bool enable);
+    static bool timing() { return timing_.load(std::memory_order_relaxed); }
+
+    struct Snapshot
+    {
+        struct Counter { std::string name_; uint64_t value_; };
+        struct Gauge { std::string name_; int64_t value_; int64_t max_; };
+        struct Histogram { std::string name_; uint64_t count_; uint64_t sum_; uint64_t p50_; uint64_t p90_; uint64_t p99_; uint64_t max_; };
+
+        std::chrono::steady_clock::time_point time_;
+        std::vector<Counter> counters_; // sorted by name
+        std::vector<Gauge> gauges_;
+        std::vector<Histogram> histograms_;
+
+        void writeJson(std::ostream & os) const;
+    };
+    static Snapshot snapshot();
+    static void writeJson(std::string const & path); // snapshot to file, throws std::runtime_error
+
+private:
+    static std::atomic<bool> timing_;
+};
+
+// records the time from construction to destruction in nanoseconds if timing is enabled
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(MetricsHistogram & histogram):
+        histogram_(Metrics::timing() ? &histogram : 0)
+    {
+        if (histogram_) start_ = std::chrono::steady_clock::now();
+    }
+
+    explicit MetricsTimer(MetricsHistogram * histogram): // nothing recorded if histogram is 0
+        histogram_(histogram && Metrics::timing() ? histogram : 0)
+    {
+        if (histogram_) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~MetricsTimer()
+    {
+        if (histogram_)
+        {
+            histogram_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+        }
+    }
+
+    MetricsTimer(MetricsTimer const &) = delete;
+    MetricsTimer & operator=(MetricsTimer const &) = delete;
+
+private:
+    MetricsHistogram * histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,25 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "StartupPhase.h"
+#include "Log.h"
+#include "Metrics.h"
+
+StartupPhase::StartupPhase(char const * name):
+    name_(name),
+    start_(Trace::now()),
+    span_(name, "startup")
+{
+}
+
+StartupPhase::~StartupPhase()
+{
+    uint64_t const end = Trace::now();
+    Metrics::histogram(std::string("startup.") + name_).record(end - start_);
+    LOG(INFO) << "startup: " << name_ << " took " << (end - start_)/1000000 << " ms, "
+              << end/1000000 << " ms since start";
+}
+
+void StartupPhase::done(char const * what)
+{
+    LOG(INFO) << "startup: " << what << " after " << Trace::now()/1000000 << " ms";
+}
@@ -0,0 +1,27 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "Trace.h"
+
+#include <cstdint>
+
+// times a phase of the startup while in scope, the duration is logged with the time since process start,
+// recorded in the metrics histogram "startup.<name>" and traced if tracing is enabled
+// name must stay valid (see Trace::intern)
+class StartupPhase
+{
+public:
+    explicit StartupPhase(char const * name);
+    ~StartupPhase();
+
+    StartupPhase(StartupPhase const &) = delete;
+    StartupPhase & operator=(StartupPhase const &) = delete;
+
+    static void done(char const * what); // logs the time since process start, e.g. when the first window is usable
+
+private:
+    char const * name_;
+    uint64_t start_; // Trace::now()
+    TraceSpan span_;
+};
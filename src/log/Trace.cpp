@@ -0,0 +1,192 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Trace.h"
+#include "Json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+std::size_t const Trace::bufferSize;
+std::atomic<bool> Trace::enabled_(false);
+
+namespace
+{
+    struct Event
+    {
+        std::atomic<char const *> name_;
+        std::atomic<char const *> category_;
+        std::atomic<uint64_t> start_;
+        std::atomic<uint64_t> end_;
+    };
+
+    // written by its thread only, events_ is allocated on the first record
+    struct Buffer
+    {
+        explicit Buffer(unsigned int tid): tid_(tid), head_(0), events_(nullptr) {}
+        ~Buffer() { delete [] events_.load(); }
+
+        unsigned int const tid_;
+        std::mutex nameMutex_;
+        std::string name_;
+        std::atomic<uint64_t> head_; // events recorded, next is events_[head_ % bufferSize]
+        std::atomic<Event *> events_;
+    };
+
+    std::chrono::steady_clock::time_point const epoch = std::chrono::steady_clock::now();
+
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<Buffer> > buffers;
+    std::set<std::string> interned;
+
+    thread_local Buffer * threadBuffer = nullptr;
+
+    Buffer & buffer()
+    {
+        if (threadBuffer == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.push_back(std::make_shared<Buffer>(static_cast<unsigned int>(buffers.size() + 1)));
+            threadBuffer = buffers.back().get();
+        }
+        return *threadBuffer;
+    }
+
+    void writeMicroseconds(std::ostream & os, uint64_t ns)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%llu.%03u", static_cast<unsigned long long>(ns/1000), static_cast<unsigned int>(ns%1000));
+        os << buf;
+    }
+}
+
+void Trace::enable(bool enable)
+{
+    enabled_.store(enable, std::memory_order_relaxed);
+}
+
+void Trace::threadName(std::string const & name)
+{
+    Buffer & b = buffer();
+    std::lock_guard<std::mutex> lock(b.nameMutex_);
+    b.name_ = name;
+}
+
+char const * Trace::intern(std::string const & name)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return interned.insert(name).first->c_str();
+}
+
+uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(char const * name, char const * category, uint64_t start, uint64_t end)
+{
+    Buffer & b = buffer();
+    Event * events = b.events_.load(std::memory_order_relaxed);
+    if (events == nullptr)
+    {
+        events = new Event[bufferSize]();
+        b.events_.store(events, std::memory_order_release);
+    }
+
+    uint64_t const head = b.head_.load(std::memory_order_relaxed);
+    Event & e = events[head % bufferSize];
+    // pairs with the fence in writeJson, a reader seeing these stores also sees head_ of at least head
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name_.store(name, std::memory_order_relaxed);
+    e.category_.store(category, std::memory_order_relaxed);
+    e.start_.store(start, std::memory_order_relaxed);
+    e.end_.store(end, std::memory_order_relaxed);
+    b.head_.store(head + 1, std::memory_order_release);
+}
+
+void Trace::writeJson(std::ostream & os, uint64_t since)
+{
+    std::vector<std::shared_ptr<Buffer> > all;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        all = buffers;
+    }
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char const * sep = "\n";
+    for (auto const & b : all)
+    {
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(b->nameMutex_);
+            name = b->name_.empty() ? "thread " + std::to_string(b->tid_) : b->name_;
+        }
+        os << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid_ << ",\"args\":{\"name\":";
+        writeJsonString(os, name.c_str());
+        os << "}}";
+        sep = ",\n";
+
+        Event const * events = b->events_.load(std::memory_order_acquire);
+        if (events == nullptr)
+        {
+            continue;
+        }
+
+        // copy first, the owner thread may overwrite the oldest events meanwhile
+        uint64_t const head = b->head_.load(std::memory_order_acquire);
+        uint64_t const begin = head > bufferSize ? head - bufferSize : 0;
+        struct Copy { char const * name_; char const * category_; uint64_t start_; uint64_t end_; };
+        std::vector<Copy> copies;
+        copies.reserve(head - begin);
+        for (uint64_t i = begin; i < head; ++i)
+        {
+            Event const & e = events[i % bufferSize];
+            copies.push_back({ e.name_.load(std::memory_order_acquire), e.category_.load(std::memory_order_acquire),
+                e.start_.load(std::memory_order_acquire), e.end_.load(std::memory_order_acquire) });
+        }
+        // the slot loads must not move after this load, else an overwrite could go unnoticed
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t const headAfter = b->head_.load(std::memory_order_acquire);
+        // older ones may be torn, the slot of event headAfter may be being written already
+        uint64_t const valid = headAfter + 1 > bufferSize ? headAfter + 1 - bufferSize : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < head; ++i)
+        {
+            Copy const & c = copies[i - begin];
+            if (c.end_ < since)
+            {
+                continue;
+            }
+            os << sep << "{\"name\":";
+            writeJsonString(os, c.name_);
+            os << ",\"cat\":";
+            writeJsonString(os, c.category_);
+            os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid_ << ",\"ts\":";
+            writeMicroseconds(os, c.start_);
+            os << ",\"dur\":";
+            writeMicroseconds(os, c.end_ - c.start_);
+            os << "}";
+        }
+    }
+    os << "\n]}\n";
+}
+
+void Trace::writeJson(std::string const & path, uint64_t since)
+{
+    std::ofstream ofs(path);
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to open trace file for writing: " + path);
+    }
+    writeJson(ofs, since);
+    if (!ofs.good())
+    {
+        throw std::runtime_error("failed to write trace file: " + path);
+    }
+}
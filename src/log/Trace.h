@@ -0,0 +1,64 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// timeline of scoped spans exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+// recording is off by default, a TraceSpan then only does one relaxed atomic load
+// each thread records into its own ring buffer of the latest spans, written without locks,
+// the buffer is created on the first span recorded by the thread and kept until exit
+// names must stay valid until exported, i.e. string literals or intern()
+
+class Trace
+{
+public:
+    static std::size_t const bufferSize = 1 << 16; // spans per thread
+
+    static void enable(bool enable);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static void threadName(std::string const & name); // of calling thread, shown in the timeline
+    static char const * intern(std::string const & name); // returns a copy that is never freed
+
+    // spans of all threads ending at or after since (see now()), may be called while recording
+    static void writeJson(std::ostream & os, uint64_t since = 0);
+    static void writeJson(std::string const & path, uint64_t since = 0); // throws std::runtime_error
+
+    static uint64_t now(); // ns since process start
+    static void record(char const * name, char const * category, uint64_t start, uint64_t end);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class TraceSpan
+{
+public:
+    // nothing is recorded if name is 0
+    explicit TraceSpan(char const * name, char const * category = "ui"):
+        name_(name && Trace::enabled() ? name : 0),
+        category_(category),
+        start_(name_ ? Trace::now() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (name_)
+        {
+            Trace::record(name_, category_, start_, Trace::now());
+        }
+    }
+
+    TraceSpan(TraceSpan const &) = delete;
+    TraceSpan & operator=(TraceSpan const &) = delete;
+
+private:
+    char const * name_;
+    char const * category_;
+    uint64_t start_;
+};
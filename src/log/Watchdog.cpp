@@ -0,0 +1,150 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Watchdog.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+
+std::atomic<uint64_t> Watchdog::heartbeat_(0);
+std::atomic<char const *> Watchdog::activity_(nullptr);
+
+static uint64_t const traceBefore = 5000000000ull; // ns of trace written before the stall
+static uint64_t const minDumpInterval = 60000000000ull; // ns
+
+Watchdog::Watchdog(std::string const & dumpDir, unsigned int thresholdMs):
+    dumpDir_(dumpDir),
+    threshold_(static_cast<uint64_t>(thresholdMs)*1000000),
+    traceWasEnabled_(Trace::enabled()),
+    stalls_(0),
+    lastDump_(0),
+    stop_(false)
+{
+    Trace::enable(true);
+    beat();
+    thread_.reset(new std::thread(&Watchdog::run, this));
+    LOG(INFO) << "watchdog started, threshold " << thresholdMs << " ms";
+}
+
+Watchdog::~Watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_->join();
+    Trace::enable(traceWasEnabled_);
+}
+
+void Watchdog::beat()
+{
+    heartbeat_.store(Trace::now(), std::memory_order_relaxed);
+}
+
+void Watchdog::run()
+{
+    Trace::threadName("watchdog");
+    static MetricsGauge & queueDepth = Metrics::gauge("controller.recv_queue");
+    static MetricsCounter & stallCount = Metrics::counter("watchdog.stalls");
+
+    std::chrono::nanoseconds const period(std::max<uint64_t>(threshold_/4, 10000000));
+    uint64_t stallSince = 0; // heartbeat when stall was detected, 0 if not stalled
+    std::string stallDump;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_)
+    {
+        cv_.wait_for(lock, period);
+        if (stop_)
+        {
+            break;
+        }
+
+        uint64_t const now = Trace::now();
+        uint64_t const heartbeat = heartbeat_.load(std::memory_order_relaxed);
+        if (stallSince == 0)
+        {
+            if (heartbeat < now && now - heartbeat > threshold_)
+            {
+                stallSince = heartbeat;
+                ++stalls_;
+                stallCount.add();
+                stallDump = dumpAllowed(now) ? dumpPath() : "";
+                stallStarted(heartbeat, activity(), queueDepth.value(), stallDump);
+            }
+        }
+        else if (heartbeat != stallSince)
+        {
+            stallEnded(stallSince, heartbeat - stallSince, stallDump);
+            stallSince = 0;
+        }
+    }
+}
+
+bool Watchdog::dumpAllowed(uint64_t now)
+{
+    if (lastDump_ != 0 && now - lastDump_ < minDumpInterval)
+    {
+        return false;
+    }
+    lastDump_ = now;
+    return true;
+}
+
+std::string Watchdog::dumpPath() const
+{
+    char buf[32];
+    std::time_t const t = std::time(0);
+    std::tm tm = *std::localtime(&t);
+    std::strftime(buf, sizeof(buf), "%Y%m%d_%H%M%S", &tm);
+    return dumpDir_ + "stall_" + buf;
+}
+
+void Watchdog::stallStarted(uint64_t since, char const * activity, int64_t queueDepth, std::string const & dumpPath)
+{
+    uint64_t const ms = (Trace::now() - since)/1000000;
+    char const * const what = activity ? activity : "event loop";
+    LOG(WARNING) << "UI thread stalled for " << ms << " ms in " << what << ", receive queue " << queueDepth;
+
+    if (dumpPath.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> const lines = Log::recentLines();
+    std::ofstream ofs(dumpPath + ".txt");
+    ofs << "UI thread stalled for " << ms << " ms\n"
+        << "activity: " << what << "\n"
+        << "receive queue: " << queueDepth << " messages\n"
+        << "\nrecent log:\n";
+    for (std::string const & line : lines)
+    {
+        ofs << line << "\n";
+    }
+    LOG_IF(WARNING, !ofs.good()) << "failed to write " << dumpPath << ".txt";
+}
+
+void Watchdog::stallEnded(uint64_t since, uint64_t duration, std::string const & dumpPath)
+{
+    LOG(WARNING) << "UI thread stall ended after " << duration/1000000 << " ms";
+
+    if (dumpPath.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        Trace::writeJson(dumpPath + ".json", since > traceBefore ? since - traceBefore : 0);
+        LOG(INFO) << "stall written to " << dumpPath << ".txt and .json";
+    }
+    catch (std::exception const & e)
+    {
+        LOG(WARNING) << e.what();
+    }
+}
@@ -0,0 +1,73 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// detects stalls of the thread calling beat(), i.e. the FLTK thread
+// a watchdog thread checks the heartbeat, when there was no beat for threshold it logs the activity
+// (see WatchdogActivity) and the receive queue depth and writes stall_<time>.txt with the recent log lines to dumpDir,
+// when the stall ends stall_<time>.json is written with the trace of the seconds before (Trace is enabled while running)
+// at most one stall per minute is written to files
+class Watchdog
+{
+public:
+    Watchdog(std::string const & dumpDir, unsigned int thresholdMs);
+    ~Watchdog();
+
+    static void beat();
+    static char const * activity() { return activity_.load(std::memory_order_relaxed); }
+
+    unsigned int stalls() const { return stalls_; } // detected so far
+
+private:
+    friend class WatchdogActivity;
+    static std::atomic<uint64_t> heartbeat_; // Trace::now()
+    static std::atomic<char const *> activity_;
+
+    std::string const dumpDir_;
+    uint64_t const threshold_; // ns
+    bool const traceWasEnabled_;
+    std::atomic<unsigned int> stalls_;
+    uint64_t lastDump_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    std::unique_ptr<std::thread> thread_;
+
+    void run();
+    bool dumpAllowed(uint64_t now);
+    std::string dumpPath() const; // without suffix
+    void stallStarted(uint64_t since, char const * activity, int64_t queueDepth, std::string const & dumpPath);
+    void stallEnded(uint64_t since, uint64_t duration, std::string const & dumpPath);
+};
+
+// names what the watched thread is doing while in scope, only used by the watched thread,
+// name must stay valid (see Trace::intern)
+class WatchdogActivity
+{
+public:
+    explicit WatchdogActivity(char const * name):
+        previous_(Watchdog::activity_.load(std::memory_order_relaxed))
+    {
+        Watchdog::activity_.store(name, std::memory_order_relaxed);
+    }
+
+    ~WatchdogActivity()
+    {
+        Watchdog::activity_.store(previous_, std::memory_order_relaxed);
+    }
+
+    WatchdogActivity(WatchdogActivity const &) = delete;
+    WatchdogActivity & operator=(WatchdogActivity const &) = delete;
+
+private:
+    char const * previous_;
+};
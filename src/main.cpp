@@ -3,6 +3,8 @@
 #include "FlobbyDirs.h"
 #include "FlobbyConfig.h"
 #include "log/Log.h"
+#include "log/StartupPhase.h"
+#include "log/Trace.h"
 #include "controller/Controller.h"
 #include "model/Model.h"
 #include "gui/UserInterface.h"
@@ -65,6 +67,11 @@ void my_handler(int s)
     UserInterface::postQuitEvent();
 }
 
+void traceSignalHandler(int s)
+{
+    UserInterface::postTraceEvent();
+}
+
 int main(int argc, char * argv[])
 {
     // setup handling of SIGINT (Ctrl-C)
@@ -78,6 +85,17 @@ int main(int argc, char * argv[])
         sigaction(SIGINT, &sigIntHandler, NULL);
     }
 
+    // SIGUSR1 starts trace recording, next ones save the trace to the cache dir
+    {
+        struct sigaction sigUsr1Handler;
+
+        sigUsr1Handler.sa_handler = traceSignalHandler;
+        sigemptyset(&sigUsr1Handler.sa_mask);
+        sigUsr1Handler.sa_flags = 0;
+
+        sigaction(SIGUSR1, &sigUsr1Handler, NULL);
+    }
+
     std::string commandLine;
     for (int i=0; i<argc; ++i)
     {
@@ -97,6 +115,7 @@ int main(int argc, char * argv[])
         printUsage(argv[0], errorMsg);
     }
 
+    Trace::threadName("main");
     LOG(INFO)<< "starting flobby "<< FLOBBY_VERSION << ", command line '" << commandLine << "'";
     initDirs(dir_);
 
@@ -109,16 +128,23 @@ int main(int argc, char * argv[])
     // extra scope to be able to check destruction
     {
         // setup
-        UserInterface::setupEarlySettings();
+        {
+            StartupPhase phase("early settings");
+            UserInterface::setupEarlySettings();
+        }
 
         Controller controller;
         Model model(controller, zerok_);
         UserInterface ui(model);
         controller.model(model);
-        controller.userInterface(ui);
+        controller.eventLoop(ui);
 
         // start
         ui.run(argc, argv);
+
+        // jobs use model and ui
+        model.stopJobs();
+        controller.stopThreads();
     }
 
     // shutdown pr-downloader
@@ -37,6 +37,8 @@
   <ghost@aladdin.com>.  Other authors are noted in the change history
   that follows (in reverse chronological order):
 
+  2026-10-19 flobby Added md5_append_lanes for hashing several messages
+	in lockstep.
   2002-04-13 lpd Clarified derivation from RFC 1321; now handles byte order
 	either statically or dynamically; added missing #include <string.h>
 	in library.
@@ -379,3 +381,160 @@ md5_finish(md5_state_t *pms, md5_byte_t digest[16])
     for (i = 0; i < 16; ++i)
 	digest[i] = (md5_byte_t)(pms->abcd[i >> 2] >> ((i & 3) << 3));
 }
+
+/*
+ * md5_process for MD5_LANES blocks of independent messages. With GCC vector
+ * extensions each operation works on all lanes at once, otherwise each
+ * operation is a loop over the lanes the compiler may vectorize.
+ */
+#if defined(__GNUC__)
+typedef md5_word_t md5_lanes_t __attribute__((vector_size(MD5_LANES * sizeof(md5_word_t))));
+#  define LANES_SET(f, a, b, c, d, k, s, Ti)\
+  t = a + f(b, c, d) + X[k] + Ti;\
+  a = ROTATE_LEFT(t, s) + b;
+#else
+typedef md5_word_t md5_lanes_t[MD5_LANES];
+#  define LANES_SET(f, a, b, c, d, k, s, Ti)\
+  for (l = 0; l < MD5_LANES; ++l) {\
+    t[l] = a[l] + f(b[l], c[l], d[l]) + X[k][l] + Ti;\
+    a[l] = ROTATE_LEFT(t[l], s) + b[l];\
+  }
+#endif
+
+static void
+md5_process_lanes(md5_state_t *pms[MD5_LANES], const md5_byte_t *data[MD5_LANES])
+{
+    md5_lanes_t a, b, c, d, t;
+    md5_lanes_t X[16];
+    int i, l;
+
+    for (l = 0; l < MD5_LANES; ++l) {
+	const md5_byte_t *xp = data[l];
+
+	a[l] = pms[l]->abcd[0];
+	b[l] = pms[l]->abcd[1];
+	c[l] = pms[l]->abcd[2];
+	d[l] = pms[l]->abcd[3];
+	for (i = 0; i < 16; ++i, xp += 4)
+	    X[i][l] = xp[0] + (xp[1] << 8) + (xp[2] << 16) + ((md5_word_t)xp[3] << 24);
+    }
+
+    /* Round 1. */
+    LANES_SET(F, a, b, c, d,  0,  7,  T1);
+    LANES_SET(F, d, a, b, c,  1, 12,  T2);
+    LANES_SET(F, c, d, a, b,  2, 17,  T3);
+    LANES_SET(F, b, c, d, a,  3, 22,  T4);
+    LANES_SET(F, a, b, c, d,  4,  7,  T5);
+    LANES_SET(F, d, a, b, c,  5, 12,  T6);
+    LANES_SET(F, c, d, a, b,  6, 17,  T7);
+    LANES_SET(F, b, c, d, a,  7, 22,  T8);
+    LANES_SET(F, a, b, c, d,  8,  7,  T9);
+    LANES_SET(F, d, a, b, c,  9, 12, T10);
+    LANES_SET(F, c, d, a, b, 10, 17, T11);
+    LANES_SET(F, b, c, d, a, 11, 22, T12);
+    LANES_SET(F, a, b, c, d, 12,  7, T13);
+    LANES_SET(F, d, a, b, c, 13, 12, T14);
+    LANES_SET(F, c, d, a, b, 14, 17, T15);
+    LANES_SET(F, b, c, d, a, 15, 22, T16);
+    /* Round 2. */
+    LANES_SET(G, a, b, c, d,  1,  5, T17);
+    LANES_SET(G, d, a, b, c,  6,  9, T18);
+    LANES_SET(G, c, d, a, b, 11, 14, T19);
+    LANES_SET(G, b, c, d, a,  0, 20, T20);
+    LANES_SET(G, a, b, c, d,  5,  5, T21);
+    LANES_SET(G, d, a, b, c, 10,  9, T22);
+    LANES_SET(G, c, d, a, b, 15, 14, T23);
+    LANES_SET(G, b, c, d, a,  4, 20, T24);
+    LANES_SET(G, a, b, c, d,  9,  5, T25);
+    LANES_SET(G, d, a, b, c, 14,  9, T26);
+    LANES_SET(G, c, d, a, b,  3, 14, T27);
+    LANES_SET(G, b, c, d, a,  8, 20, T28);
+    LANES_SET(G, a, b, c, d, 13,  5, T29);
+    LANES_SET(G, d, a, b, c,  2,  9, T30);
+    LANES_SET(G, c, d, a, b,  7, 14, T31);
+    LANES_SET(G, b, c, d, a, 12, 20, T32);
+    /* Round 3. */
+    LANES_SET(H, a, b, c, d,  5,  4, T33);
+    LANES_SET(H, d, a, b, c,  8, 11, T34);
+    LANES_SET(H, c, d, a, b, 11, 16, T35);
+    LANES_SET(H, b, c, d, a, 14, 23, T36);
+    LANES_SET(H, a, b, c, d,  1,  4, T37);
+    LANES_SET(H, d, a, b, c,  4, 11, T38);
+    LANES_SET(H, c, d, a, b,  7, 16, T39);
+    LANES_SET(H, b, c, d, a, 10, 23, T40);
+    LANES_SET(H, a, b, c, d, 13,  4, T41);
+    LANES_SET(H, d, a, b, c,  0, 11, T42);
+    LANES_SET(H, c, d, a, b,  3, 16, T43);
+    LANES_SET(H, b, c, d, a,  6, 23, T44);
+    LANES_SET(H, a, b, c, d,  9,  4, T45);
+    LANES_SET(H, d, a, b, c, 12, 11, T46);
+    LANES_SET(H, c, d, a, b, 15, 16, T47);
+    LANES_SET(H, b, c, d, a,  2, 23, T48);
+    /* Round 4. */
+    LANES_SET(I, a, b, c, d,  0,  6, T49);
+    LANES_SET(I, d, a, b, c,  7, 10, T50);
+    LANES_SET(I, c, d, a, b, 14, 15, T51);
+    LANES_SET(I, b, c, d, a,  5, 21, T52);
+    LANES_SET(I, a, b, c, d, 12,  6, T53);
+    LANES_SET(I, d, a, b, c,  3, 10, T54);
+    LANES_SET(I, c, d, a, b, 10, 15, T55);
+    LANES_SET(I, b, c, d, a,  1, 21, T56);
+    LANES_SET(I, a, b, c, d,  8,  6, T57);
+    LANES_SET(I, d, a, b, c, 15, 10, T58);
+    LANES_SET(I, c, d, a, b,  6, 15, T59);
+    LANES_SET(I, b, c, d, a, 13, 21, T60);
+    LANES_SET(I, a, b, c, d,  4,  6, T61);
+    LANES_SET(I, d, a, b, c, 11, 10, T62);
+    LANES_SET(I, c, d, a, b,  2, 15, T63);
+    LANES_SET(I, b, c, d, a,  9, 21, T64);
+#undef LANES_SET
+
+    for (l = 0; l < MD5_LANES; ++l) {
+	pms[l]->abcd[0] += a[l];
+	pms[l]->abcd[1] += b[l];
+	pms[l]->abcd[2] += c[l];
+	pms[l]->abcd[3] += d[l];
+    }
+}
+
+void
+md5_append_lanes(md5_state_t *pms[MD5_LANES], const md5_byte_t *data[MD5_LANES], int nbytes)
+{
+    const md5_byte_t *p[MD5_LANES];
+    int left = nbytes;
+    md5_word_t nbits = (md5_word_t)(nbytes << 3);
+    int l;
+
+    if (nbytes <= 0)
+	return;
+
+    for (l = 0; l < MD5_LANES; ++l) {
+	if ((pms[l]->count[0] >> 3) & 63) {
+	    /* a partial block is buffered, no lockstep possible */
+	    for (l = 0; l < MD5_LANES; ++l)
+		md5_append(pms[l], data[l], nbytes);
+	    return;
+	}
+    }
+
+    /* Update the message lengths. */
+    for (l = 0; l < MD5_LANES; ++l) {
+	pms[l]->count[1] += nbytes >> 29;
+	pms[l]->count[0] += nbits;
+	if (pms[l]->count[0] < nbits)
+	    pms[l]->count[1]++;
+	p[l] = data[l];
+    }
+
+    /* Process full blocks. */
+    for (; left >= 64; left -= 64) {
+	md5_process_lanes(pms, p);
+	for (l = 0; l < MD5_LANES; ++l)
+	    p[l] += 64;
+    }
+
+    /* Process a final partial block. */
+    if (left)
+	for (l = 0; l < MD5_LANES; ++l)
+	    memcpy(pms[l]->buf, p[l], left);
+}
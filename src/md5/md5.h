@@ -37,6 +37,8 @@
   <ghost@aladdin.com>.  Other authors are noted in the change history
   that follows (in reverse chronological order):
 
+  2026-10-19 flobby Added md5_append_lanes for hashing several messages
+	in lockstep.
   2002-04-13 lpd Removed support for non-ANSI compilers; removed
 	references to Ghostscript; clarified derivation from RFC 1321;
 	now handles byte order either statically or dynamically.
@@ -84,6 +86,16 @@ void md5_append(md5_state_t *pms, const md5_byte_t *data, int nbytes);
 /* Finish the message and return the digest. */
 void md5_finish(md5_state_t *pms, md5_byte_t digest[16]);
 
+/*
+ * Append nbytes to each of MD5_LANES independent messages, same result as
+ * md5_append on each state. Full blocks of all messages are processed in
+ * lockstep so the compiler can use SIMD instructions, this needs all
+ * states at a block boundary (only whole blocks appended so far),
+ * otherwise md5_append is used for each message.
+ */
+#define MD5_LANES 4
+void md5_append_lanes(md5_state_t *pms[MD5_LANES], const md5_byte_t *data[MD5_LANES], int nbytes);
+
 #ifdef __cplusplus
 }  /* end extern "C" */
 #endif
@@ -0,0 +1,166 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "ArchivePrefetch.h"
+#include "Downloader.h"
+#include "log/Log.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+uint64_t const chunkSize = uint64_t(8) << 20;
+
+// returns false if stopped
+bool prefetchFile(std::string const & path, uint64_t & budget, uint64_t & done, std::function<bool()> const & stopped)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        LOG(DEBUG) << "prefetch open failed: " << path;
+        return true;
+    }
+
+    bool result = true;
+    off_t const size = ::lseek(fd, 0, SEEK_END);
+    for (off_t offset = 0; offset < size; offset += chunkSize)
+    {
+        uint64_t const len = std::min<uint64_t>(chunkSize, size - offset);
+        uint64_t const available = ArchivePrefetch::availableMemory();
+        if (stopped() || len > budget || (available != 0 && available < ArchivePrefetch::minAvailableMemory))
+        {
+            result = false;
+            break;
+        }
+
+#ifdef __linux__
+        // blocks until read, so the budget checks above pace the prefetch
+        ::readahead(fd, offset, len);
+#else
+        ::posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+#endif
+        budget -= len;
+        done += len;
+    }
+    ::close(fd);
+    return result;
+}
+
+}
+
+ArchivePrefetch::ArchivePrefetch():
+    generation_(std::make_shared<std::atomic<unsigned int>>(0))
+{
+}
+
+ArchivePrefetch::~ArchivePrefetch()
+{
+    stop();
+}
+
+boost::function<int()> ArchivePrefetch::job(std::vector<std::string> const & paths, uint64_t budgetBytes)
+{
+    std::shared_ptr<std::atomic<unsigned int>> const generation = generation_;
+    unsigned int const myGeneration = ++*generation;
+
+    return [paths, budgetBytes, generation, myGeneration]() -> int
+    {
+        uint64_t const done = run(paths, budgetBytes, [&generation, myGeneration]() { return *generation != myGeneration; });
+        LOG(INFO) << "prefetched " << (done >> 20) << " MB of battle archives";
+        return 0;
+    };
+}
+
+void ArchivePrefetch::stop()
+{
+    ++*generation_;
+}
+
+uint64_t ArchivePrefetch::run(std::vector<std::string> const & paths, uint64_t budgetBytes, std::function<bool()> stopped)
+{
+    uint64_t const available = availableMemory();
+    uint64_t budget = available != 0 ? std::min(budgetBytes, available/2) : budgetBytes;
+    uint64_t done = 0;
+
+    for (std::string const & path : paths)
+    {
+        boost::system::error_code ec;
+        if (boost::filesystem::is_directory(path, ec))
+        {
+            // .sdd archive
+            for (boost::filesystem::recursive_directory_iterator it(path, ec), end; it != end; it.increment(ec))
+            {
+                if (boost::filesystem::is_regular_file(it->path(), ec) && !prefetchFile(it->path().string(), budget, done, stopped))
+                {
+                    return done;
+                }
+            }
+        }
+        else if (boost::algorithm::ends_with(path, ".sdp"))
+        {
+            // rapid game, the package file only lists the pool files the engine reads
+            for (std::string const & poolFile : rapidPoolFiles(path))
+            {
+                if (!prefetchFile(poolFile, budget, done, stopped))
+                {
+                    return done;
+                }
+            }
+        }
+        else if (!prefetchFile(path, budget, done, stopped))
+        {
+            return done;
+        }
+    }
+    return done;
+}
+
+std::vector<std::string> ArchivePrefetch::rapidPoolFiles(std::string const & sdpPath)
+{
+    std::vector<std::string> result;
+    try
+    {
+        std::ifstream ifs(sdpPath, std::ios::binary);
+        std::string const sdpGz((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::string const dataDir = boost::filesystem::path(sdpPath).parent_path().parent_path().string() + "/";
+
+        std::unordered_set<std::string> seen; // files with the same content share one pool file
+        for (Downloader::PoolFile const & file : Downloader::parseSdp(Downloader::gunzip(sdpGz)))
+        {
+            std::string const path = Downloader::poolPath(dataDir, file);
+            if (seen.insert(path).second)
+            {
+                result.push_back(path);
+            }
+        }
+    }
+    catch (std::exception const & e)
+    {
+        LOG(DEBUG) << "prefetch of " << sdpPath << " failed: " << e.what();
+    }
+    return result;
+}
+
+uint64_t ArchivePrefetch::availableMemory()
+{
+    std::ifstream ifs("/proc/meminfo");
+    std::string key;
+    uint64_t value;
+    std::string unit;
+    while (ifs >> key >> value)
+    {
+        std::getline(ifs, unit);
+        if (key == "MemAvailable:")
+        {
+            return value << 10; // kB
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <boost/function.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// reads game and map archives into the page cache before the engine needs them
+// job runs in a pooled thread, stop and job are called from the FLTK thread
+class ArchivePrefetch
+{
+public:
+    static uint64_t const defaultBudget = uint64_t(1) << 30;
+    static uint64_t const minAvailableMemory = uint64_t(256) << 20; // prefetch stops below this
+
+    ArchivePrefetch();
+    ~ArchivePrefetch(); // stops running job
+
+    // returns job for IController::startThread, a running job of a previous call stops
+    boost::function<int()> job(std::vector<std::string> const & paths, uint64_t budgetBytes = defaultBudget);
+    void stop();
+
+    // prefetches paths (files, directories or rapid .sdp packages) in order until done, budget is used,
+    // memory is tight or stopped returns true
+    // budget is also limited to half of available memory, returns bytes prefetched
+    static uint64_t run(std::vector<std::string> const & paths, uint64_t budgetBytes, std::function<bool()> stopped);
+
+    // pool files of a rapid package (<datadir>/packages/<md5>.sdp), empty if it can't be read
+    static std::vector<std::string> rapidPoolFiles(std::string const & sdpPath);
+
+    static uint64_t availableMemory(); // MemAvailable in /proc/meminfo, 0 if unknown
+
+private:
+    std::shared_ptr<std::atomic<unsigned int>> generation_;
+};
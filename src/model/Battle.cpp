@@ -7,6 +7,7 @@
 #include "log/Log.h"
 
 #include <json/json.h>
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include <iostream>
 
@@ -201,6 +202,39 @@ int Battle::spectators() const
     return spectatorCount;
 }
 
+bool Battle::sameState(Battle const& other) const
+{
+    if (id_ != other.id_
+        || replay_ != other.replay_
+        || natType_ != other.natType_
+        || founder_ != other.founder_
+        || ip_ != other.ip_
+        || port_ != other.port_
+        || maxPlayers_ != other.maxPlayers_
+        || passworded_ != other.passworded_
+        || rank_ != other.rank_
+        || mapHash_ != other.mapHash_
+        || engineName_ != other.engineName_
+        || engineVersion_ != other.engineVersion_
+        || engineBranch_ != other.engineBranch_
+        || engineVersionLong_ != other.engineVersionLong_
+        || mapName_ != other.mapName_
+        || title_ != other.title_
+        || modName_ != other.modName_
+        || spectators_ != other.spectators_
+        || locked_ != other.locked_
+        || running_ != other.running_
+        || modHash_ != other.modHash_
+        || users_.size() != other.users_.size())
+    {
+        return false;
+    }
+
+    // users are compared by name, the User objects can be from different sessions
+    return std::equal(users_.begin(), users_.end(), other.users_.begin(),
+        [](BattleUsers::value_type const & a, BattleUsers::value_type const & b) { return a.first == b.first; });
+}
+
 void Battle::print(std::ostream & os) const
 {
     os << "[Battle:" // TODO add more info
@@ -65,6 +65,8 @@ public:
     typedef std::map<std::string, User const*, ciLessBoost> BattleUsers;
     BattleUsers const& users() const;
 
+    bool sameState(Battle const& other) const; // all attributes and user names equal
+
     void print(std::ostream & os) const;
 
 private:
@@ -0,0 +1,161 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "ChannelMembers.h"
+
+#include <algorithm>
+
+bool ChannelMembers::addChannel(std::string const & channelName)
+{
+    if (slotIndex_.count(channelName) > 0)
+    {
+        return true;
+    }
+
+    // reuse free slot
+    auto it = std::find_if(slots_.begin(), slots_.end(), [](Slot const & s) { return s.name_.empty(); });
+    if (it == slots_.end())
+    {
+        if (slots_.size() == maxChannels)
+        {
+            return false;
+        }
+        it = slots_.insert(slots_.end(), Slot());
+    }
+    it->name_ = channelName;
+    slotIndex_[channelName] = it - slots_.begin();
+    return true;
+}
+
+void ChannelMembers::removeChannel(std::string const & channelName)
+{
+    std::size_t index;
+    Slot * s = slot(channelName, index);
+    if (s == 0)
+    {
+        return;
+    }
+
+    ChannelMask const bit = ChannelMask(1) << index;
+    for (std::string const & userName : s->users_)
+    {
+        auto it = userChannels_.find(userName);
+        if (it != userChannels_.end() && (it->second &= ~bit) == 0)
+        {
+            userChannels_.erase(it);
+        }
+    }
+    s->name_.clear();
+    s->users_.clear();
+    slotIndex_.erase(channelName);
+}
+
+void ChannelMembers::clear()
+{
+    slots_.clear();
+    slotIndex_.clear();
+    userChannels_.clear();
+}
+
+void ChannelMembers::add(std::string const & channelName, std::string const & userName)
+{
+    std::size_t index;
+    Slot * s = slot(channelName, index);
+    if (s == 0)
+    {
+        return;
+    }
+
+    auto it = std::lower_bound(s->users_.begin(), s->users_.end(), userName);
+    if (it == s->users_.end() || *it != userName)
+    {
+        s->users_.insert(it, userName);
+        userChannels_[userName] |= ChannelMask(1) << index;
+    }
+}
+
+void ChannelMembers::add(std::string const & channelName, std::vector<std::string> const & userNames)
+{
+    std::size_t index;
+    Slot * s = slot(channelName, index);
+    if (s == 0)
+    {
+        return;
+    }
+
+    ChannelMask const bit = ChannelMask(1) << index;
+    s->users_.insert(s->users_.end(), userNames.begin(), userNames.end());
+    std::sort(s->users_.begin(), s->users_.end());
+    s->users_.erase(std::unique(s->users_.begin(), s->users_.end()), s->users_.end());
+    for (std::string const & userName : userNames)
+    {
+        userChannels_[userName] |= bit;
+    }
+}
+
+void ChannelMembers::remove(std::string const & channelName, std::string const & userName)
+{
+    std::size_t index;
+    Slot * s = slot(channelName, index);
+    if (s == 0)
+    {
+        return;
+    }
+
+    auto it = std::lower_bound(s->users_.begin(), s->users_.end(), userName);
+    if (it != s->users_.end() && *it == userName)
+    {
+        s->users_.erase(it);
+        auto itMask = userChannels_.find(userName);
+        if (itMask != userChannels_.end() && (itMask->second &= ~(ChannelMask(1) << index)) == 0)
+        {
+            userChannels_.erase(itMask);
+        }
+    }
+}
+
+void ChannelMembers::removeUser(std::string const & userName)
+{
+    ChannelMask const mask = channels(userName);
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+    {
+        if (mask & (ChannelMask(1) << i))
+        {
+            std::vector<std::string> & users = slots_[i].users_;
+            auto it = std::lower_bound(users.begin(), users.end(), userName);
+            if (it != users.end() && *it == userName)
+            {
+                users.erase(it);
+            }
+        }
+    }
+    userChannels_.erase(userName);
+}
+
+std::vector<std::string> const & ChannelMembers::users(std::string const & channelName) const
+{
+    static std::vector<std::string> const empty;
+    auto it = slotIndex_.find(channelName);
+    return it != slotIndex_.end() ? slots_[it->second].users_ : empty;
+}
+
+ChannelMembers::ChannelMask ChannelMembers::channels(std::string const & userName) const
+{
+    auto it = userChannels_.find(userName);
+    return it != userChannels_.end() ? it->second : 0;
+}
+
+std::string const & ChannelMembers::channelName(std::size_t slot) const
+{
+    return slots_.at(slot).name_;
+}
+
+ChannelMembers::Slot * ChannelMembers::slot(std::string const & channelName, std::size_t & index)
+{
+    auto it = slotIndex_.find(channelName);
+    if (it == slotIndex_.end())
+    {
+        return 0;
+    }
+    index = it->second;
+    return &slots_[index];
+}
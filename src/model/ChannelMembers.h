@@ -0,0 +1,45 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// users of the channels we joined
+// each channel has a slot with its users sorted by name, each user has a bit mask of the slots the user is in,
+// so a change of one user is only routed to the channels that user is in
+class ChannelMembers
+{
+public:
+    typedef uint64_t ChannelMask;
+    static std::size_t const maxChannels = 64; // bits in ChannelMask
+
+    bool addChannel(std::string const & channelName); // returns false if maxChannels are already joined
+    void removeChannel(std::string const & channelName);
+    void clear();
+
+    void add(std::string const & channelName, std::string const & userName); // ignored if channel not joined
+    void add(std::string const & channelName, std::vector<std::string> const & userNames); // one sort for all
+    void remove(std::string const & channelName, std::string const & userName);
+    void removeUser(std::string const & userName); // user left server
+
+    // sorted user names, empty if channel is not joined
+    std::vector<std::string> const & users(std::string const & channelName) const;
+
+    ChannelMask channels(std::string const & userName) const;
+    std::string const & channelName(std::size_t slot) const; // slot is bit index in ChannelMask
+
+private:
+    struct Slot
+    {
+        std::string name_; // empty if slot is free
+        std::vector<std::string> users_;
+    };
+    std::vector<Slot> slots_;
+    std::unordered_map<std::string, std::size_t> slotIndex_; // channel name -> slot
+    std::unordered_map<std::string, ChannelMask> userChannels_;
+
+    Slot * slot(std::string const & channelName, std::size_t & index);
+};
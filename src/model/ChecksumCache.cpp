@@ -0,0 +1,23 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "ChecksumCache.h"
+
+ChecksumCache::ChecksumCache(Lookup lookup):
+    lookup_(lookup)
+{
+}
+
+unsigned int ChecksumCache::get(std::string const & name)
+{
+    auto it = checksums_.find(name);
+    if (it == checksums_.end())
+    {
+        it = checksums_.insert(std::make_pair(name, lookup_(name))).first;
+    }
+    return it->second;
+}
+
+void ChecksumCache::clear()
+{
+    checksums_.clear();
+}
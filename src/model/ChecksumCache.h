@@ -0,0 +1,24 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// memoized name -> checksum lookups, each distinct name is looked up once until clear
+// 0 (not found) results are cached too, so missing maps and games are not looked up again for each battle
+class ChecksumCache
+{
+public:
+    typedef std::function<unsigned int (std::string const & name)> Lookup;
+
+    explicit ChecksumCache(Lookup lookup);
+
+    unsigned int get(std::string const & name);
+    void clear(); // e.g. after new archives were found
+
+private:
+    Lookup lookup_;
+    std::unordered_map<std::string, unsigned int> checksums_;
+};
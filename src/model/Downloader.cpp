@@ -0,0 +1,602 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Downloader.h"
+#include "HttpClient.h"
+#include "log/Log.h"
+#include "log/Metrics.h"
+#include "md5/md5.h"
+
+#include <zlib.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+
+char const * const Downloader::defaultReposUrl = "http://repos.springrts.com/repos.gz";
+
+namespace
+{
+
+// gzip stream decompression with md5 of the uncompressed data
+class GunzipMd5
+{
+public:
+    GunzipMd5()
+    {
+        std::memset(&zs_, 0, sizeof(zs_));
+        if (::inflateInit2(&zs_, 16 + MAX_WBITS) != Z_OK) // gzip header
+        {
+            throw std::runtime_error("inflateInit2 failed");
+        }
+        md5_init(&md5_);
+        done_ = false;
+    }
+
+    ~GunzipMd5()
+    {
+        ::inflateEnd(&zs_);
+    }
+
+    // returns uncompressed size of data, throws on corrupt data
+    std::size_t add(char const * data, std::size_t size, std::string * out = 0)
+    {
+        std::size_t produced = 0;
+        zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zs_.avail_in = size;
+        while (zs_.avail_in > 0 && !done_)
+        {
+            zs_.next_out = reinterpret_cast<Bytef *>(buf_);
+            zs_.avail_out = sizeof(buf_);
+            int const ret = ::inflate(&zs_, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+            {
+                throw std::runtime_error("gzip data corrupt");
+            }
+            std::size_t const n = sizeof(buf_) - zs_.avail_out;
+            md5_append(&md5_, reinterpret_cast<md5_byte_t const *>(buf_), n);
+            if (out != 0)
+            {
+                out->append(buf_, n);
+            }
+            produced += n;
+            done_ = (ret == Z_STREAM_END);
+        }
+        return produced;
+    }
+
+    bool done() const { return done_; }
+
+    std::string md5Hex()
+    {
+        md5_byte_t digest[16];
+        md5_finish(&md5_, digest);
+        return Downloader::md5Hex(digest);
+    }
+
+private:
+    z_stream zs_;
+    md5_state_t md5_;
+    bool done_;
+    char buf_[64*1024];
+};
+
+}
+
+std::string Downloader::PoolFile::md5Hex() const
+{
+    return Downloader::md5Hex(md5_);
+}
+
+Downloader::Downloader(std::string const & writeDir, std::string const & reposUrl, int connections):
+    writeDir_(writeDir),
+    reposUrl_(reposUrl),
+    connections_(std::max(1, connections)),
+    canceled_(false)
+{
+    if (!writeDir_.empty() && writeDir_.back() != '/')
+    {
+        writeDir_ += '/';
+    }
+    progress_.bytesDone_ = 0;
+    progress_.bytesTotal_ = 0;
+    progress_.filesDone_ = 0;
+    progress_.filesTotal_ = 0;
+}
+
+class Downloader::ActiveClient
+{
+public:
+    ActiveClient(Downloader & downloader, HttpClient & client):
+        downloader_(downloader),
+        client_(client)
+    {
+        std::lock_guard<std::mutex> lock(downloader_.clientsMutex_);
+        downloader_.clients_.push_back(&client_);
+        if (downloader_.canceled_)
+        {
+            client_.cancel();
+        }
+    }
+
+    ~ActiveClient()
+    {
+        std::lock_guard<std::mutex> lock(downloader_.clientsMutex_);
+        std::vector<HttpClient *> & clients = downloader_.clients_;
+        clients.erase(std::remove(clients.begin(), clients.end(), &client_), clients.end());
+    }
+
+private:
+    Downloader & downloader_;
+    HttpClient & client_;
+};
+
+void Downloader::cancel()
+{
+    canceled_ = true;
+    // a download waiting for a stalled server returns now instead of after the timeout
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    for (HttpClient * client : clients_)
+    {
+        client->cancel();
+    }
+}
+
+std::string Downloader::get(std::string const & url)
+{
+    HttpClient::Url const u = HttpClient::parseUrl(url);
+    HttpClient client(u.host_, u.port_);
+    ActiveClient active(*this, client);
+    std::string body;
+    int const status = client.get(u.path_, [&body](char const * data, std::size_t size) { body.append(data, size); return true; });
+    if (status != 200)
+    {
+        throw std::runtime_error("HTTP " + boost::lexical_cast<std::string>(status) + ": " + url);
+    }
+    return body;
+}
+
+std::string Downloader::error() const
+{
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    return error_;
+}
+
+void Downloader::start()
+{
+    canceled_ = false;
+    progress_.bytesDone_ = 0;
+    progress_.bytesTotal_ = 0;
+    progress_.filesDone_ = 0;
+    progress_.filesTotal_ = 0;
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    error_.clear();
+}
+
+void Downloader::setError(std::string const & error)
+{
+    LOG(WARNING) << "download failed: " << error;
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    error_ = error;
+}
+
+int Downloader::downloadRapid(std::string const & name)
+{
+    start();
+
+    try
+    {
+        std::vector<std::string> done;
+        downloadPackage(findVersion(name), done);
+        return 0;
+    }
+    catch (std::exception const & e)
+    {
+        setError(name + ": " + e.what());
+        return 1;
+    }
+}
+
+Downloader::Version Downloader::findVersion(std::string const & name)
+{
+    std::vector<std::string> const repos = parseRepos(gunzip(get(reposUrl_)));
+    for (std::string const & repo : repos)
+    {
+        if (canceled_)
+        {
+            throw std::runtime_error("canceled");
+        }
+
+        std::vector<Version> versions;
+        try
+        {
+            versions = parseVersions(gunzip(get(repo + "/versions.gz")), repo);
+        }
+        catch (std::exception const & e)
+        {
+            LOG(WARNING) << "skipping rapid repo " << repo << ": " << e.what(); // one broken mirror shouldn't stop the search
+            continue;
+        }
+
+        for (Version const & version : versions)
+        {
+            if (version.tag_ == name || version.name_ == name)
+            {
+                return version;
+            }
+        }
+    }
+    throw std::runtime_error("not found in rapid repos");
+}
+
+void Downloader::downloadPackage(Version const & version, std::vector<std::string> & done)
+{
+    if (std::find(done.begin(), done.end(), version.md5_) != done.end())
+    {
+        return;
+    }
+    done.push_back(version.md5_);
+
+    for (std::string const & depend : version.depends_)
+    {
+        downloadPackage(findVersion(depend), done);
+    }
+
+    LOG(INFO) << "rapid download " << version.name_ << " (" << version.tag_ << ") from " << version.repoUrl_;
+
+    std::string const sdpGz = get(version.repoUrl_ + "/packages/" + version.md5_ + ".sdp");
+    std::vector<PoolFile> const files = parseSdp(gunzip(sdpGz));
+    if (packageMd5(files) != version.md5_)
+    {
+        throw std::runtime_error("package file corrupt: " + version.md5_);
+    }
+
+    fetchPool(version.repoUrl_, files);
+
+    // package last, it makes the game visible to unitsync
+    std::string const packageDir = writeDir_ + "packages/";
+    boost::filesystem::create_directories(packageDir);
+    std::string const path = packageDir + version.md5_ + ".sdp";
+    {
+        std::ofstream ofs(path + ".tmp", std::ios::binary);
+        ofs.write(sdpGz.data(), sdpGz.size());
+        if (!ofs.good())
+        {
+            throw std::runtime_error("write failed: " + path);
+        }
+    }
+    boost::filesystem::rename(path + ".tmp", path);
+}
+
+void Downloader::fetchPool(std::string const & repoUrl, std::vector<PoolFile> const & files)
+{
+    // files with the same content share one pool file
+    std::vector<PoolFile> missing;
+    std::unordered_set<std::string> seen;
+    for (PoolFile const & file : files)
+    {
+        if (seen.insert(file.md5Hex()).second && !boost::filesystem::exists(poolPath(file)))
+        {
+            missing.push_back(file);
+        }
+    }
+
+    uint64_t bytes = 0;
+    for (PoolFile const & file : missing)
+    {
+        bytes += file.size_;
+    }
+    progress_.bytesTotal_ += bytes;
+    progress_.filesTotal_ += missing.size();
+    LOG(INFO) << "rapid pool: " << files.size() << " files, fetching " << missing.size() << " (" << (bytes >> 10) << " kB)";
+
+    HttpClient::Url const url = HttpClient::parseUrl(repoUrl + "/pool/");
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    auto const worker = [&]()
+    {
+        HttpClient client(url.host_, url.port_);
+        ActiveClient active(*this, client);
+        for (std::size_t i = next++; i < missing.size() && !failed && !canceled_; i = next++)
+        {
+            try
+            {
+                fetchPoolFile(client, url.path_, missing[i]);
+            }
+            catch (std::exception const & e)
+            {
+                setError(missing[i].name_ + ": " + e.what());
+                failed = true;
+            }
+        }
+    };
+
+    std::size_t const threadCount = std::min<std::size_t>(connections_, missing.size());
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    if (threadCount > 0)
+    {
+        worker(); // this thread is a worker too
+    }
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+
+    if (canceled_)
+    {
+        throw std::runtime_error("canceled");
+    }
+    if (failed)
+    {
+        throw std::runtime_error(error());
+    }
+}
+
+void Downloader::fetchPoolFile(HttpClient & client, std::string const & path, PoolFile const & file)
+{
+    static MetricsCounter & received = Metrics::counter("download.bytes_received");
+    static MetricsCounter & files = Metrics::counter("download.pool_files");
+
+    std::string const md5 = file.md5Hex();
+    std::string const target = poolPath(file);
+    std::string const tmp = target + ".tmp";
+    boost::filesystem::create_directories(boost::filesystem::path(target).parent_path());
+
+    // one retry, e.g. connection reset in the middle of a file
+    for (int attempt = 0; ; ++attempt)
+    {
+        uint64_t counted = 0;
+        try
+        {
+            GunzipMd5 gunzip;
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            int const status = client.get(path + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz",
+                [&](char const * data, std::size_t size)
+                {
+                    ofs.write(data, size);
+                    received.add(size);
+                    std::size_t const n = gunzip.add(data, size);
+                    counted += n;
+                    progress_.bytesDone_ += n;
+                    return !canceled_;
+                });
+            ofs.close();
+
+            if (canceled_)
+            {
+                throw std::runtime_error("canceled");
+            }
+            if (status != 200)
+            {
+                throw std::runtime_error("HTTP " + boost::lexical_cast<std::string>(status));
+            }
+            if (!ofs.good())
+            {
+                throw std::runtime_error("write failed: " + tmp);
+            }
+            if (!gunzip.done() || gunzip.md5Hex() != md5)
+            {
+                throw std::runtime_error("md5 mismatch");
+            }
+
+            boost::filesystem::rename(tmp, target);
+            ++progress_.filesDone_;
+            files.add();
+            return;
+        }
+        catch (std::exception const & e)
+        {
+            progress_.bytesDone_ -= counted;
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmp, ec);
+            if (attempt > 0 || canceled_)
+            {
+                throw;
+            }
+            LOG(DEBUG) << "retrying " << file.name_ << ": " << e.what();
+        }
+    }
+}
+
+std::string Downloader::md5Hex(unsigned char const * digest)
+{
+    char str[33];
+    for (int i = 0; i < 16; ++i)
+    {
+        std::snprintf(str + 2*i, 3, "%02x", digest[i]);
+    }
+    return std::string(str, 32);
+}
+
+std::string Downloader::poolPath(PoolFile const & file) const
+{
+    return poolPath(writeDir_, file);
+}
+
+std::string Downloader::poolPath(std::string const & dataDir, PoolFile const & file)
+{
+    std::string const md5 = file.md5Hex();
+    return dataDir + "pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz";
+}
+
+int Downloader::downloadHttp(std::string const & url, std::string const & path, std::string const & md5Hex)
+{
+    static MetricsCounter & received = Metrics::counter("download.bytes_received");
+
+    start();
+    progress_.filesTotal_ = 1;
+
+    std::string const tmp = path + ".tmp";
+    try
+    {
+        HttpClient::Url const u = HttpClient::parseUrl(url);
+        HttpClient client(u.host_, u.port_);
+        ActiveClient active(*this, client);
+        md5_state_t state;
+        md5_init(&state);
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        int const status = client.get(u.path_, [&](char const * data, std::size_t size)
+            {
+                ofs.write(data, size);
+                md5_append(&state, reinterpret_cast<md5_byte_t const *>(data), size);
+                progress_.bytesDone_ += size;
+                received.add(size);
+                return !canceled_;
+            });
+        ofs.close();
+
+        md5_byte_t digest[16];
+        md5_finish(&state, digest);
+        if (canceled_)
+        {
+            throw std::runtime_error("canceled");
+        }
+        if (status != 200)
+        {
+            throw std::runtime_error("HTTP " + boost::lexical_cast<std::string>(status));
+        }
+        if (!ofs.good())
+        {
+            throw std::runtime_error("write failed: " + tmp);
+        }
+        if (!md5Hex.empty() && !boost::iequals(Downloader::md5Hex(digest), md5Hex))
+        {
+            throw std::runtime_error("md5 mismatch");
+        }
+        boost::filesystem::rename(tmp, path);
+        progress_.filesDone_ = 1;
+        return 0;
+    }
+    catch (std::exception const & e)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmp, ec);
+        setError(url + ": " + e.what());
+        return 1;
+    }
+}
+
+std::string Downloader::gunzip(std::string const & data)
+{
+    GunzipMd5 gunzip;
+    std::string out;
+    gunzip.add(data.data(), data.size(), &out);
+    if (!gunzip.done())
+    {
+        throw std::runtime_error("gzip data truncated");
+    }
+    return out;
+}
+
+std::vector<std::string> Downloader::parseRepos(std::string const & data)
+{
+    // name,url,,
+    std::vector<std::string> repos;
+    std::istringstream iss(data);
+    std::string line;
+    while (std::getline(iss, line))
+    {
+        std::vector<std::string> fields;
+        boost::split(fields, line, boost::is_any_of(","));
+        if (fields.size() >= 2 && !fields[1].empty())
+        {
+            std::string url = boost::trim_copy(fields[1]);
+            if (url.back() == '/')
+            {
+                url.pop_back();
+            }
+            repos.push_back(url);
+        }
+    }
+    return repos;
+}
+
+std::vector<Downloader::Version> Downloader::parseVersions(std::string const & data, std::string const & repoUrl)
+{
+    // tag,md5,depends,name   depends is | separated
+    std::vector<Version> versions;
+    std::istringstream iss(data);
+    std::string line;
+    while (std::getline(iss, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        std::vector<std::string> fields;
+        boost::split(fields, line, boost::is_any_of(","));
+        if (fields.size() < 4 || fields[1].size() != 32)
+        {
+            continue;
+        }
+
+        Version version;
+        version.repoUrl_ = repoUrl;
+        version.tag_ = fields[0];
+        version.md5_ = fields[1];
+        if (!fields[2].empty())
+        {
+            boost::split(version.depends_, fields[2], boost::is_any_of("|"));
+        }
+        // name may contain commas
+        std::vector<std::string> const nameParts(fields.begin() + 3, fields.end());
+        version.name_ = boost::join(nameParts, ",");
+        versions.push_back(version);
+    }
+    return versions;
+}
+
+std::vector<Downloader::PoolFile> Downloader::parseSdp(std::string const & data)
+{
+    // per file: name length (1 byte), name, md5 (16), crc32 (4), size (4, big endian)
+    std::vector<PoolFile> files;
+    std::size_t pos = 0;
+    while (pos < data.size())
+    {
+        std::size_t const nameSize = static_cast<unsigned char>(data[pos]);
+        if (pos + 1 + nameSize + 24 > data.size())
+        {
+            throw std::runtime_error("package file truncated");
+        }
+        PoolFile file;
+        file.name_ = data.substr(pos + 1, nameSize);
+        pos += 1 + nameSize;
+        std::memcpy(file.md5_, data.data() + pos, 16);
+        unsigned char const * size = reinterpret_cast<unsigned char const *>(data.data() + pos + 20);
+        file.size_ = (static_cast<uint32_t>(size[0]) << 24) | (size[1] << 16) | (size[2] << 8) | size[3];
+        pos += 24;
+        files.push_back(file);
+    }
+    return files;
+}
+
+std::string Downloader::packageMd5(std::vector<PoolFile> const & files)
+{
+    md5_state_t state;
+    md5_init(&state);
+    for (PoolFile const & file : files)
+    {
+        md5_state_t nameState;
+        md5_init(&nameState);
+        md5_append(&nameState, reinterpret_cast<md5_byte_t const *>(file.name_.data()), file.name_.size());
+        md5_byte_t nameMd5[16];
+        md5_finish(&nameState, nameMd5);
+
+        md5_append(&state, nameMd5, 16);
+        md5_append(&state, file.md5_, 16);
+    }
+    md5_byte_t digest[16];
+    md5_finish(&state, digest);
+    return md5Hex(digest);
+}
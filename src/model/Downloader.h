@@ -0,0 +1,88 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class HttpClient;
+
+// in-process download of rapid packages (games) and plain http files
+// rapid pool files are fetched in parallel, each worker keeps one keep-alive connection,
+// md5 is checked while inflating and a file is renamed into the pool only when verified,
+// the package file is written last so a partial download is never seen by unitsync
+// download functions run in a worker thread, progress and cancel may be used from any thread
+class Downloader
+{
+public:
+    static char const * const defaultReposUrl;
+
+    struct Progress
+    {
+        std::atomic<uint64_t> bytesDone_; // uncompressed
+        std::atomic<uint64_t> bytesTotal_;
+        std::atomic<unsigned int> filesDone_;
+        std::atomic<unsigned int> filesTotal_;
+    };
+
+    explicit Downloader(std::string const & writeDir, std::string const & reposUrl = defaultReposUrl, int connections = 8);
+
+    // rapid tag (e.g. "ba:stable") or full name, dependencies are downloaded too, returns 0 on success
+    int downloadRapid(std::string const & name);
+    // file is written via temp file and rename, md5Hex is checked if not empty, returns 0 on success
+    int downloadHttp(std::string const & url, std::string const & path, std::string const & md5Hex = "");
+
+    void cancel(); // running download returns non-zero, its connections are closed
+    Progress const & progress() const { return progress_; }
+    std::string error() const; // why last download failed
+
+    // rapid file formats, public for tests
+    struct Version
+    {
+        std::string repoUrl_;
+        std::string tag_;
+        std::string md5_; // hex, names package file
+        std::vector<std::string> depends_; // names
+        std::string name_;
+    };
+    struct PoolFile
+    {
+        std::string name_;
+        unsigned char md5_[16];
+        uint32_t size_;
+        std::string md5Hex() const;
+    };
+
+    static std::string gunzip(std::string const & data); // throws std::runtime_error
+    static std::vector<std::string> parseRepos(std::string const & data); // repo urls from uncompressed repos.gz
+    static std::vector<Version> parseVersions(std::string const & data, std::string const & repoUrl); // uncompressed versions.gz
+    static std::vector<PoolFile> parseSdp(std::string const & data); // uncompressed package file, throws std::runtime_error
+    static std::string packageMd5(std::vector<PoolFile> const & files); // hex md5 over md5(name) and md5(content) of each file
+    static std::string poolPath(std::string const & dataDir, PoolFile const & file); // dataDir ends with /
+    static std::string md5Hex(unsigned char const * digest); // 16 byte digest as lower case hex
+
+private:
+    std::string writeDir_;
+    std::string reposUrl_;
+    int connections_;
+    Progress progress_;
+    std::atomic<bool> canceled_;
+    mutable std::mutex errorMutex_;
+    std::string error_;
+    std::mutex clientsMutex_;
+    std::vector<HttpClient *> clients_; // of the running download, canceled by cancel
+
+    class ActiveClient; // client is in clients_ while it exists
+    std::string get(std::string const & url); // whole body, throws if status is not 200
+
+    void start(); // resets progress, error and cancel
+    void setError(std::string const & error);
+    Version findVersion(std::string const & name);
+    void downloadPackage(Version const & version, std::vector<std::string> & done);
+    void fetchPool(std::string const & repoUrl, std::vector<PoolFile> const & files);
+    void fetchPoolFile(HttpClient & client, std::string const & path, PoolFile const & file);
+    std::string poolPath(PoolFile const & file) const;
+};
@@ -0,0 +1,115 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "HostMessage.h"
+
+namespace
+{
+
+enum TextPart
+{
+    TP_MESSAGE, // whole message
+    TP_FIELDS, // from start of first field to end of message
+};
+
+// pattern is literal text with '*' fields, a field ends at the first occurrence of the literal text following it
+// (shortest match), a field at the end of the pattern takes the rest of the message
+struct Entry
+{
+    char const * dialect_;
+    HostMessage::Type type_;
+    TextPart textPart_;
+    char const * pattern_;
+};
+
+// add new autohost dialects here, more specific patterns before more general ones
+Entry const table[] =
+{
+    { "Springie", HostMessage::HM_VOTE_END, TP_FIELDS, "Poll: *[END:*" },
+    { "Springie", HostMessage::HM_VOTE_START, TP_FIELDS, "Poll: *" },
+    { "SPADS", HostMessage::HM_VOTE_START, TP_MESSAGE, "*called a vote for command*" },
+    { "SPADS", HostMessage::HM_VOTE_START, TP_MESSAGE, "*Vote in progress:*" },
+    { "SPADS", HostMessage::HM_VOTE_END, TP_MESSAGE, "*Vote for command*" },
+    { "SPADS", HostMessage::HM_VOTE_END, TP_MESSAGE, "*Vote cancelled*" },
+    { "Nightwatch", HostMessage::HM_NIGHTWATCH_PM, TP_FIELDS, "!pm|*|*|*|*" },
+};
+
+bool match(Entry const & entry, boost::string_ref msg, HostMessage & result)
+{
+    char const * p = entry.pattern_;
+    std::size_t pos = 0;
+    result.fieldCount_ = 0;
+
+    while (*p != '\0')
+    {
+        if (*p == '*')
+        {
+            ++p;
+            // literal text up to next field or end of pattern
+            char const * literalEnd = p;
+            while (*literalEnd != '\0' && *literalEnd != '*') ++literalEnd;
+            boost::string_ref const literal(p, literalEnd - p);
+
+            std::size_t end;
+            if (literal.empty())
+            {
+                end = msg.size(); // last field takes the rest
+            }
+            else
+            {
+                end = msg.substr(pos).find(literal);
+                if (end == boost::string_ref::npos)
+                {
+                    return false;
+                }
+                end += pos;
+            }
+
+            if (result.fieldCount_ < HostMessage::maxFields)
+            {
+                result.fields_[result.fieldCount_++] = msg.substr(pos, end - pos);
+            }
+            pos = end + literal.size();
+            p = literalEnd;
+        }
+        else
+        {
+            if (pos >= msg.size() || msg[pos] != *p)
+            {
+                return false;
+            }
+            ++pos;
+            ++p;
+        }
+    }
+
+    if (pos != msg.size())
+    {
+        return false;
+    }
+
+    result.type_ = entry.type_;
+    result.dialect_ = entry.dialect_;
+    result.text_ = (entry.textPart_ == TP_FIELDS && result.fieldCount_ > 0) ?
+        msg.substr(result.fields_[0].data() - msg.data()) : msg;
+    return true;
+}
+
+}
+
+HostMessage recognizeHostMessage(boost::string_ref msg)
+{
+    HostMessage result;
+    for (Entry const & entry : table)
+    {
+        // cheap reject on first character of patterns starting with literal text
+        if (entry.pattern_[0] != '*' && (msg.empty() || msg[0] != entry.pattern_[0]))
+        {
+            continue;
+        }
+        if (match(entry, msg, result))
+        {
+            return result;
+        }
+    }
+    return HostMessage();
+}
@@ -0,0 +1,31 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+
+// autohost message recognized by recognizeHostMessage
+// fields and text refer into the recognized message, nothing is allocated
+struct HostMessage
+{
+    enum Type
+    {
+        HM_NONE,
+        HM_VOTE_START, // vote started or in progress
+        HM_VOTE_END,
+        HM_NIGHTWATCH_PM, // fields are channel (empty for private), user, time, text
+    };
+    static std::size_t const maxFields = 4;
+
+    HostMessage(): type_(HM_NONE), dialect_(""), fieldCount_(0) {}
+
+    Type type_;
+    char const * dialect_; // e.g. "SPADS"
+    boost::string_ref text_; // part of message to show
+    boost::string_ref fields_[maxFields];
+    std::size_t fieldCount_;
+};
+
+// matches msg against a static table of autohost patterns, first matching entry wins
+HostMessage recognizeHostMessage(boost::string_ref msg);
@@ -0,0 +1,414 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "HttpClient.h"
+#include "log/Log.h"
+
+#include <boost/asio.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <functional>
+#include <stdexcept>
+#include <sstream>
+
+using boost::asio::ip::tcp;
+
+int const HttpClient::timeout;
+int const HttpClient::maxRedirects;
+
+struct HttpClient::Connection
+{
+    Connection(): socket_(ioService_), timer_(ioService_) {}
+
+    boost::asio::io_service ioService_;
+    tcp::socket socket_;
+    boost::asio::deadline_timer timer_;
+    boost::asio::streambuf buf_; // received but not yet consumed
+
+    typedef std::function<void (boost::system::error_code const &, std::size_t)> Handler;
+
+    // runs the asynchronous operation started by start until it completes,
+    // the socket is closed if it takes longer than timeout or the client is canceled meanwhile
+    std::size_t run(std::function<void (Handler)> const & start, boost::system::error_code & ec)
+    {
+        ec = boost::asio::error::would_block;
+        std::size_t n = 0;
+        bool timedOut = false;
+        start([&ec, &n](boost::system::error_code const & e, std::size_t bytes) { ec = e; n = bytes; });
+        timer_.expires_from_now(boost::posix_time::seconds(timeout));
+        timer_.async_wait([this, &timedOut](boost::system::error_code const & e)
+            {
+                if (!e)
+                {
+                    timedOut = true;
+                    close();
+                }
+            });
+
+        while (ec == boost::asio::error::would_block && ioService_.run_one()) {}
+        timer_.cancel();
+        ioService_.run(); // canceled timer handler, it references timedOut
+        ioService_.reset();
+
+        if (timedOut)
+        {
+            ec = boost::asio::error::timed_out;
+        }
+        return n;
+    }
+
+    std::size_t run(std::function<void (Handler)> const & start)
+    {
+        boost::system::error_code ec;
+        std::size_t const n = run(start, ec);
+        if (ec)
+        {
+            throw boost::system::system_error(ec);
+        }
+        return n;
+    }
+
+    void close()
+    {
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+    }
+
+    void connect(std::string const & host, std::string const & port)
+    {
+        tcp::resolver resolver(ioService_);
+        tcp::resolver::iterator const endpoints = resolver.resolve(tcp::resolver::query(host, port));
+        run([this, endpoints](Handler h)
+            {
+                boost::asio::async_connect(socket_, endpoints,
+                    [h](boost::system::error_code const & e, tcp::resolver::iterator) { h(e, 0); });
+            });
+    }
+
+    void write(std::string const & data)
+    {
+        run([this, &data](Handler h) { boost::asio::async_write(socket_, boost::asio::buffer(data), h); });
+    }
+
+    // reads at least one more byte into buf_, ec is eof at end
+    void fill(boost::system::error_code & ec)
+    {
+        boost::asio::streambuf::mutable_buffers_type const space = buf_.prepare(64*1024);
+        std::size_t const n = run([this, &space](Handler h) { socket_.async_read_some(space, h); }, ec);
+        buf_.commit(n);
+    }
+
+    // reads at least one more byte into buf_, throws on error or EOF
+    void fill()
+    {
+        boost::system::error_code ec;
+        fill(ec);
+        if (ec)
+        {
+            throw boost::system::system_error(ec);
+        }
+    }
+
+    std::string readLine() // without CRLF
+    {
+        run([this](Handler h) { boost::asio::async_read_until(socket_, buf_, "\r\n", h); });
+        std::istream is(&buf_);
+        std::string line;
+        std::getline(is, line);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        return line;
+    }
+
+    // passes size bytes to sink, returns false if sink aborted
+    bool readBody(uint64_t size, BodySink const & sink)
+    {
+        while (size > 0)
+        {
+            if (buf_.size() == 0)
+            {
+                fill();
+            }
+            std::size_t const n = std::min<uint64_t>(size, buf_.size());
+            char const * data = boost::asio::buffer_cast<char const *>(buf_.data());
+            if (sink && !sink(data, n))
+            {
+                return false;
+            }
+            buf_.consume(n);
+            size -= n;
+        }
+        return true;
+    }
+
+    // until server closes connection
+    bool readToEof(BodySink const & sink)
+    {
+        boost::system::error_code ec;
+        for (;;)
+        {
+            if (buf_.size() > 0)
+            {
+                char const * data = boost::asio::buffer_cast<char const *>(buf_.data());
+                if (sink && !sink(data, buf_.size()))
+                {
+                    return false;
+                }
+                buf_.consume(buf_.size());
+            }
+            fill(ec);
+            if (ec == boost::asio::error::eof)
+            {
+                return true;
+            }
+            if (ec)
+            {
+                throw boost::system::system_error(ec);
+            }
+        }
+    }
+};
+
+HttpClient::Url HttpClient::parseUrl(std::string const & url)
+{
+    std::string const scheme = "http://";
+    if (!boost::istarts_with(url, scheme))
+    {
+        throw std::invalid_argument("only http urls supported: " + url);
+    }
+
+    Url result;
+    std::string::size_type const hostStart = scheme.size();
+    std::string::size_type const pathStart = url.find('/', hostStart);
+    std::string const hostPort = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+    result.path_ = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    std::string::size_type const colon = hostPort.find(':');
+    result.host_ = hostPort.substr(0, colon);
+    result.port_ = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+    if (result.host_.empty())
+    {
+        throw std::invalid_argument("no host in url: " + url);
+    }
+    boost::replace_all(result.path_, " ", "%20");
+    return result;
+}
+
+HttpClient::HttpClient(std::string const & host, std::string const & port):
+    host_(host),
+    port_(port),
+    connects_(0),
+    canceled_(false)
+{
+}
+
+HttpClient::~HttpClient()
+{
+}
+
+void HttpClient::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    canceled_ = true;
+    // socket is closed in the get thread which runs the io service
+    for (Connection * conn : { conn_.get(), redirectConn_.get() })
+    {
+        if (conn)
+        {
+            conn->ioService_.post([conn]() { conn->close(); });
+        }
+    }
+}
+
+void HttpClient::connect(std::unique_ptr<Connection> & conn, std::string const & host, std::string const & port)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (canceled_)
+        {
+            throw std::runtime_error(host + ": canceled");
+        }
+        conn.reset(new Connection());
+    }
+    conn->connect(host, port);
+    ++connects_;
+}
+
+void HttpClient::close(std::unique_ptr<Connection> & conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    conn.reset();
+}
+
+int HttpClient::get(std::string const & path, BodySink sink)
+{
+    std::string host = host_;
+    std::string port = port_;
+    std::string target = path;
+    for (int redirects = 0; ; ++redirects)
+    {
+        bool const sameHost = (host == host_ && port == port_);
+        std::string location;
+        int const status = get(sameHost ? conn_ : redirectConn_, host, port, target, sink, location);
+        if (location.empty())
+        {
+            return status;
+        }
+        if (redirects == maxRedirects)
+        {
+            throw std::runtime_error(host_ + path + ": too many redirects");
+        }
+
+        LOG(DEBUG) << "HTTP " << status << " redirect to " << location;
+        if (boost::starts_with(location, "/"))
+        {
+            target = location;
+        }
+        else
+        {
+            Url const u = parseUrl(location); // https is not supported
+            if (u.host_ != host || u.port_ != port)
+            {
+                close(redirectConn_);
+            }
+            host = u.host_;
+            port = u.port_;
+            target = u.path_;
+        }
+    }
+}
+
+int HttpClient::get(std::unique_ptr<Connection> & conn, std::string const & host, std::string const & port,
+                    std::string const & path, BodySink const & sink, std::string & location)
+{
+    bool const reused = conn && conn->socket_.is_open();
+    bool received = false;
+    BodySink receivingSink = [&sink, &received](char const * data, std::size_t size)
+    {
+        received = true;
+        return sink(data, size);
+    };
+
+    try
+    {
+        if (!reused)
+        {
+            connect(conn, host, port);
+        }
+        return request(*conn, host, path, sink ? receivingSink : sink, location);
+    }
+    catch (boost::system::system_error const & e)
+    {
+        close(conn);
+        if (!reused || received || canceled_)
+        {
+            throw std::runtime_error(host + ": " + (canceled_ ? "canceled" : e.what()));
+        }
+    }
+
+    // server closed idle keep-alive connection, nothing was passed to sink yet
+    try
+    {
+        connect(conn, host, port);
+        return request(*conn, host, path, sink, location);
+    }
+    catch (boost::system::system_error const & e)
+    {
+        close(conn);
+        throw std::runtime_error(host + ": " + (canceled_ ? "canceled" : e.what()));
+    }
+}
+
+int HttpClient::request(Connection & conn, std::string const & host, std::string const & path, BodySink const & sink, std::string & location)
+{
+    std::ostringstream oss;
+    oss << "GET " << path << " HTTP/1.1\r\n"
+        << "Host: " << host << "\r\n"
+        << "User-Agent: flobby\r\n"
+        << "Accept-Encoding: identity\r\n"
+        << "Connection: keep-alive\r\n\r\n";
+    conn.write(oss.str());
+
+    // HTTP/1.1 200 OK
+    std::string const statusLine = conn.readLine();
+    std::vector<std::string> parts;
+    boost::split(parts, statusLine, boost::is_any_of(" "));
+    if (parts.size() < 2 || !boost::starts_with(parts[0], "HTTP/"))
+    {
+        conn.close();
+        throw std::runtime_error(host + ": bad status line: " + statusLine);
+    }
+    int const status = boost::lexical_cast<int>(parts[1]);
+    bool const redirect = (status == 301 || status == 302 || status == 303 || status == 307 || status == 308);
+
+    bool hasLength = false;
+    uint64_t length = 0;
+    bool chunked = false;
+    bool close = (parts[0] == "HTTP/1.0");
+    location.clear();
+    for (std::string line = conn.readLine(); !line.empty(); line = conn.readLine())
+    {
+        std::string::size_type const colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+        std::string const name = boost::to_lower_copy(line.substr(0, colon));
+        std::string const value = boost::trim_copy(line.substr(colon + 1));
+        if (name == "content-length")
+        {
+            hasLength = true;
+            length = boost::lexical_cast<uint64_t>(value);
+        }
+        else if (name == "transfer-encoding")
+        {
+            chunked = boost::icontains(value, "chunked");
+        }
+        else if (name == "connection")
+        {
+            close = boost::iequals(value, "close");
+        }
+        else if (name == "location" && redirect)
+        {
+            location = value;
+        }
+    }
+
+    BodySink noSink;
+    BodySink const & bodySink = (status == 200) ? sink : noSink; // error bodies are skipped to keep the connection usable
+    bool complete = true;
+    if (chunked)
+    {
+        for (;;)
+        {
+            uint64_t const chunkSize = std::stoull(conn.readLine(), 0, 16);
+            if (chunkSize == 0)
+            {
+                while (!conn.readLine().empty()) {} // trailers
+                break;
+            }
+            if (!conn.readBody(chunkSize, bodySink))
+            {
+                complete = false;
+                break;
+            }
+            conn.readLine();
+        }
+    }
+    else if (hasLength)
+    {
+        complete = conn.readBody(length, bodySink);
+    }
+    else
+    {
+        complete = conn.readToEof(bodySink);
+        close = true;
+    }
+
+    if (close || !complete)
+    {
+        conn.close(); // reopened by next get
+    }
+    return status;
+}
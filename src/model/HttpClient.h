@@ -0,0 +1,59 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// blocking HTTP/1.1 client, the connection is kept open between requests to the same host
+// only plain http, one instance must only be used by one thread at a time except cancel
+// each connect, send and receive is given up after timeout seconds without progress
+class HttpClient
+{
+public:
+    static int const timeout = 30; // seconds
+    static int const maxRedirects = 5;
+
+    struct Url
+    {
+        std::string host_;
+        std::string port_;
+        std::string path_; // with query, starts with /
+    };
+    static Url parseUrl(std::string const & url); // throws std::invalid_argument if not http://
+
+    // called with each piece of the body as received, return false to abort the transfer
+    typedef std::function<bool (char const * data, std::size_t size)> BodySink;
+
+    HttpClient(std::string const & host, std::string const & port);
+    ~HttpClient();
+
+    // returns HTTP status, body is only passed to sink for status 200, redirects to http urls are followed
+    // throws std::runtime_error on connection errors and timeout, an idle connection closed by the server is reopened once
+    int get(std::string const & path, BodySink sink);
+
+    // closes the connection from any thread, a running and all later get throw
+    void cancel();
+
+    unsigned int connects() const { return connects_; } // connections opened so far
+
+private:
+    struct Connection;
+    std::mutex mutex_; // for conn_ and redirectConn_ with cancel, they are only used by the get thread
+    std::unique_ptr<Connection> conn_;
+    std::unique_ptr<Connection> redirectConn_; // to another host than host_
+    std::string host_;
+    std::string port_;
+    unsigned int connects_;
+    std::atomic<bool> canceled_;
+
+    // location is set if status is a redirect
+    int get(std::unique_ptr<Connection> & conn, std::string const & host, std::string const & port,
+            std::string const & path, BodySink const & sink, std::string & location);
+    void connect(std::unique_ptr<Connection> & conn, std::string const & host, std::string const & port);
+    void close(std::unique_ptr<Connection> & conn);
+    int request(Connection & conn, std::string const & host, std::string const & path, BodySink const & sink, std::string & location);
+};
@@ -7,6 +7,14 @@
 
 class IControllerEvent;
 
+// thread pool lanes, each lane has its own threads so engine processes never delay downloads
+enum JobLane
+{
+    JL_DEFAULT,
+    JL_ENGINE,
+    JL_PREFETCH // archive readahead, blocks on disk so it gets a single thread of its own
+};
+
 class IController
 {
 public:
@@ -17,7 +25,14 @@ public:
     virtual uint64_t lastSendTime() const = 0; // milliseconds since start
     virtual uint64_t timeNow() const = 0; // milliseconds since start
 
-    virtual unsigned int startThread(boost::function<int()> function) = 0;
+    // runs function in a pooled thread, IControllerEvent::processDone is called with returned id and function result
+    // jobs with higher priority start first within a lane
+    virtual unsigned int startThread(boost::function<int()> function, JobLane lane = JL_DEFAULT, int priority = 0) = 0;
+    // removes a queued job (processDone is called with -1), returns false if job is unknown
+    virtual bool cancelThread(unsigned int id) = 0;
+
+    // calls function once from the event loop thread (FLTK or headless) after seconds
+    virtual void startTimer(double seconds, boost::function<void()> function) = 0;
 
 protected:
     ~IController() {}
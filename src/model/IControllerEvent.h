@@ -9,6 +9,7 @@ class IControllerEvent
 public:
     virtual void connected(bool connected) = 0;
     virtual void message(std::string const & msg) = 0;
+    virtual void messageBatchDone() = 0; // called after all queued messages have been passed to message()
     virtual void processDone(std::pair<unsigned int, int> idRetPair) = 0;
 
 protected:
@@ -0,0 +1,348 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "MapAnalysis.h"
+#include "StartRect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+std::string const MapAnalysis::version_ = "MapAnalysis_1";
+
+namespace
+{
+
+int findRoot(std::vector<int> & parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]]; // path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+void unite(std::vector<int> & parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) parent[b] = a;
+    else if (b < a) parent[a] = b;
+}
+
+}
+
+MapAnalysis::MapAnalysis():
+    meanSlope_(0),
+    maxSlope_(0),
+    flatFraction_(0)
+{
+}
+
+void MapAnalysis::analyze(uint8_t const* metal, int metalW, int metalH, uint8_t const* height, int heightW, int heightH)
+{
+    spots_.clear();
+    slopeGrid_.clear();
+    meanSlope_ = 0;
+    maxSlope_ = 0;
+    flatFraction_ = 0;
+
+    if (metal && metalW > 0 && metalH > 0)
+    {
+        findSpots(metal, metalW, metalH);
+    }
+    if (height && heightW > 1 && heightH > 1)
+    {
+        calcSlopes(height, heightW, heightH);
+    }
+}
+
+void MapAnalysis::findSpots(uint8_t const* metal, int w, int h)
+{
+    // first pass, provisional labels (0 is background) and label equivalences
+    std::vector<int> labels(w*h, 0);
+    std::vector<int> parent(1, 0);
+
+    for (int y=0; y<h; ++y)
+    {
+        uint8_t const* row = metal + y*w;
+        int* rowLabels = labels.data() + y*w;
+        int const* upLabels = (y > 0) ? rowLabels - w : nullptr;
+
+        for (int x=0; x<w; ++x)
+        {
+            if (row[x] == 0) continue;
+
+            int neighbours[4] = { 0, 0, 0, 0 };
+            if (x > 0) neighbours[0] = rowLabels[x-1];
+            if (y > 0)
+            {
+                if (x > 0) neighbours[1] = upLabels[x-1];
+                neighbours[2] = upLabels[x];
+                if (x < w-1) neighbours[3] = upLabels[x+1];
+            }
+
+            int label = 0;
+            for (int n : neighbours)
+            {
+                if (n == 0) continue;
+                if (label == 0)
+                {
+                    label = n;
+                }
+                else if (n != label)
+                {
+                    unite(parent, label, n);
+                }
+            }
+
+            if (label == 0)
+            {
+                label = parent.size();
+                parent.push_back(label);
+            }
+            rowLabels[x] = label;
+        }
+    }
+
+    // second pass, accumulate per component
+    struct Acc
+    {
+        double x;
+        double y;
+        int cells;
+        unsigned int value;
+    };
+    std::vector<int> spotIndex(parent.size(), -1);
+    std::vector<Acc> accs;
+
+    for (int y=0; y<h; ++y)
+    {
+        for (int x=0; x<w; ++x)
+        {
+            int const i = y*w + x;
+            if (labels[i] == 0) continue;
+
+            int const root = findRoot(parent, labels[i]);
+            if (spotIndex[root] == -1)
+            {
+                spotIndex[root] = accs.size();
+                accs.push_back(Acc{0, 0, 0, 0});
+            }
+            Acc & acc = accs[spotIndex[root]];
+            unsigned int const v = metal[i];
+            acc.x += (x + 0.5)*v;
+            acc.y += (y + 0.5)*v;
+            acc.cells += 1;
+            acc.value += v;
+        }
+    }
+
+    spots_.reserve(accs.size());
+    for (Acc const & acc : accs)
+    {
+        MetalSpot spot;
+        spot.x_ = acc.x/acc.value/w;
+        spot.y_ = acc.y/acc.value/h;
+        spot.cells_ = acc.cells;
+        spot.value_ = acc.value;
+        spots_.push_back(spot);
+    }
+}
+
+void MapAnalysis::calcSlopes(uint8_t const* height, int w, int h)
+{
+    int const G = slopeGridSize_;
+    int const sw = w - 1; // slope is calculated with forward differences
+    int const sh = h - 1;
+
+    std::vector<int> gridX(sw);
+    for (int x=0; x<sw; ++x)
+    {
+        gridX[x] = x*G/sw;
+    }
+
+    std::vector<double> gridSum(G*G, 0);
+    std::vector<int> gridCount(G*G, 0);
+    std::vector<float> slopes(sw);
+
+    double sum = 0;
+    float maxSlope = 0;
+    int flat = 0;
+
+    for (int y=0; y<sh; ++y)
+    {
+        uint8_t const* r0 = height + y*w;
+        uint8_t const* r1 = r0 + w;
+
+        // kept free of branches so it can be vectorized
+        float* __restrict s = slopes.data();
+        for (int x=0; x<sw; ++x)
+        {
+            float const dx = static_cast<float>(r0[x+1]) - r0[x];
+            float const dy = static_cast<float>(r1[x]) - r0[x];
+            s[x] = std::sqrt(dx*dx + dy*dy);
+        }
+
+        int const gy = y*G/sh;
+        for (int x=0; x<sw; ++x)
+        {
+            float const slope = s[x];
+            sum += slope;
+            maxSlope = std::max(maxSlope, slope);
+            flat += (slope < 1.0f);
+            gridSum[gy*G + gridX[x]] += slope;
+            gridCount[gy*G + gridX[x]] += 1;
+        }
+    }
+
+    int const cells = sw*sh;
+    meanSlope_ = sum/cells;
+    maxSlope_ = maxSlope;
+    flatFraction_ = static_cast<float>(flat)/cells;
+
+    slopeGrid_.resize(G*G);
+    for (int i=0; i<G*G; ++i)
+    {
+        slopeGrid_[i] = gridCount[i] ? gridSum[i]/gridCount[i] : -1; // -1 if height map is smaller than grid
+    }
+}
+
+unsigned int MapAnalysis::metalValue() const
+{
+    unsigned int value = 0;
+    for (MetalSpot const & spot : spots_)
+    {
+        value += spot.value_;
+    }
+    return value;
+}
+
+MapAnalysis::BoxSummary MapAnalysis::boxSummary(StartRect const& rect) const
+{
+    BoxSummary summary = { 0, 0, 0 };
+
+    for (MetalSpot const & spot : spots_)
+    {
+        if (spot.x_ >= rect.left() && spot.x_ < rect.right() &&
+            spot.y_ >= rect.top() && spot.y_ < rect.bottom())
+        {
+            summary.spots_ += 1;
+            summary.value_ += spot.value_;
+        }
+    }
+
+    if (!slopeGrid_.empty())
+    {
+        // mean of grid cells with center inside box, use the cell at box center if box is smaller than a cell
+        int const G = slopeGridSize_;
+        double sum = 0;
+        int count = 0;
+        for (int gy=0; gy<G; ++gy)
+        {
+            float const cy = (gy + 0.5f)/G;
+            if (cy < rect.top() || cy >= rect.bottom()) continue;
+            for (int gx=0; gx<G; ++gx)
+            {
+                float const cx = (gx + 0.5f)/G;
+                if (cx < rect.left() || cx >= rect.right() || slopeGrid_[gy*G + gx] < 0) continue;
+                sum += slopeGrid_[gy*G + gx];
+                ++count;
+            }
+        }
+        if (count > 0)
+        {
+            summary.meanSlope_ = sum/count;
+        }
+        else
+        {
+            int const gx = std::min(G-1, static_cast<int>((rect.left() + rect.right())/2*G));
+            int const gy = std::min(G-1, static_cast<int>((rect.top() + rect.bottom())/2*G));
+            summary.meanSlope_ = std::max(0.0f, slopeGrid_[gy*G + gx]);
+        }
+    }
+
+    return summary;
+}
+
+std::string MapAnalysis::summary() const
+{
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "Metal: " << spots_.size() << " spots (" << metalUnits(metalValue()) << ")";
+    if (!slopeGrid_.empty())
+    {
+        oss << ", mean slope " << meanSlope_
+            << ", flat " << std::setprecision(0) << flatFraction_*100 << "%";
+    }
+    return oss.str();
+}
+
+void MapAnalysis::serialize(std::ostream & os) const
+{
+    os << version_ << '\0'
+       << meanSlope_ << std::endl
+       << maxSlope_ << std::endl
+       << flatFraction_ << std::endl
+       << spots_.size() << std::endl;
+    for (MetalSpot const & spot : spots_)
+    {
+        os << spot.x_ << ' ' << spot.y_ << ' ' << spot.cells_ << ' ' << spot.value_ << std::endl;
+    }
+    os << slopeGrid_.size() << std::endl;
+    for (float slope : slopeGrid_)
+    {
+        os << slope << std::endl;
+    }
+}
+
+void MapAnalysis::unserialize(std::istream & is)
+{
+    is.exceptions(std::ios::failbit); // make istream throw on failure
+
+    std::string version;
+    std::getline(is, version, '\0');
+
+    if (version != version_)
+    {
+        throw std::runtime_error("incompatible version: " + version + "!=" + version_);
+    }
+
+    is >> meanSlope_;
+    is >> maxSlope_;
+    is >> flatFraction_;
+
+    std::size_t size;
+    is >> size;
+    spots_.resize(size);
+    for (MetalSpot & spot : spots_)
+    {
+        is >> spot.x_ >> spot.y_ >> spot.cells_ >> spot.value_;
+    }
+
+    is >> size;
+    if (size != 0 && size != static_cast<std::size_t>(slopeGridSize_*slopeGridSize_))
+    {
+        throw std::runtime_error("bad slope grid size");
+    }
+    slopeGrid_.resize(size);
+    for (float & slope : slopeGrid_)
+    {
+        is >> slope;
+    }
+}
+
+std::ostream& operator<<(std::ostream & os, MapAnalysis const & mapAnalysis)
+{
+    mapAnalysis.serialize(os);
+    return os;
+}
+
+std::istream& operator>>(std::istream & is, MapAnalysis & mapAnalysis)
+{
+    mapAnalysis.unserialize(is);
+    return is;
+}
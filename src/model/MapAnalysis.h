@@ -0,0 +1,66 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+class StartRect;
+
+// metal spots and terrain slope of a map, calculated from the info maps returned by Model::getMetalMap and Model::getHeightMap
+class MapAnalysis
+{
+public:
+    MapAnalysis();
+
+    struct MetalSpot
+    {
+        float x_; // value weighted centroid, 0-1
+        float y_;
+        int cells_; // metal map cells in spot
+        unsigned int value_; // sum of metal map values in spot
+    };
+
+    struct BoxSummary
+    {
+        int spots_; // spots with centroid inside box
+        unsigned int value_;
+        float meanSlope_;
+    };
+
+    // metal spots are 8-connected non-zero cells
+    // slopes are in height map steps per height map cell, unitsync scales the 1 byte height map between min and max height
+    void analyze(uint8_t const* metal, int metalW, int metalH, uint8_t const* height, int heightW, int heightH);
+
+    std::vector<MetalSpot> const& spots() const { return spots_; }
+    unsigned int metalValue() const; // sum of all spot values
+    float meanSlope() const { return meanSlope_; }
+    float maxSlope() const { return maxSlope_; }
+    float flatFraction() const { return flatFraction_; } // part of map with slope below 1
+
+    BoxSummary boxSummary(StartRect const& rect) const;
+    std::string summary() const; // one line text, e.g. "Metal: 12 spots (20.5), mean slope 1.2, flat 60%"
+
+    static float metalUnits(unsigned int value) { return value/255.0f; } // value as number of full metal cells
+
+    void serialize(std::ostream & os) const;
+    void unserialize(std::istream & is); // throws on error
+
+private:
+    static int const slopeGridSize_ = 32; // slope grid is used for box summaries
+    static std::string const version_; // used for compatibility check in unserialize
+
+    std::vector<MetalSpot> spots_;
+    float meanSlope_;
+    float maxSlope_;
+    float flatFraction_;
+    std::vector<float> slopeGrid_; // slopeGridSize_ x slopeGridSize_ mean slopes, empty if no height map
+
+    void findSpots(uint8_t const* metal, int w, int h);
+    void calcSlopes(uint8_t const* height, int w, int h);
+};
+
+std::ostream& operator<<(std::ostream & os, MapAnalysis const & mapAnalysis);
+std::istream& operator>>(std::istream & is, MapAnalysis & mapAnalysis);
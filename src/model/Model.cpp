@@ -11,51 +11,120 @@
 #include "UserId.h"
 #include "ServerCommands.h"
 #include "Nightwatch.h"
+#include "Process.h"
+#include "Downloader.h"
 
 #include "md5/md5.h"
 #include "md5/base64.h"
 
 #include "log/Log.h"
+#include "log/Metrics.h"
+#include "log/Trace.h"
+#include "log/Watchdog.h"
 #include "FlobbyDirs.h"
 #include "FlobbyConfig.h"
 
-// TODO #include <pr-downloader.h>
 #include <json/json.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <cassert>
 
 #define ADD_MSG_HANDLER(MSG) \
-    messageHandlers_[#MSG] = std::bind(&Model::handle_##MSG, this, std::placeholders::_1);
+    messageHandlers_[#MSG] = { std::bind(&Model::handle_##MSG, this, std::placeholders::_1), &Metrics::counter("server.msg." #MSG), #MSG };
 #define ADD_MSG_HANDLER2(MSG, METHOD) \
-    messageHandlers_[#MSG] = std::bind(&Model::handle_##METHOD, this, std::placeholders::_1);
+    messageHandlers_[#MSG] = { std::bind(&Model::handle_##METHOD, this, std::placeholders::_1), &Metrics::counter("server.msg." #MSG), #MSG };
 
 #define ADD_ZK_MSG_HANDLER(MSG) \
-    messageHandlersZerok_[#MSG] = std::bind(&Model::handle_##MSG, this, std::placeholders::_1);
+    messageHandlersZerok_[#MSG] = { std::bind(&Model::handle_##MSG, this, std::placeholders::_1), &Metrics::counter("server.msg." #MSG), #MSG };
 
 Model::Model(IController & controller, bool zerok):
     controller_(controller),
     zerok_(zerok),
     connected_(false),
     checkFirstMsg_(false),
+    loginInProgress_(false),
     loggedIn_(false),
     timePingSent_(0),
     waitingForPong_(0),
+    modChecksums_([this](std::string const & name) { return unitSync_ ? unitSync_->GetPrimaryModChecksumFromName(name.c_str()) : 0; }),
+    mapChecksums_([this](std::string const & name) { return unitSync_ ? unitSync_->GetMapChecksumFromName(name.c_str()) : 0; }),
     joinedBattleId_(-1),
     me_(0),
     springId_(0),
     prDownloaderId_(0),
     curlId_(0),
+    useExternalPrDownloader_(true),
+    prDownloadInternal_(false),
+    poolCheckId_(0),
+    autoReconnect_(true),
+    userDisconnect_(false),
+    reconnecting_(false),
+    reconnectAttempt_(0),
+    reconnectGeneration_(0),
+    resync_(false),
+    rejoinBattleId_(-1),
     flobbyDemo_("flobby_demo"),
     requestedConnectSpring_(false)
 {
     controller_.setIControllerEvent(*this);
     ServerCommand::init(*this);
 
+    // dispatch time per signal, see Metrics
+    connectedSignal_.metricsName("connected");
+    serverInfoSignal_.metricsName("serverInfo");
+    loginResultSignal_.metricsName("loginResult");
+    reconnectedSignal_.metricsName("reconnected");
+    registerResultSignal_.metricsName("registerResult");
+    agreementSignal_.metricsName("agreement");
+    userJoinedSignal_.metricsName("userJoined");
+    userChangedSignal_.metricsName("userChanged");
+    userLeftSignal_.metricsName("userLeft");
+    battleOpenedSignal_.metricsName("battleOpened");
+    battleClosedSignal_.metricsName("battleClosed");
+    battleChangedSignal_.metricsName("battleChanged");
+    usersChangedSignal_.metricsName("usersChanged");
+    channelUsersChangedSignal_.metricsName("channelUsersChanged");
+    battlesChangedSignal_.metricsName("battlesChanged");
+    battleJoinedSignal_.metricsName("battleJoined");
+    joinBattleFailedSignal_.metricsName("joinBattleFailed");
+    userJoinedBattleSignal_.metricsName("userJoinedBattle");
+    userLeftBattleSignal_.metricsName("userLeftBattle");
+    botAddedSignal_.metricsName("botAdded");
+    botChangedSignal_.metricsName("botChanged");
+    botRemovedSignal_.metricsName("botRemoved");
+    battleChatMsgSignal_.metricsName("battleChatMsg");
+    springExitSignal_.metricsName("springExit");
+    downloadDoneSignal_.metricsName("downloadDone");
+    downloadProgressSignal_.metricsName("downloadProgress");
+    serverMsgSignal_.metricsName("serverMsg");
+    sayPrivateSignal_.metricsName("sayPrivate");
+    saidPrivateSignal_.metricsName("saidPrivate");
+    channelsSignal_.metricsName("channels");
+    channelJoinedSignal_.metricsName("channelJoined");
+    channelTopicSignal_.metricsName("channelTopic");
+    channelMessageSignal_.metricsName("channelMessage");
+    channelClientsSignal_.metricsName("channelClients");
+    userJoinedChannelSignal_.metricsName("userJoinedChannel");
+    userLeftChannelSignal_.metricsName("userLeftChannel");
+    saidChannelSignal_.metricsName("saidChannel");
+    ringSignal_.metricsName("ring");
+    addStartRectSignal_.metricsName("addStartRect");
+    removeStartRectSignal_.metricsName("removeStartRect");
+    setScriptTagSignal_.metricsName("setScriptTag");
+    removeScriptTagSignal_.metricsName("removeScriptTag");
+    startDemoSignal_.metricsName("startDemo");
+
+    // collect changes for the coalesced signals emitted in messageBatchDone
+    userChangedSignal_.connect( boost::bind(&Model::markUserDirty, this, _1) );
+    battleChangedSignal_.connect( boost::bind(&Model::markBattleDirty, this, _1) );
+    userJoinedBattleSignal_.connect( boost::bind(&Model::markBattleDirty, this, _2) );
+    userLeftBattleSignal_.connect( boost::bind(&Model::markBattleDirty, this, _2) );
+
     // setup spring message handlers
     ADD_MSG_HANDLER(TASServer)
     ADD_MSG_HANDLER(ACCEPTED)
@@ -143,6 +212,16 @@ Model::Model(IController & controller, bool zerok):
 
 Model::~Model()
 {
+    stopJobs();
+}
+
+void Model::stopJobs()
+{
+    if (downloader_)
+    {
+        downloader_->cancel(); // job keeps downloader alive until it returns
+    }
+    archivePrefetch_.stop();
 }
 
 void Model::setUnitSyncPath(std::string const & path)
@@ -195,29 +274,197 @@ void Model::connected(bool connected)
     {
         checkFirstMsg_ = true; // check first message again
         timePingSent_ = controller_.timeNow();
+        rejoinedChannels_.clear();
+        connectedSignal_(connected_);
+
+        if (reconnecting_)
+        {
+            // login with the credentials of the lost connection
+            loginInProgress_ = true;
+            attemptLogin();
+        }
+        return;
+    }
+
+    bool const reconnect = autoReconnect_ && !userDisconnect_ && (loggedIn_ || reconnecting_);
+    if (reconnect && !zerok_ && (loggedIn_ || resync_))
+    {
+        // connection lost during resync login burst, go back to the state of the previous session
+        if (!snapshotUsers_.empty() || !snapshotBattles_.empty())
+        {
+            users_.swap(snapshotUsers_);
+            battles_.swap(snapshotBattles_);
+            snapshotUsers_.clear();
+            snapshotBattles_.clear();
+            auto it = users_.find(userName_);
+            me_ = (it != users_.end()) ? it->second.get() : 0;
+        }
+        // keep users and battles to compare with after reconnect, ZeroK has no end of login burst to compare at
+        resync_ = true;
     }
     else
     {
-        // reset model on disconnect
-        loggedIn_ = false;
-        waitingForPong_ = 0;
-        userName_.clear();
-        password_.clear();
-        myScriptPassword_.clear();
-        joinedBattleId_ = -1;
-        springId_ = 0;
+        resync_ = false;
+    }
+
+    if (joinedBattleId_ != -1)
+    {
+        rejoinBattleId_ = joinedBattleId_;
+    }
+
+    // reset model on disconnect
+    loggedIn_ = false;
+    waitingForPong_ = 0;
+    myScriptPassword_.clear();
+    joinedBattleId_ = -1;
+    archivePrefetch_.stop();
+    springId_ = 0;
+    bots_.clear();
+    channelMembers_.clear(); // channels are joined again after reconnect
+    dirtyUsers_.clear();
+    dirtyBattles_.clear();
+    if (!resync_)
+    {
         me_ = 0;
         battles_.clear();
         users_.clear();
-        bots_.clear();
+    }
+
+    if (loginInProgress_ && !reconnecting_)
+    {
+        loginResultSignal_(false, "no connection to server");
+    }
+    loginInProgress_ = false;
 
-        if (loginInProgress_)
+    if (reconnect)
+    {
+        reconnecting_ = true;
+        scheduleReconnect();
+    }
+    else
+    {
+        resetSession();
+    }
+    connectedSignal_(connected_);
+}
+
+void Model::resetSession()
+{
+    reconnecting_ = false;
+    ++reconnectGeneration_;
+    reconnectAttempt_ = 0;
+    resync_ = false;
+    me_ = 0;
+    battles_.clear();
+    users_.clear();
+    snapshotUsers_.clear();
+    snapshotBattles_.clear();
+    userName_.clear();
+    password_.clear();
+    joinedChannels_.clear();
+    rejoinBattleId_ = -1;
+    battlePassword_.clear();
+}
+
+void Model::scheduleReconnect()
+{
+    // 1, 2, 4 ... seconds, at most one minute
+    int const delay = std::min(60, 1 << std::min(reconnectAttempt_, 6));
+    ++reconnectAttempt_;
+
+    std::ostringstream oss;
+    oss << "Connection lost, reconnecting in " << delay << " s";
+    serverMsgSignal_(oss.str(), 1);
+    controller_.startTimer(delay, boost::bind(&Model::reconnect, this, reconnectGeneration_));
+}
+
+void Model::reconnect(unsigned int generation)
+{
+    if (generation == reconnectGeneration_ && reconnecting_ && !connected_)
+    {
+        LOG(INFO) << "reconnect attempt " << reconnectAttempt_ << " to " << host_ << ":" << port_;
+        controller_.connect(host_, port_);
+    }
+}
+
+void Model::stopReconnect()
+{
+    if (reconnecting_ && !connected_)
+    {
+        resetSession();
+        connectedSignal_(false); // views drop the users and battles they kept for resync
+    }
+}
+
+void Model::rejoin()
+{
+    for (auto const & pair : joinedChannels_)
+    {
+        joinChannel(pair.first, pair.second);
+        rejoinedChannels_.insert(pair.first);
+    }
+
+    if (rejoinBattleId_ != -1)
+    {
+        // battle list of the new session is not received yet, the server handles our JOINBATTLE after the login burst
+        joinBattle(rejoinBattleId_, battlePassword_);
+        rejoinBattleId_ = -1;
+    }
+}
+
+void Model::finishResync()
+{
+    // battles and users gone while we were disconnected
+    for (auto const & pair : snapshotBattles_)
+    {
+        if (battles_.find(pair.first) == battles_.end())
         {
-            loginResultSignal_(false, "no connection to server");
-            loginInProgress_ = false;
+            battleClosedSignal_(*pair.second);
         }
     }
-    connectedSignal_(connected_);
+    for (auto const & pair : snapshotUsers_)
+    {
+        if (users_.find(pair.first) == users_.end())
+        {
+            userLeftSignal_(*pair.second);
+        }
+    }
+
+    // only new and changed ones are signaled, changes are coalesced in messageBatchDone
+    int changedUsers = 0;
+    for (auto const & pair : users_)
+    {
+        auto it = snapshotUsers_.find(pair.first);
+        if (it == snapshotUsers_.end())
+        {
+            userJoinedSignal_(*pair.second);
+        }
+        else if (!it->second->sameState(*pair.second))
+        {
+            markUserDirty(*pair.second);
+            ++changedUsers;
+        }
+    }
+    int changedBattles = 0;
+    for (auto const & pair : battles_)
+    {
+        auto it = snapshotBattles_.find(pair.first);
+        if (it == snapshotBattles_.end())
+        {
+            battleOpenedSignal_(*pair.second);
+        }
+        else if (!it->second->sameState(*pair.second))
+        {
+            markBattleDirty(*pair.second);
+            ++changedBattles;
+        }
+    }
+    LOG(INFO) << "resync: users " << snapshotUsers_.size() << " -> " << users_.size() << " (" << changedUsers << " changed)"
+              << ", battles " << snapshotBattles_.size() << " -> " << battles_.size() << " (" << changedBattles << " changed)";
+
+    snapshotUsers_.clear();
+    snapshotBattles_.clear();
+    resync_ = false;
 }
 
 void Model::attemptLogin()
@@ -251,38 +498,135 @@ void Model::message(std::string const & msg)
     processServerMsg(msg);
 }
 
-int Model::runProcess(std::string const& cmd, bool logToFile)
+void Model::messageBatchDone()
 {
-    LOG(DEBUG) << "runProcess: '" << cmd << "'";
+    if (!dirtyUsers_.empty())
+    {
+        std::vector<User const *> users;
+        users.reserve(dirtyUsers_.size());
+        for (std::string const & name : dirtyUsers_)
+        {
+            auto it = users_.find(name);
+            if (it != users_.end()) // skip users removed in batch
+            {
+                users.push_back(it->second.get());
+            }
+        }
+        dirtyUsers_.clear();
+        if (!users.empty())
+        {
+            usersChangedSignal_(users);
+            channelUsersChanged(users);
+        }
+    }
+
+    if (!dirtyBattles_.empty())
+    {
+        std::vector<Battle const *> battles;
+        battles.reserve(dirtyBattles_.size());
+        for (int id : dirtyBattles_)
+        {
+            auto it = battles_.find(id);
+            if (it != battles_.end()) // skip battles closed in batch
+            {
+                battles.push_back(it->second.get());
+            }
+        }
+        dirtyBattles_.clear();
+        if (!battles.empty())
+        {
+            battlesChangedSignal_(battles);
+        }
+    }
+}
 
-    int ret;
+void Model::channelUsersChanged(std::vector<User const *> const & users)
+{
+    // route each user only to the channels the user is in
+    std::vector<std::vector<User const *>> channelUsers;
+    for (User const * user : users)
+    {
+        ChannelMembers::ChannelMask mask = channelMembers_.channels(user->name());
+        for (std::size_t slot = 0; mask != 0; ++slot, mask >>= 1)
+        {
+            if (mask & 1)
+            {
+                if (channelUsers.size() <= slot)
+                {
+                    channelUsers.resize(slot + 1);
+                }
+                channelUsers[slot].push_back(user);
+            }
+        }
+    }
+
+    for (std::size_t slot = 0; slot < channelUsers.size(); ++slot)
+    {
+        if (!channelUsers[slot].empty())
+        {
+            channelUsersChangedSignal_(channelMembers_.channelName(slot), channelUsers[slot]);
+        }
+    }
+}
+
+void Model::markUserDirty(User const & user)
+{
+    dirtyUsers_.insert(user.name());
+}
+
+void Model::markBattleDirty(Battle const & battle)
+{
+    dirtyBattles_.insert(battle.id());
+}
+
+int Model::runProcess(std::vector<std::string> const& args, bool logToFile)
+{
+    std::ostringstream oss;
+    for (std::string const& arg : args)
+    {
+        oss << " '" << arg << "'";
+    }
+    LOG(DEBUG) << "runProcess:" << oss.str();
+
+    std::string log;
     if (logToFile)
     {
         // create log filename
-        std::string const first = cmd.substr(0, cmd.find(' '));
-        boost::filesystem::path const path(first);
-        std::string const log = cacheDir() + "flobby_process_" + path.stem().string() + ".log";
+        boost::filesystem::path const path(args.at(0));
+        log = cacheDir() + "flobby_process_" + path.stem().string() + ".log";
         LOG(DEBUG) << "runProcess logFile: '" << log << "'";
+    }
 
-        // redirect stdout and stderr to log file
-        std::string cmdLine = cmd + " >> " + log + " 2>&1";
-
-        LOG(DEBUG) << "runProcess system(): '" << cmdLine << "'";
-        ret = std::system(cmdLine.c_str());
+    try
+    {
+        // keep last output line, it usually tells why a download failed
+        std::string lastLine;
+        int const ret = Process::run(args, log, [&lastLine](std::string const& line) { lastLine = line; });
+        LOG_IF(WARNING, ret != 0) << "runProcess " << args[0] << " returned " << ret << ": " << lastLine;
+        return ret;
     }
-    else
+    catch (std::exception const& e)
     {
-        std::string cmdLine = cmd + " >> /dev/null" + " 2>&1";
-        LOG(DEBUG) << "runProcess system(): '" << cmdLine << "'";
-        ret = std::system(cmdLine.c_str());
+        LOG(ERROR) << "runProcess failed: " << e.what();
+        return -1;
     }
-
-    return ret;
 }
 
 void Model::processDone(std::pair<unsigned int, int> idRetPair)
 {
     LOG(DEBUG)<< "processDone, id:"<< idRetPair.first << " ret:" << idRetPair.second;
+    auto const job = jobs_.find(idRetPair.first);
+    if (job != jobs_.end())
+    {
+        std::function<void (int)> const done = job->second;
+        jobs_.erase(job);
+        if (done)
+        {
+            done(idRetPair.second);
+        }
+        return;
+    }
+
     if (idRetPair.first == springId_)
     {
         springExitSignal_();
@@ -297,8 +641,13 @@ void Model::processDone(std::pair<unsigned int, int> idRetPair)
             prDownloadName_.pop_back();
         }
 
+        if (prDownloadInternal_ && idRetPair.second != 0)
+        {
+            serverMsgSignal_("download failed: " + downloader_->error(), 1);
+        }
         downloadDoneSignal_(prDownloadType_, prDownloadName_, idRetPair.second == 0 ? true : false);
         prDownloaderId_ = 0;
+        prDownloadInternal_ = false;
     }
     else if (idRetPair.first == curlId_)
     {
@@ -306,6 +655,26 @@ void Model::processDone(std::pair<unsigned int, int> idRetPair)
         curlId_ = 0;
     }
 
+    else if (idRetPair.first == poolCheckId_)
+    {
+        PoolScanner::Report const & report = *poolCheckReport_;
+        bool const problems = !report.corruptFiles_.empty() || !report.brokenPackages_.empty();
+        std::ostringstream oss;
+        oss << (idRetPair.second == 0 ? report.summary() : "game file check failed");
+        for (std::string const & path : report.brokenPackages_)
+        {
+            oss << "\n  broken package: " << path;
+        }
+        if (problems)
+        {
+            oss << (report.removed_.empty() ? "\n  use Repair downloaded games to remove them"
+                                            : "\n  reload games and download the broken games again");
+        }
+        serverMsgSignal_(oss.str(), problems || !report.error_.empty() ? 1 : 0);
+        poolCheckId_ = 0;
+        poolCheckReport_.reset();
+    }
+
     // check start of downloaded demo
     if (demoDownloadJobs_.find(idRetPair.first) != demoDownloadJobs_.end())
     {
@@ -333,6 +702,10 @@ void Model::connect(const std::string & host, const std::string & port)
 {
     if (!connected_)
     {
+        stopReconnect();
+        userDisconnect_ = false;
+        host_ = host;
+        port_ = port;
         controller_.connect(host, port);
     }
     else
@@ -421,6 +794,12 @@ const Battle & Model::getBattle(int battleId)
     auto it = battles_.find(battleId);
     if (it == battles_.end())
     {
+        // views still show the previous session during resync login burst
+        auto itSnapshot = snapshotBattles_.find(battleId);
+        if (itSnapshot != snapshotBattles_.end())
+        {
+            return *itSnapshot->second;
+        }
         throw std::invalid_argument("battle not found:" + boost::lexical_cast<std::string>(battleId));
     }
     return *it->second;
@@ -438,8 +817,39 @@ std::vector<User const *> Model::getUsers()
     return users;
 }
 
+std::vector<User const *> Model::getChannelUsers(std::string const & channelName)
+{
+    std::vector<std::string> const & names = channelMembers_.users(channelName);
+    std::vector<User const *> users;
+    users.reserve(names.size());
+
+    for (std::string const & name : names)
+    {
+        auto it = users_.find(name);
+        if (it != users_.end())
+        {
+            users.push_back(it->second.get());
+        }
+        else
+        {
+            LOG(WARNING)<< "user in channel " << channelName << " not found: " << name; // uberserver bug
+        }
+    }
+
+    return users;
+}
+
 User const & Model::getUser(std::string const & str)
 {
+    // views still show the previous session during resync login burst
+    if (!snapshotUsers_.empty() && users_.find(str) == users_.end())
+    {
+        auto it = snapshotUsers_.find(str);
+        if (it != snapshotUsers_.end())
+        {
+            return *it->second;
+        }
+    }
     return user(str);
 }
 
@@ -568,6 +978,10 @@ void Model::meAway(bool away)
 
 void Model::processServerMsg(const std::string & msg)
 {
+    static MetricsHistogram & processTime = Metrics::histogram("server.msg_time");
+    static MetricsCounter & unhandled = Metrics::counter("server.msg_unhandled");
+    MetricsTimer timer(processTime);
+
     std::istringstream iss(msg);
 
     try // catch all message parsing exceptions
@@ -596,10 +1010,14 @@ void Model::processServerMsg(const std::string & msg)
         auto res = messageHandlers.find(ex);
         if (res != messageHandlers.end())
         {
-            res->second(iss);
+            res->second.received_->add();
+            TraceSpan span(res->second.command_, "server");
+            WatchdogActivity activity(res->second.command_);
+            res->second.handle_(iss);
         }
         else
         {
+            unhandled.add();
             LOG(WARNING) << "Unhandled message:" << msg;
         }
     }
@@ -615,6 +1033,7 @@ void Model::joinBattle(int battleId, std::string const & password)
 {
     if (joinedBattleId_ != battleId)
     {
+        battlePassword_ = password; // for rejoin after reconnect
         if (joinedBattleId_ != -1)
         {
             leaveBattle();
@@ -780,21 +1199,24 @@ void Model::startSpring()
     {
         std::string const scriptPath = cacheDir() + "flobby_script.txt";
         script_.write(scriptPath);
-        std::ostringstream oss;
-        oss << "\"" << springPath_ << "\"" << " " << springOptions_ << " " << scriptPath;
+        std::vector<std::string> args = Process::splitArgs(springOptions_);
+        args.insert(args.begin(), springPath_);
+        args.push_back(scriptPath);
 
-        springId_ = controller_.startThread( boost::bind(&Model::runProcess, this, oss.str(), false) );
+        springId_ = controller_.startThread( boost::bind(&Model::runProcess, this, args, false), JL_ENGINE );
     }
     meInGame(true);
 }
 
 void Model::disconnect()
 {
+    userDisconnect_ = true;
     if (!zerok_)
     {
         sendMessage("EXIT");
     }
     controller_.disconnect();
+    stopReconnect();
 }
 
 void Model::updateBattleRunningStatus(User const & user)
@@ -893,6 +1315,8 @@ void Model::refresh()
     unitSync_->Init(true, 1);
     unitSync_->GetPrimaryModCount();
     initMapIndex();
+    modChecksums_.clear();
+    mapChecksums_.clear();
 
     updateSync();
 }
@@ -908,10 +1332,58 @@ void Model::updateSync()
             LOG(DEBUG) << "sync changed:" << sync;
             u.battleStatus_.sync(sync);
             sendMyBattleStatus();
+            prefetchArchives(getBattle(joinedBattleId_)); // e.g. map was downloaded after join
         }
     }
 }
 
+void Model::prefetchArchives(Battle const & battle)
+{
+    if (!unitSync_ || calcSync(battle) != 1)
+    {
+        return;
+    }
+
+    // unitsync is not thread safe, archive paths are resolved here and only the reading is done in the thread
+    // a rapid game resolves to its .sdp package, the pool files it lists are read by the job
+    std::vector<std::string> paths;
+    auto const addArchive = [this, &paths](char const * name)
+    {
+        if (name != 0 && *name != 0)
+        {
+            char const * dir = unitSync_->GetArchivePath(name);
+            if (dir != 0)
+            {
+                std::string const path = std::string(dir) + name;
+                if (std::find(paths.begin(), paths.end(), path) == paths.end())
+                {
+                    paths.push_back(path);
+                }
+            }
+        }
+    };
+
+    int const mapArchiveCount = unitSync_->GetMapArchiveCount(battle.mapName().c_str());
+    for (int i = 0; i < mapArchiveCount; ++i)
+    {
+        addArchive(unitSync_->GetMapArchiveName(i));
+    }
+
+    int const modIndex = unitSync_->GetPrimaryModIndex(battle.modName().c_str());
+    if (modIndex >= 0)
+    {
+        addArchive(unitSync_->GetPrimaryModArchive(modIndex));
+        int const modArchiveCount = unitSync_->GetPrimaryModArchiveCount(modIndex); // game and its dependencies
+        for (int i = 0; i < modArchiveCount; ++i)
+        {
+            addArchive(unitSync_->GetPrimaryModArchiveList(i));
+        }
+    }
+
+    LOG(DEBUG) << "prefetching " << paths.size() << " archives";
+    controller_.startThread(archivePrefetch_.job(paths), JL_PREFETCH);
+}
+
 void Model::sendMyInitialBattleStatus(Battle const & battle)
 {
 /* skip reset/change of my battle status when joining new game, this is to not break matchmaking hosts
@@ -1005,17 +1477,32 @@ void Model::sendMyInitialBattleStatus(Battle const & battle)
 
 bool Model::gameExist(std::string const & gameName)
 {
-    if (!unitSync_) return false;
+    return modChecksums_.get(gameName) != 0;
+}
+
+Model::SyncStatus Model::getSyncStatus(Battle const & battle)
+{
+    if (!unitSync_) return SS_UNKNOWN;
+
+    unsigned int const modChecksum = modChecksums_.get(battle.modName());
+    unsigned int const mapChecksum = mapChecksums_.get(battle.mapName());
 
-    return (unitSync_->GetPrimaryModChecksumFromName( gameName.c_str()) != 0 );
+    if (modChecksum == 0 && mapChecksum == 0) return SS_MISSING_BOTH;
+    if (modChecksum == 0) return SS_MISSING_GAME;
+    if (mapChecksum == 0) return SS_MISSING_MAP;
+    if ((battle.modHash() != 0 && battle.modHash() != modChecksum) || (battle.mapHash() != 0 && battle.mapHash() != mapChecksum))
+    {
+        return SS_MISMATCH;
+    }
+    return SS_SYNCED;
 }
 
 int Model::calcSync(Battle const & battle)
 {
     if (!unitSync_) return 2;
 
-    unsigned int const modChecksum = unitSync_->GetPrimaryModChecksumFromName( battle.modName().c_str() );
-    unsigned int const mapChecksum = unitSync_->GetMapChecksumFromName( battle.mapName().c_str() );
+    unsigned int const modChecksum = modChecksums_.get(battle.modName());
+    unsigned int const mapChecksum = mapChecksums_.get(battle.mapName());
 
     if (modChecksum == 0 || mapChecksum == 0)
     {
@@ -1141,6 +1628,10 @@ void Model::handle_LoginResponse(std::istream & is) // ResultCode Reason
         loginInProgress_ = false;
         loginResultSignal_(loginSuccess, reason);
     }
+    else if (reconnecting_)
+    {
+        rejoin();
+    }
 }
 
 void Model::handle_User(std::istream & is) // User content
@@ -1171,6 +1662,8 @@ void Model::handle_User(std::istream & is) // User content
             me_ = u.get();
             loggedIn_ = true;
             loginInProgress_ = false;
+            reconnecting_ = false; // ZeroK is not resynced, views get the full state with LoginResult
+            reconnectAttempt_ = 0;
             loginResultSignal_(true, "");
         }
         else if (loggedIn_)
@@ -1193,6 +1686,7 @@ void Model::handle_UserDisconnected(std::istream & is) // Name Reason
 
     User const & user = getUser(name);
     userLeftSignal_(user);
+    channelMembers_.removeUser(name);
     users_.erase(name);
 }
 
@@ -1217,6 +1711,19 @@ void Model::handle_ACCEPTED(std::istream & is) // userName
     std::string ex;
     extractWord(is, ex);
     assert(ex == userName_);
+
+    if (resync_)
+    {
+        // login burst builds a new state, compared with the previous session at LOGININFOEND
+        snapshotUsers_.swap(users_);
+        snapshotBattles_.swap(battles_);
+        users_.clear();
+        battles_.clear();
+    }
+    if (reconnecting_)
+    {
+        rejoin();
+    }
 }
 
 void Model::handle_DENIED(std::istream & is) // {reason}
@@ -1225,7 +1732,15 @@ void Model::handle_DENIED(std::istream & is) // {reason}
     std::string ex;
     extractSentence(is, ex);
     loginInProgress_ = false;
+
+    // credentials of the lost session are refused (e.g. password changed or banned), retrying them can't succeed
+    bool const wasReconnecting = reconnecting_;
+    resetSession();
     loginResultSignal_(false, ex);
+    if (wasReconnecting)
+    {
+        disconnect(); // views drop the users and battles they kept for resync
+    }
 }
 
 void Model::handle_ADDUSER(std::istream & is) // userName country cpu [accountID]
@@ -1234,7 +1749,7 @@ void Model::handle_ADDUSER(std::istream & is) // userName country cpu [accountID
 
     std::shared_ptr<User> u(new User(is));
     users_[u->name()] = u;
-    if (me_ == 0 && u->name() == userName_)
+    if (u->name() == userName_) // also replaces me_ of previous session after reconnect
     {
         me_ = u.get();
     }
@@ -1252,6 +1767,7 @@ void Model::handle_REMOVEUSER(std::istream & is) // userName
     extractWord(is, userName);
     User const & user = getUser(userName);
     userLeftSignal_(user);
+    channelMembers_.removeUser(userName);
     users_.erase(userName);
 
 }
@@ -1401,6 +1917,7 @@ void Model::handle_JoinedBattle(std::istream & is)
     {
         joinedBattleId_ = b.id();
         sendMyInitialBattleStatus(b);
+        prefetchArchives(b);
         battleJoinedSignal_(b);
     }
 }
@@ -1423,6 +1940,7 @@ void Model::handle_LEFTBATTLE(std::istream & is) // battleId username
     if (u == me() && b.id () == joinedBattleId_)
     {
         joinedBattleId_ = -1;
+        archivePrefetch_.stop();
         bots_.clear();
     }
 }
@@ -1445,6 +1963,7 @@ void Model::handle_LeftBattle(std::istream & is)
     if (u == me() && b.id () == joinedBattleId_)
     {
         joinedBattleId_ = -1;
+        archivePrefetch_.stop();
         bots_.clear();
     }
 }
@@ -1468,6 +1987,18 @@ void Model::handle_LOGININFOEND(std::istream & is)
 {
     loggedIn_ = true;
     loginInProgress_ = false;
+    if (reconnecting_)
+    {
+        reconnecting_ = false;
+        reconnectAttempt_ = 0;
+        if (resync_)
+        {
+            finishResync();
+            serverMsgSignal_("Reconnected", 1);
+            reconnectedSignal_();
+            return;
+        }
+    }
     loginResultSignal_(true, "");
 }
 
@@ -1571,6 +2102,7 @@ void Model::handle_REQUESTBATTLESTATUS(std::istream & is)
 {
     Battle const & b = getBattle(joinedBattleId_); // joinedBattleId_ set in JOINBATTLE above
     sendMyInitialBattleStatus(b);
+    prefetchArchives(b);
     battleJoinedSignal_(b);
 }
 
@@ -1747,6 +2279,7 @@ void Model::handle_JOIN(std::istream & is) // channelName
     using namespace LobbyProtocol;
     std::string channelName;
     extractWord(is, channelName);
+    addChannelMembers(channelName);
     channelJoinedSignal_(channelName);
 }
 
@@ -1759,13 +2292,19 @@ void Model::handle_JoinChannelResponse(std::istream & is)
     if (jv["Success"].asBool())
     {
         // TODO add topic info
+        addChannelMembers(channelName);
         channelJoinedSignal_(channelName);
 
+        // same as CLIENTS, users already in channel are not signaled one by one as joined
         Json::Value const& jvUsers = jv["Channel"]["Users"];
+        std::vector<std::string> clients;
+        clients.reserve(jvUsers.size());
         for (Json::ValueConstIterator it = jvUsers.begin(); it != jvUsers.end(); ++it)
         {
-            userJoinedChannelSignal_(channelName, (*it).asString());
+            clients.push_back((*it).asString());
         }
+        channelMembers_.add(channelName, clients);
+        channelClientsSignal_(channelName, clients);
     }
     else
     {
@@ -1774,6 +2313,11 @@ void Model::handle_JoinChannelResponse(std::istream & is)
     }
 }
 
+void Model::addChannelMembers(std::string const & channelName)
+{
+    LOG_IF(WARNING, !channelMembers_.addChannel(channelName))<< "too many channels, users of " << channelName << " are not tracked";
+}
+
 void Model::handle_CLIENTS(std::istream & is) // channelName {clients}
 {
     using namespace LobbyProtocol;
@@ -1787,6 +2331,7 @@ void Model::handle_CLIENTS(std::istream & is) // channelName {clients}
         extractWord(is, userName);
         clients.push_back(userName);
     }
+    channelMembers_.add(channelName, clients);
     channelClientsSignal_(channelName, clients);
 }
 
@@ -1813,6 +2358,12 @@ void Model::joinChannel(std::string const & channelName, std::string const & pas
 {
     if (!channelName.empty() && connected_)
     {
+        joinedChannels_[channelName] = password;
+        if (rejoinedChannels_.erase(channelName) > 0)
+        {
+            return; // already rejoined after reconnect, e.g. auto-join after ZeroK login
+        }
+
         std::ostringstream oss;
         if (zerok_)
         {
@@ -1865,6 +2416,8 @@ void Model::sayChannel(std::string const & channelName, std::string const & mess
 
 void Model::leaveChannel(std::string const & channelName)
 {
+    joinedChannels_.erase(channelName);
+    channelMembers_.removeChannel(channelName);
     if (!channelName.empty() && connected_)
     {
         std::ostringstream oss;
@@ -1916,6 +2469,7 @@ void Model::handle_JOINED(std::istream & is) // channelName userName
     extractWord(is, channelName);
     std::string userName;
     extractWord(is, userName);
+    channelMembers_.add(channelName, userName);
     userJoinedChannelSignal_(channelName, userName);
 }
 
@@ -1923,7 +2477,10 @@ void Model::handle_ChannelUserAdded(std::istream & is)
 {
     Json::Value jv;
     is >> jv;
-    userJoinedChannelSignal_(jv["ChannelName"].asString(), jv["UserName"].asString());
+    std::string const channelName = jv["ChannelName"].asString();
+    std::string const userName = jv["UserName"].asString();
+    channelMembers_.add(channelName, userName);
+    userJoinedChannelSignal_(channelName, userName);
 }
 
 void Model::handle_LEFT(std::istream & is) // channelName userName [{reason}]
@@ -1942,6 +2499,7 @@ void Model::handle_LEFT(std::istream & is) // channelName userName [{reason}]
         extractSentence(is, reason);
     }
 
+    channelMembers_.remove(channelName, userName);
     userLeftChannelSignal_(channelName, userName, reason);
 }
 
@@ -1949,7 +2507,10 @@ void Model::handle_ChannelUserRemoved(std::istream & is)
 {
     Json::Value jv;
     is >> jv;
-    userLeftChannelSignal_(jv["ChannelName"].asString(), jv["UserName"].asString(), "");
+    std::string const channelName = jv["ChannelName"].asString();
+    std::string const userName = jv["UserName"].asString();
+    channelMembers_.remove(channelName, userName);
+    userLeftChannelSignal_(channelName, userName, "");
 }
 
 void Model::handle_CHANNELTOPIC(std::istream & is) // channelName author changedTime {topic}
@@ -2114,9 +2675,7 @@ std::vector<std::string> Model::getMaps()
 
 unsigned int Model::getMapChecksum(std::string const & mapName)
 {
-    if (!unitSync_) return 0;
-
-    return unitSync_->GetMapChecksumFromName(mapName.c_str());
+    return mapChecksums_.get(mapName);
 }
 
 void Model::handle_ADDSTARTRECT(std::istream & is) // allyNo left top right bottom
@@ -2583,7 +3142,7 @@ unsigned int Model::downloadPr(std::string const& name, DownloadType type)
     prDownloadType_ = type;
     prDownloadName_ = name;
 
-    if (useExternalPrDownloader_)
+    if (useExternalPrDownloader_ || type != DT_GAME)
     {
         auto const jobId = prDownloadExternal(name, type);
         if (jobId == 0) {
@@ -2597,10 +3156,9 @@ unsigned int Model::downloadPr(std::string const& name, DownloadType type)
     }
     else
     {
-        // TODO pr-d static disabled for now
-        assert(false);
-        //downloaderId_ = controller_.startThread( boost::bind(&Model::downloadInternal, this, name, type) );
-        return 0;
+        auto const jobId = prDownloadInternal(name);
+        serverMsgSignal_(jobId == 0 ? "download of " + name + " failed" : "downloading " + name + " ...", jobId == 0 ? 1 : 0);
+        return jobId;
     }
 }
 
@@ -2615,63 +3173,43 @@ unsigned int Model::downloadCurl(std::string const& url, std::string const& file
     curlDownloadUrl_ = url;
     std::string url2 = url;
     boost::replace_all(url2, " ", "%20");
-    std::ostringstream oss;
-    oss << "curl -o " << file << " '" << url2 << "'";
-    curlId_ = controller_.startThread( boost::bind(&Model::runProcess, this, oss.str(), true) );
+    std::vector<std::string> const args = { "curl", "-o", file, url2 };
+    curlId_ = controller_.startThread( boost::bind(&Model::runProcess, this, args, true) );
     return curlId_;
 }
 
-/* TODO disable pr-d static for now
-int Model::prDownloadInternal(std::string const& name, DownloadType type)
+unsigned int Model::prDownloadInternal(std::string const& name)
 {
-    category prdType;
-
-    switch (type)
+    if (writeableDataDir_.empty())
     {
-    case DT_MAP:
-        prdType = CAT_MAP;
-        break;
-
-    case DT_GAME:
-        prdType = CAT_GAME;
-        break;
-
-    case DT_ENGINE:
-        prdType = CAT_ENGINE;
-        break;
-
-    default:
-        LOG(ERROR)<< "unknown DownloadType " << type;
-        return 1;
+        LOG(ERROR)<< "writeable data dir unknown, check unitsync path";
+        return 0;
     }
 
-    int cnt = DownloadSearch(DL_ANY, prdType, name.c_str());
-    LOG(INFO)<< "DownloadSearch returned " << cnt;
-
-    if (cnt > 0)
+    if (!downloader_)
     {
-        bool res;
-        if (!DownloadAdd(0)) // i hope pr-d puts the best dl alt first
-        {
-            LOG(ERROR)<< "DownloadAdd failed"<<" ("<<name<<","<<type<<")";
-            return 1;
-        }
-        if (!DownloadStart())
-        {
-            LOG(ERROR)<< "DownloadStart failed"<<" ("<<name<<","<<type<<")";
-            return 1;
-        }
+        downloader_ = std::make_shared<Downloader>(writeableDataDir_);
     }
-    else
+
+    std::shared_ptr<Downloader> const downloader = downloader_;
+    prDownloaderId_ = controller_.startThread( [downloader, name]() { return downloader->downloadRapid(name); } );
+    prDownloadInternal_ = true;
+    controller_.startTimer(0.5, boost::bind(&Model::pollDownloadProgress, this));
+
+    return prDownloaderId_;
+}
+
+void Model::pollDownloadProgress()
+{
+    if (prDownloaderId_ == 0 || !prDownloadInternal_)
     {
-        LOG(ERROR)<< "DownloadSearch failed ("<<name<<","<<type<<")";
-        return 1;
+        return;
     }
 
-    LOG(INFO)<< "Download finished";
-    return 0;
+    Downloader::Progress const & progress = downloader_->progress();
+    downloadProgressSignal_(prDownloadType_, prDownloadName_, progress.bytesDone_, progress.bytesTotal_);
+    controller_.startTimer(0.5, boost::bind(&Model::pollDownloadProgress, this));
 }
-*/
 
 unsigned int Model::prDownloadExternal(std::string const& name, DownloadType type)
 {
@@ -2682,33 +3220,69 @@ unsigned int Model::prDownloadExternal(std::string const& name, DownloadType typ
         return 0;
     }
 
-    std::ostringstream oss;
-    oss << prDownloaderCmd_ << " ";
+    std::vector<std::string> args = Process::splitArgs(prDownloaderCmd_);
     switch (type)
     {
     case DT_MAP:
-        oss << "--download-map ";
+        args.push_back("--download-map");
         break;
 
     case DT_GAME:
-        oss << "--download-game ";
+        args.push_back("--download-game");
         break;
 
     case DT_ENGINE:
-        oss << "--download-engine ";
+        args.push_back("--download-engine");
         break;
 
     default:
         LOG(ERROR)<< "unknown DownloadType:"<< type;
         return 0;
     }
-    oss << "\"" << name << "\"";
+    args.push_back(name);
 
-    prDownloaderId_ = controller_.startThread( boost::bind(&Model::runProcess, this, oss.str(), true) );
+    prDownloaderId_ = controller_.startThread( boost::bind(&Model::runProcess, this, args, true) );
 
     return prDownloaderId_;
 }
 
+unsigned int Model::checkPool(bool repair)
+{
+    if (poolCheckId_ != 0 || !unitSync_)
+    {
+        return 0;
+    }
+
+    std::vector<std::string> dataDirs;
+    int const count = unitSync_->GetDataDirectoryCount();
+    for (int i = 0; i < count; ++i)
+    {
+        char const * dir = unitSync_->GetDataDirectory(i);
+        if (dir != 0)
+        {
+            dataDirs.push_back(dir);
+        }
+    }
+
+    serverMsgSignal_(repair ? "repairing downloaded games ..." : "checking downloaded games ...", 0);
+    std::shared_ptr<PoolScanner::Report> const report = std::make_shared<PoolScanner::Report>();
+    poolCheckReport_ = report;
+    std::string const cachePath = cacheDir() + "pool_check.cache";
+    poolCheckId_ = controller_.startThread( [dataDirs, cachePath, repair, report]()
+        {
+            *report = PoolScanner(dataDirs, cachePath).scan(repair);
+            return 0;
+        });
+    return poolCheckId_;
+}
+
+unsigned int Model::runJob(std::function<int ()> job, std::function<void (int)> done)
+{
+    unsigned int const id = controller_.startThread(job, JL_DEFAULT, -1);
+    jobs_[id] = done;
+    return id;
+}
+
 void Model::checkPing()
 {
     if (zerok_) {
@@ -2724,7 +3298,7 @@ void Model::checkPing()
             std::string const msg = "PONG not received in time, disconnecting";
             LOG(WARNING) << msg;
             serverMsgSignal_(msg, 1);
-            disconnect();
+            controller_.disconnect(); // not disconnect(), a dead connection is reconnected
         }
         else
         {
@@ -2890,8 +3464,9 @@ void Model::handleZerokAction(std::string const& action, std::string const& arg)
 
 void Model::startDemo(std::string const& springCmd, std::string const& demoPath)
 {
-    std::string const cmd = springCmd + " " + demoPath;
-    controller_.startThread( boost::bind(&Model::runProcess, this, cmd, false) );
+    std::vector<std::string> args = Process::splitArgs(springCmd);
+    args.push_back(demoPath);
+    controller_.startThread( boost::bind(&Model::runProcess, this, args, false), JL_ENGINE );
 }
 
 void Model::openBattle(int type, std::string const& title, std::string const& password)
@@ -12,9 +12,13 @@
 #include "MapInfo.h"
 #include "StartRect.h"
 #include "ServerInfo.h"
+#include "ChannelMembers.h"
+#include "ArchivePrefetch.h"
+#include "ChecksumCache.h"
+#include "PoolScanner.h"
 #include "AI.h"
+#include "Signal.h"
 
-#include <boost/signals2/signal.hpp>
 #include <sstream>
 #include <unordered_map>
 #include <functional>
@@ -29,6 +33,7 @@
 class IController;
 class IViewEvent;
 class UnitSync;
+class Downloader;
 
 class Model: public IControllerEvent
 {
@@ -47,6 +52,10 @@ public:
     std::string const & getPrDownloaderCmd() const { return prDownloaderCmd_; }
 
     void connect(std::string const & host, std::string const & port);
+    void setAutoReconnect(bool autoReconnect) { autoReconnect_ = autoReconnect; }
+    bool reconnecting() const { return reconnecting_; } // connection was lost and is being restored, disconnect stops it
+    // users and battles of the lost connection are kept until the login burst after reconnect has been compared against them
+    bool resyncPending() const { return resync_; }
     void login(std::string const & username, std::string const & passwordHash);
     std::string calcPasswordHash(std::string const& str);
     void sendMessage(std::string const& msg);
@@ -60,6 +69,7 @@ public:
 
     std::vector<User const *> getUsers();
     User const & getUser(std::string const & str);
+    std::vector<User const *> getChannelUsers(std::string const & channelName); // sorted by name
     Bot & getBot(std::string const & str);
 
     typedef std::map<std::string,Bot*> Bots;
@@ -119,6 +129,22 @@ public:
 
     void refresh(); // to find new mods and maps
 
+    // runs job in a pooled thread with low priority, done is called with the job result from the event loop thread
+    // for slow work of the user interface, e.g. indexing chat logs, returns job id
+    unsigned int runJob(std::function<int ()> job, std::function<void (int)> done);
+
+    // cancels downloads and archive prefetch, at exit so the controller's jobs end before it stops waiting for them
+    void stopJobs();
+
+    // verifies the rapid pool and packages of the spring data dirs in a thread, result is sent with ServerMsgSignal
+    // repair removes corrupt files so broken games can be downloaded again, returns 0 if a check is already running
+    unsigned int checkPool(bool repair);
+
+    // what we have of the battle's map and game, checksums are memoized until refresh
+    // so checking all battles calls unitsync at most once per distinct map and game name
+    enum SyncStatus { SS_UNKNOWN, SS_SYNCED, SS_MISSING_MAP, SS_MISSING_GAME, SS_MISSING_BOTH, SS_MISMATCH };
+    SyncStatus getSyncStatus(Battle const & battle);
+
     std::vector<AI> getModAIs(std::string const & modName);
     std::vector<std::string> getModSideNames(std::string const & modName);
 
@@ -129,156 +155,181 @@ public:
 
     // signals
     //
-    typedef boost::signals2::signal<void (bool connected)> ConnectedSignal;
-    boost::signals2::connection connectConnected(ConnectedSignal::slot_type subscriber)
+    typedef Signal<void (bool connected)> ConnectedSignal;
+    SignalConnection connectConnected(ConnectedSignal::slot_type subscriber)
     { return connectedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (ServerInfo const & serverInfo)> ServerInfoSignal;
-    boost::signals2::connection connectServerInfo(ServerInfoSignal::slot_type subscriber)
+    typedef Signal<void (ServerInfo const & serverInfo)> ServerInfoSignal;
+    SignalConnection connectServerInfo(ServerInfoSignal::slot_type subscriber)
     { return serverInfoSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (bool success, std::string const & msg)> LoginResultSignal;
-    boost::signals2::connection connectLoginResult(LoginResultSignal::slot_type subscriber)
+    typedef Signal<void (bool success, std::string const & msg)> LoginResultSignal;
+    SignalConnection connectLoginResult(LoginResultSignal::slot_type subscriber)
     { return loginResultSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (bool success, std::string const & msg)> RegisterResultSignal;
-    boost::signals2::connection connectRegisterResult(RegisterResultSignal::slot_type subscriber)
+    // login after automatic reconnect succeeded and users and battles have been resynced, sent instead of LoginResult
+    typedef Signal<void ()> ReconnectedSignal;
+    SignalConnection connectReconnected(ReconnectedSignal::slot_type subscriber)
+    { return reconnectedSignal_.connect(subscriber); }
+
+    typedef Signal<void (bool success, std::string const & msg)> RegisterResultSignal;
+    SignalConnection connectRegisterResult(RegisterResultSignal::slot_type subscriber)
     { return registerResultSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & text)> AgreementSignal;
-    boost::signals2::connection connectAgreement(AgreementSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & text)> AgreementSignal;
+    SignalConnection connectAgreement(AgreementSignal::slot_type subscriber)
     { return agreementSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (User const & user)> UserJoinedSignal;
-    boost::signals2::connection connectUserJoined(UserJoinedSignal::slot_type subscriber)
+    typedef Signal<void (User const & user)> UserJoinedSignal;
+    SignalConnection connectUserJoined(UserJoinedSignal::slot_type subscriber)
     { return userJoinedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (User const & user)> UserChangedSignal;
-    boost::signals2::connection connectUserChanged(UserChangedSignal::slot_type subscriber)
+    typedef Signal<void (User const & user)> UserChangedSignal;
+    SignalConnection connectUserChanged(UserChangedSignal::slot_type subscriber)
     { return userChangedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (User const & user)> UserLeftSignal;
-    boost::signals2::connection connectUserLeft(UserLeftSignal::slot_type subscriber)
+    typedef Signal<void (User const & user)> UserLeftSignal;
+    SignalConnection connectUserLeft(UserLeftSignal::slot_type subscriber)
     { return userLeftSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Battle const & battle)> BattleOpenedSignal;
-    boost::signals2::connection connectBattleOpened(BattleOpenedSignal::slot_type subscriber)
+    typedef Signal<void (Battle const & battle)> BattleOpenedSignal;
+    SignalConnection connectBattleOpened(BattleOpenedSignal::slot_type subscriber)
     { return battleOpenedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Battle const & battle)> BattleClosedSignal;
-    boost::signals2::connection connectBattleClosed(BattleClosedSignal::slot_type subscriber)
+    typedef Signal<void (Battle const & battle)> BattleClosedSignal;
+    SignalConnection connectBattleClosed(BattleClosedSignal::slot_type subscriber)
     { return battleClosedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Battle const & battle)> BattleChangedSignal;
-    boost::signals2::connection connectBattleChanged(BattleChangedSignal::slot_type subscriber)
+    typedef Signal<void (Battle const & battle)> BattleChangedSignal;
+    SignalConnection connectBattleChanged(BattleChangedSignal::slot_type subscriber)
     { return battleChangedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Battle const & battle)> BattleJoinedSignal;
-    boost::signals2::connection connectBattleJoined(BattleJoinedSignal::slot_type subscriber)
+    // coalesced variants of UserChanged and BattleChanged (the latter also covering users joining and leaving battles),
+    // emitted once after each batch of server messages with every changed user or battle listed once
+    typedef Signal<void (std::vector<User const *> const & users)> UsersChangedSignal;
+    SignalConnection connectUsersChanged(UsersChangedSignal::slot_type subscriber)
+    { return usersChangedSignal_.connect(subscriber); }
+
+    // UsersChanged for the users of one joined channel, only emitted for channels the changed users are in
+    typedef Signal<void (std::string const & channelName, std::vector<User const *> const & users)> ChannelUsersChangedSignal;
+    SignalConnection connectChannelUsersChanged(ChannelUsersChangedSignal::slot_type subscriber)
+    { return channelUsersChangedSignal_.connect(subscriber); }
+
+    typedef Signal<void (std::vector<Battle const *> const & battles)> BattlesChangedSignal;
+    SignalConnection connectBattlesChanged(BattlesChangedSignal::slot_type subscriber)
+    { return battlesChangedSignal_.connect(subscriber); }
+
+    typedef Signal<void (Battle const & battle)> BattleJoinedSignal;
+    SignalConnection connectBattleJoined(BattleJoinedSignal::slot_type subscriber)
     { return battleJoinedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & reason)> JoinBattleFailedSignal;
-    boost::signals2::connection connectJoinBattleFailed(JoinBattleFailedSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & reason)> JoinBattleFailedSignal;
+    SignalConnection connectJoinBattleFailed(JoinBattleFailedSignal::slot_type subscriber)
     { return joinBattleFailedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (User const & user, Battle const & battle)> UserJoinedBattleSignal;
-    boost::signals2::connection connectUserJoinedBattle(UserJoinedBattleSignal::slot_type subscriber)
+    typedef Signal<void (User const & user, Battle const & battle)> UserJoinedBattleSignal;
+    SignalConnection connectUserJoinedBattle(UserJoinedBattleSignal::slot_type subscriber)
     { return userJoinedBattleSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (User const & user, Battle const & battle)> UserLeftBattleSignal;
-    boost::signals2::connection connectUserLeftBattle(UserLeftBattleSignal::slot_type subscriber)
+    typedef Signal<void (User const & user, Battle const & battle)> UserLeftBattleSignal;
+    SignalConnection connectUserLeftBattle(UserLeftBattleSignal::slot_type subscriber)
     { return userLeftBattleSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Bot const & bot)> BotAddedSignal;
-    boost::signals2::connection connectBotAdded(BotAddedSignal::slot_type subscriber)
+    typedef Signal<void (Bot const & bot)> BotAddedSignal;
+    SignalConnection connectBotAdded(BotAddedSignal::slot_type subscriber)
     { return botAddedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Bot const & bot)> BotChangedSignal;
-    boost::signals2::connection connectBotChanged(BotChangedSignal::slot_type subscriber)
+    typedef Signal<void (Bot const & bot)> BotChangedSignal;
+    SignalConnection connectBotChanged(BotChangedSignal::slot_type subscriber)
     { return botChangedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Bot const & bot)> BotRemovedSignal;
-    boost::signals2::connection connectBotRemoved(BotRemovedSignal::slot_type subscriber)
+    typedef Signal<void (Bot const & bot)> BotRemovedSignal;
+    SignalConnection connectBotRemoved(BotRemovedSignal::slot_type subscriber)
     { return botRemovedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & userName, std::string const & msg)> BattleChatMsgSignal;
-    boost::signals2::connection connectBattleChatMsg(BattleChatMsgSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & userName, std::string const & msg)> BattleChatMsgSignal;
+    SignalConnection connectBattleChatMsg(BattleChatMsgSignal::slot_type subscriber)
     { return battleChatMsgSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void ()> SpringExitSignal;
-    boost::signals2::connection connectSpringExit(SpringExitSignal::slot_type subscriber)
+    typedef Signal<void ()> SpringExitSignal;
+    SignalConnection connectSpringExit(SpringExitSignal::slot_type subscriber)
     { return springExitSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (DownloadType downloadType, std::string const & name, bool success)> DownloadDoneSignal;
-    boost::signals2::connection connectDownloadDone(DownloadDoneSignal::slot_type subscriber)
+    typedef Signal<void (DownloadType downloadType, std::string const & name, bool success)> DownloadDoneSignal;
+    SignalConnection connectDownloadDone(DownloadDoneSignal::slot_type subscriber)
     { return downloadDoneSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & msg, int interest)> ServerMsgSignal;
-    boost::signals2::connection connectServerMsg(ServerMsgSignal::slot_type subscriber)
+    // only for in-process downloads, bytes are uncompressed, total grows while dependencies are found
+    typedef Signal<void (DownloadType downloadType, std::string const & name, uint64_t bytesDone, uint64_t bytesTotal)> DownloadProgressSignal;
+    SignalConnection connectDownloadProgress(DownloadProgressSignal::slot_type subscriber)
+    { return downloadProgressSignal_.connect(subscriber); }
+
+    typedef Signal<void (std::string const & msg, int interest)> ServerMsgSignal;
+    SignalConnection connectServerMsg(ServerMsgSignal::slot_type subscriber)
     { return serverMsgSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & userName, std::string const & msg)> SayPrivateSignal;
-    boost::signals2::connection connectSayPrivate(SayPrivateSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & userName, std::string const & msg)> SayPrivateSignal;
+    SignalConnection connectSayPrivate(SayPrivateSignal::slot_type subscriber)
     { return sayPrivateSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & userName, std::string const & msg)> SaidPrivateSignal;
-    boost::signals2::connection connectSaidPrivate(SaidPrivateSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & userName, std::string const & msg)> SaidPrivateSignal;
+    SignalConnection connectSaidPrivate(SaidPrivateSignal::slot_type subscriber)
     { return saidPrivateSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (Channels const &)> ChannelsSignal;
-    boost::signals2::connection connectChannels(ChannelsSignal::slot_type subscriber)
+    typedef Signal<void (Channels const &)> ChannelsSignal;
+    SignalConnection connectChannels(ChannelsSignal::slot_type subscriber)
     { return channelsSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName)> ChannelJoinedSignal;
-    boost::signals2::connection connectChannelJoined(ChannelJoinedSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName)> ChannelJoinedSignal;
+    SignalConnection connectChannelJoined(ChannelJoinedSignal::slot_type subscriber)
     { return channelJoinedSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::string const & author, time_t epochSeconds, std::string const & topic)> ChannelTopicSignal;
-    boost::signals2::connection connectChannelTopicSignal(ChannelTopicSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::string const & author, time_t epochSeconds, std::string const & topic)> ChannelTopicSignal;
+    SignalConnection connectChannelTopicSignal(ChannelTopicSignal::slot_type subscriber)
     { return channelTopicSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::string const & message)> ChannelMessageSignal;
-    boost::signals2::connection connectChannelMessageSignal(ChannelMessageSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::string const & message)> ChannelMessageSignal;
+    SignalConnection connectChannelMessageSignal(ChannelMessageSignal::slot_type subscriber)
     { return channelMessageSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::vector<std::string> const & clients)> ChannelClientsSignal;
-    boost::signals2::connection connectChannelClients(ChannelClientsSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::vector<std::string> const & clients)> ChannelClientsSignal;
+    SignalConnection connectChannelClients(ChannelClientsSignal::slot_type subscriber)
     { return channelClientsSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::string const & userName)> UserJoinedChannelSignal;
-    boost::signals2::connection connectUserJoinedChannel(UserJoinedChannelSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::string const & userName)> UserJoinedChannelSignal;
+    SignalConnection connectUserJoinedChannel(UserJoinedChannelSignal::slot_type subscriber)
     { return userJoinedChannelSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::string const & userName, std::string const & reason)> UserLeftChannelSignal;
-    boost::signals2::connection connectUserLeftChannel(UserLeftChannelSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::string const & userName, std::string const & reason)> UserLeftChannelSignal;
+    SignalConnection connectUserLeftChannel(UserLeftChannelSignal::slot_type subscriber)
     { return userLeftChannelSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & channelName, std::string const & userName, std::string const & message)> SaidChannelSignal;
-    boost::signals2::connection connectSaidChannel(SaidChannelSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & channelName, std::string const & userName, std::string const & message)> SaidChannelSignal;
+    SignalConnection connectSaidChannel(SaidChannelSignal::slot_type subscriber)
     { return saidChannelSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & userName)> RingSignal;
-    boost::signals2::connection connectRing(RingSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & userName)> RingSignal;
+    SignalConnection connectRing(RingSignal::slot_type subscriber)
     { return ringSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (StartRect const & startRect)> AddStartRectSignal;
-    boost::signals2::connection connectAddStartRect(AddStartRectSignal::slot_type subscriber)
+    typedef Signal<void (StartRect const & startRect)> AddStartRectSignal;
+    SignalConnection connectAddStartRect(AddStartRectSignal::slot_type subscriber)
     { return addStartRectSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (int ally)> RemoveStartRectSignal;
-    boost::signals2::connection connectRemoveStartRect(RemoveStartRectSignal::slot_type subscriber)
+    typedef Signal<void (int ally)> RemoveStartRectSignal;
+    SignalConnection connectRemoveStartRect(RemoveStartRectSignal::slot_type subscriber)
     { return removeStartRectSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & key, std::string const & value)> SetScriptTagSignal;
-    boost::signals2::connection connectSetScriptTag(SetScriptTagSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & key, std::string const & value)> SetScriptTagSignal;
+    SignalConnection connectSetScriptTag(SetScriptTagSignal::slot_type subscriber)
     { return setScriptTagSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const & key)> RemoveScriptTagSignal;
-    boost::signals2::connection connectRemoveScriptTag(RemoveScriptTagSignal::slot_type subscriber)
+    typedef Signal<void (std::string const & key)> RemoveScriptTagSignal;
+    SignalConnection connectRemoveScriptTag(RemoveScriptTagSignal::slot_type subscriber)
     { return removeScriptTagSignal_.connect(subscriber); }
 
-    typedef boost::signals2::signal<void (std::string const& engineVersion, std::string const& demoFile)> StartDemoSignal;
-    boost::signals2::connection connectStartDemo(StartDemoSignal::slot_type subscriber)
+    typedef Signal<void (std::string const& engineVersion, std::string const& demoFile)> StartDemoSignal;
+    SignalConnection connectStartDemo(StartDemoSignal::slot_type subscriber)
     { return startDemoSignal_.connect(subscriber); }
 
 private:
@@ -292,6 +343,9 @@ private:
     uint64_t timePingSent_;
     int waitingForPong_;
     std::unique_ptr<UnitSync> unitSync_;
+    // unitsync checksums by name, cleared in refresh
+    ChecksumCache modChecksums_;
+    ChecksumCache mapChecksums_;
 
     std::string writeableDataDir_;
     std::string userName_;
@@ -317,22 +371,32 @@ private:
     std::string prDownloaderCmd_;
     Script script_;
 
-    int runProcess(std::string const& cmd, bool logToFile);
+    int runProcess(std::vector<std::string> const& args, bool logToFile); // returns exit code, -1 if process could not be started
 
     unsigned int prDownloadExternal(std::string const& name, DownloadType type); // returns >0 if download attempt is done
 
-    // TODO disabled for now
-    //int prDownloadInternal(std::string const& name, DownloadType type);
+    // rapid games are downloaded in-process, maps and engines still need pr-downloader
+    std::shared_ptr<Downloader> downloader_; // shared with running download job
+    bool prDownloadInternal_; // prDownloaderId_ is an in-process download
+    unsigned int prDownloadInternal(std::string const& name); // returns >0 if download is started
+    void pollDownloadProgress();
+
+    std::map<unsigned int, std::function<void (int)> > jobs_; // runJob id -> done
+
+    unsigned int poolCheckId_; // 0 if not running
+    std::shared_ptr<PoolScanner::Report> poolCheckReport_; // written by the check thread
 
     // IControllerEvent
     //
     void connected(bool connected);
     void message(std::string const & msg);
+    void messageBatchDone();
     void processDone(std::pair<unsigned int, int> idRetPair);
 
     ConnectedSignal connectedSignal_;
     ServerInfoSignal serverInfoSignal_;
     LoginResultSignal loginResultSignal_;
+    ReconnectedSignal reconnectedSignal_;
     RegisterResultSignal registerResultSignal_;
     AgreementSignal agreementSignal_;
     UserJoinedSignal userJoinedSignal_;
@@ -341,6 +405,9 @@ private:
     BattleOpenedSignal battleOpenedSignal_;
     BattleClosedSignal battleClosedSignal_;
     BattleChangedSignal battleChangedSignal_;
+    UsersChangedSignal usersChangedSignal_;
+    ChannelUsersChangedSignal channelUsersChangedSignal_;
+    BattlesChangedSignal battlesChangedSignal_;
     BattleJoinedSignal battleJoinedSignal_;
     JoinBattleFailedSignal joinBattleFailedSignal_;
     UserJoinedBattleSignal userJoinedBattleSignal_;
@@ -351,6 +418,7 @@ private:
     BattleChatMsgSignal battleChatMsgSignal_;
     SpringExitSignal springExitSignal_;
     DownloadDoneSignal downloadDoneSignal_;
+    DownloadProgressSignal downloadProgressSignal_;
     ServerMsgSignal serverMsgSignal_;
     SayPrivateSignal sayPrivateSignal_;
     SaidPrivateSignal saidPrivateSignal_;
@@ -370,12 +438,47 @@ private:
     StartDemoSignal startDemoSignal_;
 
     void attemptLogin();
+
+    // automatic reconnect
+    std::string host_;
+    std::string port_;
+    bool autoReconnect_;
+    bool userDisconnect_; // disconnect was requested, do not reconnect
+    bool reconnecting_;
+    int reconnectAttempt_;
+    unsigned int reconnectGeneration_; // increased when reconnecting stops, invalidates pending reconnect timer
+    bool resync_;
+    std::map<std::string, std::string> joinedChannels_; // channel name -> password, rejoined after reconnect
+    std::set<std::string> rejoinedChannels_; // rejoined after reconnect, next joinChannel of these is not sent again
+    int rejoinBattleId_;
+    std::string battlePassword_;
+    void scheduleReconnect();
+    void reconnect(unsigned int generation);
+    void stopReconnect();
+    void rejoin(); // pipelined right after login is accepted
+    void finishResync();
+    void resetSession(); // forget users, battles and login
     void processServerMsg(const std::string & msg);
 
     typedef std::map<std::string, std::shared_ptr<User>> Users;
     Users users_;
 
-    std::map<int, std::shared_ptr<Battle>> battles_;
+    typedef std::map<int, std::shared_ptr<Battle>> Battles;
+    Battles battles_;
+
+    // state of the lost connection during resync login burst, see resyncPending
+    Users snapshotUsers_;
+    Battles snapshotBattles_;
+
+    ChannelMembers channelMembers_;
+
+    // changed since last messageBatchDone, see UsersChangedSignal and BattlesChangedSignal
+    std::set<std::string> dirtyUsers_;
+    std::set<int> dirtyBattles_;
+    void markUserDirty(User const & user);
+    void channelUsersChanged(std::vector<User const *> const & users);
+    void addChannelMembers(std::string const & channelName);
+    void markBattleDirty(Battle const & battle);
 
     std::ostringstream agreementStream_;
 
@@ -396,11 +499,20 @@ private:
     int calcSync(Battle const & battle);
     void updateSync();
 
+    ArchivePrefetch archivePrefetch_;
+    void prefetchArchives(Battle const & battle); // warms page cache for game start, only when synced
+
     void meInGame(bool inGame);
 
     void sendUpdateBot(std::string const& name, UserBattleStatus const& ubs, int color);
 
-    typedef std::unordered_map<std::string, std::function<void (std::istream &)>> MessageHandlers;
+    struct MessageHandler
+    {
+        std::function<void (std::istream &)> handle_;
+        MetricsCounter * received_; // "server.msg.<command>"
+        char const * command_; // trace span name
+    };
+    typedef std::unordered_map<std::string, MessageHandler> MessageHandlers;
     MessageHandlers messageHandlers_;
     MessageHandlers messageHandlersZerok_;
 
@@ -0,0 +1,544 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "PoolScanner.h"
+#include "Downloader.h"
+#include "log/Log.h"
+#include "md5/md5.h"
+
+#include <zlib.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+std::size_t const readSize = 1 << 20; // large sequential reads
+std::size_t const chunkSize = 256 << 10; // inflated bytes hashed per round, multiple of 64
+
+struct FileId
+{
+    uint64_t inode_;
+    int64_t mtime_;
+    uint64_t size_;
+
+    bool operator==(FileId const & other) const
+    {
+        return inode_ == other.inode_ && mtime_ == other.mtime_ && size_ == other.size_;
+    }
+};
+
+bool fileId(std::string const & path, FileId & id)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    id.inode_ = st.st_ino;
+    id.mtime_ = st.st_mtime;
+    id.size_ = st.st_size;
+    return true;
+}
+
+// path -> id of the file when it was verified
+typedef std::unordered_map<std::string, FileId> Cache;
+
+Cache loadCache(std::string const & path)
+{
+    Cache cache;
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        // inode mtime size path
+        std::istringstream iss(line);
+        FileId id;
+        std::string file;
+        if (iss >> id.inode_ >> id.mtime_ >> id.size_ && std::getline(iss >> std::ws, file))
+        {
+            cache[file] = id;
+        }
+    }
+    return cache;
+}
+
+void saveCache(std::string const & path, Cache const & cache)
+{
+    std::string const tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp);
+        for (auto const & pair : cache)
+        {
+            FileId const & id = pair.second;
+            ofs << id.inode_ << ' ' << id.mtime_ << ' ' << id.size_ << ' ' << pair.first << '\n';
+        }
+        if (!ofs.good())
+        {
+            LOG(WARNING) << "writing pool scan cache failed: " << tmp;
+            return;
+        }
+    }
+    boost::system::error_code ec;
+    fs::rename(tmp, path, ec);
+    LOG_IF(WARNING, ec) << "renaming pool scan cache failed: " << ec.message();
+}
+
+// one file being inflated and hashed
+class Lane
+{
+public:
+    Lane(): fd_(-1), in_(readSize), out_(chunkSize) {}
+    ~Lane() { close(); }
+
+    bool active() const { return fd_ != -1; }
+
+    void open(std::string const & path, std::size_t item)
+    {
+        item_ = item;
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        error_ = (fd_ == -1);
+        end_ = false;
+        eof_ = false;
+        outSize_ = 0;
+        bytesRead_ = 0;
+        if (fd_ == -1)
+        {
+            return;
+        }
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        std::memset(&zs_, 0, sizeof(zs_));
+        if (::inflateInit2(&zs_, 16 + MAX_WBITS) != Z_OK) // gzip header
+        {
+            ::close(fd_);
+            fd_ = -1;
+            error_ = true;
+            return;
+        }
+        md5_init(&md5_);
+    }
+
+    void close()
+    {
+        if (fd_ != -1)
+        {
+            ::inflateEnd(&zs_);
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // inflates up to chunkSize bytes into out
+    void produce()
+    {
+        outSize_ = 0;
+        while (!done() && outSize_ < chunkSize)
+        {
+            if (zs_.avail_in == 0)
+            {
+                if (eof_)
+                {
+                    error_ = true; // truncated
+                    return;
+                }
+                ssize_t const n = ::read(fd_, in_.data(), in_.size());
+                if (n < 0)
+                {
+                    error_ = true;
+                    return;
+                }
+                bytesRead_ += n;
+                eof_ = (n == 0);
+                zs_.next_in = reinterpret_cast<Bytef *>(in_.data());
+                zs_.avail_in = n;
+                continue;
+            }
+            zs_.next_out = reinterpret_cast<Bytef *>(out_.data() + outSize_);
+            zs_.avail_out = chunkSize - outSize_;
+            int const ret = ::inflate(&zs_, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+            {
+                error_ = true;
+                return;
+            }
+            outSize_ = chunkSize - zs_.avail_out;
+            end_ = (ret == Z_STREAM_END);
+        }
+    }
+
+    bool done() const { return end_ || error_; }
+    bool full() const { return outSize_ == chunkSize; }
+    md5_byte_t const * out() const { return reinterpret_cast<md5_byte_t const *>(out_.data()); }
+    std::size_t outSize() const { return outSize_; }
+    md5_state_t * md5() { return &md5_; }
+
+    std::size_t item() const { return item_; }
+    uint64_t bytesRead() const { return bytesRead_; }
+
+    std::string result() // md5 hex, empty if corrupt
+    {
+        if (error_ || !end_)
+        {
+            return std::string();
+        }
+        md5_byte_t digest[16];
+        md5_finish(&md5_, digest);
+        return Downloader::md5Hex(digest);
+    }
+
+private:
+    int fd_;
+    z_stream zs_;
+    md5_state_t md5_;
+    std::vector<char> in_;
+    std::vector<char> out_;
+    std::size_t outSize_;
+    std::size_t item_;
+    uint64_t bytesRead_;
+    bool eof_;
+    bool end_;
+    bool error_;
+};
+
+// hashes paths[next++] until all are done, results[i] is md5 hex of paths[i] or empty if corrupt
+void verifyWorker(std::vector<std::string> const & paths, std::vector<std::string> & results,
+    std::atomic<std::size_t> & next, std::atomic<uint64_t> & bytesRead)
+{
+    Lane lanes[MD5_LANES];
+
+    for (;;)
+    {
+        int active = 0;
+        for (Lane & lane : lanes)
+        {
+            while (!lane.active())
+            {
+                std::size_t const item = next++;
+                if (item >= paths.size())
+                {
+                    break;
+                }
+                lane.open(paths[item], item);
+                if (!lane.active())
+                {
+                    results[item].clear(); // can't open
+                }
+            }
+            active += lane.active() ? 1 : 0;
+        }
+        if (active == 0)
+        {
+            return;
+        }
+
+        bool allFull = (active == MD5_LANES);
+        for (Lane & lane : lanes)
+        {
+            if (lane.active())
+            {
+                lane.produce();
+                allFull &= lane.full();
+            }
+        }
+
+        if (allFull)
+        {
+            md5_state_t * states[MD5_LANES];
+            md5_byte_t const * data[MD5_LANES];
+            for (int l = 0; l < MD5_LANES; ++l)
+            {
+                states[l] = lanes[l].md5();
+                data[l] = lanes[l].out();
+            }
+            md5_append_lanes(states, data, chunkSize);
+        }
+        else
+        {
+            for (Lane & lane : lanes)
+            {
+                if (lane.active())
+                {
+                    md5_append(lane.md5(), lane.out(), lane.outSize());
+                }
+            }
+        }
+
+        for (Lane & lane : lanes)
+        {
+            if (lane.active() && lane.done())
+            {
+                results[lane.item()] = lane.result();
+                bytesRead += lane.bytesRead();
+                lane.close();
+            }
+        }
+    }
+}
+
+struct PoolFile
+{
+    std::string path_;
+    std::string md5_; // from name
+    std::size_t dataDir_;
+    FileId id_;
+    bool ok_;
+};
+
+PoolScanner::Report listingFailed(std::string const & dir, boost::system::error_code const & ec)
+{
+    PoolScanner::Report report;
+    report.error_ = "listing " + dir + " failed: " + ec.message();
+    LOG(WARNING) << report.summary();
+    return report;
+}
+
+}
+
+PoolScanner::Report::Report():
+    poolFiles_(0),
+    cachedFiles_(0),
+    packages_(0),
+    bytesRead_(0)
+{
+}
+
+std::string PoolScanner::Report::summary() const
+{
+    if (!error_.empty())
+    {
+        return "game file check aborted, " + error_;
+    }
+    std::ostringstream oss;
+    oss << "checked " << poolFiles_ << " pool files (" << cachedFiles_ << " unchanged) and " << packages_ << " packages: "
+        << corruptFiles_.size() << " corrupt files, " << brokenPackages_.size() << " broken packages";
+    if (!removed_.empty())
+    {
+        oss << ", removed " << removed_.size() << " files";
+    }
+    return oss.str();
+}
+
+PoolScanner::PoolScanner(std::vector<std::string> const & dataDirs, std::string const & cachePath, unsigned int threads):
+    dataDirs_(dataDirs),
+    cachePath_(cachePath),
+    threads_(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    for (std::string & dir : dataDirs_)
+    {
+        if (!dir.empty() && dir.back() != '/')
+        {
+            dir += '/';
+        }
+    }
+}
+
+PoolScanner::Report PoolScanner::scan(bool repair)
+{
+    Report report;
+    Cache const cache = cachePath_.empty() ? Cache() : loadCache(cachePath_);
+    boost::system::error_code ec;
+
+    // pool/xx/<30 hex>.gz
+    std::vector<PoolFile> files;
+    std::vector<std::string> verifyPaths;
+    std::vector<std::size_t> verifyFiles; // index in files
+    for (std::size_t d = 0; d < dataDirs_.size(); ++d)
+    {
+        // a file not listed would look missing and repair would remove its packages, so listing errors abort
+        fs::path const pool(dataDirs_[d] + "pool");
+        boost::system::error_code listEc;
+        fs::recursive_directory_iterator it(pool, listEc), end;
+        if (listEc == boost::system::errc::no_such_file_or_directory)
+        {
+            continue;
+        }
+        for (; !listEc && it != end; it.increment(listEc))
+        {
+            fs::path const & path = it->path();
+            std::string const md5 = path.parent_path().filename().string() + path.stem().string();
+            if (path.extension() != ".gz" || md5.size() != 32 || !fs::is_regular_file(path, ec))
+            {
+                continue;
+            }
+
+            PoolFile file;
+            file.path_ = path.string();
+            file.md5_ = boost::to_lower_copy(md5);
+            file.dataDir_ = d;
+            file.ok_ = false;
+            if (!fileId(file.path_, file.id_))
+            {
+                continue;
+            }
+
+            auto const cached = cache.find(file.path_);
+            if (cached != cache.end() && cached->second == file.id_)
+            {
+                file.ok_ = true;
+                ++report.cachedFiles_;
+            }
+            else
+            {
+                verifyPaths.push_back(file.path_);
+                verifyFiles.push_back(files.size());
+            }
+            files.push_back(file);
+        }
+        if (listEc)
+        {
+            return listingFailed(pool.string(), listEc);
+        }
+    }
+    report.poolFiles_ = files.size();
+
+    // verify changed files, one worker per core
+    std::vector<std::string> results(verifyPaths.size());
+    std::atomic<std::size_t> next(0);
+    std::atomic<uint64_t> bytesRead(0);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < std::min<std::size_t>(threads_, verifyPaths.size()); ++i)
+    {
+        threads.emplace_back([&]() { verifyWorker(verifyPaths, results, next, bytesRead); });
+    }
+    verifyWorker(verifyPaths, results, next, bytesRead);
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+    report.bytesRead_ = bytesRead;
+
+    Cache newCache;
+    std::vector<std::set<std::string>> okMd5s(dataDirs_.size());
+    for (std::size_t i = 0; i < verifyFiles.size(); ++i)
+    {
+        PoolFile & file = files[verifyFiles[i]];
+        file.ok_ = (results[i] == file.md5_);
+    }
+    for (PoolFile const & file : files)
+    {
+        if (file.ok_)
+        {
+            okMd5s[file.dataDir_].insert(file.md5_);
+            newCache[file.path_] = file.id_;
+        }
+        else
+        {
+            report.corruptFiles_.push_back(file.path_);
+        }
+    }
+
+    // packages/<md5>.sdp
+    for (std::size_t d = 0; d < dataDirs_.size(); ++d)
+    {
+        fs::path const packages(dataDirs_[d] + "packages");
+        boost::system::error_code listEc;
+        fs::directory_iterator it(packages, listEc), end;
+        if (listEc == boost::system::errc::no_such_file_or_directory)
+        {
+            continue;
+        }
+        for (; !listEc && it != end; it.increment(listEc))
+        {
+            fs::path const & path = it->path();
+            if (path.extension() != ".sdp")
+            {
+                continue;
+            }
+            ++report.packages_;
+
+            bool ok = false;
+            try
+            {
+                std::ifstream ifs(path.string(), std::ios::binary);
+                std::string const data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+                std::vector<Downloader::PoolFile> const poolFiles = Downloader::parseSdp(Downloader::gunzip(data));
+                ok = (Downloader::packageMd5(poolFiles) == boost::to_lower_copy(path.stem().string()));
+                for (Downloader::PoolFile const & poolFile : poolFiles)
+                {
+                    ok &= (okMd5s[d].count(poolFile.md5Hex()) != 0);
+                }
+            }
+            catch (std::exception const & e)
+            {
+                LOG(WARNING) << "package " << path.string() << ": " << e.what();
+            }
+
+            if (!ok)
+            {
+                report.brokenPackages_.push_back(path.string());
+            }
+        }
+        if (listEc)
+        {
+            return listingFailed(packages.string(), listEc);
+        }
+    }
+
+    std::sort(report.corruptFiles_.begin(), report.corruptFiles_.end());
+    std::sort(report.brokenPackages_.begin(), report.brokenPackages_.end());
+
+    if (repair)
+    {
+        std::vector<std::string> remove = report.corruptFiles_;
+        remove.insert(remove.end(), report.brokenPackages_.begin(), report.brokenPackages_.end());
+        for (std::string const & path : remove)
+        {
+            if (fs::remove(path, ec))
+            {
+                report.removed_.push_back(path);
+            }
+            LOG_IF(WARNING, ec) << "removing " << path << " failed: " << ec.message();
+        }
+    }
+
+    if (!cachePath_.empty())
+    {
+        for (auto const & pair : cache)
+        {
+            if (!scanned(pair.first))
+            {
+                newCache.insert(pair);
+            }
+        }
+        saveCache(cachePath_, newCache);
+    }
+
+    LOG(INFO) << report.summary() << ", read " << (report.bytesRead_ >> 20) << " MB";
+    return report;
+}
+
+std::string PoolScanner::verifyFile(std::string const & path, uint64_t & bytesRead)
+{
+    std::vector<std::string> const paths = { path };
+    std::vector<std::string> results(1);
+    std::atomic<std::size_t> next(0);
+    std::atomic<uint64_t> bytes(0);
+    verifyWorker(paths, results, next, bytes);
+    bytesRead = bytes;
+    return results[0];
+}
+
+bool PoolScanner::scanned(std::string const & path) const
+{
+    for (std::string const & dir : dataDirs_)
+    {
+        if (boost::starts_with(path, dir + "pool/"))
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// verifies the rapid pool and package files (packages/*.sdp) of spring data dirs
+// pool files are gzipped and named by the md5 of their content, they are inflated and hashed
+// by one worker per core, each worker hashes MD5_LANES files in lockstep (md5_append_lanes)
+// files verified before are skipped while their inode, mtime and size are unchanged
+class PoolScanner
+{
+public:
+    struct Report
+    {
+        Report();
+
+        unsigned int poolFiles_; // pool files found
+        unsigned int cachedFiles_; // of poolFiles_ skipped, unchanged since verified
+        unsigned int packages_;
+        uint64_t bytesRead_;
+        std::vector<std::string> corruptFiles_; // pool files not matching their name
+        std::vector<std::string> brokenPackages_; // package files corrupt or referencing missing or corrupt pool files
+        std::vector<std::string> removed_; // by repair
+        std::string error_; // a directory could not be listed, the scan was aborted and nothing was removed
+
+        std::string summary() const; // one line
+    };
+
+    // cachePath is where verified files are remembered, empty to always verify all
+    // the cache may be shared, entries of other data dirs are kept
+    PoolScanner(std::vector<std::string> const & dataDirs, std::string const & cachePath, unsigned int threads = 0);
+
+    // repair removes corrupt pool files and broken package files, so the game is seen as missing and can be downloaded again
+    Report scan(bool repair);
+
+    static std::string verifyFile(std::string const & path, uint64_t & bytesRead); // returns md5 hex of gunzipped content, empty if corrupt
+
+private:
+    bool scanned(std::string const & path) const; // path is below the pool of one of dataDirs_
+
+    std::vector<std::string> dataDirs_;
+    std::string cachePath_;
+    unsigned int threads_;
+};
@@ -0,0 +1,303 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#include "Process.h"
+#include "log/Log.h"
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+extern char **environ;
+
+namespace
+{
+
+// posix_spawn file actions, destroyed with scope
+class FileActions
+{
+public:
+    FileActions() { ::posix_spawn_file_actions_init(&fa_); }
+    ~FileActions() { ::posix_spawn_file_actions_destroy(&fa_); }
+    posix_spawn_file_actions_t * get() { return &fa_; }
+
+private:
+    posix_spawn_file_actions_t fa_;
+};
+
+pid_t spawn(std::vector<std::string> const & args, posix_spawn_file_actions_t * fa)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("empty command");
+    }
+
+    std::vector<char*> argv;
+    for (std::string const & arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int const err = ::posix_spawnp(&pid, argv[0], fa, nullptr, argv.data(), environ);
+    if (err != 0)
+    {
+        throw std::runtime_error("failed to start " + args[0] + ": " + std::strerror(err));
+    }
+    return pid;
+}
+
+int exitCode(int status)
+{
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status))
+    {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+int waitChild(pid_t pid)
+{
+    int status;
+    while (::waitpid(pid, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
+        }
+    }
+    return exitCode(status);
+}
+
+// one thread reaps all detached children, it only waits for their pids so waitChild of Process::run is not disturbed
+// started with the first child, joined at exit
+class DetachedReaper
+{
+public:
+    DetachedReaper(): stop_(false) {}
+
+    ~DetachedReaper()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    void add(pid_t pid)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pids_.push_back(pid);
+            if (!thread_.joinable())
+            {
+                thread_ = std::thread(&DetachedReaper::run, this);
+            }
+        }
+        cond_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<pid_t> pids_;
+    bool stop_;
+    std::thread thread_;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_)
+        {
+            pids_.erase(std::remove_if(pids_.begin(), pids_.end(), [](pid_t pid)
+                {
+                    int status;
+                    return ::waitpid(pid, &status, WNOHANG) != 0; // exited or not our child anymore
+                }), pids_.end());
+
+            // children are short lived sound commands, they are only polled while there are any
+            if (pids_.empty())
+            {
+                cond_.wait(lock, [this]() { return stop_ || !pids_.empty(); });
+            }
+            else
+            {
+                cond_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stop_; });
+            }
+        }
+    }
+};
+
+DetachedReaper & detachedReaper()
+{
+    static DetachedReaper reaper;
+    return reaper;
+}
+
+}
+
+std::vector<std::string> Process::splitArgs(std::string const & cmdLine)
+{
+    std::vector<std::string> args;
+    std::string arg;
+    bool inArg = false;
+    char quote = 0;
+
+    for (std::size_t i = 0; i < cmdLine.size(); ++i)
+    {
+        char const c = cmdLine[i];
+
+        if (quote == '\'')
+        {
+            if (c == '\'') quote = 0;
+            else arg += c;
+        }
+        else if (quote == '"')
+        {
+            if (c == '"') quote = 0;
+            else if (c == '\\' && i+1 < cmdLine.size() && std::strchr("\"\\$`", cmdLine[i+1])) arg += cmdLine[++i];
+            else arg += c;
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+            inArg = true;
+        }
+        else if (c == '\\' && i+1 < cmdLine.size())
+        {
+            arg += cmdLine[++i];
+            inArg = true;
+        }
+        else if (c == ' ' || c == '\t' || c == '\n')
+        {
+            if (inArg)
+            {
+                args.push_back(arg);
+                arg.clear();
+                inArg = false;
+            }
+        }
+        else
+        {
+            arg += c;
+            inArg = true;
+        }
+    }
+
+    LOG_IF(WARNING, quote != 0) << "unterminated quote: " << cmdLine;
+    if (inArg)
+    {
+        args.push_back(arg);
+    }
+    return args;
+}
+
+int Process::run(std::vector<std::string> const & args, std::string const & logFile, LineFunction lineFunction)
+{
+    FileActions fa;
+
+    if (logFile.empty() && !lineFunction)
+    {
+        ::posix_spawn_file_actions_addopen(fa.get(), 1, "/dev/null", O_WRONLY, 0);
+        ::posix_spawn_file_actions_adddup2(fa.get(), 1, 2);
+        return waitChild(spawn(args, fa.get()));
+    }
+
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) != 0)
+    {
+        throw std::runtime_error(std::string("pipe failed: ") + std::strerror(errno));
+    }
+
+    // dup2 clears close on exec for the child's copies
+    ::posix_spawn_file_actions_adddup2(fa.get(), fds[1], 1);
+    ::posix_spawn_file_actions_adddup2(fa.get(), fds[1], 2);
+
+    pid_t pid;
+    try
+    {
+        pid = spawn(args, fa.get());
+    }
+    catch (...)
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        throw;
+    }
+    ::close(fds[1]);
+
+    std::ofstream log;
+    if (!logFile.empty())
+    {
+        log.open(logFile, std::ios::app);
+        LOG_IF(WARNING, !log) << "failed to open " << logFile;
+    }
+
+    // the calling thread waits for the child anyway, so a blocking read until EOF is enough
+    char buf[4096];
+    std::string line;
+    for (;;)
+    {
+        ssize_t const n = ::read(fds[0], buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        if (log)
+        {
+            log.write(buf, n);
+            log.flush();
+        }
+
+        if (lineFunction)
+        {
+            // progress output often uses \r to redraw the same line
+            for (ssize_t i = 0; i < n; ++i)
+            {
+                if (buf[i] == '\n' || buf[i] == '\r')
+                {
+                    if (!line.empty()) lineFunction(line);
+                    line.clear();
+                }
+                else
+                {
+                    line += buf[i];
+                }
+            }
+        }
+    }
+    ::close(fds[0]);
+
+    if (lineFunction && !line.empty())
+    {
+        lineFunction(line);
+    }
+
+    return waitChild(pid);
+}
+
+void Process::spawnDetached(std::vector<std::string> const & args)
+{
+    FileActions fa;
+    ::posix_spawn_file_actions_addopen(fa.get(), 1, "/dev/null", O_WRONLY, 0);
+    ::posix_spawn_file_actions_adddup2(fa.get(), 1, 2);
+    detachedReaper().add(spawn(args, fa.get()));
+}
@@ -0,0 +1,26 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// child processes started with posix_spawnp, no shell is involved
+class Process
+{
+public:
+    typedef std::function<void (std::string const & line)> LineFunction;
+
+    // splits a command line into arguments, single and double quotes and backslash work like in the shell
+    // no other shell expansion is done, an unterminated quote is closed at end of cmdLine
+    static std::vector<std::string> splitArgs(std::string const & cmdLine);
+
+    // runs args[0] (searched in PATH) and waits for it to exit
+    // stdout and stderr are appended to logFile and passed line by line to lineFunction, discarded if neither is set
+    // returns exit code or 128+signal if child was killed, throws if child could not be started
+    static int run(std::vector<std::string> const & args, std::string const & logFile, LineFunction lineFunction = LineFunction());
+
+    // starts args[0] with output discarded and returns at once, finished children are reaped by one thread
+    static void spawnDetached(std::vector<std::string> const & args);
+};
@@ -0,0 +1,293 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+#pragma once
+
+#include "log/Metrics.h"
+#include "log/Trace.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// single threaded replacement for boost::signals2::signal, only supports void return type
+// no locking and no copy of the slot list when emitting, small callables (e.g. boost::bind of a member function and this)
+// are stored inline in the slot
+// connecting or disconnecting from a slot while the signal is emitted is allowed, new slots are called from next emit
+// a signal given a metrics name records its dispatch time in histogram "signal.<name>" while metrics timing is enabled
+// and a trace span of that name while tracing
+
+template <typename Signature> class SignalSlot;
+
+template <typename... Args>
+class SignalSlot<void (Args...)>
+{
+public:
+    // implicit like boost::signals2 slot_type so a boost::bind result can be passed to connect
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SignalSlot>::value>::type>
+    SignalSlot(F f);
+
+    SignalSlot(SignalSlot const & other);
+    SignalSlot(SignalSlot && other);
+    SignalSlot & operator=(SignalSlot other);
+    ~SignalSlot();
+
+    void operator()(Args... args) { ops_->invoke_(&storage_, args...); }
+
+private:
+    static std::size_t const inlineSize = 4*sizeof(void*);
+    typedef typename std::aligned_storage<inlineSize, alignof(std::max_align_t)>::type Storage;
+
+    struct Ops
+    {
+        void (*invoke_)(void * storage, Args... args);
+        void (*copy_)(void * dst, void const * src);
+        void (*move_)(void * dst, void * src); // leaves src destroyable
+        void (*destroy_)(void * storage);
+    };
+
+    // callable stored in storage_
+    template <typename F>
+    struct InlineOps
+    {
+        static void invoke(void * s, Args... args) { (*static_cast<F*>(s))(args...); }
+        static void copy(void * dst, void const * src) { new (dst) F(*static_cast<F const*>(src)); }
+        static void move(void * dst, void * src) { new (dst) F(std::move(*static_cast<F*>(src))); }
+        static void destroy(void * s) { static_cast<F*>(s)->~F(); }
+        static Ops const ops;
+    };
+
+    // pointer to callable stored in storage_
+    template <typename F>
+    struct HeapOps
+    {
+        static F * get(void * s) { return *static_cast<F**>(s); }
+        static void invoke(void * s, Args... args) { (*get(s))(args...); }
+        static void copy(void * dst, void const * src) { new (dst) F*(new F(**static_cast<F* const*>(src))); }
+        static void move(void * dst, void * src) { new (dst) F*(get(src)); *static_cast<F**>(src) = nullptr; }
+        static void destroy(void * s) { delete get(s); }
+        static Ops const ops;
+    };
+
+    Storage storage_;
+    Ops const * ops_;
+
+    template <typename F> void init(F & f, std::true_type /* fits inline */);
+    template <typename F> void init(F & f, std::false_type);
+};
+
+template <typename... Args>
+template <typename F>
+typename SignalSlot<void (Args...)>::Ops const SignalSlot<void (Args...)>::InlineOps<F>::ops =
+    { &InlineOps<F>::invoke, &InlineOps<F>::copy, &InlineOps<F>::move, &InlineOps<F>::destroy };
+
+template <typename... Args>
+template <typename F>
+typename SignalSlot<void (Args...)>::Ops const SignalSlot<void (Args...)>::HeapOps<F>::ops =
+    { &HeapOps<F>::invoke, &HeapOps<F>::copy, &HeapOps<F>::move, &HeapOps<F>::destroy };
+
+template <typename... Args>
+template <typename F, typename>
+SignalSlot<void (Args...)>::SignalSlot(F f)
+{
+    init(f, std::integral_constant<bool, sizeof(F) <= inlineSize && alignof(F) <= alignof(Storage)>());
+}
+
+template <typename... Args>
+template <typename F>
+void SignalSlot<void (Args...)>::init(F & f, std::true_type)
+{
+    new (&storage_) F(std::move(f));
+    ops_ = &InlineOps<F>::ops;
+}
+
+template <typename... Args>
+template <typename F>
+void SignalSlot<void (Args...)>::init(F & f, std::false_type)
+{
+    new (&storage_) F*(new F(std::move(f)));
+    ops_ = &HeapOps<F>::ops;
+}
+
+template <typename... Args>
+SignalSlot<void (Args...)>::SignalSlot(SignalSlot const & other):
+    ops_(other.ops_)
+{
+    ops_->copy_(&storage_, &other.storage_);
+}
+
+template <typename... Args>
+SignalSlot<void (Args...)>::SignalSlot(SignalSlot && other):
+    ops_(other.ops_)
+{
+    ops_->move_(&storage_, &other.storage_);
+}
+
+template <typename... Args>
+SignalSlot<void (Args...)> & SignalSlot<void (Args...)>::operator=(SignalSlot other)
+{
+    ops_->destroy_(&storage_);
+    ops_ = other.ops_;
+    ops_->move_(&storage_, &other.storage_);
+    return *this;
+}
+
+template <typename... Args>
+SignalSlot<void (Args...)>::~SignalSlot()
+{
+    ops_->destroy_(&storage_);
+}
+
+
+// returned by Signal::connect, can be ignored if the slot is never disconnected
+class SignalConnection
+{
+public:
+    SignalConnection() {}
+    explicit SignalConnection(std::shared_ptr<bool> const & connected): connected_(connected) {}
+
+    void disconnect() const { if (connected_) *connected_ = false; }
+    bool connected() const { return connected_ && *connected_; }
+
+private:
+    std::shared_ptr<bool> connected_;
+};
+
+
+template <typename Signature> class Signal;
+
+template <typename... Args>
+class Signal<void (Args...)>
+{
+public:
+    typedef SignalSlot<void (Args...)> slot_type;
+
+    Signal(): emitting_(0), dispatchTime_(0), traceName_(0) {}
+    Signal(Signal const &) = delete;
+    Signal & operator=(Signal const &) = delete;
+
+    SignalConnection connect(slot_type const & slot);
+    void disconnectAll();
+    bool empty() const;
+    void metricsName(std::string const & name)
+    {
+        dispatchTime_ = &Metrics::histogram("signal." + name);
+        traceName_ = Trace::intern("signal." + name);
+    }
+
+    void operator()(Args... args);
+
+private:
+    struct Entry
+    {
+        Entry(slot_type const & slot, std::shared_ptr<bool> const & connected): slot_(slot), connected_(connected) {}
+        slot_type slot_;
+        std::shared_ptr<bool> connected_;
+    };
+    std::vector<Entry> slots_;
+    std::vector<Entry> pending_; // connected while emitting
+    int emitting_; // > 0 while emitting, slots_ must not change then
+    MetricsHistogram * dispatchTime_;
+    char const * traceName_;
+
+    void commit(); // adds pending_ and removes disconnected slots
+
+    struct EmitGuard
+    {
+        EmitGuard(Signal & signal): signal_(signal) { ++signal_.emitting_; }
+        ~EmitGuard() { if (--signal_.emitting_ == 0) signal_.commit(); }
+        Signal & signal_;
+    };
+};
+
+template <typename... Args>
+SignalConnection Signal<void (Args...)>::connect(slot_type const & slot)
+{
+    std::shared_ptr<bool> connected = std::make_shared<bool>(true);
+    if (emitting_ > 0)
+    {
+        pending_.emplace_back(slot, connected);
+    }
+    else
+    {
+        commit();
+        slots_.emplace_back(slot, connected);
+    }
+    return SignalConnection(connected);
+}
+
+template <typename... Args>
+void Signal<void (Args...)>::disconnectAll()
+{
+    for (Entry & entry : slots_)
+    {
+        *entry.connected_ = false;
+    }
+    pending_.clear();
+    if (emitting_ == 0)
+    {
+        slots_.clear();
+    }
+}
+
+template <typename... Args>
+bool Signal<void (Args...)>::empty() const
+{
+    for (Entry const & entry : slots_)
+    {
+        if (*entry.connected_) return false;
+    }
+    return pending_.empty();
+}
+
+template <typename... Args>
+void Signal<void (Args...)>::operator()(Args... args)
+{
+    if (slots_.empty())
+    {
+        return;
+    }
+
+    MetricsTimer timer(dispatchTime_);
+    TraceSpan span(traceName_, "signal");
+    EmitGuard guard(*this);
+    std::size_t const size = slots_.size();
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        Entry & entry = slots_[i];
+        if (*entry.connected_)
+        {
+            entry.slot_(args...);
+        }
+    }
+}
+
+template <typename... Args>
+void Signal<void (Args...)>::commit()
+{
+    auto it = slots_.begin();
+    for (Entry & entry : slots_)
+    {
+        if (*entry.connected_)
+        {
+            if (&*it != &entry)
+            {
+                *it = std::move(entry);
+            }
+            ++it;
+        }
+    }
+    slots_.erase(it, slots_.end());
+
+    for (Entry & entry : pending_)
+    {
+        if (*entry.connected_)
+        {
+            slots_.push_back(std::move(entry));
+        }
+    }
+    pending_.clear();
+}
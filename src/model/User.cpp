@@ -140,6 +140,19 @@ void User::leftBattle(Battle const & battle)
     joinedBattle_ = -1;
 }
 
+bool User::sameState(User const& other) const
+{
+    return name_ == other.name_
+        && country_ == other.country_
+        && cpu_ == other.cpu_
+        && zkClientType_ == other.zkClientType_
+        && zkAccountID_ == other.zkAccountID_
+        && color_ == other.color_
+        && status_ == other.status_
+        && battleStatus_ == other.battleStatus_
+        && joinedBattle_ == other.joinedBattle_;
+}
+
 void User::print(std::ostream & os) const
 {
     os << "[User:"
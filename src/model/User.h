@@ -45,6 +45,7 @@ public:
 
     bool operator==(User const& other) const;
     bool operator!=(User const& other) const;
+    bool sameState(User const& other) const; // all attributes equal, operator== only compares name
     void print(std::ostream & os) const;
 
 private:
@@ -0,0 +1,90 @@
+// This file is part of flobby (GPL v2 or later), see the LICENSE file
+
+// command line front end of PoolScanner, same check as Other > Verify downloaded games
+
+#include "FlobbyDirs.h"
+#include "model/PoolScanner.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static
+void printUsage(char const* argv0)
+{
+    std::fprintf(stderr,
+        "usage: %s [options] [spring data dir ...]\n"
+        " -r | --repair   : remove corrupt pool files and broken packages\n"
+        " -n | --no-cache : verify all files, also those unchanged since last check\n"
+        " -d | --dir <dir>: use <dir> for flobby cache instead of XDG\n"
+        " -h | --help     : print help message\n"
+        "data dir defaults to ~/.spring\n"
+        "exit code is 0 if all files are ok, 1 if corrupt files were found, 2 if the check failed\n", argv0);
+}
+
+int main(int argc, char * argv[])
+{
+    bool repair = false;
+    bool useCache = true;
+    std::string dir;
+    std::vector<std::string> dataDirs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp("-r", argv[i]) == 0 || std::strcmp("--repair", argv[i]) == 0)
+        {
+            repair = true;
+        }
+        else if (std::strcmp("-n", argv[i]) == 0 || std::strcmp("--no-cache", argv[i]) == 0)
+        {
+            useCache = false;
+        }
+        else if ((std::strcmp("-d", argv[i]) == 0 || std::strcmp("--dir", argv[i]) == 0) && i < argc-1)
+        {
+            dir = argv[++i];
+        }
+        else if (std::strcmp("-h", argv[i]) == 0 || std::strcmp("--help", argv[i]) == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (argv[i][0] == '-')
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            dataDirs.push_back(wordExpand(argv[i]));
+        }
+    }
+
+    if (dataDirs.empty())
+    {
+        dataDirs.push_back(wordExpand("~/.spring"));
+    }
+
+    initDirs(dir);
+    PoolScanner::Report const report = PoolScanner(dataDirs, useCache ? cacheDir() + "pool_check.cache" : "").scan(repair);
+
+    for (std::string const & path : report.corruptFiles_)
+    {
+        std::printf("corrupt file: %s\n", path.c_str());
+    }
+    for (std::string const & path : report.brokenPackages_)
+    {
+        std::printf("broken package: %s\n", path.c_str());
+    }
+    for (std::string const & path : report.removed_)
+    {
+        std::printf("removed: %s\n", path.c_str());
+    }
+    std::printf("%s\n", report.summary().c_str());
+
+    if (!report.error_.empty())
+    {
+        return 2;
+    }
+    return (report.corruptFiles_.empty() && report.brokenPackages_.empty()) ? 0 : 1;
+}
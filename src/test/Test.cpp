@@ -1,25 +1,73 @@
 // This file is part of flobby (GPL v2 or later), see the LICENSE file
 
 #include "model/Model.h"
+#include "model/IController.h"
+#include "model/IControllerEvent.h"
 #include "gui/MyImage.h"
+#include "gui/ImageResize.h"
+#include "gui/BattleFilter.h"
 #include "gui/TextFunctions.h"
+#include "gui/SoundSample.h"
+#include "gui/SoundSettingsDialog.h"
+#include "gui/LogFile.h"
+#include "gui/LogIndex.h"
+#include "gui/Lazy.h"
 #include "log/Log.h"
 #include "FlobbyDirs.h"
 #include "model/Nightwatch.h"
+#include "model/HostMessage.h"
 #include "model/LobbyProtocol.h"
+#include "model/MapAnalysis.h"
+#include "model/StartRect.h"
+#include "model/Signal.h"
+#include "model/Process.h"
+#include "model/ChannelMembers.h"
+#include "model/ArchivePrefetch.h"
+#include "model/ChecksumCache.h"
+#include "model/Downloader.h"
+#include "model/HttpClient.h"
+#include "model/PoolScanner.h"
+#include "md5/md5.h"
+#include "log/Metrics.h"
+#include "log/Trace.h"
+#include "log/Watchdog.h"
+#include "log/StartupPhase.h"
+#include "controller/ThreadPool.h"
+#include "controller/RateLimiter.h"
+#include "controller/HeadlessEventLoop.h"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
+#include <boost/signals2/signal.hpp>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
 #define BOOST_TEST_DYN_LINK // this will define BOOST_TEST_ALTERNATIVE_INIT_API in boost/test/detail/config.hpp
 #define BOOST_TEST_ALTERNATIVE_INIT_API // here for clarity
 #define BOOST_TEST_NO_MAIN
 #include <boost/test/unit_test.hpp>
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <stdexcept>
 #include <sstream>
 #include <string>
 #include <memory>
 #include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <zlib.h>
+#include <unistd.h>
+#ifdef FLOBBY_BENCH_MAGICK
+#include <Magick++.h>
+#endif
 
 static
 bool init_unit_test()
@@ -467,6 +515,701 @@ BOOST_AUTO_TEST_CASE(testBot)
     }
 }
 
+// records what model sends, timers are run by the test
+class FakeController: public IController
+{
+public:
+    FakeController(): event_(0), connects_(0) {}
+
+    void setIControllerEvent(IControllerEvent & iControllerEvent) { event_ = &iControllerEvent; }
+    void connect(std::string const & host, std::string const & service) { ++connects_; }
+    void disconnect() {}
+    void send(std::string const& msg) { sent_.push_back(msg); }
+    uint64_t lastSendTime() const { return 0; }
+    uint64_t timeNow() const { return 0; }
+    unsigned int startThread(boost::function<int()> function, JobLane lane, int priority) { return 0; }
+    bool cancelThread(unsigned int id) { return false; }
+    void startTimer(double seconds, boost::function<void()> function) { timers_.push_back(function); }
+
+    void receive(std::vector<std::string> const & msgs)
+    {
+        for (std::string const & msg : msgs)
+        {
+            event_->message(msg);
+        }
+        event_->messageBatchDone();
+    }
+
+    IControllerEvent * event_;
+    int connects_;
+    std::vector<std::string> sent_;
+    std::vector<boost::function<void()>> timers_;
+};
+
+BOOST_AUTO_TEST_CASE(testReconnectResync)
+{
+    FakeController controller;
+    Model model(controller, false);
+
+    std::vector<std::string> joined, left, changed;
+    std::vector<int> opened, closed, battlesChanged;
+    int loginResults = 0;
+    int reconnects = 0;
+    model.connectUserJoined([&joined](User const & u) { joined.push_back(u.name()); });
+    model.connectUserLeft([&left](User const & u) { left.push_back(u.name()); });
+    model.connectUsersChanged([&changed](std::vector<User const *> const & users) { for (auto u : users) changed.push_back(u->name()); });
+    model.connectBattleOpened([&opened](Battle const & b) { opened.push_back(b.id()); });
+    model.connectBattleClosed([&closed](Battle const & b) { closed.push_back(b.id()); });
+    model.connectBattlesChanged([&battlesChanged](std::vector<Battle const *> const & battles) { for (auto b : battles) battlesChanged.push_back(b->id()); });
+    model.connectLoginResult([&loginResults](bool success, std::string const &) { loginResults += success; });
+    model.connectReconnected([&reconnects]() { ++reconnects; });
+
+    std::string const battle1 = "BATTLEOPENED 1 0 0 alice 1.2.3.4 8452 16 0 0 123 spring\t104.0\tMap\tTitle\tGame";
+    std::string const battle2 = "BATTLEOPENED 2 0 0 bob 1.2.3.4 8453 16 0 0 123 spring\t104.0\tMap\tTitle\tGame";
+
+    model.connect("host", "8200");
+    BOOST_CHECK_EQUAL(1, controller.connects_);
+    controller.event_->connected(true);
+    model.login("me", "pw");
+    controller.receive({ "TASServer 0.37 * 8201 0", "ACCEPTED me",
+        "ADDUSER me SE 0 1", "ADDUSER alice SE 0 2", "ADDUSER bob SE 0 3", battle1, battle2, "LOGININFOEND" });
+    BOOST_CHECK_EQUAL(1, loginResults);
+    model.joinChannel("main");
+    BOOST_CHECK_EQUAL("JOIN main", controller.sent_.back());
+
+    // connection lost, users and battles are kept and reconnect is scheduled
+    controller.event_->connected(false);
+    BOOST_CHECK(model.reconnecting());
+    BOOST_CHECK(model.resyncPending());
+    BOOST_CHECK_EQUAL("alice", model.getUser("alice").name());
+    BOOST_CHECK_EQUAL(2, model.getBattle(2).id());
+    BOOST_REQUIRE_EQUAL(1u, controller.timers_.size());
+    controller.timers_.back()();
+    BOOST_CHECK_EQUAL(2, controller.connects_);
+
+    // login and channel rejoin are sent without waiting for the login burst to end
+    controller.sent_.clear();
+    controller.event_->connected(true);
+    BOOST_REQUIRE_EQUAL(1u, controller.sent_.size());
+    BOOST_CHECK(boost::starts_with(controller.sent_[0], "LOGIN me pw"));
+    controller.receive({ "TASServer 0.37 * 8201 0", "ACCEPTED me" });
+    BOOST_REQUIRE_EQUAL(2u, controller.sent_.size());
+    BOOST_CHECK_EQUAL("JOIN main", controller.sent_[1]);
+    BOOST_CHECK_EQUAL("alice", model.getUser("alice").name()); // previous session still visible during burst
+
+    // bob and his battle are gone, carol is new, alice changed status
+    joined.clear(); changed.clear(); battlesChanged.clear();
+    controller.receive({ "ADDUSER me SE 0 1", "ADDUSER alice SE 0 2", "ADDUSER carol SE 0 4", battle1,
+        "CLIENTSTATUS alice 2", "LOGININFOEND" });
+    BOOST_CHECK_EQUAL(1, loginResults);
+    BOOST_CHECK_EQUAL(1, reconnects);
+    BOOST_CHECK(!model.reconnecting());
+    BOOST_CHECK(!model.resyncPending());
+    BOOST_CHECK(std::vector<std::string>({ "carol" }) == joined);
+    BOOST_CHECK(std::vector<std::string>({ "bob" }) == left);
+    BOOST_CHECK(std::vector<std::string>({ "alice" }) == changed);
+    BOOST_CHECK(opened.empty());
+    BOOST_CHECK(closed == std::vector<int>({ 2 }));
+    BOOST_CHECK(battlesChanged.empty());
+
+    // disconnect stops reconnecting and drops the state
+    model.disconnect();
+    controller.event_->connected(false);
+    BOOST_CHECK(!model.reconnecting());
+    BOOST_CHECK(!model.resyncPending());
+    BOOST_CHECK_THROW(model.getUser("alice"), std::invalid_argument);
+    BOOST_CHECK_EQUAL(1u, controller.timers_.size());
+
+    // login refused after reconnect drops the session instead of retrying
+    model.connect("host", "8200");
+    controller.event_->connected(true);
+    model.login("me", "pw");
+    controller.receive({ "TASServer 0.37 * 8201 0", "ACCEPTED me", "ADDUSER me SE 0 1", "ADDUSER alice SE 0 2", "LOGININFOEND" });
+    controller.event_->connected(false);
+    BOOST_REQUIRE_EQUAL(2u, controller.timers_.size());
+    controller.timers_.back()();
+    controller.event_->connected(true);
+    controller.sent_.clear();
+    controller.receive({ "TASServer 0.37 * 8201 0", "DENIED Bad username/password" });
+    BOOST_CHECK(!model.reconnecting());
+    BOOST_CHECK(!model.resyncPending());
+    BOOST_CHECK_THROW(model.getUser("alice"), std::invalid_argument);
+    BOOST_CHECK(std::find(controller.sent_.begin(), controller.sent_.end(), "EXIT") != controller.sent_.end());
+    controller.event_->connected(false);
+    BOOST_CHECK(!model.reconnecting());
+    BOOST_CHECK_EQUAL(2u, controller.timers_.size());
+}
+
+BOOST_AUTO_TEST_CASE(testChannelMembers)
+{
+    {
+        ChannelMembers cm;
+        BOOST_CHECK(cm.addChannel("a"));
+        BOOST_CHECK(cm.addChannel("b"));
+        cm.add("a", "zed");
+        cm.add("a", "amy");
+        cm.add("a", "amy");
+        cm.add("b", "amy");
+        cm.add("c", "amy"); // not joined
+        BOOST_CHECK(std::vector<std::string>({ "amy", "zed" }) == cm.users("a"));
+        BOOST_CHECK_EQUAL(3u, cm.channels("amy"));
+        BOOST_CHECK_EQUAL(1u, cm.channels("zed"));
+        BOOST_CHECK(cm.users("c").empty());
+
+        // bulk add of CLIENTS, repeated and existing names are kept once
+        cm.add("b", std::vector<std::string>({ "kim", "amy", "bo", "kim" }));
+        BOOST_CHECK(std::vector<std::string>({ "amy", "bo", "kim" }) == cm.users("b"));
+        BOOST_CHECK_EQUAL(2u, cm.channels("kim"));
+        cm.removeUser("kim");
+        cm.removeUser("bo");
+
+        cm.remove("a", "amy");
+        BOOST_CHECK_EQUAL(2u, cm.channels("amy"));
+        cm.removeUser("amy");
+        BOOST_CHECK_EQUAL(0u, cm.channels("amy"));
+        BOOST_CHECK(cm.users("b").empty());
+
+        // slot of removed channel is reused
+        cm.removeChannel("a");
+        BOOST_CHECK_EQUAL(0u, cm.channels("zed"));
+        BOOST_CHECK(cm.addChannel("d"));
+        BOOST_CHECK_EQUAL("d", cm.channelName(0));
+
+        for (std::size_t i = 2; i < ChannelMembers::maxChannels; ++i)
+        {
+            BOOST_CHECK(cm.addChannel("x" + std::to_string(i)));
+        }
+        BOOST_CHECK(!cm.addChannel("full"));
+        BOOST_CHECK(cm.addChannel("d")); // already joined
+    }
+
+    // status changes are only signaled to the channels of the user
+    FakeController controller;
+    Model model(controller, false);
+
+    std::map<std::string, std::vector<std::string>> changed;
+    model.connectChannelUsersChanged([&changed](std::string const & channelName, std::vector<User const *> const & users)
+        { for (auto u : users) changed[channelName].push_back(u->name()); });
+
+    model.connect("host", "8200");
+    controller.event_->connected(true);
+    model.login("me", "pw");
+    controller.receive({ "TASServer 0.37 * 8201 0", "ACCEPTED me",
+        "ADDUSER me SE 0 1", "ADDUSER alice SE 0 2", "ADDUSER bob SE 0 3", "LOGININFOEND" });
+    controller.receive({ "JOIN main", "CLIENTS main me alice bob", "JOIN dev", "CLIENTS dev me bob" });
+
+    std::vector<User const *> const users = model.getChannelUsers("main");
+    BOOST_REQUIRE_EQUAL(3u, users.size());
+    BOOST_CHECK_EQUAL("alice", users[0]->name());
+    BOOST_CHECK_EQUAL("me", users[2]->name());
+
+    controller.receive({ "CLIENTSTATUS alice 2" });
+    BOOST_CHECK(changed["main"] == std::vector<std::string>({ "alice" }));
+    BOOST_CHECK(changed["dev"].empty());
+
+    changed.clear();
+    controller.receive({ "LEFT main bob", "CLIENTSTATUS bob 2", "JOINED dev alice", "CLIENTSTATUS alice 0" });
+    BOOST_CHECK(changed["main"] == std::vector<std::string>({ "alice" }));
+    BOOST_CHECK(changed["dev"] == std::vector<std::string>({ "alice", "bob" }));
+
+    controller.receive({ "REMOVEUSER bob" });
+    BOOST_CHECK_EQUAL(2u, model.getChannelUsers("dev").size());
+
+    model.leaveChannel("dev");
+    BOOST_CHECK(model.getChannelUsers("dev").empty());
+}
+
+BOOST_AUTO_TEST_CASE(testArchivePrefetch)
+{
+    namespace fs = boost::filesystem;
+    std::string const dir = "ArchivePrefetchTest/";
+    fs::remove_all(dir);
+    fs::create_directories(dir + "game.sdd/sub");
+
+    uint64_t const mb = 1 << 20;
+    auto const write = [](std::string const & path, uint64_t size)
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << std::string(size, 'x');
+    };
+    write(dir + "map.sd7", 10*mb);
+    write(dir + "game.sdd/modinfo.lua", mb);
+    write(dir + "game.sdd/sub/unit.lua", mb);
+
+    std::vector<std::string> const paths = { dir + "map.sd7", dir + "game.sdd", dir + "missing.sdz" };
+    auto const never = []() { return false; };
+
+    BOOST_CHECK_EQUAL(12*mb, ArchivePrefetch::run(paths, ArchivePrefetch::defaultBudget, never));
+
+    // stops at first chunk exceeding budget
+    BOOST_CHECK_EQUAL(8*mb, ArchivePrefetch::run(paths, 9*mb, never));
+    BOOST_CHECK_EQUAL(0u, ArchivePrefetch::run(paths, ArchivePrefetch::defaultBudget, []() { return true; }));
+
+    // a new job stops the previous one
+    ArchivePrefetch prefetch;
+    boost::function<int()> const first = prefetch.job(paths);
+    boost::function<int()> const second = prefetch.job(paths);
+    BOOST_CHECK_EQUAL(0, first());
+    BOOST_CHECK_EQUAL(0, second());
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(testChecksumCache)
+{
+    std::map<std::string, int> lookups;
+    ChecksumCache cache([&lookups](std::string const & name) -> unsigned int
+    {
+        ++lookups[name];
+        return name == "missing" ? 0 : name.size();
+    });
+
+    // 1000 battles on 10 maps
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string const name = "map" + boost::lexical_cast<std::string>(i % 10);
+        BOOST_CHECK_EQUAL(name.size(), cache.get(name));
+    }
+    BOOST_CHECK_EQUAL(10u, lookups.size());
+    BOOST_CHECK_EQUAL(1, lookups["map0"]);
+
+    // not found is cached too
+    BOOST_CHECK_EQUAL(0u, cache.get("missing"));
+    BOOST_CHECK_EQUAL(0u, cache.get("missing"));
+    BOOST_CHECK_EQUAL(1, lookups["missing"]);
+
+    cache.clear();
+    cache.get("map0");
+    BOOST_CHECK_EQUAL(2, lookups["map0"]);
+}
+
+// minimal keep-alive HTTP server for downloader tests, serves files below root
+// package files (.sdp) are sent chunked to cover both body encodings
+class TestHttpServer
+{
+public:
+    explicit TestHttpServer(std::string const & root):
+        root_(root),
+        acceptor_(ioService_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        stop_(false),
+        connections_(0),
+        requests_(0)
+    {
+        thread_ = std::thread([this]() { acceptLoop(); });
+    }
+
+    ~TestHttpServer()
+    {
+        stop_ = true;
+        boost::asio::ip::tcp::socket wakeUp(ioService_);
+        wakeUp.connect(acceptor_.local_endpoint());
+        thread_.join();
+        for (std::thread & t : connectionThreads_)
+        {
+            t.join();
+        }
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + boost::lexical_cast<std::string>(acceptor_.local_endpoint().port()); }
+    unsigned int connections() const { return connections_; }
+    unsigned int requests() const { return requests_; }
+
+private:
+    std::string root_;
+    boost::asio::io_service ioService_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::thread thread_;
+    std::vector<std::thread> connectionThreads_;
+    std::atomic<bool> stop_;
+    std::atomic<unsigned int> connections_;
+    std::atomic<unsigned int> requests_;
+
+    void acceptLoop()
+    {
+        for (;;)
+        {
+            std::shared_ptr<boost::asio::ip::tcp::socket> socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
+            acceptor_.accept(*socket);
+            if (stop_)
+            {
+                return;
+            }
+            ++connections_;
+            connectionThreads_.emplace_back([this, socket]() { serve(*socket); });
+        }
+    }
+
+    void serve(boost::asio::ip::tcp::socket & socket)
+    {
+        boost::asio::streambuf buf;
+        boost::system::error_code ec;
+        while (boost::asio::read_until(socket, buf, "\r\n\r\n", ec))
+        {
+            std::istream is(&buf);
+            std::string method, path, line;
+            is >> method >> path;
+            while (std::getline(is, line) && line != "\r") {}
+            ++requests_;
+
+            if (path == "/stall")
+            {
+                continue; // no response, waits for the client to close
+            }
+            if (boost::starts_with(path, "/redirect/"))
+            {
+                std::string const response = "HTTP/1.1 302 Found\r\nLocation: " + url() + path.substr(9) + "\r\nContent-Length: 0\r\n\r\n";
+                boost::asio::write(socket, boost::asio::buffer(response), ec);
+                continue;
+            }
+
+            std::ifstream ifs(root_ + path, std::ios::binary);
+            std::string const body((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+            std::ostringstream oss;
+            if (!ifs.is_open())
+            {
+                oss << "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found";
+            }
+            else if (boost::ends_with(path, ".sdp"))
+            {
+                oss << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+                std::size_t const half = body.size()/2;
+                oss << std::hex << half << "\r\n" << body.substr(0, half) << "\r\n"
+                    << (body.size() - half) << "\r\n" << body.substr(half) << "\r\n0\r\n\r\n";
+            }
+            else
+            {
+                oss << "HTTP/1.1 200 OK\r\nContent-Length: " << body.size() << "\r\n\r\n" << body;
+            }
+            boost::asio::write(socket, boost::asio::buffer(oss.str()), ec);
+        }
+    }
+};
+
+namespace
+{
+
+std::string gzipString(std::string const & data)
+{
+    z_stream zs = {};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+void writeFile(std::string const & path, std::string const & data)
+{
+    boost::filesystem::create_directories(boost::filesystem::path(path).parent_path());
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << data;
+}
+
+// adds content to the fixture pool, returns sdp record
+std::string addPoolFile(std::string const & server, std::string const & name, std::string const & content, Downloader::PoolFile & file)
+{
+    md5_state_t state;
+    md5_init(&state);
+    md5_append(&state, reinterpret_cast<md5_byte_t const *>(content.data()), content.size());
+    md5_finish(&state, file.md5_);
+    file.name_ = name;
+    file.size_ = content.size();
+
+    std::string const md5 = file.md5Hex();
+    writeFile(server + "test/pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz", gzipString(content));
+
+    std::string record(1, static_cast<char>(name.size()));
+    record += name;
+    record.append(reinterpret_cast<char const *>(file.md5_), 16);
+    record += std::string(4, '\0'); // crc32 is not checked
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        record += static_cast<char>((file.size_ >> shift) & 0xff);
+    }
+    return record;
+}
+
+// returns package md5
+std::string addPackage(std::string const & server, std::vector<std::pair<std::string, std::string>> const & files)
+{
+    std::string sdp;
+    std::vector<Downloader::PoolFile> poolFiles;
+    for (auto const & pair : files)
+    {
+        Downloader::PoolFile file;
+        sdp += addPoolFile(server, pair.first, pair.second, file);
+        poolFiles.push_back(file);
+    }
+    std::string const md5 = Downloader::packageMd5(poolFiles);
+    writeFile(server + "test/packages/" + md5 + ".sdp", gzipString(sdp));
+    return md5;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testDownloader)
+{
+    namespace fs = boost::filesystem;
+    std::string const dir = "DownloaderTest/";
+    std::string const server = dir + "server/";
+    std::string const client = dir + "client/";
+    fs::remove_all(dir);
+
+    TestHttpServer httpServer(server);
+
+    // fixture repository: base package, game depending on it sharing one file content
+    std::string const baseMd5 = addPackage(server, { { "base/a.lua", "return 1" }, { "base/b.lua", std::string(100000, 'b') } });
+    std::vector<std::pair<std::string, std::string>> gameFiles;
+    for (int i = 0; i < 20; ++i)
+    {
+        gameFiles.push_back(std::make_pair("units/u" + boost::lexical_cast<std::string>(i) + ".lua", "unit " + std::string(i*1000, 'u')));
+    }
+    gameFiles.push_back(std::make_pair("copy.lua", "return 1")); // same content as base/a.lua
+    std::string const gameMd5 = addPackage(server, gameFiles);
+
+    fs::copy_file(server + "test/packages/" + baseMd5 + ".sdp", server + "test/packages/00000000000000000000000000000000.sdp");
+    writeFile(server + "repos.gz", gzipString("test," + httpServer.url() + "/test,,\nbroken," + httpServer.url() + "/broken,,\n"));
+    writeFile(server + "test/versions.gz", gzipString(
+        "test:base," + baseMd5 + ",,Test Base\n" +
+        "test:stable," + gameMd5 + ",Test Base,Test Game, v1\n" +
+        "test:corrupt,00000000000000000000000000000000,,Corrupt\n"));
+
+    Downloader downloader(client, httpServer.url() + "/repos.gz", 4);
+
+    BOOST_CHECK_EQUAL(0, downloader.downloadRapid("test:stable"));
+    BOOST_CHECK(downloader.error().empty());
+    BOOST_CHECK(fs::exists(client + "packages/" + baseMd5 + ".sdp"));
+    BOOST_CHECK(fs::exists(client + "packages/" + gameMd5 + ".sdp"));
+    BOOST_CHECK_EQUAL(22u, downloader.progress().filesTotal_.load()); // 23 files, 22 distinct
+    BOOST_CHECK_EQUAL(downloader.progress().filesTotal_.load(), downloader.progress().filesDone_.load());
+    BOOST_CHECK_EQUAL(downloader.progress().bytesTotal_.load(), downloader.progress().bytesDone_.load());
+
+    // pool files are stored compressed as received
+    Downloader::PoolFile a;
+    addPoolFile(server, "base/a.lua", "return 1", a);
+    std::string const aMd5 = a.md5Hex();
+    std::ifstream ifs(client + "pool/" + aMd5.substr(0, 2) + "/" + aMd5.substr(2) + ".gz", std::ios::binary);
+    std::string const aGz((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL("return 1", Downloader::gunzip(aGz));
+
+    // pool files were fetched over a few kept alive connections
+    BOOST_CHECK(httpServer.connections() < 20);
+    BOOST_CHECK(httpServer.requests() > 22);
+
+    // prefetch reads the pool files of a rapid package
+    std::vector<std::string> const poolFiles = ArchivePrefetch::rapidPoolFiles(client + "packages/" + gameMd5 + ".sdp");
+    BOOST_CHECK_EQUAL(21u, poolFiles.size()); // copy.lua shares its content with none of the units
+    BOOST_CHECK(std::all_of(poolFiles.begin(), poolFiles.end(), [](std::string const & p) { return fs::exists(p); }));
+    BOOST_CHECK(ArchivePrefetch::run({ client + "packages/" + gameMd5 + ".sdp" }, ArchivePrefetch::defaultBudget, []() { return false; }) > 0);
+    BOOST_CHECK(ArchivePrefetch::rapidPoolFiles(client + "packages/missing.sdp").empty());
+
+    // by name, nothing left to fetch
+    BOOST_CHECK_EQUAL(0, downloader.downloadRapid("Test Game, v1"));
+    BOOST_CHECK_EQUAL(0u, downloader.progress().filesTotal_.load());
+
+    BOOST_CHECK_NE(0, downloader.downloadRapid("test:unknown"));
+    BOOST_CHECK_NE(0, downloader.downloadRapid("test:corrupt")); // package md5 doesn't match its files
+    BOOST_CHECK(!downloader.error().empty());
+
+    // content not matching its md5 is not moved into the pool
+    {
+        Downloader::PoolFile file;
+        std::string const sdp = addPoolFile(server, "bad.lua", "good content", file);
+        std::string const md5 = file.md5Hex();
+        writeFile(server + "test/pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz", gzipString("bad content"));
+        std::string const packageMd5 = Downloader::packageMd5({ file });
+        writeFile(server + "test/packages/" + packageMd5 + ".sdp", gzipString(sdp));
+        writeFile(server + "test/versions.gz", gzipString("test:bad," + packageMd5 + ",,Bad\n"));
+
+        BOOST_CHECK_NE(0, downloader.downloadRapid("test:bad"));
+        BOOST_CHECK(!fs::exists(client + "pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz"));
+        BOOST_CHECK(!fs::exists(client + "pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz.tmp"));
+        BOOST_CHECK(!fs::exists(client + "packages/" + packageMd5 + ".sdp"));
+    }
+
+    // plain http
+    writeFile(server + "files/map.sd7", "map data");
+    BOOST_CHECK_EQUAL(0, downloader.downloadHttp(httpServer.url() + "/files/map.sd7", client + "map.sd7", "CA1642FA1D45EBA2146F42EE66B28050"));
+    BOOST_CHECK_EQUAL(8u, fs::file_size(client + "map.sd7"));
+    BOOST_CHECK_NE(0, downloader.downloadHttp(httpServer.url() + "/files/map.sd7", client + "bad.sd7", "00000000000000000000000000000000"));
+    BOOST_CHECK(!fs::exists(client + "bad.sd7"));
+    BOOST_CHECK_NE(0, downloader.downloadHttp(httpServer.url() + "/files/missing.sd7", client + "missing.sd7"));
+    BOOST_CHECK_THROW(HttpClient::parseUrl("https://example.com/"), std::invalid_argument);
+    BOOST_CHECK_EQUAL(0, downloader.downloadHttp(httpServer.url() + "/redirect/redirect/files/map.sd7", client + "redirected.sd7"));
+    BOOST_CHECK_EQUAL(8u, fs::file_size(client + "redirected.sd7"));
+
+    // cancel closes the connection to a server not responding
+    {
+        auto const start = std::chrono::steady_clock::now();
+        std::thread canceler([&downloader]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                downloader.cancel();
+            });
+        BOOST_CHECK_NE(0, downloader.downloadHttp(httpServer.url() + "/stall", client + "stall"));
+        canceler.join();
+        BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(HttpClient::timeout));
+    }
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(testMd5Lanes)
+{
+    std::string data[MD5_LANES];
+    for (int l = 0; l < MD5_LANES; ++l)
+    {
+        for (int i = 0; i < 100000; ++i)
+        {
+            data[l] += static_cast<char>((i*(l + 3)) ^ (i >> 7));
+        }
+    }
+
+    // same digests as md5_append, also when a partial block is buffered
+    for (int prefix : { 0, 64, 5 })
+    {
+        md5_state_t lanes[MD5_LANES];
+        md5_state_t scalar[MD5_LANES];
+        md5_state_t * states[MD5_LANES];
+        md5_byte_t const * chunks[MD5_LANES];
+        for (int l = 0; l < MD5_LANES; ++l)
+        {
+            md5_init(&lanes[l]);
+            md5_init(&scalar[l]);
+            md5_append(&lanes[l], reinterpret_cast<md5_byte_t const *>(data[l].data()), prefix);
+            md5_append(&scalar[l], reinterpret_cast<md5_byte_t const *>(data[l].data()), 99999);
+            states[l] = &lanes[l];
+            chunks[l] = reinterpret_cast<md5_byte_t const *>(data[l].data()) + prefix;
+        }
+        md5_append_lanes(states, chunks, 99999 - prefix);
+
+        for (int l = 0; l < MD5_LANES; ++l)
+        {
+            md5_byte_t a[16];
+            md5_byte_t b[16];
+            md5_finish(&lanes[l], a);
+            md5_finish(&scalar[l], b);
+            BOOST_CHECK_EQUAL(0, std::memcmp(a, b, 16));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testPoolScanner)
+{
+    namespace fs = boost::filesystem;
+    std::string const dir = "PoolScannerTest/";
+    std::string const dataDir = dir + "spring/";
+    std::string const cachePath = dir + "pool.cache";
+    fs::remove_all(dir);
+
+    auto const md5Of = [](std::string const & content)
+    {
+        Downloader::PoolFile file;
+        md5_state_t state;
+        md5_init(&state);
+        md5_append(&state, reinterpret_cast<md5_byte_t const *>(content.data()), content.size());
+        md5_finish(&state, file.md5_);
+        return file;
+    };
+    auto const poolPath = [&dataDir](std::string const & md5)
+    {
+        return dataDir + "pool/" + md5.substr(0, 2) + "/" + md5.substr(2) + ".gz";
+    };
+    // sdp of files, named by packageMd5 unless name is given
+    auto const addPackage = [&dataDir](std::vector<Downloader::PoolFile> files, std::string name)
+    {
+        std::string sdp;
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            files[i].name_ = "file" + boost::lexical_cast<std::string>(i);
+            sdp += static_cast<char>(files[i].name_.size()) + files[i].name_;
+            sdp.append(reinterpret_cast<char const *>(files[i].md5_), 16);
+            sdp += std::string(8, '\0');
+        }
+        name = name.empty() ? Downloader::packageMd5(files) : name;
+        writeFile(dataDir + "packages/" + name + ".sdp", gzipString(sdp));
+        return dataDir + "packages/" + name + ".sdp";
+    };
+
+    std::vector<Downloader::PoolFile> good;
+    for (int i = 0; i < 10; ++i)
+    {
+        // some larger than one hashing round
+        std::string const content = "content " + boost::lexical_cast<std::string>(i) + std::string(i*150000, static_cast<char>('a' + i));
+        good.push_back(md5Of(content));
+        writeFile(poolPath(good.back().md5Hex()), gzipString(content));
+    }
+    Downloader::PoolFile const corrupt = md5Of("expected");
+    writeFile(poolPath(corrupt.md5Hex()), gzipString("other"));
+    Downloader::PoolFile const truncated = md5Of(std::string(300000, 't'));
+    writeFile(poolPath(truncated.md5Hex()), gzipString(std::string(300000, 't')).substr(0, 100));
+
+    std::string const okPackage = addPackage({ good[0], good[9] }, "");
+    std::string const brokenPackage = addPackage({ good[1], corrupt }, "");
+    std::string const badNamePackage = addPackage({ good[2] }, "0123456789abcdef0123456789abcdef");
+
+    uint64_t bytes;
+    BOOST_CHECK_EQUAL(good[9].md5Hex(), PoolScanner::verifyFile(poolPath(good[9].md5Hex()), bytes));
+    BOOST_CHECK(PoolScanner::verifyFile(poolPath(truncated.md5Hex()), bytes).empty());
+
+    PoolScanner scanner({ dataDir }, cachePath, 2);
+    PoolScanner::Report report = scanner.scan(false);
+    BOOST_CHECK_EQUAL(12u, report.poolFiles_);
+    BOOST_CHECK_EQUAL(0u, report.cachedFiles_);
+    BOOST_CHECK_EQUAL(3u, report.packages_);
+    std::vector<std::string> corruptFiles = { poolPath(corrupt.md5Hex()), poolPath(truncated.md5Hex()) };
+    std::sort(corruptFiles.begin(), corruptFiles.end());
+    BOOST_CHECK(corruptFiles == report.corruptFiles_);
+    std::vector<std::string> brokenPackages = { brokenPackage, badNamePackage };
+    std::sort(brokenPackages.begin(), brokenPackages.end());
+    BOOST_CHECK(brokenPackages == report.brokenPackages_);
+    BOOST_CHECK(report.removed_.empty());
+
+    // verified files are skipped while unchanged
+    report = scanner.scan(false);
+    BOOST_CHECK_EQUAL(10u, report.cachedFiles_);
+    BOOST_CHECK_EQUAL(2u, report.corruptFiles_.size());
+
+    writeFile(poolPath(good[0].md5Hex()), gzipString("changed"));
+    report = scanner.scan(true);
+    BOOST_CHECK_EQUAL(9u, report.cachedFiles_);
+    BOOST_CHECK_EQUAL(3u, report.corruptFiles_.size());
+    BOOST_CHECK_EQUAL(3u, report.brokenPackages_.size()); // okPackage references good[0]
+    BOOST_CHECK_EQUAL(6u, report.removed_.size());
+    BOOST_CHECK(!fs::exists(okPackage));
+
+    report = scanner.scan(false);
+    BOOST_CHECK_EQUAL(9u, report.poolFiles_);
+    BOOST_CHECK_EQUAL(9u, report.cachedFiles_);
+    BOOST_CHECK(report.corruptFiles_.empty() && report.brokenPackages_.empty());
+
+    // cache entries of other data dirs are kept
+    std::string const otherDataDir = dir + "other/";
+    std::string const otherContent = "other content";
+    std::string const otherMd5 = md5Of(otherContent).md5Hex();
+    writeFile(otherDataDir + "pool/" + otherMd5.substr(0, 2) + "/" + otherMd5.substr(2) + ".gz", gzipString(otherContent));
+    PoolScanner otherScanner({ otherDataDir }, cachePath, 2);
+    BOOST_CHECK_EQUAL(0u, otherScanner.scan(false).cachedFiles_);
+    BOOST_CHECK_EQUAL(9u, scanner.scan(false).cachedFiles_);
+    BOOST_CHECK_EQUAL(1u, otherScanner.scan(false).cachedFiles_);
+
+    // a pool that can't be listed aborts, repair removes nothing
+    std::string const badDataDir = dir + "bad/";
+    writeFile(badDataDir + "pool", "not a directory");
+    std::string const brokenAgain = addPackage({ good[1], corrupt }, "");
+    report = PoolScanner({ dataDir, badDataDir }, cachePath, 2).scan(true);
+    BOOST_CHECK(!report.error_.empty());
+    BOOST_CHECK(report.brokenPackages_.empty() && report.removed_.empty());
+    BOOST_CHECK(fs::exists(brokenAgain));
+
+    fs::remove_all(dir);
+}
+
 BOOST_AUTO_TEST_CASE(testMyImage)
 {
     // 3x2x1
@@ -510,12 +1253,784 @@ BOOST_AUTO_TEST_CASE(testMyImage)
         BOOST_CHECK_EQUAL(static_cast<uchar>('1'), image.array[0]);
     }
 
+    // 2x1x1 with tint
+    {
+        std::string const fileName("MyImageTestFile");
+        uchar const data[] = { 255, 128 };
+        MyImage::write(fileName, data, 2, 1, 1, 0x00ff00);
+
+        MyImage image(fileName);
+
+        BOOST_CHECK_EQUAL(2, image.w());
+        BOOST_CHECK_EQUAL(1, image.h());
+        BOOST_CHECK_EQUAL(3, image.d());
+        BOOST_CHECK_EQUAL(0, image.array[0]);
+        BOOST_CHECK_EQUAL(255, image.array[1]);
+        BOOST_CHECK_EQUAL(0, image.array[2]);
+        BOOST_CHECK_EQUAL(128, image.array[4]);
+    }
+
     // test exception is thrown if file not found
     {
         BOOST_CHECK_THROW(MyImage image("non_existing_file"), std::invalid_argument);
     }
 }
 
+BOOST_AUTO_TEST_CASE(testImageResize)
+{
+    // 4x2 -> 2x1, each destination pixel is the mean of a 2x2 block
+    {
+        uint8_t const src[] = {
+            0, 4,  10, 10,
+            8, 12, 20, 40 };
+        uint8_t dst[2];
+        resizeAreaAverage(src, 4, 2, 1, dst, 2, 1);
+        BOOST_CHECK_EQUAL(6, dst[0]);
+        BOOST_CHECK_EQUAL(20, dst[1]);
+    }
+
+    // 3x1 -> 2x1, middle pixel is split between both destination pixels
+    {
+        uint8_t const src[] = { 0, 90, 180 };
+        uint8_t dst[2];
+        resizeAreaAverage(src, 3, 1, 1, dst, 2, 1);
+        BOOST_CHECK_EQUAL(30, dst[0]); // (0*1 + 90*0.5)/1.5
+        BOOST_CHECK_EQUAL(150, dst[1]); // (90*0.5 + 180*1)/1.5
+    }
+
+    // RGB channels are kept apart
+    {
+        uint8_t const src[] = { 255,0,0, 255,0,0, 0,0,255, 0,0,255 };
+        uint8_t dst[3];
+        resizeAreaAverage(src, 2, 2, 3, dst, 1, 1);
+        BOOST_CHECK_EQUAL(128, dst[0]);
+        BOOST_CHECK_EQUAL(0, dst[1]);
+        BOOST_CHECK_EQUAL(128, dst[2]);
+    }
+
+    // constant image stays constant, also when upscaling
+    {
+        std::vector<uint8_t> src(7*5, 77);
+        std::vector<uint8_t> dst(16*3);
+        resizeAreaAverage(src.data(), 7, 5, 1, dst.data(), 16, 3);
+        for (auto v : dst)
+        {
+            BOOST_CHECK_EQUAL(77, v);
+        }
+    }
+
+    // thumbnail sizes
+    {
+        int w, h;
+        thumbnailSize(1024, 1024, 1, 128, w, h);
+        BOOST_CHECK_EQUAL(128, w);
+        BOOST_CHECK_EQUAL(128, h);
+
+        thumbnailSize(1024, 1024, 0.5, 128, w, h); // minimap of a 8x16 map
+        BOOST_CHECK_EQUAL(64, w);
+        BOOST_CHECK_EQUAL(128, h);
+
+        thumbnailSize(1025, 513, 1, 128, w, h); // heightmap of a 16x8 map
+        BOOST_CHECK_EQUAL(128, w);
+        BOOST_CHECK_EQUAL(64, h);
+    }
+}
+
+// benchmark, run with: unittest --run_test=benchImageResize
+BOOST_AUTO_TEST_CASE(benchImageResize, * boost::unit_test::disabled())
+{
+    // minimap sized input, print timings for ocular inspection
+    int const w = 1024;
+    int const h = 1024;
+    int const d = 3;
+    int const loops = 20;
+
+    std::vector<uint8_t> src(w*h*d);
+    for (std::size_t i=0; i<src.size(); ++i)
+    {
+        src[i] = static_cast<uint8_t>(i*7 + i/w);
+    }
+    std::vector<uint8_t> dst(128*128*d);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<loops; ++i)
+    {
+        resizeAreaAverage(src.data(), w, h, d, dst.data(), 128, 128);
+        MyImage::write("ImageResizeBench.img", dst.data(), 128, 128, d);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "resizeAreaAverage+MyImage::write: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/loops << " us/image" << std::endl;
+
+#ifdef FLOBBY_BENCH_MAGICK
+    Magick::InitializeMagick(0);
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<loops; ++i)
+    {
+        Magick::Image image;
+        image.read(w, h, "RGB", Magick::CharPixel, src.data());
+        image.depth(8);
+        Magick::Geometry geom(128, 128);
+        geom.aspect(true);
+        image.resize(geom);
+        image.write("ImageResizeBench.png");
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << "Magick resize+write png: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/loops << " us/image" << std::endl;
+#endif
+}
+
+namespace
+{
+struct SignalCounter
+{
+    SignalCounter(): sum_(0) {}
+    void add(int v) { sum_ += v; }
+    void addText(std::string const & text, int & result) { result += text.size(); }
+    int sum_;
+};
+}
+
+BOOST_AUTO_TEST_CASE(testSignal)
+{
+    {
+        SignalCounter counter;
+        int lambdaSum = 0;
+        Signal<void (int)> signal;
+        signal.connect( boost::bind(&SignalCounter::add, &counter, _1) );
+        SignalConnection connection = signal.connect( [&lambdaSum](int v) { lambdaSum += v; } );
+        BOOST_CHECK(!signal.empty());
+
+        signal(2);
+        BOOST_CHECK_EQUAL(2, counter.sum_);
+        BOOST_CHECK_EQUAL(2, lambdaSum);
+
+        connection.disconnect();
+        BOOST_CHECK(!connection.connected());
+        signal(3);
+        BOOST_CHECK_EQUAL(5, counter.sum_);
+        BOOST_CHECK_EQUAL(2, lambdaSum);
+
+        signal.disconnectAll();
+        BOOST_CHECK(signal.empty());
+        signal(3);
+        BOOST_CHECK_EQUAL(5, counter.sum_);
+    }
+
+    {
+        // reference arguments and callable too big for inline storage
+        SignalCounter counter;
+        std::string const big(100, 'x');
+        Signal<void (std::string const &, int &)> signal;
+        signal.connect( boost::bind(&SignalCounter::addText, &counter, _1, _2) );
+        signal.connect( [big](std::string const & text, int & result) { result += big.size(); } );
+
+        int result = 0;
+        signal("abc", result);
+        BOOST_CHECK_EQUAL(103, result);
+    }
+
+    {
+        // connect and disconnect while emitting
+        int calls = 0;
+        Signal<void ()> signal;
+        SignalConnection second;
+        signal.connect( [&]() { ++calls; second.disconnect(); } );
+        second = signal.connect( [&]() { calls += 10; } );
+        signal.connect( [&]() { if (calls == 1) signal.connect( [&]() { calls += 100; } ); } );
+
+        signal();
+        BOOST_CHECK_EQUAL(1, calls);
+        signal();
+        BOOST_CHECK_EQUAL(102, calls);
+    }
+}
+
+// benchmark, run with: unittest --run_test=benchSignal
+BOOST_AUTO_TEST_CASE(benchSignal, * boost::unit_test::disabled())
+{
+    // per emit cost with one connected slot, print timings for ocular inspection
+    int const loops = 1000000;
+
+    SignalCounter counter1;
+    boost::signals2::signal<void (int)> signal1;
+    signal1.connect( boost::bind(&SignalCounter::add, &counter1, _1) );
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<loops; ++i)
+    {
+        signal1(1);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "boost::signals2::signal: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/loops << " ns/emit" << std::endl;
+
+    SignalCounter counter2;
+    Signal<void (int)> signal2;
+    signal2.connect( boost::bind(&SignalCounter::add, &counter2, _1) );
+
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<loops; ++i)
+    {
+        signal2(1);
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << "Signal: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/loops << " ns/emit" << std::endl;
+
+    BOOST_CHECK_EQUAL(counter1.sum_, counter2.sum_);
+}
+
+BOOST_AUTO_TEST_CASE(testMetrics)
+{
+    MetricsCounter & counter = Metrics::counter("test.counter");
+    BOOST_CHECK_EQUAL(&counter, &Metrics::counter("test.counter"));
+    counter.add();
+    counter.add(2);
+    BOOST_CHECK_EQUAL(3u, counter.value());
+
+    MetricsGauge & gauge = Metrics::gauge("test.gauge");
+    gauge.set(5);
+    gauge.set(2);
+    BOOST_CHECK_EQUAL(2, gauge.value());
+    BOOST_CHECK_EQUAL(5, gauge.max());
+
+    // buckets are contiguous and values are within 1/subBuckets of their bucket
+    for (int i = 0; i + 1 < MetricsHistogram::bucketCount; ++i)
+    {
+        uint64_t const low = MetricsHistogram::bucketLow(i);
+        BOOST_REQUIRE_EQUAL(i, MetricsHistogram::bucket(low));
+        BOOST_REQUIRE_EQUAL(i, MetricsHistogram::bucket(MetricsHistogram::bucketLow(i + 1) - 1));
+        BOOST_REQUIRE(MetricsHistogram::bucketLow(i + 1) - low <= std::max<uint64_t>(1, low/MetricsHistogram::subBuckets));
+    }
+    BOOST_CHECK_EQUAL(MetricsHistogram::bucketCount - 1, MetricsHistogram::bucket(UINT64_MAX));
+
+    MetricsHistogram & histogram = Metrics::histogram("test.histogram");
+    BOOST_CHECK_EQUAL(0u, histogram.percentile(0.5));
+    for (uint64_t v = 1; v <= 1000; ++v)
+    {
+        histogram.record(v*1000);
+    }
+    BOOST_CHECK_EQUAL(1000u, histogram.count());
+    BOOST_CHECK_EQUAL(1000000u, histogram.max());
+    BOOST_CHECK_CLOSE(500000.0, static_cast<double>(histogram.percentile(0.5)), 100.0/MetricsHistogram::subBuckets);
+    BOOST_CHECK_CLOSE(990000.0, static_cast<double>(histogram.percentile(0.99)), 100.0/MetricsHistogram::subBuckets);
+    BOOST_CHECK_EQUAL(1000000u, histogram.percentile(1));
+
+    // timers and signals only record while timing is enabled
+    MetricsHistogram & signalTime = Metrics::histogram("signal.testMetrics");
+    Signal<void (int)> signal;
+    signal.metricsName("testMetrics");
+    int sum = 0;
+    signal.connect([&sum](int i) { sum += i; });
+    BOOST_REQUIRE(!Metrics::timing());
+    {
+        MetricsTimer timer(histogram);
+    }
+    signal(1);
+    BOOST_CHECK_EQUAL(1000u, histogram.count());
+    BOOST_CHECK_EQUAL(0u, signalTime.count());
+
+    Metrics::timing(true);
+    {
+        MetricsTimer timer(histogram);
+        MetricsTimer none(static_cast<MetricsHistogram*>(0));
+    }
+    signal(2);
+    Metrics::timing(false);
+    BOOST_CHECK_EQUAL(1001u, histogram.count());
+    BOOST_CHECK_EQUAL(1u, signalTime.count());
+    BOOST_CHECK_EQUAL(3, sum);
+
+    Metrics::Snapshot const snapshot = Metrics::snapshot();
+    BOOST_CHECK(std::is_sorted(snapshot.counters_.begin(), snapshot.counters_.end(),
+        [](Metrics::Snapshot::Counter const & a, Metrics::Snapshot::Counter const & b) { return a.name_ < b.name_; }));
+    std::ostringstream oss;
+    snapshot.writeJson(oss);
+    std::string const json = oss.str();
+    BOOST_CHECK(json.find("\"test.counter\": 3") != std::string::npos);
+    BOOST_CHECK(json.find("\"test.gauge\": { \"value\": 2, \"max\": 5 }") != std::string::npos);
+    BOOST_CHECK(json.find("\"test.histogram\": { \"count\": 1001,") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testTrace)
+{
+    auto const count = [](std::string const & text, std::string const & what)
+    {
+        std::size_t n = 0;
+        for (std::size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+        {
+            ++n;
+        }
+        return n;
+    };
+    auto const json = []()
+    {
+        std::ostringstream oss;
+        Trace::writeJson(oss);
+        return oss.str();
+    };
+
+    BOOST_REQUIRE(!Trace::enabled());
+    {
+        TraceSpan span("testTraceOff");
+    }
+    BOOST_CHECK_EQUAL(0u, count(json(), "testTraceOff"));
+
+    char const * name = Trace::intern("testTrace " + std::string("interned"));
+    BOOST_CHECK_EQUAL(name, Trace::intern("testTrace interned"));
+
+    Signal<void ()> signal;
+    signal.metricsName("testTrace");
+    signal.connect([]() {});
+
+    Trace::enable(true);
+    {
+        TraceSpan outer(name, "test");
+        TraceSpan none(0);
+        signal();
+    }
+    // only the latest spans are kept per thread
+    std::thread thread([]()
+        {
+            Trace::threadName("testTrace \"worker\"");
+            for (std::size_t i = 0; i < Trace::bufferSize + 10; ++i)
+            {
+                TraceSpan span("testTraceWorker");
+            }
+        });
+    thread.join();
+    Trace::enable(false);
+
+    std::string const text = json();
+    BOOST_CHECK_EQUAL(1u, count(text, "\"name\":\"testTrace interned\",\"cat\":\"test\",\"ph\":\"X\""));
+    BOOST_CHECK_EQUAL(1u, count(text, "\"name\":\"signal.testTrace\",\"cat\":\"signal\""));
+    BOOST_CHECK_EQUAL(Trace::bufferSize - 1, count(text, "\"testTraceWorker\"")); // oldest slot is next to be overwritten
+    BOOST_CHECK_EQUAL(1u, count(text, "\"args\":{\"name\":\"testTrace \\\"worker\\\"\"}"));
+    BOOST_CHECK(boost::algorithm::starts_with(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+    BOOST_CHECK(boost::algorithm::ends_with(text, "\n]}\n"));
+}
+
+BOOST_AUTO_TEST_CASE(testWatchdog)
+{
+    namespace fs = boost::filesystem;
+    std::string const dir = "WatchdogTest/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    auto const beatFor = [](int ms)
+    {
+        for (int i = 0; i < ms/10; ++i)
+        {
+            Watchdog::beat();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    };
+
+    BOOST_REQUIRE(!Trace::enabled());
+    {
+        Watchdog watchdog(dir, 100);
+        BOOST_CHECK(Trace::enabled());
+        beatFor(200);
+        BOOST_CHECK_EQUAL(0u, watchdog.stalls());
+
+        {
+            WatchdogActivity activity("testWatchdogActivity");
+            TraceSpan span("testWatchdogSpan");
+            LOG(INFO) << "testWatchdog before stall";
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        BOOST_CHECK(Watchdog::activity() == 0);
+        beatFor(300);
+        BOOST_CHECK_EQUAL(1u, watchdog.stalls());
+    }
+    BOOST_CHECK(!Trace::enabled());
+
+    std::vector<std::string> const recent = Log::recentLines();
+    BOOST_CHECK(recent.size() <= Log::recentLinesMax);
+    BOOST_CHECK(std::any_of(recent.begin(), recent.end(),
+        [](std::string const & line) { return line.find("UI thread stall ended after") != std::string::npos; }));
+
+    std::string txt;
+    std::string json;
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it)
+    {
+        std::ifstream ifs(it->path().string());
+        std::string const content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        (it->path().extension() == ".txt" ? txt : json) = content;
+    }
+    BOOST_CHECK(txt.find("activity: testWatchdogActivity\n") != std::string::npos);
+    BOOST_CHECK(txt.find("testWatchdog before stall") != std::string::npos);
+    BOOST_CHECK(json.find("\"testWatchdogSpan\"") != std::string::npos);
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(testLazy)
+{
+    struct Dialog
+    {
+        Dialog(int & alive): alive_(alive) { ++alive_; }
+        ~Dialog() { --alive_; }
+        int & alive_;
+        int value_ = 0;
+    };
+
+    int created = 0;
+    int alive = 0;
+    {
+        Lazy<Dialog> dialog([&] { ++created; return new Dialog(alive); });
+        BOOST_CHECK(dialog.created() == 0);
+        BOOST_CHECK_EQUAL(created, 0);
+
+        dialog->value_ = 42;
+        BOOST_CHECK_EQUAL(dialog.get().value_, 42);
+        BOOST_CHECK(dialog.created() == &dialog.get());
+        BOOST_CHECK_EQUAL(created, 1);
+
+        dialog.reset();
+        BOOST_CHECK(dialog.created() == 0);
+        BOOST_CHECK_EQUAL(alive, 0);
+        BOOST_CHECK_EQUAL(dialog->value_, 0);
+        BOOST_CHECK_EQUAL(created, 2);
+        BOOST_CHECK_EQUAL(alive, 1);
+    }
+    BOOST_CHECK_EQUAL(alive, 0);
+
+    uint64_t const count = Metrics::histogram("startup.testLazy").count();
+    {
+        StartupPhase phase("testLazy");
+    }
+    BOOST_CHECK_EQUAL(Metrics::histogram("startup.testLazy").count(), count + 1);
+}
+
+BOOST_AUTO_TEST_CASE(testThreadPool)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::pair<unsigned int, int>> done;
+    bool started = false;
+    bool release = false;
+
+    ThreadPool pool({ 1, 1 }, [&](unsigned int id, int result)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.push_back(std::make_pair(id, result));
+            cond.notify_all();
+        });
+
+    auto waitDone = [&](std::size_t count)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            return cond.wait_for(lock, std::chrono::seconds(5), [&]() { return done.size() >= count; });
+        };
+
+    // block lane 0 so the following jobs are queued
+    pool.submit(1, [&](CancelToken const &)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started = true;
+            cond.notify_all();
+            cond.wait(lock, [&]() { return release; });
+            return 1;
+        }, 0);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        BOOST_REQUIRE(cond.wait_for(lock, std::chrono::seconds(5), [&]() { return started; }));
+    }
+    pool.submit(2, [](CancelToken const &) { return 2; }, 0, 0);
+    pool.submit(3, [](CancelToken const &) { return 3; }, 0, 5);
+    pool.submit(4, [](CancelToken const &) { return 4; }, 0, 0);
+    pool.submit(5, [](CancelToken const &) -> int { throw std::runtime_error("failed"); }, 0, 0);
+
+    // other lane is not blocked
+    pool.submit(6, [](CancelToken const &) { return 6; }, 1);
+    BOOST_REQUIRE(waitDone(1));
+    BOOST_CHECK_EQUAL(6U, done[0].first);
+
+    // queued job is canceled immediately
+    BOOST_CHECK(pool.cancel(4));
+    BOOST_CHECK(!pool.cancel(100));
+    BOOST_REQUIRE(waitDone(2));
+    BOOST_CHECK_EQUAL(4U, done[1].first);
+    BOOST_CHECK_EQUAL(-1, done[1].second);
+    BOOST_CHECK_EQUAL(3U, pool.queued(0));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+        cond.notify_all();
+    }
+    BOOST_REQUIRE(waitDone(6));
+
+    // priority first, then submit order, throwing job reports -1
+    BOOST_CHECK_EQUAL(1U, done[2].first);
+    BOOST_CHECK_EQUAL(3U, done[3].first);
+    BOOST_CHECK_EQUAL(2U, done[4].first);
+    BOOST_CHECK_EQUAL(5U, done[5].first);
+    BOOST_CHECK_EQUAL(-1, done[5].second);
+
+    ThreadPool::Stats const stats = pool.stats(0);
+    BOOST_CHECK_EQUAL(4U, stats.jobs_);
+    BOOST_CHECK_EQUAL(1U, stats.canceled_);
+    BOOST_CHECK(stats.runSeconds_ >= 0);
+}
+
+BOOST_AUTO_TEST_CASE(testThreadPoolStop)
+{
+    // jobs of the detached lane may outlive the test, they only use shared state
+    auto const doneCalls = std::make_shared<std::atomic<int>>(0);
+    auto const started = std::make_shared<std::atomic<int>>(0);
+    auto const release = std::make_shared<std::atomic<bool>>(false);
+    std::unique_ptr<ThreadPool> pool(new ThreadPool({ 1, 1 }, [doneCalls](unsigned int, int) { ++*doneCalls; }, { 1 }));
+
+    pool->submit(1, [started](CancelToken const & token)
+        {
+            ++*started;
+            while (!token.canceled())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return 1;
+        }, 0);
+    pool->submit(2, [](CancelToken const &) { return 2; }, 0); // queued, dropped by stop
+    pool->submit(3, [started, release](CancelToken const &)
+        {
+            ++*started;
+            while (!*release) // like an engine process, ignores the token
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return 3;
+        }, 1);
+    for (int i = 0; i < 5000 && *started < 2; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_REQUIRE_EQUAL(2, *started);
+
+    // canceled job is waited for, detached lane is not
+    auto const start = std::chrono::steady_clock::now();
+    pool->stop();
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(ThreadPool::stopSeconds));
+    BOOST_CHECK_EQUAL(0, *doneCalls);
+
+    *release = true;
+    pool.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(0, *doneCalls); // not called after stop
+}
+
+BOOST_AUTO_TEST_CASE(testRateLimiter)
+{
+    typedef RateLimiter::Clock Clock;
+    Clock::time_point const t0 = Clock::now();
+    RateLimiter limiter(1000, 4000, t0);
+
+    BOOST_CHECK_EQUAL(4000u, limiter.allowance(t0));
+    BOOST_CHECK(limiter.allowed(4000, t0));
+    limiter.consume(3000);
+    BOOST_CHECK_EQUAL(1000u, limiter.allowance(t0));
+    BOOST_CHECK(!limiter.allowed(1500, t0));
+    BOOST_CHECK(limiter.delay(1500, t0) > std::chrono::milliseconds(499));
+    BOOST_CHECK(limiter.delay(1500, t0) < std::chrono::milliseconds(501));
+    BOOST_CHECK(limiter.allowed(1500, t0 + limiter.delay(1500, t0)));
+
+    // refill is capped at burst
+    BOOST_CHECK_EQUAL(4000u, limiter.allowance(t0 + std::chrono::seconds(60)));
+
+    // message larger than burst is allowed on a full bucket, then the bucket must refill past zero
+    Clock::time_point const t1 = t0 + std::chrono::seconds(60);
+    BOOST_CHECK(limiter.allowed(10000, t1));
+    limiter.consume(10000);
+    BOOST_CHECK_EQUAL(0u, limiter.allowance(t1));
+    BOOST_CHECK(!limiter.allowed(1, t1 + std::chrono::seconds(6)));
+    BOOST_CHECK(limiter.allowed(1, t1 + std::chrono::seconds(7)));
+}
+
+namespace
+{
+    struct LoopRecorder
+    {
+        HeadlessEventLoop * loop_;
+        std::vector<int> order_;
+    };
+    LoopRecorder loopRecorder;
+
+    template <int N>
+    void loopRecord(void * data)
+    {
+        static_cast<LoopRecorder*>(data)->order_.push_back(N);
+    }
+
+    void loopQuit(void * data)
+    {
+        static_cast<LoopRecorder*>(data)->loop_->quit();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testHeadlessEventLoop)
+{
+    HeadlessEventLoop loop;
+    loopRecorder.loop_ = &loop;
+
+    // events in order added, before timeouts, timeouts in due order then in order added
+    loop.addTimeout(0.02, loopRecord<5>, &loopRecorder);
+    loop.addTimeout(0.01, loopRecord<3>, &loopRecorder);
+    loop.addTimeout(0.01, loopRecord<4>, &loopRecorder);
+    loop.addTimeout(0.01, loopRecord<9>, &loopRecorder);
+    loop.removeTimeout(loopRecord<9>, &loopRecorder);
+    loop.addCallbackEvent(loopRecord<1>, &loopRecorder);
+    loop.addCallbackEvent(loopRecord<2>, &loopRecorder);
+    BOOST_CHECK_EQUAL(loop.runFor(0.1), 5);
+    BOOST_CHECK((loopRecorder.order_ == std::vector<int>{ 1, 2, 3, 4, 5 }));
+
+    // events posted from another thread keep their order, quit from a callback stops run
+    loopRecorder.order_.clear();
+    std::thread poster([&loop]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                loop.addCallbackEvent(i % 2 ? loopRecord<1> : loopRecord<0>, &loopRecorder);
+            }
+            loop.addCallbackEvent(loopQuit, &loopRecorder);
+        });
+    loop.run();
+    poster.join();
+    BOOST_REQUIRE_EQUAL(loopRecorder.order_.size(), 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK_EQUAL(loopRecorder.order_[i], i % 2);
+    }
+
+    // nothing due
+    BOOST_CHECK_EQUAL(loop.runFor(0.01), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testProcess)
+{
+    typedef std::vector<std::string> Args;
+
+    BOOST_CHECK(Args() == Process::splitArgs("  "));
+    BOOST_CHECK(Args({ "spring", "--window", "script.txt" }) == Process::splitArgs(" spring  --window\tscript.txt "));
+    BOOST_CHECK(Args({ "/opt/my spring/spring", "a b", "" }) == Process::splitArgs("\"/opt/my spring/spring\" 'a b' ''"));
+    BOOST_CHECK(Args({ "a\"b", "c d", "$x" }) == Process::splitArgs("\"a\\\"b\" c\\ d '$x'"));
+    BOOST_CHECK(Args({ "abc" }) == Process::splitArgs("'abc"));
+
+    {
+        Args lines;
+        int const ret = Process::run({ "sh", "-c", "echo first; echo second 1>&2; printf 'a\\rb'; exit 3" }, "ProcessTest.log",
+            [&lines](std::string const & line) { lines.push_back(line); });
+        BOOST_CHECK_EQUAL(3, ret);
+        BOOST_CHECK(Args({ "first", "second", "a", "b" }) == lines);
+
+        std::ifstream ifs("ProcessTest.log");
+        std::string first;
+        std::getline(ifs, first);
+        BOOST_CHECK_EQUAL("first", first);
+    }
+
+    BOOST_CHECK_EQUAL(0, Process::run({ "true" }, ""));
+    BOOST_CHECK_EQUAL(128 + 9, Process::run({ "sh", "-c", "kill -9 $$" }, ""));
+    BOOST_CHECK_THROW(Process::run({ "flobby_no_such_command" }, ""), std::runtime_error);
+    BOOST_CHECK_THROW(Process::run({}, ""), std::invalid_argument);
+
+    // detached children are reaped without a further spawn, run still gets its own child's exit code
+    auto const zombieChildren = []()
+    {
+        int count = 0;
+        for (boost::filesystem::directory_iterator it("/proc"), end; it != end; ++it)
+        {
+            std::ifstream ifs(it->path().string() + "/stat");
+            std::string stat;
+            std::getline(ifs, stat); // pid (comm) state ppid ...
+            std::size_t const paren = stat.rfind(')');
+            std::istringstream iss(paren == std::string::npos ? "" : stat.substr(paren + 1));
+            char state;
+            int ppid;
+            if (iss >> state >> ppid && ppid == ::getpid() && state == 'Z')
+            {
+                ++count;
+            }
+        }
+        return count;
+    };
+    Process::spawnDetached({ "true" });
+    Process::spawnDetached({ "sh", "-c", "exit 1" });
+    BOOST_CHECK_EQUAL(3, Process::run({ "sh", "-c", "sleep 0.1; exit 3" }, ""));
+    int zombies = zombieChildren();
+    for (int i = 0; i < 100 && zombies > 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        zombies = zombieChildren();
+    }
+    BOOST_CHECK_EQUAL(0, zombies);
+}
+
+BOOST_AUTO_TEST_CASE(testSoundSample)
+{
+    // 16 bit stereo at 22050 Hz, 4 frames, left and right are averaged
+    auto u32 = [](uint32_t v) { return std::string({ char(v), char(v >> 8), char(v >> 16), char(v >> 24) }); };
+    auto u16 = [](uint16_t v) { return std::string({ char(v), char(v >> 8) }); };
+    std::string data;
+    for (int16_t v : { 1000, 3000, 2000, 2000, -4000, -4000, 0, 100 })
+    {
+        data += u16(v);
+    }
+    std::string const fmt = "fmt " + u32(16) + u16(1) + u16(2) + u32(22050) + u32(22050*4) + u16(4) + u16(16);
+    std::string const wav = "RIFF" + u32(4 + fmt.size() + 8 + data.size()) + "WAVE" + fmt + "data" + u32(data.size()) + data;
+    {
+        std::ofstream ofs("SoundTest.wav", std::ios::binary);
+        ofs << wav;
+    }
+
+    auto sample = SoundSample::loadWav("SoundTest.wav", 44100);
+    BOOST_CHECK_EQUAL(44100, sample->rate_);
+    BOOST_REQUIRE_EQUAL(8u, sample->data_.size());
+    BOOST_CHECK_EQUAL(2000, sample->data_[0]);
+    BOOST_CHECK_EQUAL(2000, sample->data_[1]); // interpolated between equal frames
+    BOOST_CHECK_EQUAL(2000, sample->data_[2]);
+    BOOST_CHECK_EQUAL(-1000, sample->data_[3]); // half way to -4000
+    BOOST_CHECK_EQUAL(-4000, sample->data_[4]);
+    BOOST_CHECK_EQUAL(50, sample->data_[6]);
+
+    BOOST_CHECK_THROW(SoundSample::loadWav("SoundTestNoSuchFile.wav", 44100), std::invalid_argument);
+    {
+        std::ofstream ofs("SoundTest.wav", std::ios::binary);
+        ofs << "RIFF1234WAVEdata";
+    }
+    BOOST_CHECK_THROW(SoundSample::loadWav("SoundTest.wav", 44100), std::runtime_error);
+
+    auto tone = SoundSample::tone(1000, 10, 44100, 1.0);
+    BOOST_CHECK_EQUAL(441u, tone->data_.size());
+    BOOST_CHECK_EQUAL(0, tone->data_.front()); // faded in
+
+    // two voices are summed and clipped, silence after they end
+    std::shared_ptr<SoundSample> loud = std::make_shared<SoundSample>();
+    loud->rate_ = 44100;
+    loud->data_ = { 30000, 30000, -30000 };
+    SoundMixer mixer;
+    BOOST_CHECK(!mixer.active());
+    mixer.play(loud);
+    mixer.play(loud);
+    BOOST_CHECK(mixer.active());
+    int16_t out[4];
+    mixer.mix(out, 4);
+    BOOST_CHECK_EQUAL(32767, out[0]);
+    BOOST_CHECK_EQUAL(-32768, out[2]);
+    BOOST_CHECK_EQUAL(0, out[3]);
+    BOOST_CHECK(!mixer.active());
+}
+
+BOOST_AUTO_TEST_CASE(testSoundUseCommandDefault)
+{
+    // older versions stored the default command at every start, only a changed command is still used
+    BOOST_CHECK_EQUAL(0, SoundSettingsDialog::useCommandDefault(0));
+    BOOST_CHECK_EQUAL(0, SoundSettingsDialog::useCommandDefault("xkbbell -v 100"));
+    BOOST_CHECK_EQUAL(1, SoundSettingsDialog::useCommandDefault("aplay ~/beep.wav"));
+}
+
 static
 void logThread(int id)
 {
@@ -544,6 +2059,164 @@ BOOST_AUTO_TEST_CASE(testLog)
     }
 }
 
+BOOST_AUTO_TEST_CASE(testLogFileTail)
+{
+    typedef std::vector<std::string> Lines;
+    std::string const fileName = "LogFileTail.log";
+
+    BOOST_CHECK(LogFile::tail("flobby_no_such_file.log", 10).empty());
+
+    {
+        std::ofstream ofs(fileName);
+        ofs << "\nNEW LOG SESSION 2016-01-01 10:00:00\n";
+        for (int i = 0; i < 5000; ++i)
+        {
+            ofs << "2016-01-01 10:00:00: line " << i << "\n";
+        }
+        ofs << "\nNEW LOG SESSION 2016-01-02 10:00:00\n" << "2016-01-02 10:00:00: last";
+    }
+
+    BOOST_CHECK(Lines({ "2016-01-01 10:00:00: line 4999", "NEW LOG SESSION 2016-01-02 10:00:00", "2016-01-02 10:00:00: last" })
+        == LogFile::tail(fileName, 3));
+    BOOST_CHECK_EQUAL(5003u, LogFile::tail(fileName, 10000).size());
+    BOOST_CHECK_EQUAL("NEW LOG SESSION 2016-01-01 10:00:00", LogFile::tail(fileName, 10000).front());
+
+    // only complete lines within maxBytes
+    Lines const lines = LogFile::tail(fileName, 10000, 100);
+    BOOST_CHECK(!lines.empty() && lines.size() < 5);
+    BOOST_CHECK_EQUAL("2016-01-02 10:00:00: last", lines.back());
+    BOOST_CHECK(boost::starts_with(lines.front(), "2016-01-01") || boost::starts_with(lines.front(), "NEW LOG"));
+
+    // line starting exactly at maxBytes is complete
+    std::string const last = "2016-01-02 10:00:00: last";
+    BOOST_CHECK(Lines({ last }) == LogFile::tail(fileName, 10000, last.size()));
+    BOOST_CHECK(Lines({ "NEW LOG SESSION 2016-01-02 10:00:00", last }) == LogFile::tail(fileName, 10000, last.size() + 36));
+    BOOST_CHECK(Lines({ last }) == LogFile::tail(fileName, 10000, last.size() + 35));
+}
+
+BOOST_AUTO_TEST_CASE(testLogIndex)
+{
+    namespace fs = boost::filesystem;
+    std::string const dir = "LogIndexTest/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    BOOST_CHECK(std::vector<std::string>({ "hello", "wörld", "42" }) == LogIndex::words("Hello, wörld! a 42"));
+
+    // old log, indexed by update
+    {
+        std::ofstream ofs(dir + "channel_main.log");
+        ofs << "\nNEW LOG SESSION 2016-01-01 10:00:00\n";
+        for (int i = 0; i < 1000; ++i)
+        {
+            ofs << "2016-01-01 10:00:00: alice: line " << i << "\n";
+        }
+        ofs << "2016-02-01 10:00:00: bob: Spring rocks\n";
+        ofs << "2016-03-01 10:00:00: incomplete";
+    }
+
+    {
+        LogIndex index(dir);
+        index.update();
+
+        LogIndex::Query query;
+        query.text_ = "SPRING rocks";
+        std::vector<LogIndex::Hit> hits = index.search(query);
+        BOOST_REQUIRE_EQUAL(1u, hits.size());
+        BOOST_CHECK_EQUAL("channel_main", hits[0].logName_);
+        BOOST_CHECK_EQUAL("2016-02-01 10:00:00: bob: Spring rocks", hits[0].line_);
+
+        int hitLine;
+        std::vector<std::string> const context = LogIndex::context(index.path(hits[0].logName_), hits[0].offset_, 2, hitLine);
+        BOOST_REQUIRE_EQUAL(3u, context.size()); // incomplete last line is not included
+        BOOST_CHECK_EQUAL(2, hitLine);
+        BOOST_CHECK_EQUAL("2016-01-01 10:00:00: alice: line 998", context[0]);
+
+        // new lines added as they are logged
+        uint64_t const offset = 0;
+        {
+            std::ofstream ofs(dir + "chat_bob.log");
+            ofs << "2016-04-01 10:00:00: bob: more spring\n";
+        }
+        index.add("chat_bob", offset, "2016-04-01 10:00:00: bob: more spring");
+
+        query.text_ = "spring";
+        hits = index.search(query);
+        BOOST_REQUIRE_EQUAL(2u, hits.size());
+        BOOST_CHECK_EQUAL("chat_bob", hits[0].logName_); // newest first
+
+        query.since_ = "2016-03";
+        BOOST_CHECK_EQUAL(1u, index.search(query).size());
+        query.since_.clear();
+        query.logName_ = "main";
+        BOOST_CHECK_EQUAL(1u, index.search(query).size());
+        query.logName_.clear();
+
+        query.text_ = "line";
+        query.userName_ = "alice";
+        BOOST_CHECK_EQUAL(100u, index.search(query, 100).size());
+        query.userName_ = "bob";
+        BOOST_CHECK(index.search(query).empty());
+
+        index.flush();
+    }
+
+    // index is loaded from disk, incomplete line is indexed when completed, left over temporary files are removed
+    {
+        std::ofstream ofs(dir + "channel_main.log", std::ios::app);
+        ofs << " now\n";
+    }
+    {
+        std::ofstream ofs(dir + "index/seg99.tmp");
+        ofs << "FLIX1";
+    }
+    LogIndex index(dir);
+    BOOST_CHECK(!index.ready());
+    LogIndex::Query query;
+    query.text_ = "line 999";
+    BOOST_CHECK_EQUAL(1u, index.search(query).size());
+    BOOST_CHECK(!fs::exists(dir + "index/seg99.tmp"));
+    query.text_ = "spring";
+    BOOST_CHECK_EQUAL(2u, index.search(query).size());
+    query.text_ = "incomplete";
+    BOOST_CHECK(index.search(query).empty());
+    index.update();
+    BOOST_CHECK(index.ready());
+    BOOST_CHECK(!fs::exists(dir + "index/seg1") && !fs::exists(dir + "index/seg2")); // merged into seg3 and removed
+    BOOST_CHECK_EQUAL(1u, index.search(query).size());
+
+    // filters are applied to the newest lines before the candidate limit
+    query.text_ = "line";
+    query.userName_ = "alice";
+    query.since_ = "2016-01-01";
+    std::vector<LogIndex::Hit> const hits = index.search(query, 3);
+    BOOST_REQUIRE_EQUAL(3u, hits.size());
+    BOOST_CHECK_EQUAL("2016-01-01 10:00:00: alice: line 999", hits[0].line_);
+
+    // a crash after a segment was written and before the indexed sizes were saved only gives duplicate postings
+    {
+        std::ifstream ifs(dir + "index/files");
+        std::string names;
+        for (std::string line; std::getline(ifs, line); )
+        {
+            names += "0" + line.substr(line.find('\t')) + "\n";
+        }
+        ifs.close();
+        std::ofstream ofs(dir + "index/files");
+        ofs << names;
+    }
+    LogIndex reloaded(dir);
+    reloaded.update();
+    query = LogIndex::Query();
+    query.text_ = "spring";
+    std::vector<LogIndex::Hit> const reloadedHits = reloaded.search(query);
+    BOOST_REQUIRE_EQUAL(2u, reloadedHits.size());
+    BOOST_CHECK_EQUAL("chat_bob", reloadedHits[0].logName_);
+    BOOST_CHECK_EQUAL("channel_main", reloadedHits[1].logName_);
+
+    fs::remove_all(dir);
+}
+
 BOOST_AUTO_TEST_CASE(testTextFunctions)
 {
     typedef std::vector<std::string> StringVector;
@@ -665,6 +2338,79 @@ BOOST_AUTO_TEST_CASE(testNightwatch)
 
 }
 
+BOOST_AUTO_TEST_CASE(testHostMessage)
+{
+    {
+        HostMessage const hm = recognizeHostMessage("Poll: Change map to Comet Catcher Redux? [!y=0/3, !n=0/3]");
+        BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_START, hm.type_);
+        BOOST_CHECK_EQUAL("Springie", std::string(hm.dialect_));
+        BOOST_CHECK_EQUAL("Change map to Comet Catcher Redux? [!y=0/3, !n=0/3]", hm.text_);
+    }
+    {
+        HostMessage const hm = recognizeHostMessage("Poll: Change map to Comet Catcher Redux? [END:SUCCESS]");
+        BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_END, hm.type_);
+        BOOST_CHECK_EQUAL("Change map to Comet Catcher Redux? [END:SUCCESS]", hm.text_);
+    }
+    {
+        std::string const msg = "* bob called a vote for command \"bSet startpostype 2\" [!vote y, !vote n, !vote b]";
+        HostMessage const hm = recognizeHostMessage(msg);
+        BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_START, hm.type_);
+        BOOST_CHECK_EQUAL("SPADS", std::string(hm.dialect_));
+        BOOST_CHECK_EQUAL(msg, hm.text_);
+    }
+    BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_START, recognizeHostMessage("* Vote in progress: \"map DSD\" [y:1/2, n:0/2]").type_);
+    BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_END, recognizeHostMessage("* Vote for command \"map DSD\" passed.").type_);
+    BOOST_CHECK_EQUAL(HostMessage::HM_VOTE_END, recognizeHostMessage("* Vote cancelled by bob").type_);
+    {
+        HostMessage const hm = recognizeHostMessage("!pm|chan1|user1|07/01/2015 03:32:14|a|b");
+        BOOST_CHECK_EQUAL(HostMessage::HM_NIGHTWATCH_PM, hm.type_);
+        BOOST_REQUIRE_EQUAL(4u, hm.fieldCount_);
+        BOOST_CHECK_EQUAL("chan1", hm.fields_[0]);
+        BOOST_CHECK_EQUAL("a|b", hm.fields_[3]);
+    }
+    BOOST_CHECK_EQUAL(HostMessage::HM_NONE, recognizeHostMessage("").type_);
+    BOOST_CHECK_EQUAL(HostMessage::HM_NONE, recognizeHostMessage("Poll").type_);
+    BOOST_CHECK_EQUAL(HostMessage::HM_NONE, recognizeHostMessage("!pm|a|b").type_);
+    BOOST_CHECK_EQUAL(HostMessage::HM_NONE, recognizeHostMessage("gl hf").type_);
+}
+
+// benchmark, run with: unittest --run_test=benchHostMessage
+BOOST_AUTO_TEST_CASE(benchHostMessage, * boost::unit_test::disabled())
+{
+    // battle chat as seen from SPADS and Springie hosts, most lines are not host messages
+    std::vector<std::string> const corpus =
+    {
+        "gl hf",
+        "* Map changed by bob: DeltaSiegeDry",
+        "* bob called a vote for command \"map DeltaSiegeDry\" [!vote y, !vote n, !vote b]",
+        "* Vote in progress: \"map DeltaSiegeDry\" [y:1/3, n:0/3(2)] (25s remaining)",
+        "* Vote for command \"map DeltaSiegeDry\" passed.",
+        "* Balancing according to TrueSkill ratings... (2 teams of 4)",
+        "can we play something else",
+        "Poll: Change map to Comet Catcher Redux? [!y=1/4, !n=0/4]",
+        "Poll: Change map to Comet Catcher Redux? [END:SUCCESS]",
+        "* Hi bob! Current battle type is team.",
+        "!pm|zk|alice|07/01/2015 03:32:14|anyone up for a game?",
+        "rdy",
+    };
+
+    int const loops = 100000;
+    std::size_t recognized = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; ++i)
+    {
+        for (std::string const & msg : corpus)
+        {
+            recognized += recognizeHostMessage(msg).type_ != HostMessage::HM_NONE;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "recognizeHostMessage: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()/(loops*corpus.size()) << " ns/line" << std::endl;
+
+    BOOST_CHECK_EQUAL(6u*loops, recognized);
+}
+
 BOOST_AUTO_TEST_CASE(testLobbyProtocol)
 {
     using namespace LobbyProtocol;
@@ -773,3 +2519,122 @@ BOOST_AUTO_TEST_CASE(test_getLastWord)
         BOOST_CHECK(pairWordPos.second == 5);
     }
 }
+
+BOOST_AUTO_TEST_CASE(testMapAnalysis)
+{
+    // 8x4 metal map, one 2x2 spot top left, one diagonal spot bottom right (8-connected)
+    uint8_t const metal[] = {
+        255, 255, 0, 0, 0, 0, 0, 0,
+        255, 255, 0, 0, 0, 0, 0, 0,
+        0,   0,   0, 0, 0, 0, 100, 0,
+        0,   0,   0, 0, 0, 0, 0, 100 };
+
+    // 5x3 height map, ramp in x direction, 2 steps per cell
+    uint8_t const height[] = {
+        0, 2, 4, 6, 8,
+        0, 2, 4, 6, 8,
+        0, 2, 4, 6, 8 };
+
+    MapAnalysis ma;
+    ma.analyze(metal, 8, 4, height, 5, 3);
+
+    BOOST_REQUIRE_EQUAL(2, ma.spots().size());
+    BOOST_CHECK_EQUAL(4, ma.spots()[0].cells_);
+    BOOST_CHECK_EQUAL(4*255, ma.spots()[0].value_);
+    BOOST_CHECK_CLOSE(1.0/8, ma.spots()[0].x_, 0.01);
+    BOOST_CHECK_CLOSE(1.0/4, ma.spots()[0].y_, 0.01);
+    BOOST_CHECK_EQUAL(2, ma.spots()[1].cells_);
+    BOOST_CHECK_EQUAL(200, ma.spots()[1].value_);
+    BOOST_CHECK_CLOSE(7.0/8, ma.spots()[1].x_, 0.01);
+    BOOST_CHECK_EQUAL(4*255 + 200, ma.metalValue());
+
+    BOOST_CHECK_CLOSE(2.0, ma.meanSlope(), 0.01);
+    BOOST_CHECK_CLOSE(2.0, ma.maxSlope(), 0.01);
+    BOOST_CHECK_EQUAL(0, ma.flatFraction());
+
+    // left half and right half boxes
+    MapAnalysis::BoxSummary left = ma.boxSummary(StartRect(0, 0, 0, 100, 200));
+    BOOST_CHECK_EQUAL(1, left.spots_);
+    BOOST_CHECK_EQUAL(4*255, left.value_);
+    BOOST_CHECK_CLOSE(2.0, left.meanSlope_, 0.01);
+
+    MapAnalysis::BoxSummary right = ma.boxSummary(StartRect(1, 100, 0, 200, 200));
+    BOOST_CHECK_EQUAL(1, right.spots_);
+    BOOST_CHECK_EQUAL(200, right.value_);
+
+    // serialization
+    std::stringstream ss;
+    ss << ma;
+    MapAnalysis ma2;
+    ss >> ma2;
+    BOOST_REQUIRE_EQUAL(2, ma2.spots().size());
+    BOOST_CHECK_EQUAL(ma.spots()[1].value_, ma2.spots()[1].value_);
+    BOOST_CHECK_CLOSE(ma.meanSlope(), ma2.meanSlope(), 0.01);
+    BOOST_CHECK_EQUAL(200, ma2.boxSummary(StartRect(1, 100, 0, 200, 200)).value_);
+
+    // no info maps
+    MapAnalysis empty;
+    empty.analyze(nullptr, 0, 0, nullptr, 0, 0);
+    BOOST_CHECK(empty.spots().empty());
+    BOOST_CHECK_EQUAL(0, empty.boxSummary(StartRect(0, 0, 0, 200, 200)).meanSlope_);
+}
+
+BOOST_AUTO_TEST_CASE(testBattleFilter)
+{
+    std::string const opened =
+            "8235 0 0 Founder " // id, replay, nat, founder
+            "94.23.170.70 8463 32 " // ip, port, maxPlayers
+            "1 2 -112462944 " // passw, rank, mapHash
+            "engineName\t"
+            "104.0\t"
+            "Comet Catcher Redux\t"
+            "Battle title\t"
+            "Zero-K v1.5";
+
+    std::stringstream ssOpened(opened);
+    Battle b(ssOpened);
+
+    // default passes all
+    {
+        BattleFilter filter;
+        BOOST_CHECK(filter.passes(b));
+        BOOST_CHECK_EQUAL(0, filter.fields());
+    }
+
+    // text filters are case-insensitive, comma separated and trimmed
+    {
+        BattleFilter::Settings settings;
+        settings.game_ = "nota, zero";
+        settings.map_ = "COMET";
+        BattleFilter filter(settings);
+        BOOST_CHECK(filter.passes(b));
+        BOOST_CHECK_EQUAL(BF_GAME | BF_MAP, filter.fields());
+
+        settings.engine_ = "105";
+        BOOST_CHECK(!BattleFilter(settings).passes(b));
+
+        // empty token matches all
+        settings.engine_ = "105,";
+        BOOST_CHECK(BattleFilter(settings).passes(b));
+        BOOST_CHECK_EQUAL(0, BattleFilter(settings).fields() & BF_ENGINE);
+    }
+
+    // players, rank and status
+    {
+        BattleFilter::Settings settings;
+        settings.minPlayers_ = 1;
+        BOOST_CHECK(!BattleFilter(settings).passes(b)); // no users in battle
+        BOOST_CHECK_EQUAL(BF_PLAYERS, BattleFilter(settings).fields());
+
+        settings = BattleFilter::Settings();
+        settings.maxRank_ = 1;
+        BOOST_CHECK(!BattleFilter(settings).passes(b));
+        settings.maxRank_ = 2;
+        BOOST_CHECK(BattleFilter(settings).passes(b));
+
+        settings = BattleFilter::Settings();
+        settings.hidePassworded_ = true;
+        BOOST_CHECK(!BattleFilter(settings).passes(b));
+        BOOST_CHECK_EQUAL(BF_STATUS, BattleFilter(settings).fields());
+    }
+}